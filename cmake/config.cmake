@@ -358,6 +358,19 @@ if(HAVE_STATX)
     set(CONFIG_HAVE_STATX 1)
 endif()
 
+# Check for epoll support
+check_c_source_compiles("
+#include <sys/epoll.h>
+int main(int argc, char **argv) {
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET };
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    return epoll_ctl(fd, EPOLL_CTL_ADD, 0, &ev) + epoll_wait(fd, &ev, 1, 0);
+}
+" HAVE_EPOLL)
+if(HAVE_EPOLL)
+    set(CONFIG_HAVE_EPOLL 1)
+endif()
+
 # Check for RUSAGE_THREAD
 check_c_source_compiles("
 #include <sys/time.h>
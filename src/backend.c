@@ -44,9 +44,12 @@
 #include "idletime.h"
 #include "err.h"
 #include "workqueue.h"
+#include "log_stream.h"
+#include "iolog_decomp.h"
 #include "lib/mountcheck.h"
 #include "rate-submit.h"
 #include "helper_thread.h"
+#include "timeline.h"
 #include "pshared.h"
 #include "zone-dist.h"
 #include "fio_time.h"
@@ -376,6 +379,7 @@ static void check_update_rusage(struct thread_data *td)
 	if (td->update_rusage) {
 		td->update_rusage = 0;
 		update_rusage_stat(td);
+		rate_submit_sum_stats(td);
 		fio_sem_up(td->rusage_sem);
 	}
 }
@@ -660,7 +664,7 @@ static void do_verify(struct thread_data *td, uint64_t verify_bytes)
 					 * Pretend we issued it for rwmix
 					 * accounting
 					 */
-					td->io_issues[DDIR_READ]++;
+					td_io_issues_inc(td, DDIR_READ);
 					put_io_u(td, io_u);
 					continue;
 				} else if (io_u->ddir == DDIR_TRIM) {
@@ -1013,7 +1017,7 @@ void clear_inflight(struct thread_data *td)
 	 * Experimental verify can increment io_issues for writes, so catch
 	 * inflight_issued up in between loops.
 	 */
-	td->inflight_issued = td->io_issues[DDIR_WRITE];
+	td->inflight_issued = td_io_issues(td, DDIR_WRITE);
 }
 
 /*
@@ -1125,7 +1129,7 @@ static void do_io(struct thread_data *td, uint64_t *bytes_done)
 		if (io_u->ddir == DDIR_WRITE && td->flags & TD_F_DO_VERIFY) {
 			if (!(io_u->flags & IO_U_F_PATTERN_DONE)) {
 				io_u_set(td, io_u, IO_U_F_PATTERN_DONE);
-				io_u->numberio = td->io_issues[io_u->ddir];
+				io_u->numberio = td_io_issues(td, io_u->ddir);
 				populate_verify_io_u(td, io_u);
 				log_inflight(td, io_u);
 			}
@@ -1152,7 +1156,7 @@ static void do_io(struct thread_data *td, uint64_t *bytes_done)
 					io_u->rand_seed *= __rand(&td->verify_state);
 			}
 
-			if (verify_state_should_stop(td, td->io_issues[io_u->ddir])) {
+			if (verify_state_should_stop(td, td_io_issues(td, io_u->ddir))) {
 				put_io_u(td, io_u);
 				break;
 			}
@@ -1189,7 +1193,7 @@ static void do_io(struct thread_data *td, uint64_t *bytes_done)
 			ret = FIO_Q_QUEUED;
 
 			if (ddir_rw(__ddir)) {
-				td->io_issues[__ddir]++;
+				td_io_issues_inc(td, __ddir);
 				td->io_issue_bytes[__ddir] += blen;
 				td->rate_io_issue_bytes[__ddir] += blen;
 			}
@@ -1312,6 +1316,9 @@ static int init_inflight_logging(struct thread_data *td)
 	for (i = 0; i < td->o.iodepth; i++)
 		td->inflight_numberio[i] = INVALID_NUMBERIO;
 
+	if (verify_state_journal_enabled(td))
+		return verify_state_journal_init(td);
+
 	return 0;
 }
 
@@ -1325,6 +1332,19 @@ static void cleanup_io_u(struct thread_data *td)
 {
 	struct io_u *io_u;
 
+	/*
+	 * The rings aren't set up if the job failed before init_io_u()
+	 */
+	if (td->io_u_requeues.ring) {
+		while ((io_u = io_u_rpop(&td->io_u_requeues)) != NULL)
+			put_io_u(td, io_u);
+	}
+
+	if (td->io_u_freering.ring) {
+		while ((io_u = io_u_rpop(&td->io_u_freering)) != NULL)
+			io_u_qpush(&td->io_u_freelist, io_u);
+	}
+
 	while ((io_u = io_u_qpop(&td->io_u_freelist)) != NULL) {
 
 		if (td->io_ops->io_u_free)
@@ -1333,13 +1353,10 @@ static void cleanup_io_u(struct thread_data *td)
 		fio_memfree(io_u, sizeof(*io_u), td_offload_overlap(td));
 	}
 
-	while ((io_u = io_u_rpop(&td->io_u_requeues)) != NULL) {
-		put_io_u(td, io_u);
-	}
-
 	free_io_mem(td);
 
 	io_u_rexit(&td->io_u_requeues);
+	io_u_rexit(&td->io_u_freering);
 	io_u_qexit(&td->io_u_freelist, false);
 	io_u_qexit(&td->io_u_all, td_offload_overlap(td));
 
@@ -1355,6 +1372,7 @@ static int init_io_u(struct thread_data *td)
 
 	err = 0;
 	err += !io_u_rinit(&td->io_u_requeues, td->o.iodepth);
+	err += !io_u_rinit(&td->io_u_freering, td->o.iodepth);
 	err += !io_u_qinit(&td->io_u_freelist, td->o.iodepth, false);
 	err += !io_u_qinit(&td->io_u_all, td->o.iodepth, td_offload_overlap(td));
 
@@ -1379,7 +1397,6 @@ static int init_io_u(struct thread_data *td)
 
 		io_u = ptr;
 		memset(io_u, 0, sizeof(*io_u));
-		INIT_FLIST_HEAD(&io_u->verify_list);
 		dprint(FD_MEM, "io_u alloc %p, index %u\n", io_u, i);
 
 		io_u->inflight_idx = -1;
@@ -1434,9 +1451,10 @@ int init_io_u_buffers(struct thread_data *td)
 
 	/*
 	 * For reads, writes, and multi-range trim operations we need a
-	 * data buffer
+	 * data buffer, unless the engine brings its own
 	 */
 	if (td_ioengine_flagged(td, FIO_NOIO) ||
+	    (td->flags & TD_F_ENGINE_BUFS) ||
 	    !(td_read(td) || td_write(td) || (td_trim(td) && td->o.num_range > 1)))
 		data_xfer = 0;
 
@@ -1703,10 +1721,8 @@ static uint64_t do_dry_run(struct thread_data *td)
 		io_u_set(td, io_u, IO_U_F_FLIGHT);
 		io_u->error = 0;
 		io_u->resid = 0;
-		if (ddir_rw(acct_ddir(io_u))) {
-			io_u->numberio = td->io_issues[acct_ddir(io_u)];
-			td->io_issues[acct_ddir(io_u)]++;
-		}
+		if (ddir_rw(acct_ddir(io_u)))
+			io_u->numberio = td_io_issues_inc(td, acct_ddir(io_u));
 
 		if (ddir_rw(io_u->ddir)) {
 			io_u_mark_depth(td, 1);
@@ -1765,7 +1781,6 @@ static void *thread_main(void *data)
 
 	INIT_FLIST_HEAD(&td->io_log_list);
 	INIT_FLIST_HEAD(&td->io_hist_list);
-	INIT_FLIST_HEAD(&td->verify_list);
 	INIT_FLIST_HEAD(&td->trim_list);
 	td->io_hist_tree = RB_ROOT;
 
@@ -1774,11 +1789,6 @@ static void *thread_main(void *data)
 		td_verror(td, ret, "mutex_cond_init_pshared");
 		goto err;
 	}
-	ret = cond_init_pshared(&td->verify_cond);
-	if (ret) {
-		td_verror(td, ret, "mutex_cond_pshared");
-		goto err;
-	}
 
 	td_set_runstate(td, TD_INITIALIZED);
 	dprint(FD_MUTEX, "up startup_sem\n");
@@ -1809,6 +1819,8 @@ static void *thread_main(void *data)
 	 */
 	if (iolog_compress_init(td, sk_out))
 		goto err;
+	if (log_stream_init(td, sk_out))
+		goto err;
 
 	/*
 	 * If we have a gettimeofday() thread, make sure we exclude that
@@ -2124,6 +2136,7 @@ static void *thread_main(void *data)
 	td_writeout_logs(td, true);
 
 	iolog_compress_exit(td);
+	log_stream_exit(td);
 	rate_submit_exit(td);
 
 	if (o->exec_postrun)
@@ -2146,6 +2159,7 @@ err:
 	cgroup_shutdown(td, cgroup_mnt);
 	verify_free_state(td);
 	td_zone_free_index(td);
+	free_dedupe_working_set(td);
 
 	if (fio_option_is_set(o, cpumask)) {
 		ret = fio_cpuset_exit(&o->cpumask);
@@ -2159,7 +2173,9 @@ err:
 	if (o->write_iolog_file)
 		write_iolog_close(td);
 	if (td->io_log_rfile)
-		fclose(td->io_log_rfile);
+		iolog_fclose(td->io_log_rfile);
+	iolog_bin_read_close(td);
+	iolog_text_read_close(td);
 
 	td_set_runstate(td, TD_EXITED);
 
@@ -2744,6 +2760,8 @@ int fio_backend(struct sk_out *sk_out)
 	stat_init();
 	if (helper_thread_create(startup_sem, sk_out))
 		log_err("fio: failed to create helper thread\n");
+	if (timeline_create())
+		log_err("fio: failed to create timeline thread\n");
 
 	cgroup_list = smalloc(sizeof(*cgroup_list));
 	if (cgroup_list)
@@ -2752,6 +2770,7 @@ int fio_backend(struct sk_out *sk_out)
 	run_threads(sk_out);
 
 	helper_thread_exit();
+	timeline_exit();
 
 	if (!fio_abort) {
 		__show_run_stats();
@@ -2769,6 +2788,7 @@ int fio_backend(struct sk_out *sk_out)
 		struct thread_stat *ts = &td->ts;
 
 		free_clat_prio_stats(ts);
+		free_lat_hist_stats(ts);
 		steadystate_free(td);
 		fio_options_free(td);
 		fio_dump_options_free(td);
@@ -12,6 +12,7 @@
 #include "iolog.h"
 #include "blktrace.h"
 #include "blktrace_api.h"
+#include "iolog_decomp.h"
 #include "oslib/linux-dev-lookup.h"
 
 struct file_cache {
@@ -29,8 +30,23 @@ static int discard_pdu(FILE* f, struct blk_io_trace *t)
 		return 0;
 
 	dprint(FD_BLKTRACE, "discard pdu len %u\n", t->pdu_len);
-	if (fseek(f, t->pdu_len, SEEK_CUR) < 0)
-		return -errno;
+	if (fseek(f, t->pdu_len, SEEK_CUR) < 0) {
+		char buf[256];
+		size_t left = t->pdu_len;
+
+		/*
+		 * Decompressed input can't seek, read past the pdu instead
+		 */
+		if (errno != ESPIPE)
+			return -errno;
+		while (left) {
+			size_t ret = fread(buf, 1, min(left, sizeof(buf)), f);
+
+			if (!ret)
+				return ferror(f) ? -EIO : -ENODATA;
+			left -= ret;
+		}
+	}
 
 	return t->pdu_len;
 }
@@ -42,19 +58,12 @@ static int discard_pdu(FILE* f, struct blk_io_trace *t)
 bool is_blktrace(const char *filename, int *need_swap)
 {
 	struct blk_io_trace t;
-	int fd, ret;
-
-	fd = open(filename, O_RDONLY);
-	if (fd < 0)
-		return false;
-
-	ret = read(fd, &t, sizeof(t));
-	close(fd);
+	ssize_t ret;
 
-	if (ret < 0) {
-		perror("read blktrace");
+	ret = iolog_peek(filename, &t, sizeof(t));
+	if (ret < 0)
 		return false;
-	} else if (ret != sizeof(t)) {
+	else if (ret != sizeof(t)) {
 		log_err("fio: short read on blktrace file\n");
 		return false;
 	}
@@ -211,9 +220,12 @@ static bool handle_trace_discard(struct thread_data *td,
 	if (td->o.replay_skip & (1u << DDIR_TRIM))
 		return false;
 
+	fileno = trace_add_file(td, t->device, cache);
+	if (iolog_shard_skip(td, DDIR_TRIM, fileno, t->sector * 512, &ttime))
+		return false;
+
 	ipo = calloc(1, sizeof(*ipo));
 	init_ipo(ipo);
-	fileno = trace_add_file(td, t->device, cache);
 
 	ios[DDIR_TRIM]++;
 	if (t->bytes > bs[DDIR_TRIM])
@@ -269,6 +281,10 @@ static bool handle_trace_fs(struct thread_data *td, struct blk_io_trace *t,
 		return false;
 	}
 
+	if (iolog_shard_skip(td, rw ? DDIR_WRITE : DDIR_READ, fileno,
+			     t->sector * 512, &ttime))
+		return false;
+
 	if (t->bytes > bs[rw])
 		bs[rw] = t->bytes;
 
@@ -288,9 +304,12 @@ static bool handle_trace_flush(struct thread_data *td, struct blk_io_trace *t,
 	if (td->o.replay_skip & (1u << DDIR_SYNC))
 		return false;
 
+	fileno = trace_add_file(td, t->device, cache);
+	if (iolog_shard_skip(td, DDIR_SYNC, fileno, 0, &ttime))
+		return false;
+
 	ipo = calloc(1, sizeof(*ipo));
 	init_ipo(ipo);
-	fileno = trace_add_file(td, t->device, cache);
 
 	ipo->delay = ttime / 1000;
 	ipo->ddir = DDIR_SYNC;
@@ -406,7 +425,7 @@ bool init_blktrace_read(struct thread_data *td, const char *filename, int need_s
 {
 	int old_state;
 
-	td->io_log_rfile = fopen(filename, "rb");
+	td->io_log_rfile = iolog_fopen(filename);
 	if (!td->io_log_rfile) {
 		td_verror(td, errno, "open blktrace file");
 		goto err;
@@ -434,7 +453,7 @@ bool init_blktrace_read(struct thread_data *td, const char *filename, int need_s
 
 err:
 	if (td->io_log_rfile) {
-		fclose(td->io_log_rfile);
+		iolog_fclose(td->io_log_rfile);
 		td->io_log_rfile = NULL;
 	}
 	return false;
@@ -471,6 +490,12 @@ bool read_blktrace(struct thread_data* td)
 			td_verror(td, errno, "read blktrace file");
 			goto err;
 		} else if (feof(f)) {
+			/* a compressed trace may have ended early */
+			ret = iolog_ferror(f);
+			if (ret) {
+				td_verror(td, ret, "read blktrace file");
+				goto err;
+			}
 			break;
 		} else if (ret < (int) sizeof(t)) {
 			log_err("fio: iolog short read\n");
@@ -532,7 +557,7 @@ bool read_blktrace(struct thread_data* td)
 						td->o.name, skipped_writes);
 
 	if (td->o.read_iolog_chunked) {
-		if (td->io_log_current == 0) {
+		if (td->io_log_current == 0 && !iolog_sharded(td)) {
 			return false;
 		}
 		td->o.td_ddir = TD_DDIR_RW;
@@ -555,7 +580,7 @@ bool read_blktrace(struct thread_data* td)
 	for_each_file(td, fiof, i)
 		trace_add_open_close_event(td, fiof->fileno, FIO_LOG_CLOSE_FILE);
 
-	fclose(td->io_log_rfile);
+	iolog_fclose(td->io_log_rfile);
 	td->io_log_rfile = NULL;
 
 	/*
@@ -573,6 +598,9 @@ bool read_blktrace(struct thread_data* td)
 
 	if (!ios[DDIR_READ] && !ios[DDIR_WRITE] && !ios[DDIR_TRIM] &&
 	    !ios[DDIR_SYNC]) {
+		/* a shard that got no I/O leaves an idle clone */
+		if (iolog_sharded(td))
+			return true;
 		log_err("fio: found no ios in blktrace data\n");
 		return false;
 	}
@@ -599,7 +627,8 @@ bool read_blktrace(struct thread_data* td)
 
 	return true;
 err:
-	fclose(f);
+	iolog_fclose(f);
+	td->io_log_rfile = NULL;
 	return false;
 }
 
@@ -744,6 +773,17 @@ int merge_blktrace_iologs(struct thread_data *td)
 	str = ptr = strdup(td->o.read_iolog_file);
 	nr_logs = 0;
 	for (i = 0; (name = get_next_str(&ptr)) != NULL; i++) {
+		/*
+		 * Merging rewinds the inputs, which a decompressed stream
+		 * can't do
+		 */
+		if (iolog_compression(name) != IOLOG_COMP_NONE) {
+			log_err("fio: can't merge compressed blktrace %s, "
+				"decompress it first\n", name);
+			ret = -EINVAL;
+			free(str);
+			goto err_file;
+		}
 		bcs[i].f = fopen(name, "rb");
 		if (!bcs[i].f) {
 			log_err("fio: could not open file: %s\n", name);
@@ -41,6 +41,7 @@ static void free_thread_options_to_cpu(struct thread_options *o)
 	free(o->lat_log_file);
 	free(o->iops_log_file);
 	free(o->hist_log_file);
+	free(o->timeline_log_file);
 	free(o->replay_redirect);
 	free(o->exec_prerun);
 	free(o->exec_postrun);
@@ -88,6 +89,7 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	string_to_cpu(&o->lat_log_file, top->lat_log_file);
 	string_to_cpu(&o->iops_log_file, top->iops_log_file);
 	string_to_cpu(&o->hist_log_file, top->hist_log_file);
+	string_to_cpu(&o->timeline_log_file, top->timeline_log_file);
 	string_to_cpu(&o->replay_redirect, top->replay_redirect);
 	string_to_cpu(&o->exec_prerun, top->exec_prerun);
 	string_to_cpu(&o->exec_postrun, top->exec_postrun);
@@ -181,6 +183,8 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->do_verify = le32_to_cpu(top->do_verify);
 	o->experimental_verify = le32_to_cpu(top->experimental_verify);
 	o->verify_state = le32_to_cpu(top->verify_state);
+	o->verify_state_interval = le32_to_cpu(top->verify_state_interval);
+	o->verify_tracking = le32_to_cpu(top->verify_tracking);
 	o->verify_interval = le32_to_cpu(top->verify_interval);
 	o->verify_offset = le32_to_cpu(top->verify_offset);
 	o->verify_write_sequence = le32_to_cpu(top->verify_write_sequence);
@@ -223,6 +227,8 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->log_issue_time = le32_to_cpu(top->log_issue_time);
 	o->log_gz = le32_to_cpu(top->log_gz);
 	o->log_gz_store = le32_to_cpu(top->log_gz_store);
+	o->log_gz_type = le32_to_cpu(top->log_gz_type);
+	o->log_format = le32_to_cpu(top->log_format);
 	o->log_alternate_epoch = le32_to_cpu(top->log_alternate_epoch);
 	o->log_alternate_epoch_clock_id = le32_to_cpu(top->log_alternate_epoch_clock_id);
 	o->job_start_clock_id = le32_to_cpu(top->job_start_clock_id);
@@ -320,6 +326,8 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->lat_percentiles = le32_to_cpu(top->lat_percentiles);
 	o->slat_percentiles = le32_to_cpu(top->slat_percentiles);
 	o->percentile_precision = le32_to_cpu(top->percentile_precision);
+	o->lat_hist_precision = le32_to_cpu(top->lat_hist_precision);
+	o->lat_hist_max = le64_to_cpu(top->lat_hist_max);
 	o->sig_figs = le32_to_cpu(top->sig_figs);
 	o->continue_on_error = le32_to_cpu(top->continue_on_error);
 	o->cgroup_weight = le32_to_cpu(top->cgroup_weight);
@@ -345,11 +353,16 @@ int convert_thread_options_to_cpu(struct thread_options *o,
 	o->replay_scale = le32_to_cpu(top->replay_scale);
 	o->replay_time_scale = le32_to_cpu(top->replay_time_scale);
 	o->replay_skip = le32_to_cpu(top->replay_skip);
+	o->write_iolog_format = le32_to_cpu(top->write_iolog_format);
+	o->replay_shard = le32_to_cpu(top->replay_shard);
+	o->replay_shard_chunk = le32_to_cpu(top->replay_shard_chunk);
 	o->per_job_logs = le32_to_cpu(top->per_job_logs);
 	o->write_bw_log = le32_to_cpu(top->write_bw_log);
 	o->write_lat_log = le32_to_cpu(top->write_lat_log);
 	o->write_iops_log = le32_to_cpu(top->write_iops_log);
 	o->write_hist_log = le32_to_cpu(top->write_hist_log);
+	o->write_timeline_log = le32_to_cpu(top->write_timeline_log);
+	o->log_timeline_usec = le32_to_cpu(top->log_timeline_usec);
 
 	o->trim_backlog = le64_to_cpu(top->trim_backlog);
 	o->rate_process = le32_to_cpu(top->rate_process);
@@ -403,6 +416,7 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	string_to_net(top->lat_log_file, o->lat_log_file);
 	string_to_net(top->iops_log_file, o->iops_log_file);
 	string_to_net(top->hist_log_file, o->hist_log_file);
+	string_to_net(top->timeline_log_file, o->timeline_log_file);
 	string_to_net(top->replay_redirect, o->replay_redirect);
 	string_to_net(top->exec_prerun, o->exec_prerun);
 	string_to_net(top->exec_postrun, o->exec_postrun);
@@ -450,6 +464,8 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->do_verify = cpu_to_le32(o->do_verify);
 	top->experimental_verify = cpu_to_le32(o->experimental_verify);
 	top->verify_state = cpu_to_le32(o->verify_state);
+	top->verify_state_interval = cpu_to_le32(o->verify_state_interval);
+	top->verify_tracking = cpu_to_le32(o->verify_tracking);
 	top->verify_interval = cpu_to_le32(o->verify_interval);
 	top->verify_offset = cpu_to_le32(o->verify_offset);
 	top->verify_write_sequence = cpu_to_le32(o->verify_write_sequence);
@@ -475,6 +491,8 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->log_issue_time = cpu_to_le32(o->log_issue_time);
 	top->log_gz = cpu_to_le32(o->log_gz);
 	top->log_gz_store = cpu_to_le32(o->log_gz_store);
+	top->log_gz_type = cpu_to_le32(o->log_gz_type);
+	top->log_format = cpu_to_le32(o->log_format);
 	top->log_alternate_epoch = cpu_to_le32(o->log_alternate_epoch);
 	top->log_alternate_epoch_clock_id = cpu_to_le32(o->log_alternate_epoch_clock_id);
 	top->job_start_clock_id = cpu_to_le32(o->job_start_clock_id);
@@ -548,6 +566,8 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->lat_percentiles = cpu_to_le32(o->lat_percentiles);
 	top->slat_percentiles = cpu_to_le32(o->slat_percentiles);
 	top->percentile_precision = cpu_to_le32(o->percentile_precision);
+	top->lat_hist_precision = cpu_to_le32(o->lat_hist_precision);
+	top->lat_hist_max = __cpu_to_le64(o->lat_hist_max);
 	top->sig_figs = cpu_to_le32(o->sig_figs);
 	top->continue_on_error = cpu_to_le32(o->continue_on_error);
 	top->cgroup_weight = cpu_to_le32(o->cgroup_weight);
@@ -573,11 +593,16 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->replay_scale = cpu_to_le32(o->replay_scale);
 	top->replay_time_scale = cpu_to_le32(o->replay_time_scale);
 	top->replay_skip = cpu_to_le32(o->replay_skip);
+	top->write_iolog_format = cpu_to_le32(o->write_iolog_format);
+	top->replay_shard = cpu_to_le32(o->replay_shard);
+	top->replay_shard_chunk = cpu_to_le32(o->replay_shard_chunk);
 	top->per_job_logs = cpu_to_le32(o->per_job_logs);
 	top->write_bw_log = cpu_to_le32(o->write_bw_log);
 	top->write_lat_log = cpu_to_le32(o->write_lat_log);
 	top->write_iops_log = cpu_to_le32(o->write_iops_log);
 	top->write_hist_log = cpu_to_le32(o->write_hist_log);
+	top->write_timeline_log = cpu_to_le32(o->write_timeline_log);
+	top->log_timeline_usec = cpu_to_le32(o->log_timeline_usec);
 
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		top->bs[i] = __cpu_to_le64(o->bs[i]);
@@ -15,6 +15,9 @@
 #ifdef CONFIG_ZLIB
 #include <zlib.h>
 #endif
+#ifdef CONFIG_HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #include "fio.h"
 #include "client.h"
@@ -267,6 +270,8 @@ void fio_put_client(struct fio_client *client)
 		free(client->files);
 	if (client->opt_lists)
 		free(client->opt_lists);
+	fio_net_delta_free(&client->delta_list);
+	fio_net_rx_free(&client->rx);
 
 	if (!client->did_stat)
 		sum_stat_clients--;
@@ -290,21 +295,28 @@ static int fio_client_dec_jobs_eta(struct client_eta *eta, client_eta_op eta_fn)
 
 static void fio_drain_client_text(struct fio_client *client)
 {
+	struct fio_net_cmd *cmd;
+	ssize_t ret;
+	int err;
+
 	do {
-		struct fio_net_cmd *cmd = NULL;
+		ret = fio_net_rx_fill(client->fd, &client->rx);
 
-		if (fio_server_poll_fd(client->fd, POLLIN, 0))
-			cmd = fio_net_recv_cmd(client->fd, false);
-		if (!cmd)
-			break;
+		while ((cmd = fio_net_rx_cmd(&client->rx, &err)) != NULL) {
+			if (cmd->opcode == FIO_NET_CMD_DELTA) {
+				cmd = fio_net_delta_decode(&client->delta_list, cmd);
+				if (!cmd)
+					return;
+			}
 
-		if (cmd->opcode == FIO_NET_CMD_TEXT) {
-			convert_text(cmd);
-			client->ops->text(client, cmd);
-		}
+			if (cmd->opcode == FIO_NET_CMD_TEXT) {
+				convert_text(cmd);
+				client->ops->text(client, cmd);
+			}
 
-		free(cmd);
-	} while (1);
+			free(cmd);
+		}
+	} while (ret > 0 && !err);
 }
 
 static void remove_client(struct fio_client *client)
@@ -317,6 +329,8 @@ static void remove_client(struct fio_client *client)
 
 	if (!flist_empty(&client->list))
 		flist_del_init(&client->list);
+	if (!flist_empty(&client->rx_list))
+		flist_del_init(&client->rx_list);
 
 	fio_client_remove_hash(client);
 
@@ -383,6 +397,8 @@ static struct fio_client *get_new_client(void)
 	INIT_FLIST_HEAD(&client->arg_list);
 	INIT_FLIST_HEAD(&client->eta_list);
 	INIT_FLIST_HEAD(&client->cmd_list);
+	INIT_FLIST_HEAD(&client->delta_list);
+	INIT_FLIST_HEAD(&client->rx_list);
 
 	buf_output_init(&client->buf);
 
@@ -521,9 +537,9 @@ static void probe_client(struct fio_client *client)
 	dprint(FD_NET, "client: send probe\n");
 
 #ifdef CONFIG_ZLIB
-	pdu.flags = __le64_to_cpu(FIO_PROBE_FLAG_ZLIB);
+	pdu.flags = __le64_to_cpu(FIO_PROBE_FLAG_ZLIB | FIO_PROBE_FLAG_DELTA);
 #else
-	pdu.flags = 0;
+	pdu.flags = __le64_to_cpu(FIO_PROBE_FLAG_DELTA);
 #endif
 
 	sname = server_name(client, buf, sizeof(buf));
@@ -1085,6 +1101,15 @@ static void convert_ts(struct thread_stat *dst, struct thread_stat *src)
 
 	dst->cachehit		= le64_to_cpu(src->cachehit);
 	dst->cachemiss		= le64_to_cpu(src->cachemiss);
+
+	dst->hist_bits		= le32_to_cpu(src->hist_bits);
+	dst->hist_groups	= le32_to_cpu(src->hist_groups);
+	for (i = 0; i < FIO_LAT_CNT; i++) {
+		if (!dst->hist_plat[i])
+			continue;
+		for (j = 0; j < DDIR_RWDIR_CNT * lat_hist_nr(dst); j++)
+			dst->hist_plat[i][j] = le64_to_cpu(src->hist_plat[i][j]);
+	}
 }
 
 static void convert_gs(struct group_run_stats *dst, struct group_run_stats *src)
@@ -1426,7 +1451,8 @@ static void handle_eta(struct fio_client *client, struct fio_net_cmd *cmd)
 	fio_client_dec_jobs_eta(eta, client->ops->eta);
 }
 
-static void client_flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
+static void client_flush_hist_samples(FILE *f, int hist_coarseness,
+				      unsigned int hist_nr, void *samples,
 				      uint64_t sample_size)
 {
 	struct io_sample *s, *s_tmp;
@@ -1450,23 +1476,23 @@ static void client_flush_hist_samples(FILE *f, int hist_coarseness, void *sample
 
 		s_tmp = __get_sample(samples, log_offset, log_issue_time, i);
 		s = (struct io_sample *)((char *)s_tmp +
-					 i * sizeof(struct io_u_plat_entry));
+					 i * io_u_plat_entry_sz(hist_nr));
 
 		entry = s->data.plat_entry;
 		io_u_plat = entry->io_u_plat;
 
 		fprintf(f, "%lu, %u, %llu, ", (unsigned long) s->time,
 						io_sample_ddir(s), (unsigned long long) s->bs);
-		for (j = 0; j < FIO_IO_U_PLAT_NR - stride; j += stride) {
+		for (j = 0; j < hist_nr - stride; j += stride) {
 			fprintf(f, "%llu, ", (unsigned long long)hist_sum(j, stride, io_u_plat, NULL));
 		}
 		fprintf(f, "%llu\n", (unsigned long long)
-			hist_sum(FIO_IO_U_PLAT_NR - stride, stride, io_u_plat, NULL));
+			hist_sum(hist_nr - stride, stride, io_u_plat, NULL));
 
 	}
 }
 
-static int fio_client_handle_iolog(struct fio_client *client,
+static int fio_client_handle_iolog(const char *hostname,
 				   struct fio_net_cmd *cmd)
 {
 	struct cmd_iolog_pdu *pdu = NULL;
@@ -1483,14 +1509,14 @@ static int fio_client_handle_iolog(struct fio_client *client,
 
         /* allocate buffer big enough for next sprintf() call */
 	log_pathname = malloc(10 + strlen((char *)pdu->name) +
-			strlen(client->hostname));
+			strlen(hostname));
 	if (!log_pathname) {
 		log_err("fio: memory allocation of unique pathname failed\n");
 		ret = -1;
 		goto out;
 	}
 	/* generate a unique pathname for the log file using hostname */
-	sprintf(log_pathname, "%s.%s", pdu->name, client->hostname);
+	sprintf(log_pathname, "%s.%s", pdu->name, hostname);
 
 	if (store_direct) {
 		ssize_t wrote;
@@ -1537,7 +1563,8 @@ static int fio_client_handle_iolog(struct fio_client *client,
 		}
 
 		if (pdu->log_type == IO_LOG_TYPE_HIST) {
-			client_flush_hist_samples(f, pdu->log_hist_coarseness, pdu->samples,
+			client_flush_hist_samples(f, pdu->log_hist_coarseness,
+					   pdu->log_hist_nr, pdu->samples,
 					   pdu->nr_samples * sizeof(struct io_sample));
 		} else {
 			flush_samples(f, pdu->samples,
@@ -1557,6 +1584,111 @@ out:
 	return ret;
 }
 
+/*
+ * Inflating an IO log and writing it out can take a while for big logs,
+ * and would hold up every other server. A writer thread takes them off the
+ * event loop. It's a single thread, so the chunks of a log are written in
+ * the order they arrived.
+ */
+struct client_iolog_work {
+	struct flist_head list;
+	char *hostname;
+	struct fio_net_cmd *cmd;
+};
+
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct flist_head list;
+	bool running;
+	bool exit;
+} iolog_writer = {
+	.lock	= PTHREAD_MUTEX_INITIALIZER,
+	.cond	= PTHREAD_COND_INITIALIZER,
+	.list	= FLIST_HEAD_INIT(iolog_writer.list),
+};
+
+static void *iolog_writer_thread(void *data)
+{
+	struct client_iolog_work *work;
+
+	pthread_mutex_lock(&iolog_writer.lock);
+	while (!flist_empty(&iolog_writer.list) || !iolog_writer.exit) {
+		if (flist_empty(&iolog_writer.list)) {
+			pthread_cond_wait(&iolog_writer.cond, &iolog_writer.lock);
+			continue;
+		}
+
+		work = flist_first_entry(&iolog_writer.list,
+					 struct client_iolog_work, list);
+		flist_del(&work->list);
+		pthread_mutex_unlock(&iolog_writer.lock);
+
+		fio_client_handle_iolog(work->hostname, work->cmd);
+		free(work->hostname);
+		free(work->cmd);
+		free(work);
+
+		pthread_mutex_lock(&iolog_writer.lock);
+	}
+	pthread_mutex_unlock(&iolog_writer.lock);
+	return NULL;
+}
+
+/*
+ * Hand an IO log to the writer thread, which then owns cmd. Returns
+ * non-zero if the caller has to write it out itself.
+ */
+static int iolog_writer_queue(struct fio_client *client,
+			      struct fio_net_cmd *cmd)
+{
+	struct client_iolog_work *work;
+
+	if (!iolog_writer.running) {
+		iolog_writer.exit = false;
+		if (pthread_create(&iolog_writer.thread, NULL,
+				   iolog_writer_thread, NULL)) {
+			log_err("fio: failed to start IO log writer thread\n");
+			return 1;
+		}
+		iolog_writer.running = true;
+	}
+
+	work = malloc(sizeof(*work));
+	if (!work)
+		return 1;
+	work->hostname = strdup(client->hostname);
+	if (!work->hostname) {
+		free(work);
+		return 1;
+	}
+	work->cmd = cmd;
+
+	pthread_mutex_lock(&iolog_writer.lock);
+	flist_add_tail(&work->list, &iolog_writer.list);
+	pthread_cond_signal(&iolog_writer.cond);
+	pthread_mutex_unlock(&iolog_writer.lock);
+	return 0;
+}
+
+/*
+ * Wait for the writer thread to write out everything queued
+ */
+static void iolog_writer_exit(void)
+{
+	if (!iolog_writer.running)
+		return;
+
+	pthread_mutex_lock(&iolog_writer.lock);
+	iolog_writer.exit = true;
+	pthread_cond_signal(&iolog_writer.cond);
+	pthread_mutex_unlock(&iolog_writer.lock);
+
+	pthread_join(iolog_writer.thread, NULL);
+	iolog_writer.running = false;
+}
+
 static void handle_probe(struct fio_client *client, struct fio_net_cmd *cmd)
 {
 	struct cmd_probe_reply_pdu *probe = (struct cmd_probe_reply_pdu *) cmd->payload;
@@ -1658,7 +1790,7 @@ static struct cmd_iolog_pdu *convert_iolog_gz(struct fio_net_cmd *cmd,
 					le32_to_cpu(pdu->log_issue_time));
 	if (pdu->log_type == IO_LOG_TYPE_HIST)
 		total = nr_samples * (log_entry_size +
-				      sizeof(struct io_u_plat_entry));
+			io_u_plat_entry_sz(le32_to_cpu(pdu->log_hist_nr)));
 	else
 		total = nr_samples * log_entry_size;
 	ret = malloc(total + sizeof(*pdu));
@@ -1751,6 +1883,7 @@ static struct cmd_iolog_pdu *convert_iolog(struct fio_net_cmd *cmd,
 	ret->log_prio		= le32_to_cpu(ret->log_prio);
 	ret->log_issue_time	= le32_to_cpu(ret->log_issue_time);
 	ret->log_hist_coarseness = le32_to_cpu(ret->log_hist_coarseness);
+	ret->log_hist_nr	= le32_to_cpu(ret->log_hist_nr);
 	ret->per_job_logs	= le32_to_cpu(ret->per_job_logs);
 
 	if (*store_direct)
@@ -1762,7 +1895,8 @@ static struct cmd_iolog_pdu *convert_iolog(struct fio_net_cmd *cmd,
 
 		s = __get_sample(samples, ret->log_offset, ret->log_issue_time, i);
 		if (ret->log_type == IO_LOG_TYPE_HIST)
-			s = (struct io_sample *)((char *)s + sizeof(struct io_u_plat_entry) * i);
+			s = (struct io_sample *)((char *)s +
+				io_u_plat_entry_sz(ret->log_hist_nr) * i);
 
 		s->time		= le64_to_cpu(s->time);
 		if (ret->log_type != IO_LOG_TYPE_HIST) {
@@ -1832,16 +1966,19 @@ fail:
 	return 0;
 }
 
-int fio_handle_client(struct fio_client *client)
+static int handle_client_cmd(struct fio_client *client,
+			     struct fio_net_cmd *cmd)
 {
 	struct client_ops const *ops = client->ops;
-	struct fio_net_cmd *cmd;
-
-	dprint(FD_NET, "client: handle %s\n", client->hostname);
 
-	cmd = fio_net_recv_cmd(client->fd, true);
-	if (!cmd)
-		return 0;
+	if (cmd->opcode == FIO_NET_CMD_DELTA) {
+		cmd = fio_net_delta_decode(&client->delta_list, cmd);
+		if (!cmd) {
+			log_err("fio: client %s, bad delta update\n",
+				client->hostname);
+			return 0;
+		}
+	}
 
 	dprint(FD_NET, "client: got cmd op %s from %s (pdu=%u)\n",
 		fio_server_op(cmd->opcode), client->hostname, cmd->pdu_len);
@@ -1880,6 +2017,13 @@ int fio_handle_client(struct fio_client *client)
 			}
 		}
 
+		for (i = 0; i < FIO_LAT_CNT; i++) {
+			if (p->ts.hist_plat_offset[i]) {
+				offset = le64_to_cpu(p->ts.hist_plat_offset[i]);
+				p->ts.hist_plat[i] = (uint64_t *)((char *)p + offset);
+			}
+		}
+
 		dprint(FD_NET, "client: ts->ss_state = %u\n", (unsigned int) le32_to_cpu(p->ts.ss_state));
 		if (le32_to_cpu(p->ts.ss_state) & FIO_SS_DATA) {
 			dprint(FD_NET, "client: received steadystate ring buffers\n");
@@ -1954,7 +2098,9 @@ int fio_handle_client(struct fio_client *client)
 		break;
 		}
 	case FIO_NET_CMD_IOLOG:
-		fio_client_handle_iolog(client, cmd);
+		if (!iolog_writer_queue(client, cmd))
+			return 1;
+		fio_client_handle_iolog(client->hostname, cmd);
 		break;
 	case FIO_NET_CMD_UPDATE_JOB:
 		ops->update_job(client, cmd);
@@ -1992,6 +2138,43 @@ int fio_handle_client(struct fio_client *client)
 	return 1;
 }
 
+/*
+ * Read what the server has sent, without blocking, and handle the commands
+ * that are complete. At most FIO_CLIENT_RX_FILLS reads are done per call, so
+ * a server with a lot to send can't starve the others or the ETA updates.
+ * Returns 0 if the connection is gone or broken, FIO_CLIENT_RX_MORE if
+ * the budget ran out before the socket was empty, 1 otherwise. Edge
+ * triggered epoll won't report data left behind again, the caller has to
+ * come back for it.
+ */
+int fio_handle_client(struct fio_client *client)
+{
+	struct fio_net_cmd *cmd;
+	unsigned int fills = 0;
+	ssize_t ret;
+	int err;
+
+	dprint(FD_NET, "client: handle %s\n", client->hostname);
+
+	do {
+		ret = fio_net_rx_fill(client->fd, &client->rx);
+
+		while ((cmd = fio_net_rx_cmd(&client->rx, &err)) != NULL) {
+			if (!handle_client_cmd(client, cmd))
+				return 0;
+			/* removed, e.g. the server quit */
+			if (client->fd == -1)
+				return 1;
+		}
+		if (err)
+			return 0;
+		if (ret > 0 && ++fills == FIO_CLIENT_RX_FILLS)
+			return FIO_CLIENT_RX_MORE;
+	} while (ret > 0);
+
+	return !ret;
+}
+
 int fio_clients_send_trigger(const char *cmd)
 {
 	struct flist_head *entry;
@@ -2154,14 +2337,159 @@ static int fio_check_clients_timed_out(void)
 	return ret;
 }
 
+/*
+ * The clients with something to read. With epoll the sockets are added once,
+ * edge triggered, and a wait costs nothing per idle client. The poll
+ * fallback rebuilds its array from the client list on every wait.
+ */
+struct client_events {
+	int nr;
+#ifdef CONFIG_HAVE_EPOLL
+	int epfd;
+	struct epoll_event *events;
+#else
+	struct pollfd *pfds;
+#endif
+};
+
+#ifdef CONFIG_HAVE_EPOLL
+static int client_events_init(struct client_events *ev)
+{
+	struct flist_head *entry;
+
+	ev->nr = 0;
+	ev->events = calloc(nr_clients, sizeof(struct epoll_event));
+	if (!ev->events)
+		return 1;
+
+	ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (ev->epfd < 0) {
+		log_err("fio: epoll_create1: %s\n", strerror(errno));
+		free(ev->events);
+		return 1;
+	}
+
+	flist_for_each(entry, &client_list) {
+		struct fio_client *client;
+		struct epoll_event e = {
+			.events	= EPOLLIN | EPOLLET,
+		};
+
+		client = flist_entry(entry, struct fio_client, list);
+		e.data.fd = client->fd;
+		if (epoll_ctl(ev->epfd, EPOLL_CTL_ADD, client->fd, &e) < 0) {
+			log_err("fio: epoll_ctl: %s\n", strerror(errno));
+			close(ev->epfd);
+			free(ev->events);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Closing a client's socket takes it out of the epoll set
+ */
+static int client_events_wait(struct client_events *ev, int timeout)
+{
+	int ret;
+
+	ret = epoll_wait(ev->epfd, ev->events, nr_clients, timeout);
+	ev->nr = max(ret, 0);
+	return ret;
+}
+
+static int client_events_fd(struct client_events *ev, int i)
+{
+	return ev->events[i].data.fd;
+}
+
+static void client_events_exit(struct client_events *ev)
+{
+	close(ev->epfd);
+	free(ev->events);
+}
+#else
+static int client_events_init(struct client_events *ev)
+{
+	ev->nr = 0;
+	ev->pfds = malloc(nr_clients * sizeof(struct pollfd));
+	return !ev->pfds;
+}
+
+static int client_events_wait(struct client_events *ev, int timeout)
+{
+	struct flist_head *entry;
+	int ret;
+
+	ev->nr = 0;
+	flist_for_each(entry, &client_list) {
+		struct fio_client *client;
+
+		client = flist_entry(entry, struct fio_client, list);
+		ev->pfds[ev->nr].fd = client->fd;
+		ev->pfds[ev->nr].events = POLLIN;
+		ev->nr++;
+	}
+
+	assert(ev->nr == nr_clients);
+
+	ret = poll(ev->pfds, ev->nr, timeout);
+	if (ret <= 0)
+		ev->nr = 0;
+	return ret;
+}
+
+static int client_events_fd(struct client_events *ev, int i)
+{
+	if (!(ev->pfds[i].revents & POLLIN))
+		return -1;
+
+	return ev->pfds[i].fd;
+}
+
+static void client_events_exit(struct client_events *ev)
+{
+	free(ev->pfds);
+}
+#endif
+
+/*
+ * Handle what a client has sent. Clients that have more to read than one
+ * call handles go on the ready list. Returns 1 if the client failed.
+ */
+static int service_client(struct fio_client *client,
+			  struct flist_head *ready_list)
+{
+	int ret;
+
+	if (!flist_empty(&client->rx_list))
+		flist_del_init(&client->rx_list);
+
+	ret = fio_handle_client(client);
+	if (!ret) {
+		log_info("client: host=%s disconnected\n", client->hostname);
+		remove_client(client);
+		return 1;
+	}
+
+	if (ret == FIO_CLIENT_RX_MORE)
+		flist_add_tail(&client->rx_list, ready_list);
+
+	return client->error != 0;
+}
+
 int fio_handle_clients(struct client_ops const *ops)
 {
-	struct pollfd *pfds;
-	int i, ret = 0, retval = 0;
+	FLIST_HEAD(ready_list);
+	struct client_events ev;
+	int i, fd, ret = 0, retval = 0;
 
 	fio_gettime(&eta_ts, NULL);
 
-	pfds = malloc(nr_clients * sizeof(struct pollfd));
+	if (client_events_init(&ev))
+		return 1;
 
 	init_thread_stat(&client_ts);
 	init_group_run_stat(&client_gs);
@@ -2169,8 +2497,8 @@ int fio_handle_clients(struct client_ops const *ops)
 	while (!exit_backend && nr_clients) {
 		struct flist_head *entry, *tmp;
 		struct fio_client *client;
+		FLIST_HEAD(pending);
 
-		i = 0;
 		flist_for_each_safe(entry, tmp, &client_list) {
 			client = flist_entry(entry, struct fio_client, list);
 
@@ -2179,17 +2507,12 @@ int fio_handle_clients(struct client_ops const *ops)
 				remove_client(client);
 				continue;
 			}
-
-			pfds[i].fd = client->fd;
-			pfds[i].events = POLLIN;
-			i++;
 		}
 
 		if (!nr_clients)
 			break;
 
-		assert(i == nr_clients);
-
+		ev.nr = 0;
 		do {
 			struct timespec ts;
 			int timeout;
@@ -2205,45 +2528,70 @@ int fio_handle_clients(struct client_ops const *ops)
 
 			check_trigger_file();
 
-			timeout = min(100u, ops->eta_msec);
-
-			ret = poll(pfds, nr_clients, timeout);
+			/*
+			 * Don't sleep while clients have data we know about
+			 */
+			if (!flist_empty(&ready_list))
+				timeout = 0;
+			else
+				timeout = min(100u, ops->eta_msec);
+
+			ret = client_events_wait(&ev, timeout);
 			if (ret < 0) {
 				if (errno == EINTR)
 					continue;
 				log_err("fio: poll clients: %s\n", strerror(errno));
 				break;
-			} else if (!ret)
-				continue;
-		} while (ret <= 0);
+			}
+		} while (ret <= 0 && flist_empty(&ready_list));
+
+		/*
+		 * Serve the clients that were left with data last round after
+		 * the ones that just woke up. A client that is in both is only
+		 * handled once, service_client() takes it off the ready list.
+		 */
+		flist_splice_init(&ready_list, &pending);
 
-		for (i = 0; i < nr_clients; i++) {
-			if (!(pfds[i].revents & POLLIN))
+		for (i = 0; i < ev.nr; i++) {
+			fd = client_events_fd(&ev, i);
+			if (fd == -1)
 				continue;
 
-			client = find_client_by_fd(pfds[i].fd);
-			if (!client) {
-				log_err("fio: unknown client fd %ld\n", (long) pfds[i].fd);
+			/*
+			 * Gone already, removed while handling another client
+			 */
+			client = find_client_by_fd(fd);
+			if (!client)
 				continue;
-			}
-			if (!fio_handle_client(client)) {
-				log_info("client: host=%s disconnected\n",
-						client->hostname);
-				remove_client(client);
-				retval = 1;
-			} else if (client->error)
-				retval = 1;
+			retval |= service_client(client, &ready_list);
+			fio_put_client(client);
+		}
+
+		while (!flist_empty(&pending)) {
+			client = flist_first_entry(&pending, struct fio_client,
+						   rx_list);
+			fio_get_client(client);
+			retval |= service_client(client, &ready_list);
 			fio_put_client(client);
 		}
 	}
 
+	/*
+	 * The list is on our stack, don't leave clients linked to it
+	 */
+	while (!flist_empty(&ready_list))
+		flist_del_init(ready_list.next);
+
+	iolog_writer_exit();
+
 	log_info_buf(allclients.buf, allclients.buflen);
 	buf_output_free(&allclients);
 
 	fio_client_json_fini();
 
 	free_clat_prio_stats(&client_ts);
-	free(pfds);
+	free_lat_hist_stats(&client_ts);
+	client_events_exit(&ev);
 	return retval || error_clients;
 }
 
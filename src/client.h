@@ -7,6 +7,7 @@
 
 #include "lib/types.h"
 #include "stat.h"
+#include "server.h"
 
 struct fio_net_cmd;
 
@@ -66,6 +67,9 @@ struct fio_client {
 	unsigned int eta_timeouts;
 
 	struct flist_head cmd_list;
+	struct flist_head delta_list;	/* bases of TS and ETA deltas */
+	struct fio_net_rx rx;		/* received, not yet handled */
+	struct flist_head rx_list;	/* on the ready list, more to read */
 
 	uint16_t argc;
 	char **argv;
@@ -114,6 +118,12 @@ struct client_eta {
 	struct jobs_eta eta;
 };
 
+/*
+ * Reads fio_handle_client() does per call, each up to FIO_NET_RX_CHUNK
+ */
+#define FIO_CLIENT_RX_FILLS	16
+#define FIO_CLIENT_RX_MORE	2
+
 extern int fio_handle_client(struct fio_client *);
 extern void fio_client_sum_jobs_eta(struct jobs_eta *dst, struct jobs_eta *je);
 
@@ -21,6 +21,13 @@
 #include "../lib/bswap.h"
 #include "sha256.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <stdbool.h>
+#include <immintrin.h>
+#include "../arch/arch.h"
+#define SHA256_X86
+#endif
+
 #define SHA256_DIGEST_SIZE	32
 #define SHA256_HMAC_BLOCK_SIZE	64
 
@@ -226,6 +233,122 @@ static void sha256_transform(uint32_t *state, const uint8_t *input)
 	memset(W, 0, 64 * sizeof(uint32_t));
 }
 
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#ifdef SHA256_X86
+/*
+ * One block with the SHA extensions. The state is kept as ABEF/CDGH
+ * pairs, which is what sha256rnds2 works on.
+ */
+#define SHA_NI_ROUNDS(i, msg)						\
+	do {								\
+		__m128i __m;						\
+									\
+		__m = _mm_add_epi32(msg,				\
+			_mm_loadu_si128((const __m128i *) &sha256_k[(i) * 4])); \
+		st1 = _mm_sha256rnds2_epu32(st1, st0, __m);		\
+		__m = _mm_shuffle_epi32(__m, 0x0e);			\
+		st0 = _mm_sha256rnds2_epu32(st0, st1, __m);		\
+	} while (0)
+
+#define SHA_NI_SCHED(m0, m1, m2, m3)					\
+	m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), \
+				  _mm_alignr_epi8(m3, m2, 4)), m3)
+
+static __attribute__((target("sha,sse4.1")))
+void sha256_transform_ni(uint32_t *state, const uint8_t *input)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i st0, st1, tmp, abef, cdgh, m0, m1, m2, m3;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1);
+	st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b);
+	st0 = _mm_alignr_epi8(tmp, st1, 8);
+	st1 = _mm_blend_epi16(st1, tmp, 0xf0);
+	abef = st0;
+	cdgh = st1;
+
+	m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (input + 0)), bswap);
+	m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (input + 16)), bswap);
+	m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (input + 32)), bswap);
+	m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (input + 48)), bswap);
+
+	SHA_NI_ROUNDS(0, m0);
+	SHA_NI_ROUNDS(1, m1);
+	SHA_NI_ROUNDS(2, m2);
+	SHA_NI_ROUNDS(3, m3);
+	SHA_NI_SCHED(m0, m1, m2, m3); SHA_NI_ROUNDS(4, m0);
+	SHA_NI_SCHED(m1, m2, m3, m0); SHA_NI_ROUNDS(5, m1);
+	SHA_NI_SCHED(m2, m3, m0, m1); SHA_NI_ROUNDS(6, m2);
+	SHA_NI_SCHED(m3, m0, m1, m2); SHA_NI_ROUNDS(7, m3);
+	SHA_NI_SCHED(m0, m1, m2, m3); SHA_NI_ROUNDS(8, m0);
+	SHA_NI_SCHED(m1, m2, m3, m0); SHA_NI_ROUNDS(9, m1);
+	SHA_NI_SCHED(m2, m3, m0, m1); SHA_NI_ROUNDS(10, m2);
+	SHA_NI_SCHED(m3, m0, m1, m2); SHA_NI_ROUNDS(11, m3);
+	SHA_NI_SCHED(m0, m1, m2, m3); SHA_NI_ROUNDS(12, m0);
+	SHA_NI_SCHED(m1, m2, m3, m0); SHA_NI_ROUNDS(13, m1);
+	SHA_NI_SCHED(m2, m3, m0, m1); SHA_NI_ROUNDS(14, m2);
+	SHA_NI_SCHED(m3, m0, m1, m2); SHA_NI_ROUNDS(15, m3);
+
+	st0 = _mm_add_epi32(st0, abef);
+	st1 = _mm_add_epi32(st1, cdgh);
+
+	tmp = _mm_shuffle_epi32(st0, 0x1b);
+	st1 = _mm_shuffle_epi32(st1, 0xb1);
+	st0 = _mm_blend_epi16(tmp, st1, 0xf0);
+	st1 = _mm_alignr_epi8(st1, tmp, 8);
+
+	_mm_storeu_si128((__m128i *) &state[0], st0);
+	_mm_storeu_si128((__m128i *) &state[4], st1);
+}
+
+static bool sha256_have_ni(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	cpuid(0, &eax, &ebx, &ecx, &edx);
+	if (eax < 7)
+		return false;
+
+	cpuid(7, &eax, &ebx, &ecx, &edx);
+	return (ebx & (1U << 29)) != 0;
+}
+
+static void sha256_transform_probe(uint32_t *, const uint8_t *);
+static void (*sha256_transform_fn)(uint32_t *, const uint8_t *) = sha256_transform_probe;
+
+static void sha256_transform_probe(uint32_t *state, const uint8_t *input)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.1") && sha256_have_ni())
+		sha256_transform_fn = sha256_transform_ni;
+	else
+		sha256_transform_fn = sha256_transform;
+
+	sha256_transform_fn(state, input);
+}
+#else
+#define sha256_transform_fn	sha256_transform
+#endif
+
 void fio_sha256_init(struct fio_sha256_ctx *sctx)
 {
 	sctx->state[0] = H0;
@@ -258,7 +381,7 @@ void fio_sha256_update(struct fio_sha256_ctx *sctx, const uint8_t *data,
 		}
 
 		do {
-			sha256_transform(sctx->state, src);
+			sha256_transform_fn(sctx->state, src);
 			done += 64;
 			src = data + done;
 		} while (done + 63 < len);
@@ -290,3 +413,260 @@ void fio_sha256_final(struct fio_sha256_ctx *sctx)
 	for (i = 0; i < 8; i++)
 		sctx->buf[i] = sctx->state[i];
 }
+
+static void sha256_one(const uint8_t *data, unsigned int len, uint8_t *out)
+{
+	struct fio_sha256_ctx ctx = {
+		.buf = out,
+	};
+
+	fio_sha256_init(&ctx);
+	fio_sha256_update(&ctx, data, len);
+	fio_sha256_final(&ctx);
+}
+
+#ifdef SHA256_X86
+/*
+ * Multi-buffer hashing: the round function runs on one block from each of
+ * several independent messages, every message in its own vector lane. A
+ * lane that finishes its message picks up the next one. AVX2 runs 8 lanes,
+ * more would spill, AVX-512 runs 16.
+ */
+#define SHA256_MB_LANES	16
+
+typedef uint32_t sha256_v8 __attribute__((vector_size(32)));
+typedef uint32_t sha256_v16 __attribute__((vector_size(64)));
+
+#define vror(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define vE0(x)		(vror(x, 2) ^ vror(x, 13) ^ vror(x, 22))
+#define vE1(x)		(vror(x, 6) ^ vror(x, 11) ^ vror(x, 25))
+#define vS0(x)		(vror(x, 7) ^ vror(x, 18) ^ ((x) >> 3))
+#define vS1(x)		(vror(x, 17) ^ vror(x, 19) ^ ((x) >> 10))
+
+#define SHA256_MB_KERNEL(name, vec, lanes, tgt)				\
+static __attribute__((target(tgt)))					\
+void name(uint32_t (*st)[SHA256_MB_LANES], const uint8_t **blocks)	\
+{									\
+	uint32_t w[16][lanes] __attribute__((aligned(64)));		\
+	vec W[16], s[8], a, b, c, d, e, f, g, h, t1, t2;		\
+	int i, l;							\
+									\
+	for (l = 0; l < lanes; l++)					\
+		for (i = 0; i < 16; i++)				\
+			w[i][l] = __be32_to_cpu(((const uint32_t *) blocks[l])[i]); \
+	for (i = 0; i < 16; i++)					\
+		memcpy(&W[i], w[i], sizeof(W[i]));			\
+	for (i = 0; i < 8; i++)						\
+		memcpy(&s[i], st[i], sizeof(s[i]));			\
+									\
+	a = s[0]; b = s[1]; c = s[2]; d = s[3];				\
+	e = s[4]; f = s[5]; g = s[6]; h = s[7];				\
+									\
+	_Pragma("GCC unroll 64")					\
+	for (i = 0; i < 64; i++) {					\
+		if (i >= 16)						\
+			W[i & 15] += vS1(W[(i - 2) & 15]) +		\
+				     W[(i - 7) & 15] +			\
+				     vS0(W[(i - 15) & 15]);		\
+		t1 = h + vE1(e) + (g ^ (e & (f ^ g))) + sha256_k[i] +	\
+			W[i & 15];					\
+		t2 = vE0(a) + ((a & b) | (c & (a | b)));		\
+		h = g; g = f; f = e; e = d + t1;			\
+		d = c; c = b; b = a; a = t1 + t2;			\
+	}								\
+									\
+	s[0] += a; s[1] += b; s[2] += c; s[3] += d;			\
+	s[4] += e; s[5] += f; s[6] += g; s[7] += h;			\
+	for (i = 0; i < 8; i++)						\
+		memcpy(st[i], &s[i], sizeof(s[i]));			\
+}
+
+SHA256_MB_KERNEL(sha256_mb8_avx2, sha256_v8, 8, "avx2")
+SHA256_MB_KERNEL(sha256_mb8_avx512, sha256_v8, 8, "avx512f,avx512vl")
+SHA256_MB_KERNEL(sha256_mb16_avx512, sha256_v16, 16, "avx512f,avx512vl")
+
+struct sha256_lane {
+	const uint8_t *data;
+	unsigned int full;	/* blocks left in data */
+	unsigned int npad;	/* 1 or 2 blocks of padding */
+	unsigned int padpos;	/* next padding block */
+	unsigned int idx;
+	uint8_t pad[128];
+};
+
+/*
+ * Set up the trailing block(s) exactly like fio_sha256_final() does,
+ * including the native endian bit count.
+ */
+static void sha256_lane_start(struct sha256_lane *ln,
+			      uint32_t (*st)[SHA256_MB_LANES], unsigned int l,
+			      const uint8_t *data, unsigned int len,
+			      unsigned int idx)
+{
+	static const uint32_t H[8] = { H0, H1, H2, H3, H4, H5, H6, H7 };
+	uint64_t bits = (uint64_t) len << 3;
+	unsigned int rem = len & 0x3f;
+	int i;
+
+	ln->data = data;
+	ln->full = len >> 6;
+	ln->npad = rem < 56 ? 1 : 2;
+	ln->padpos = 0;
+	ln->idx = idx;
+
+	memset(ln->pad, 0, sizeof(ln->pad));
+	memcpy(ln->pad, data + (len & ~0x3fU), rem);
+	ln->pad[rem] = 0x80;
+	memcpy(ln->pad + ln->npad * 64 - sizeof(bits), &bits, sizeof(bits));
+
+	for (i = 0; i < 8; i++)
+		st[i][l] = H[i];
+}
+
+static const uint8_t *sha256_lane_next(struct sha256_lane *ln)
+{
+	const uint8_t *p;
+
+	if (ln->full) {
+		p = ln->data;
+		ln->data += 64;
+		ln->full--;
+	} else
+		p = ln->pad + 64 * ln->padpos++;
+
+	return p;
+}
+
+/*
+ * Same 64 bytes fio_sha256_final() leaves in ctx->buf: the last block
+ * that was hashed, with the low byte of each state word in front.
+ */
+static void sha256_lane_finish(struct sha256_lane *ln,
+			       uint32_t (*st)[SHA256_MB_LANES], unsigned int l,
+			       uint8_t *out)
+{
+	int i;
+
+	memcpy(out, ln->pad + 64 * (ln->npad - 1), 64);
+	for (i = 0; i < 8; i++)
+		out[i] = st[i][l];
+}
+
+static void sha256_mb(void (*fn)(uint32_t (*)[SHA256_MB_LANES],
+				 const uint8_t **),
+		      unsigned int lanes, const uint8_t **data,
+		      const unsigned int *len, uint8_t **out, unsigned int nr)
+{
+	static const uint8_t idle[64];
+	uint32_t st[8][SHA256_MB_LANES] __attribute__((aligned(64)));
+	struct sha256_lane ln[SHA256_MB_LANES];
+	const uint8_t *blocks[SHA256_MB_LANES];
+	unsigned int l, next = 0, active = 0;
+
+	memset(st, 0, sizeof(st));
+	for (l = 0; l < lanes; l++) {
+		ln[l].idx = -1U;
+		if (next < nr) {
+			sha256_lane_start(&ln[l], st, l, data[next],
+					  len[next], next);
+			next++;
+			active++;
+		}
+	}
+
+	while (active) {
+		for (l = 0; l < lanes; l++) {
+			if (ln[l].idx != -1U)
+				blocks[l] = sha256_lane_next(&ln[l]);
+			else
+				blocks[l] = idle;
+		}
+
+		fn(st, blocks);
+
+		for (l = 0; l < lanes; l++) {
+			if (ln[l].idx == -1U || ln[l].full ||
+			    ln[l].padpos != ln[l].npad)
+				continue;
+
+			sha256_lane_finish(&ln[l], st, l, out[ln[l].idx]);
+			ln[l].idx = -1U;
+			active--;
+			if (next < nr) {
+				sha256_lane_start(&ln[l], st, l, data[next],
+						  len[next], next);
+				next++;
+				active++;
+			}
+		}
+	}
+}
+
+enum {
+	SHA256_MB_UNKNOWN = 0,
+	SHA256_MB_NONE,
+	SHA256_MB_AVX2,
+	SHA256_MB_AVX512,
+};
+
+static int sha256_mb_mode;
+static bool sha256_mb_ni;
+
+static int sha256_mb_probe(void)
+{
+	__builtin_cpu_init();
+
+	sha256_mb_ni = __builtin_cpu_supports("sse4.1") && sha256_have_ni();
+	if (__builtin_cpu_supports("avx512f") &&
+	    __builtin_cpu_supports("avx512vl"))
+		return SHA256_MB_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SHA256_MB_AVX2;
+
+	return SHA256_MB_NONE;
+}
+
+void fio_sha256_multi(const uint8_t **data, const unsigned int *len,
+		      uint8_t **out, unsigned int nr)
+{
+	unsigned int i;
+
+	if (!sha256_mb_mode)
+		sha256_mb_mode = sha256_mb_probe();
+
+	/*
+	 * One stream with the SHA extensions is about as fast as 8 lanes of
+	 * AVX-512 and beats AVX2, so only go wide if there's enough to do.
+	 */
+	switch (sha256_mb_mode) {
+	case SHA256_MB_AVX512:
+		if (nr >= 16) {
+			sha256_mb(sha256_mb16_avx512, 16, data, len, out, nr);
+			return;
+		}
+		if (nr >= (sha256_mb_ni ? 8 : 2)) {
+			sha256_mb(sha256_mb8_avx512, 8, data, len, out, nr);
+			return;
+		}
+		break;
+	case SHA256_MB_AVX2:
+		if (!sha256_mb_ni && nr >= 2) {
+			sha256_mb(sha256_mb8_avx2, 8, data, len, out, nr);
+			return;
+		}
+		break;
+	}
+
+	for (i = 0; i < nr; i++)
+		sha256_one(data[i], len[i], out[i]);
+}
+#else
+void fio_sha256_multi(const uint8_t **data, const unsigned int *len,
+		      uint8_t **out, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		sha256_one(data[i], len[i], out[i]);
+}
+#endif
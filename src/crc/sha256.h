@@ -16,4 +16,11 @@ void fio_sha256_init(struct fio_sha256_ctx *);
 void fio_sha256_update(struct fio_sha256_ctx *, const uint8_t *, unsigned int);
 void fio_sha256_final(struct fio_sha256_ctx *);
 
+/*
+ * Hash nr independent buffers, leaving in out[i] the same 64 bytes that
+ * fio_sha256_final() leaves in ctx->buf.
+ */
+void fio_sha256_multi(const uint8_t **, const unsigned int *, uint8_t **,
+		      unsigned int);
+
 #endif
@@ -419,3 +419,166 @@ uint32_t XXH32_digest (void* state_in)
 
     return h32;
 }
+
+
+//****************************
+// Multi-buffer hashing
+//****************************
+// Each of 8 independent inputs runs in its own 32-bit lane of an AVX2
+// register. Every lane reads two stripes (32 bytes) per step, the 8x8 block
+// of words is transposed so that word k of all lanes ends up in one vector.
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define XXH_MB_LANES 8
+
+static inline __attribute__((target("avx2")))
+__m256i XXH32_mb_round(__m256i v, __m256i in)
+{
+    v = _mm256_add_epi32(v, _mm256_mullo_epi32(in, _mm256_set1_epi32((int) PRIME32_2)));
+    v = _mm256_or_si256(_mm256_slli_epi32(v, 13), _mm256_srli_epi32(v, 32 - 13));
+    return _mm256_mullo_epi32(v, _mm256_set1_epi32((int) PRIME32_1));
+}
+
+// Run 'pairs' pairs of stripes on all lanes, leaving the accumulators
+// of lane l in v[l][0..3]
+static __attribute__((target("avx2")))
+void XXH32_mb_avx2(const uint8_t **p, unsigned int pairs, uint32_t seed, uint32_t (*v)[4])
+{
+    __m256i acc[4], r[8], t[8], u[8], w[8];
+    uint32_t out[4][XXH_MB_LANES] __attribute__((aligned(32)));
+    unsigned int i, l;
+
+    acc[0] = _mm256_set1_epi32((int) (seed + PRIME32_1 + PRIME32_2));
+    acc[1] = _mm256_set1_epi32((int) (seed + PRIME32_2));
+    acc[2] = _mm256_set1_epi32((int) seed);
+    acc[3] = _mm256_set1_epi32((int) (seed - PRIME32_1));
+
+    for (i = 0; i < pairs; i++)
+    {
+        for (l = 0; l < 8; l++)
+            r[l] = _mm256_loadu_si256((const __m256i *) (p[l] + i * 32));
+
+        t[0] = _mm256_unpacklo_epi32(r[0], r[1]); t[1] = _mm256_unpackhi_epi32(r[0], r[1]);
+        t[2] = _mm256_unpacklo_epi32(r[2], r[3]); t[3] = _mm256_unpackhi_epi32(r[2], r[3]);
+        t[4] = _mm256_unpacklo_epi32(r[4], r[5]); t[5] = _mm256_unpackhi_epi32(r[4], r[5]);
+        t[6] = _mm256_unpacklo_epi32(r[6], r[7]); t[7] = _mm256_unpackhi_epi32(r[6], r[7]);
+
+        u[0] = _mm256_unpacklo_epi64(t[0], t[2]); u[1] = _mm256_unpackhi_epi64(t[0], t[2]);
+        u[2] = _mm256_unpacklo_epi64(t[1], t[3]); u[3] = _mm256_unpackhi_epi64(t[1], t[3]);
+        u[4] = _mm256_unpacklo_epi64(t[4], t[6]); u[5] = _mm256_unpackhi_epi64(t[4], t[6]);
+        u[6] = _mm256_unpacklo_epi64(t[5], t[7]); u[7] = _mm256_unpackhi_epi64(t[5], t[7]);
+
+        // w[k] holds word k of every lane, first stripe is 0..3
+        for (l = 0; l < 4; l++)
+        {
+            w[l] = _mm256_permute2x128_si256(u[l], u[l + 4], 0x20);
+            w[l + 4] = _mm256_permute2x128_si256(u[l], u[l + 4], 0x31);
+        }
+
+        for (l = 0; l < 4; l++)
+            acc[l] = XXH32_mb_round(acc[l], w[l]);
+        for (l = 0; l < 4; l++)
+            acc[l] = XXH32_mb_round(acc[l], w[l + 4]);
+    }
+
+    for (i = 0; i < 4; i++)
+        _mm256_store_si256((__m256i *) out[i], acc[i]);
+    for (l = 0; l < 8; l++)
+        for (i = 0; i < 4; i++)
+            v[l][i] = out[i][l];
+}
+
+// Same as the tail of XXH32_endian_align(), starting from accumulators
+// that already consumed everything up to p
+static uint32_t XXH32_mb_finish(const uint32_t *acc, const uint8_t *p, uint32_t len, uint32_t seed, const uint8_t *bEnd)
+{
+    uint32_t v1 = acc[0], v2 = acc[1], v3 = acc[2], v4 = acc[3];
+    uint32_t h32;
+
+    while (p + 16 <= bEnd)
+    {
+        v1 += XXH_readLE32((const uint32_t*)p, XXH_littleEndian) * PRIME32_2; v1 = XXH_rotl32(v1, 13); v1 *= PRIME32_1; p+=4;
+        v2 += XXH_readLE32((const uint32_t*)p, XXH_littleEndian) * PRIME32_2; v2 = XXH_rotl32(v2, 13); v2 *= PRIME32_1; p+=4;
+        v3 += XXH_readLE32((const uint32_t*)p, XXH_littleEndian) * PRIME32_2; v3 = XXH_rotl32(v3, 13); v3 *= PRIME32_1; p+=4;
+        v4 += XXH_readLE32((const uint32_t*)p, XXH_littleEndian) * PRIME32_2; v4 = XXH_rotl32(v4, 13); v4 *= PRIME32_1; p+=4;
+    }
+
+    h32 = XXH_rotl32(v1, 1) + XXH_rotl32(v2, 7) + XXH_rotl32(v3, 12) + XXH_rotl32(v4, 18);
+    h32 += len;
+
+    while (p + 4 <= bEnd)
+    {
+        h32 += XXH_readLE32((const uint32_t*)p, XXH_littleEndian) * PRIME32_3;
+        h32  = XXH_rotl32(h32, 17) * PRIME32_4;
+        p+=4;
+    }
+
+    while (p<bEnd)
+    {
+        h32 += (*p) * PRIME32_5;
+        h32 = XXH_rotl32(h32, 11) * PRIME32_1;
+        p++;
+    }
+
+    h32 ^= h32 >> 15;
+    h32 *= PRIME32_2;
+    h32 ^= h32 >> 13;
+    h32 *= PRIME32_3;
+    h32 ^= h32 >> 16;
+
+    return h32;
+}
+
+static int XXH32_mb_avail = -1;
+
+void XXH32_multi(const void** input, const uint32_t* len, uint32_t seed, uint32_t* out, unsigned int nr)
+{
+    const uint8_t* p[XXH_MB_LANES];
+    uint32_t acc[XXH_MB_LANES][4];
+    unsigned int i, l, n, pairs;
+
+    if (XXH32_mb_avail < 0)
+    {
+        __builtin_cpu_init();
+        XXH32_mb_avail = __builtin_cpu_supports("avx2");
+    }
+
+    for (i = 0; i < nr; i += n)
+    {
+        n = nr - i < XXH_MB_LANES ? nr - i : XXH_MB_LANES;
+
+        // Lanes run in lock step, so they go as far as the shortest input.
+        // A lone input or two isn't worth it.
+        pairs = -1U;
+        for (l = 0; l < n; l++)
+            if (len[i + l] / 32 < pairs)
+                pairs = len[i + l] / 32;
+
+        if (!XXH32_mb_avail || n < 3 || !pairs)
+        {
+            for (l = 0; l < n; l++)
+                out[i + l] = XXH32(input[i + l], len[i + l], seed);
+            continue;
+        }
+
+        // Idle lanes just redo the first input
+        for (l = 0; l < XXH_MB_LANES; l++)
+            p[l] = input[i + (l < n ? l : 0)];
+
+        XXH32_mb_avx2(p, pairs, seed, acc);
+
+        for (l = 0; l < n; l++)
+            out[i + l] = XXH32_mb_finish(acc[l], p[l] + pairs * 32, len[i + l], seed, p[l] + len[i + l]);
+    }
+}
+#else
+void XXH32_multi(const void** input, const uint32_t* len, uint32_t seed, uint32_t* out, unsigned int nr)
+{
+    unsigned int i;
+
+    for (i = 0; i < nr; i++)
+        out[i] = XXH32(input[i], len[i], seed);
+}
+#endif
@@ -101,6 +101,13 @@ XXH32() :
     If your data is larger, use the advanced functions below.
 */
 
+void XXH32_multi(const void** input, const uint32_t* len, uint32_t seed, uint32_t* out, unsigned int nr);
+/*
+XXH32_multi() :
+    Same as calling XXH32() on each of the nr inputs, but hashes several of them
+    at once with SIMD instructions where available.
+*/
+
 
 
 //****************************
@@ -1,5 +1,11 @@
 #include "fio.h"
 
+/*
+ * Initial buf_state of every job, for dedupe_global. Set up by the backend
+ * before the jobs start, and shared by all of them.
+ */
+static struct frand_state *global_bases;
+
 /**
  * initializes the global dedup workset.
  * this needs to be called after all jobs' seeds
@@ -7,6 +13,24 @@
  */
 int init_global_dedupe_working_set_seeds(void)
 {
+	bool any = false;
+
+	for_each_td(td) {
+		if (td->o.dedupe_global)
+			any = true;
+	} end_for_each();
+
+	if (!any)
+		return 0;
+
+	global_bases = calloc(thread_number, sizeof(struct frand_state));
+	if (!global_bases)
+		return 1;
+
+	for_each_td(td) {
+		frand_copy(&global_bases[__td_index], &td->buf_state);
+	} end_for_each();
+
 	for_each_td(td) {
 		if (!td->o.dedupe_global)
 			continue;
@@ -18,17 +42,21 @@ int init_global_dedupe_working_set_seeds(void)
 	return 0;
 }
 
+/*
+ * The working set is the first num_unique_pages buffers generated from a
+ * base seed: page i is the base state advanced i times. With global dedupe,
+ * the pages are spread evenly across the jobs, each run of pages_per_seed
+ * pages starting over from the next job's base state. Rather than storing
+ * the state of every page, keep the base states and jump ahead from them
+ * when a page is needed.
+ */
 int init_dedupe_working_set_seeds(struct thread_data *td, bool global_dedup)
 {
-	int tindex;
-	struct thread_data *td_seed;
-	unsigned long long i, j, num_seed_advancements, pages_per_seed;
-	struct frand_state dedupe_working_set_state = {0};
+	unsigned long long num_seed_advancements, stride;
 
 	if (!td->o.dedupe_percentage || !(td->o.dedupe_mode == DEDUPE_MODE_WORKING_SET))
 		return 0;
 
-	tindex = td->thread_number - 1;
 	num_seed_advancements = td->o.min_bs[DDIR_WRITE] /
 		min_not_zero(td->o.min_bs[DDIR_WRITE], (unsigned long long) td->o.compress_chunk);
 	/*
@@ -36,36 +64,54 @@ int init_dedupe_working_set_seeds(struct thread_data *td, bool global_dedup)
 	 * Dedupe-ed pages will be generated using those seeds.
 	 */
 	td->num_unique_pages = (td->o.size * (unsigned long long)td->o.dedupe_working_set_percentage / 100) / td->o.min_bs[DDIR_WRITE];
-	td->dedupe_working_set_states = malloc(sizeof(struct frand_state) * td->num_unique_pages);
-	if (!td->dedupe_working_set_states) {
-		log_err("fio: could not allocate dedupe working set\n");
-		return 1;
+
+	if (global_dedup) {
+		td->dedupe_working_set_bases = global_bases;
+		td->dedupe_pages_per_seed = max(td->num_unique_pages / thread_number, 1ull);
+	} else {
+		frand_copy(&td->dedupe_working_set_base, &td->buf_state);
+		td->dedupe_working_set_bases = &td->dedupe_working_set_base;
+		td->dedupe_pages_per_seed = max(td->num_unique_pages, 1ull);
 	}
 
-	frand_copy(&dedupe_working_set_state, &td->buf_state);
-	frand_copy(&td->dedupe_working_set_states[0], &dedupe_working_set_state);
-	pages_per_seed = max(td->num_unique_pages / thread_number, 1ull);
-	for (i = 1; i < td->num_unique_pages; i++) {
-		/*
-		 * When compression is used the seed is advanced multiple times to
-		 * generate the buffer. We want to regenerate the same buffer when
-		 * deduping against this page
-		 */
-		for (j = 0; j < num_seed_advancements; j++)
-			__get_next_seed(&dedupe_working_set_state);
-
-		/*
-		 * When global dedup is used, we rotate the seeds to allow
-		 * generating same buffers across different jobs. Deduplication buffers
-		 * are spread evenly across jobs participating in global dedupe
-		 */
-		if (global_dedup && i % pages_per_seed == 0) {
-			td_seed = tnumber_to_td(++tindex % thread_number);
-			frand_copy(&dedupe_working_set_state, &td_seed->buf_state);
-		}
-
-		frand_copy(&td->dedupe_working_set_states[i], &dedupe_working_set_state);
+	/*
+	 * When compression is used the seed is advanced multiple times to
+	 * generate the buffer. We want to regenerate the same buffer when
+	 * deduping against this page. Each seed takes two steps of the
+	 * generator on 64-bit hosts, see __get_next_seed().
+	 */
+	stride = num_seed_advancements;
+	if (sizeof(int) != sizeof(long *))
+		stride *= 2;
+
+	if (frand_jump_init(&td->dedupe_working_set_jump,
+			    td->buf_state.use64, stride,
+			    td->dedupe_pages_per_seed - 1)) {
+		log_err("fio: could not allocate dedupe working set\n");
+		return 1;
 	}
 
 	return 0;
 }
+
+/*
+ * Get the state that generates working set page 'page'
+ */
+void dedupe_working_set_state(struct thread_data *td, unsigned long long page,
+			      struct frand_state *fs)
+{
+	unsigned long long seg = page / td->dedupe_pages_per_seed;
+	unsigned int base = 0;
+
+	if (td->o.dedupe_global)
+		base = (td->thread_number - 1 + seg) % thread_number;
+
+	frand_copy(fs, &td->dedupe_working_set_bases[base]);
+	frand_jump(&td->dedupe_working_set_jump, fs,
+			page % td->dedupe_pages_per_seed);
+}
+
+void free_dedupe_working_set(struct thread_data *td)
+{
+	frand_jump_free(&td->dedupe_working_set_jump);
+}
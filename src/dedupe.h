@@ -3,5 +3,8 @@
 
 int init_dedupe_working_set_seeds(struct thread_data *td, bool global_dedupe);
 int init_global_dedupe_working_set_seeds(void);
+void dedupe_working_set_state(struct thread_data *td, unsigned long long page,
+			      struct frand_state *fs);
+void free_dedupe_working_set(struct thread_data *td);
 
 #endif
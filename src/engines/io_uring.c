@@ -133,6 +133,8 @@ struct ioring_mmap {
 
 struct ioring_data {
 	int ring_fd;
+	int enter_ring_fd;
+	unsigned enter_flags;
 
 	struct io_u **io_u_index;
 	char *md_buf;
@@ -156,6 +158,18 @@ struct ioring_data {
 
 	struct ioring_mmap mmap[3];
 
+	/* provided buffer ring, see fio_ioring_br_init() */
+	struct io_uring_buf_ring *br;
+	char *br_bufs;
+	size_t br_buf_len;
+	unsigned br_entries;
+	unsigned br_mask;
+	unsigned br_avail;
+	__u16 br_tail;
+	int *br_bid;
+	unsigned *br_recycle;
+	unsigned br_nr_recycle;
+
 	struct cmdprio cmdprio;
 
 	struct nvme_dsm *dsm;
@@ -177,7 +191,10 @@ struct ioring_options {
 	unsigned int verify_mode;
 	struct cmdprio_options cmdprio_options;
 	unsigned int fixedbufs;
+	unsigned int buffer_ring;
+	unsigned int buffer_ring_entries;
 	unsigned int registerfiles;
+	unsigned int submit_wait;
 	unsigned int sqpoll_thread;
 	unsigned int sqpoll_set;
 	unsigned int sqpoll_cpu;
@@ -300,6 +317,25 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "buffer_ring",
+		.lname	= "Provided buffer ring",
+		.type	= FIO_OPT_STR_SET,
+		.off1	= offsetof(struct ioring_options, buffer_ring),
+		.help	= "Let the kernel pick read buffers from a registered ring",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "buffer_ring_entries",
+		.lname	= "Provided buffer ring entries",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, buffer_ring_entries),
+		.def	= "0",
+		.help	= "Number of buffers in the provided buffer ring (Default: iodepth)",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= "registerfiles",
 		.lname	= "Register file set",
@@ -309,6 +345,16 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "submit_wait",
+		.lname	= "Submit and wait",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct ioring_options, submit_wait),
+		.help	= "Wait for completions in the submit call if the queue is full",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= "sqthread_poll",
 		.lname	= "Kernel SQ thread polling",
@@ -449,15 +495,107 @@ static struct fio_option options[] = {
 static int io_uring_enter(struct ioring_data *ld, unsigned int to_submit,
 			 unsigned int min_complete, unsigned int flags)
 {
+	flags |= ld->enter_flags;
 #ifdef FIO_ARCH_HAS_SYSCALL
-	return __do_syscall6(__NR_io_uring_enter, ld->ring_fd, to_submit,
+	return __do_syscall6(__NR_io_uring_enter, ld->enter_ring_fd, to_submit,
 				min_complete, flags, NULL, 0);
 #else
-	return syscall(__NR_io_uring_enter, ld->ring_fd, to_submit,
+	return syscall(__NR_io_uring_enter, ld->enter_ring_fd, to_submit,
 			min_complete, flags, NULL, 0);
 #endif
 }
 
+/*
+ * Register the ring fd with itself, so io_uring_enter() can skip the fd
+ * lookup on every call. Not supported on older kernels, in which case we
+ * just keep using the normal fd.
+ */
+static void fio_ioring_register_ring_fd(struct ioring_data *ld)
+{
+	struct io_uring_rsrc_update up = {
+		.offset	= -1U,
+		.data	= ld->ring_fd,
+	};
+	int ret;
+
+	ld->enter_ring_fd = ld->ring_fd;
+	ld->enter_flags = 0;
+
+	ret = syscall(__NR_io_uring_register, ld->ring_fd,
+			IORING_REGISTER_RING_FDS, &up, 1);
+	if (ret != 1)
+		return;
+
+	ld->enter_ring_fd = up.offset;
+	ld->enter_flags = IORING_ENTER_REGISTERED_RING;
+}
+
+static void fio_ioring_unregister_ring_fd(struct ioring_data *ld)
+{
+	struct io_uring_rsrc_update up = {
+		.offset	= ld->enter_ring_fd,
+	};
+
+	if (!(ld->enter_flags & IORING_ENTER_REGISTERED_RING))
+		return;
+
+	syscall(__NR_io_uring_register, ld->ring_fd,
+		IORING_UNREGISTER_RING_FDS, &up, 1);
+	ld->enter_ring_fd = ld->ring_fd;
+	ld->enter_flags = 0;
+}
+
+/*
+ * Buffer group ID used for the provided buffer ring
+ */
+#define FIO_IORING_BGID		0
+
+static void fio_ioring_br_add(struct ioring_data *ld, unsigned bid,
+			      unsigned offset)
+{
+	struct io_uring_buf *buf;
+
+	buf = &ld->br->bufs[(ld->br_tail + offset) & ld->br_mask];
+	buf->addr = (unsigned long) (ld->br_bufs + bid * ld->br_buf_len);
+	buf->len = ld->br_buf_len;
+	buf->bid = bid;
+}
+
+/*
+ * Hand buffers picked by the kernel back to the ring. The io_us on the
+ * recycle list were returned by the last reap, and fio is done with them
+ * once we get called again. Short reads that fio requeued still need their
+ * buffer for the remainder of the transfer, keep those around until the
+ * continuation completes.
+ */
+static void fio_ioring_br_recycle(struct ioring_data *ld)
+{
+	unsigned i, nr = 0;
+
+	if (!ld->br_nr_recycle)
+		return;
+
+	for (i = 0; i < ld->br_nr_recycle; i++) {
+		unsigned index = ld->br_recycle[i];
+		struct io_u *io_u = ld->io_u_index[index];
+
+		if (io_u->xfer_buf != io_u->buf)
+			continue;
+
+		fio_ioring_br_add(ld, ld->br_bid[index], nr++);
+		ld->br_bid[index] = -1;
+		io_u->buf = io_u->xfer_buf = ld->iovecs[index].iov_base;
+	}
+
+	ld->br_nr_recycle = 0;
+	if (!nr)
+		return;
+
+	ld->br_tail += nr;
+	atomic_store_release(&ld->br->tail, ld->br_tail);
+	ld->br_avail += nr;
+}
+
 #ifndef BLOCK_URING_CMD_DISCARD
 #define BLOCK_URING_CMD_DISCARD	_IO(0x12, 0)
 #endif
@@ -498,8 +636,23 @@ static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 		sqe->flags = 0;
 	}
 
+	if (ld->br)
+		fio_ioring_br_recycle(ld);
+
 	if (io_u->ddir == DDIR_READ || io_u->ddir == DDIR_WRITE) {
-		if (o->fixedbufs) {
+		if (ld->br) {
+			sqe->opcode = IORING_OP_READ;
+			sqe->len = io_u->xfer_buflen;
+			if (ld->br_bid[io_u->index] < 0) {
+				sqe->flags |= IOSQE_BUFFER_SELECT;
+				sqe->buf_group = FIO_IORING_BGID;
+				sqe->addr = 0;
+			} else {
+				/* requeued short read, finish it in place */
+				sqe->buf_index = 0;
+				sqe->addr = (unsigned long) io_u->xfer_buf;
+			}
+		} else if (o->fixedbufs) {
 			sqe->opcode = fixed_ddir_to_op[io_u->ddir];
 			sqe->addr = (unsigned long) io_u->xfer_buf;
 			sqe->len = io_u->xfer_buflen;
@@ -680,6 +833,21 @@ static struct io_u *fio_ioring_event(struct thread_data *td, int event)
 	cqe = &ld->cq_ring.cqes[index];
 	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
 
+	if (ld->br && io_u->ddir == DDIR_READ) {
+		if (cqe->flags & IORING_CQE_F_BUFFER) {
+			unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+			ld->br_bid[io_u->index] = bid;
+			io_u->buf = ld->br_bufs + bid * ld->br_buf_len;
+			io_u->xfer_buf = io_u->buf;
+		} else if (ld->br_bid[io_u->index] < 0) {
+			/* failed before a buffer was picked */
+			ld->br_avail++;
+		}
+		if (ld->br_bid[io_u->index] >= 0)
+			ld->br_recycle[ld->br_nr_recycle++] = io_u->index;
+	}
+
 	/* trim returns 0 on success */
 	if (cqe->res == io_u->xfer_buflen ||
 	    (io_u->ddir == DDIR_TRIM && !cqe->res)) {
@@ -812,6 +980,9 @@ static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 	unsigned events = 0;
 	int r;
 
+	if (ld->br)
+		fio_ioring_br_recycle(ld);
+
 	ld->cq_ring_off = *ring->head;
 	for (;;) {
 		r = fio_ioring_cqring_reap(td, max - events);
@@ -901,6 +1072,17 @@ static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 		return FIO_Q_COMPLETED;
 	}
 
+	/*
+	 * Reads that select a buffer from the ring can only be issued if
+	 * there's one left to pick, otherwise the kernel fails them with
+	 * ENOBUFS. Wait for completions to hand some back instead.
+	 */
+	if (ld->br && io_u->ddir == DDIR_READ && ld->br_bid[io_u->index] < 0) {
+		if (!ld->br_avail)
+			return FIO_Q_BUSY;
+		ld->br_avail--;
+	}
+
 	if (ld->cmdprio.mode != CMDPRIO_MODE_NONE)
 		fio_ioring_cmdprio_prep(td, io_u);
 
@@ -917,7 +1099,8 @@ static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 	return FIO_Q_QUEUED;
 }
 
-static void fio_ioring_queued(struct thread_data *td, int start, int nr)
+static void fio_ioring_queued(struct thread_data *td, int start, int nr,
+			      const struct timespec *issue)
 {
 	struct ioring_data *ld = td->io_ops_data;
 	struct timespec now;
@@ -925,7 +1108,10 @@ static void fio_ioring_queued(struct thread_data *td, int start, int nr)
 	if (!fio_fill_issue_time(td))
 		return;
 
-	fio_gettime(&now, NULL);
+	if (issue)
+		now = *issue;
+	else
+		fio_gettime(&now, NULL);
 
 	while (nr--) {
 		struct io_sq_ring *ring = &ld->sq_ring;
@@ -949,6 +1135,9 @@ static int fio_ioring_commit(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
 	struct ioring_options *o = td->eo;
+	const struct timespec *issue = NULL;
+	unsigned min_complete = 0;
+	struct timespec now;
 	int ret;
 
 	if (!ld->queued)
@@ -968,20 +1157,40 @@ static int fio_ioring_commit(struct thread_data *td)
 		if (flags & IORING_SQ_NEED_WAKEUP)
 			io_uring_enter(ld, ld->queued, 0,
 					IORING_ENTER_SQ_WAKEUP);
-		fio_ioring_queued(td, start, ld->queued);
+		fio_ioring_queued(td, start, ld->queued, NULL);
 		io_u_mark_submit(td, ld->queued);
 
 		ld->queued = 0;
 		return 0;
 	}
 
+	/*
+	 * If the queue is full after this submit, the next thing fio does is
+	 * to wait for completions. Do that as part of the submit call, and
+	 * let fio_ioring_getevents() find the events already posted. The
+	 * issue time must then be sampled before we enter the kernel, or
+	 * the time spent waiting would be taken out of the completion
+	 * latency.
+	 */
+	if (o->submit_wait && queue_full(td)) {
+		min_complete = min(td->o.iodepth_batch_complete_min,
+					td->cur_depth);
+		if (!min_complete)
+			min_complete = 1;
+		if (fio_fill_issue_time(td)) {
+			fio_gettime(&now, NULL);
+			issue = &now;
+		}
+	}
+
 	do {
 		unsigned start = *ld->sq_ring.head;
 		long nr = ld->queued;
 
-		ret = io_uring_enter(ld, nr, 0, IORING_ENTER_GETEVENTS);
+		ret = io_uring_enter(ld, nr, min_complete,
+					IORING_ENTER_GETEVENTS);
 		if (ret > 0) {
-			fio_ioring_queued(td, start, ret);
+			fio_ioring_queued(td, start, ret, issue);
 			io_u_mark_submit(td, ret);
 
 			ld->queued -= ret;
@@ -1011,18 +1220,31 @@ static void fio_ioring_unmap(struct ioring_data *ld)
 {
 	int i;
 
+	fio_ioring_unregister_ring_fd(ld);
 	for (i = 0; i < FIO_ARRAY_SIZE(ld->mmap); i++)
 		munmap(ld->mmap[i].ptr, ld->mmap[i].len);
 	close(ld->ring_fd);
 }
 
+static void fio_ioring_br_free(struct ioring_data *ld)
+{
+	if (ld->br)
+		munmap(ld->br, ld->br_entries * sizeof(struct io_uring_buf));
+	if (ld->br_bufs)
+		munmap(ld->br_bufs, ld->br_entries * ld->br_buf_len);
+	ld->br = NULL;
+	ld->br_bufs = NULL;
+}
+
 static void fio_ioring_cleanup(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
 
 	if (ld) {
-		if (!(td->flags & TD_F_CHILD))
+		if (!(td->flags & TD_F_CHILD)) {
 			fio_ioring_unmap(ld);
+			fio_ioring_br_free(ld);
+		}
 
 		fio_cmdprio_cleanup(&ld->cmdprio);
 		free(ld->io_u_index);
@@ -1031,6 +1253,8 @@ static void fio_ioring_cleanup(struct thread_data *td)
 		free(ld->iovecs);
 		free(ld->fds);
 		free(ld->dsm);
+		free(ld->br_bid);
+		free(ld->br_recycle);
 		free(ld);
 	}
 }
@@ -1183,6 +1407,7 @@ retry:
 	}
 
 	ld->ring_fd = ret;
+	fio_ioring_register_ring_fd(ld);
 
 	fio_ioring_probe(td);
 
@@ -1267,6 +1492,7 @@ retry:
 	}
 
 	ld->ring_fd = ret;
+	fio_ioring_register_ring_fd(ld);
 
 	fio_ioring_probe(td);
 
@@ -1320,6 +1546,91 @@ err:
 	return ret;
 }
 
+/*
+ * Set up a ring of provided buffers. Reads are issued with
+ * IOSQE_BUFFER_SELECT and the kernel picks a buffer for each of them,
+ * so the memory in use follows the number of buffers in the ring rather
+ * than the number of io_us.
+ */
+static int fio_ioring_br_init(struct thread_data *td)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct io_uring_buf_reg reg;
+	unsigned i;
+	int ret;
+
+	ld->br_entries = o->buffer_ring_entries;
+	if (!ld->br_entries)
+		ld->br_entries = ld->iodepth;
+	ld->br_entries = roundup_pow2(ld->br_entries);
+	if (ld->br_entries > 32768) {
+		log_err("fio: buffer_ring_entries must be <= 32768\n");
+		return 1;
+	}
+	ld->br_mask = ld->br_entries - 1;
+	ld->br_buf_len = td_max_bs(td);
+
+	ld->br = mmap(NULL, ld->br_entries * sizeof(struct io_uring_buf),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (ld->br == MAP_FAILED) {
+		ld->br = NULL;
+		td_verror(td, errno, "mmap buffer ring");
+		return 1;
+	}
+
+	ld->br_bufs = mmap(NULL, ld->br_entries * ld->br_buf_len,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (ld->br_bufs == MAP_FAILED) {
+		ld->br_bufs = NULL;
+		td_verror(td, errno, "mmap buffer ring buffers");
+		goto err;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) ld->br;
+	reg.ring_entries = ld->br_entries;
+	reg.bgid = FIO_IORING_BGID;
+
+	ret = syscall(__NR_io_uring_register, ld->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0) {
+		if (errno == EINVAL)
+			log_err("fio: your kernel doesn't support io_uring "
+				"provided buffer rings\n");
+		td_verror(td, errno, "io_uring_register pbuf ring");
+		goto err;
+	}
+
+	ld->br_bid = malloc(td->o.iodepth * sizeof(int));
+	ld->br_recycle = calloc(td->o.iodepth, sizeof(unsigned));
+	for (i = 0; i < td->o.iodepth; i++)
+		ld->br_bid[i] = -1;
+
+	for (i = 0; i < ld->br_entries; i++)
+		fio_ioring_br_add(ld, i, i);
+	ld->br_tail = ld->br_entries;
+	atomic_store_release(&ld->br->tail, ld->br_tail);
+	ld->br_avail = ld->br_entries;
+
+	/*
+	 * The io_us have no buffers of their own, see TD_F_ENGINE_BUFS. Until
+	 * a read picks one, an io_u points at a buffer of the ring.
+	 */
+	for (i = 0; i < td->o.iodepth; i++) {
+		struct io_u *io_u = ld->io_u_index[i];
+
+		io_u->buf = ld->br_bufs + (i & ld->br_mask) * ld->br_buf_len;
+		ld->iovecs[i].iov_base = io_u->buf;
+	}
+	return 0;
+err:
+	fio_ioring_br_free(ld);
+	return 1;
+}
+
 static int fio_ioring_post_init(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -1352,6 +1663,9 @@ static int fio_ioring_post_init(struct thread_data *td)
 		memset(sqe, 0, sizeof(*sqe));
 	}
 
+	if (o->buffer_ring && fio_ioring_br_init(td))
+		return 1;
+
 	if (o->registerfiles) {
 		err = fio_ioring_register_files(td);
 		if (err) {
@@ -1474,6 +1788,33 @@ static int fio_ioring_init(struct thread_data *td)
 		return 1;
 	}
 
+	if (o->buffer_ring) {
+		if (td->io_ops->prep == fio_ioring_cmd_prep) {
+			log_err("fio: buffer_ring is not supported by io_uring_cmd\n");
+			return 1;
+		}
+		if (td_write(td) || td_trim(td)) {
+			log_err("fio: io_uring buffer_ring only supports reads\n");
+			return 1;
+		}
+		if (o->fixedbufs || o->md_per_io_size) {
+			log_err("fio: io_uring buffer_ring can't be combined with "
+				"fixedbufs or md_per_io_size\n");
+			return 1;
+		}
+		if (td->o.verify_async) {
+			log_err("fio: io_uring buffer_ring can't be used with "
+				"verify_async\n");
+			return 1;
+		}
+
+		/*
+		 * Reads land in the ring's buffers, don't allocate io_u
+		 * buffers on top of them
+		 */
+		td->flags |= TD_F_ENGINE_BUFS;
+	}
+
 	ld = calloc(1, sizeof(*ld));
 
 	ld->is_uring_cmd_eng = (td->io_ops->prep == fio_ioring_cmd_prep);
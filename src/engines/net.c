@@ -32,6 +32,15 @@ struct sockaddr_vm {
 #include "../verify.h"
 #include "../optgroup.h"
 
+#if defined(__linux__) && defined(ARCH_HAVE_IOURING)
+#define FIO_HAVE_NET_URING
+#include <sys/mman.h>
+#include "../lib/roundup.h"
+#include "../os/linux/io_uring.h"
+
+struct netio_uring;
+#endif
+
 struct netio_data {
 	int listenfd;
 	int use_splice;
@@ -43,6 +52,9 @@ struct netio_data {
 	struct sockaddr_vm addr_vm;
 	uint64_t udp_send_seq;
 	uint64_t udp_recv_seq;
+#ifdef FIO_HAVE_NET_URING
+	struct netio_uring *ur;
+#endif
 };
 
 struct netio_options {
@@ -56,6 +68,8 @@ struct netio_options {
 	unsigned int window_size;
 	unsigned int mss;
 	char *intfc;
+	unsigned int sendzc;
+	unsigned int recv_buffers;
 };
 
 struct udp_close_msg {
@@ -218,6 +232,30 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_NETIO,
 	},
+#endif
+#ifdef FIO_HAVE_NET_URING
+	{
+		.name	= "sendzc",
+		.lname	= "Zero copy send",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct netio_options, sendzc),
+		.def	= "1",
+		.help	= "Use zero copy sends if supported (net_uring)",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_NETIO,
+	},
+	{
+		.name	= "recv_buffers",
+		.lname	= "Receive buffers",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct netio_options, recv_buffers),
+		.def	= "0",
+		.minval	= 0,
+		.maxval	= 32768,
+		.help	= "Number of provided buffers for multishot receive (net_uring)",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_NETIO,
+	},
 #endif
 	{
 		.name	= NULL,
@@ -590,14 +628,13 @@ static int fio_netio_send(struct thread_data *td, struct io_u *io_u)
 	return ret;
 }
 
-static int is_close_msg(struct io_u *io_u, int len)
+static int __is_close_msg(const void *buf, int len)
 {
-	struct udp_close_msg *msg;
+	const struct udp_close_msg *msg = buf;
 
 	if (len != sizeof(struct udp_close_msg))
 		return 0;
 
-	msg = io_u->xfer_buf;
 	if (le32_to_cpu(msg->magic) != FIO_LINK_OPEN_CLOSE_MAGIC)
 		return 0;
 	if (le32_to_cpu(msg->cmd) != FIO_LINK_CLOSE)
@@ -606,6 +643,11 @@ static int is_close_msg(struct io_u *io_u, int len)
 	return 1;
 }
 
+static int is_close_msg(struct io_u *io_u, int len)
+{
+	return __is_close_msg(io_u->xfer_buf, len);
+}
+
 static int fio_netio_recv(struct thread_data *td, struct io_u *io_u)
 {
 	struct netio_data *nd = td->io_ops_data;
@@ -924,7 +966,7 @@ static void fio_netio_send_close(struct thread_data *td, struct fio_file *f)
 	if (is_ipv6(o)) {
 		to = (struct sockaddr *) &nd->addr6;
 		len = sizeof(nd->addr6);
-	} else if (is_vsock(o)) {
+	} else if (is_vsock(o) || o->proto == FIO_TYPE_UNIX) {
 		to = NULL;
 		len = 0;
 	} else {
@@ -1512,6 +1554,1049 @@ static void fio_netio_terminate(struct thread_data *td)
 	kill(td->pid, SIGTERM);
 }
 
+#ifdef FIO_HAVE_NET_URING
+/*
+ * net_uring: same connection setup and link protocol as the net engine,
+ * but data moves through io_uring. Sends use SEND_ZC when the kernel and
+ * socket support it, receives are served by one multishot RECV picking
+ * buffers from a provided buffer ring, and stream connections are taken
+ * from a multishot ACCEPT.
+ */
+enum {
+	NU_TAG_RECV	= 1,
+	NU_TAG_ACCEPT	= 2,
+	NU_TAG_CANCEL	= 3,
+
+	NU_BGID		= 0,
+	NU_MIN_BUFS	= 8,
+	NU_MAX_BUFS	= 32768,
+	NU_ACCEPT_Q	= 16,
+};
+
+/* per io_u progress */
+struct nu_io {
+	unsigned int done;
+	int phase;
+	/* zero copy notifications still to come */
+	unsigned int notifs;
+	/* the send is over, only waiting for notifications */
+	bool sent;
+};
+
+/* received data still sitting in a provided buffer */
+struct nu_chunk {
+	unsigned int bid;
+	unsigned int len;
+	unsigned int off;
+};
+
+struct netio_uring {
+	int ring_fd;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned tail;
+	unsigned queued;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *mmap_ptr[3];
+	size_t mmap_len[3];
+
+	/* io_us queued since the last commit */
+	struct io_u **issued;
+	unsigned nr_issued;
+
+	/* completed io_us, handed out by getevents */
+	struct io_u **events;
+	unsigned ev_mask;
+	unsigned ev_head;
+	unsigned ev_tail;
+	unsigned ev_off;
+
+	/* reads waiting for data, in queue order */
+	struct io_u **recv_q;
+	unsigned rq_mask;
+	unsigned rq_head;
+	unsigned rq_tail;
+
+	/* stream sends waiting for the previous send on the socket */
+	struct io_u **send_q;
+	unsigned sndq_head;
+	unsigned sndq_tail;
+
+	struct nu_chunk *chunks;
+	unsigned ch_head;
+	unsigned ch_tail;
+
+	struct io_uring_buf_ring *br;
+	char *bufs;
+	unsigned buf_len;
+	unsigned nr_bufs;
+	__u16 br_tail;
+
+	struct nu_io *ios;
+
+	int accept_fds[NU_ACCEPT_Q];
+	unsigned acc_head;
+	unsigned acc_tail;
+	int accept_err;
+	bool accept_armed;
+
+	int recv_fd;
+	int recv_err;
+	bool recv_armed;
+	bool recv_eof;
+
+	bool use_zc;
+};
+
+static int nu_enter(struct netio_uring *ur, unsigned int min_complete,
+		    unsigned int flags)
+{
+	int ret;
+
+	atomic_store_release(ur->sq_tail, ur->tail);
+	ret = syscall(__NR_io_uring_enter, ur->ring_fd, ur->queued,
+			min_complete, flags, NULL, 0);
+	if (ret > 0)
+		ur->queued -= ret;
+
+	return ret;
+}
+
+/*
+ * Returns NULL with errno set if the SQ ring is full and can't be flushed.
+ */
+static struct io_uring_sqe *nu_get_sqe(struct netio_uring *ur)
+{
+	struct io_uring_sqe *sqe;
+
+	/*
+	 * The SQ ring is sized for iodepth plus our internal requests, so
+	 * this should not trigger. If it does, flush what we have once.
+	 */
+	if (ur->queued == ur->sq_entries) {
+		if (nu_enter(ur, 0, 0) < 0)
+			return NULL;
+		if (ur->queued == ur->sq_entries) {
+			errno = EBUSY;
+			return NULL;
+		}
+	}
+
+	sqe = &ur->sqes[ur->tail & ur->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	ur->tail++;
+	ur->queued++;
+	return sqe;
+}
+
+static void nu_buf_recycle(struct netio_uring *ur, unsigned int bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &ur->br->bufs[ur->br_tail & (ur->nr_bufs - 1)];
+	buf->addr = (unsigned long) (ur->bufs + bid * ur->buf_len);
+	buf->len = ur->buf_len;
+	buf->bid = bid;
+	ur->br_tail++;
+	atomic_store_release(&ur->br->tail, ur->br_tail);
+}
+
+static void nu_arm_recv(struct netio_uring *ur, int fd)
+{
+	struct io_uring_sqe *sqe = nu_get_sqe(ur);
+
+	if (!sqe) {
+		ur->recv_err = errno;
+		return;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = NU_BGID;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = NU_TAG_RECV;
+
+	ur->recv_fd = fd;
+	ur->recv_armed = true;
+}
+
+static void nu_arm_accept(struct netio_uring *ur, int fd)
+{
+	struct io_uring_sqe *sqe = nu_get_sqe(ur);
+
+	if (!sqe) {
+		ur->accept_err = errno;
+		return;
+	}
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = NU_TAG_ACCEPT;
+
+	ur->accept_armed = true;
+}
+
+/*
+ * Prepare the (rest of the) send for an io_u. Returns 0 or an error.
+ */
+static int nu_prep_send(struct thread_data *td, struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+	struct nu_io *io = &ur->ios[io_u->index];
+	struct io_uring_sqe *sqe = nu_get_sqe(ur);
+
+	if (!sqe)
+		return errno;
+
+	sqe->opcode = ur->use_zc ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+	sqe->fd = io_u->file->fd;
+	sqe->addr = (unsigned long) io_u->xfer_buf + io->done;
+	sqe->len = io_u->xfer_buflen - io->done;
+
+	/*
+	 * Have the kernel retry short plain sends. A zero copy send gets
+	 * no flags: its buffer stays pinned until the notification, and
+	 * short sends are resent by nu_send_cqe() either way. MSG_MORE is
+	 * never set, with sends completing out of band we can't tell which
+	 * one is the last.
+	 */
+	if (!is_udp(o) && !ur->use_zc)
+		sqe->msg_flags = MSG_WAITALL;
+	sqe->user_data = (unsigned long) io_u;
+	return 0;
+}
+
+static void nu_complete(struct netio_uring *ur, struct io_u *io_u)
+{
+	ur->events[ur->ev_tail++ & ur->ev_mask] = io_u;
+}
+
+/*
+ * A stream socket has at most one send in flight, so the data can't be
+ * reordered when a send comes up short. The io_u being sent is kept in
+ * the file's engine data, later ones wait in send_q.
+ */
+static void nu_send_next(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+
+	while (ur->sndq_head != ur->sndq_tail) {
+		struct io_u *io_u = ur->send_q[ur->sndq_head & ur->rq_mask];
+		struct fio_file *f = io_u->file;
+		int ret;
+
+		if (FILE_ENG_DATA(f))
+			break;
+
+		ur->sndq_head++;
+		ret = nu_prep_send(td, io_u);
+		if (ret) {
+			io_u->error = ret;
+			nu_complete(ur, io_u);
+			continue;
+		}
+		FILE_SET_ENG_DATA(f, io_u);
+	}
+}
+
+static void nu_queue_send(struct thread_data *td, struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+	int ret;
+
+	if (!is_udp(o)) {
+		ur->send_q[ur->sndq_tail++ & ur->rq_mask] = io_u;
+		nu_send_next(td);
+		return;
+	}
+
+	ret = nu_prep_send(td, io_u);
+	if (ret) {
+		io_u->error = ret;
+		nu_complete(ur, io_u);
+	}
+}
+
+/*
+ * The current direction of an io_u is done. For ping-pong, turn it around
+ * once, otherwise it is complete.
+ */
+static void nu_phase_done(struct thread_data *td, struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+	struct nu_io *io = &ur->ios[io_u->index];
+
+	if (o->pingpong && !io->phase) {
+		io->phase = 1;
+		io->done = 0;
+		if (io_u->ddir == DDIR_WRITE)
+			ur->recv_q[ur->rq_tail++ & ur->rq_mask] = io_u;
+		else
+			nu_queue_send(td, io_u);
+		return;
+	}
+
+	io_u->resid = io_u->xfer_buflen - io->done;
+	nu_complete(ur, io_u);
+}
+
+/*
+ * The send of an io_u is over. Let the next send on the socket go, and
+ * hand the io_u on once the kernel no longer references its buffer.
+ */
+static void nu_send_done(struct thread_data *td, struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+	struct nu_io *io = &ur->ios[io_u->index];
+
+	if (!io->sent) {
+		io->sent = true;
+		if (FILE_ENG_DATA(io_u->file) == io_u) {
+			FILE_SET_ENG_DATA(io_u->file, NULL);
+			nu_send_next(td);
+		}
+	}
+
+	if (io->notifs)
+		return;
+
+	io->sent = false;
+	if (io_u->error)
+		nu_complete(ur, io_u);
+	else
+		nu_phase_done(td, io_u);
+}
+
+static void nu_send_cqe(struct thread_data *td, struct io_u *io_u,
+			struct io_uring_cqe *cqe)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+	struct nu_io *io = &ur->ios[io_u->index];
+	int res = cqe->res;
+	int ret;
+
+	/*
+	 * A zero copy send posts its result with F_MORE set, and a
+	 * notification once the kernel no longer references the buffer.
+	 * The result drives the send, notifications only hold back the
+	 * completion of the io_u.
+	 */
+	if (cqe->flags & IORING_CQE_F_NOTIF) {
+		io->notifs--;
+		if (io->sent)
+			nu_send_done(td, io_u);
+		return;
+	}
+	if (cqe->flags & IORING_CQE_F_MORE)
+		io->notifs++;
+
+	if (res == -EOPNOTSUPP && ur->use_zc) {
+		dprint(FD_IO, "net_uring: zero copy send not supported\n");
+		ur->use_zc = false;
+		goto resend;
+	}
+	if (res < 0) {
+		io_u->error = -res;
+		nu_send_done(td, io_u);
+		return;
+	}
+
+	io->done += res;
+	if (!res || is_udp(o) || io->done == io_u->xfer_buflen) {
+		nu_send_done(td, io_u);
+		return;
+	}
+resend:
+	ret = nu_prep_send(td, io_u);
+	if (ret) {
+		io_u->error = ret;
+		nu_send_done(td, io_u);
+	}
+}
+
+static void nu_recv_cqe(struct thread_data *td, struct io_uring_cqe *cqe)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		ur->recv_armed = false;
+
+	if (cqe->flags & IORING_CQE_F_BUFFER) {
+		unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+		/* an empty datagram is still a datagram */
+		if (cqe->res > 0 || is_udp(o)) {
+			struct nu_chunk *c;
+
+			c = &ur->chunks[ur->ch_tail++ & (ur->nr_bufs - 1)];
+			c->bid = bid;
+			c->len = cqe->res;
+			c->off = 0;
+			return;
+		}
+		nu_buf_recycle(ur, bid);
+	}
+
+	if (!cqe->res && !is_udp(o))
+		ur->recv_eof = true;
+	else if (cqe->res < 0 && cqe->res != -ENOBUFS &&
+		 cqe->res != -ECANCELED)
+		ur->recv_err = -cqe->res;
+}
+
+static void nu_accept_cqe(struct netio_uring *ur, struct io_uring_cqe *cqe)
+{
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		ur->accept_armed = false;
+
+	if (cqe->res < 0) {
+		if (cqe->res != -ECANCELED)
+			ur->accept_err = -cqe->res;
+		return;
+	}
+
+	if (ur->acc_tail - ur->acc_head == NU_ACCEPT_Q) {
+		close(cqe->res);
+		return;
+	}
+
+	ur->accept_fds[ur->acc_tail++ % NU_ACCEPT_Q] = cqe->res;
+}
+
+static void nu_consume_chunk(struct netio_uring *ur, struct nu_chunk *c)
+{
+	nu_buf_recycle(ur, c->bid);
+	ur->ch_head++;
+}
+
+/*
+ * Copy received data into pending reads, in order. A stream read is done
+ * when it is full, a datagram read takes exactly one datagram.
+ */
+static void nu_fill_recv(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+
+	while (ur->rq_head != ur->rq_tail) {
+		struct io_u *io_u = ur->recv_q[ur->rq_head & ur->rq_mask];
+		struct nu_io *io = &ur->ios[io_u->index];
+		struct nu_chunk *c;
+		unsigned int len;
+		char *buf;
+
+		if (ur->ch_head == ur->ch_tail) {
+			if (!ur->recv_eof && !ur->recv_err && !td->done &&
+			    !td->terminate)
+				break;
+
+			/* no more data is coming, hand back what we have */
+			ur->rq_head++;
+			if (ur->recv_err && !io->done)
+				io_u->error = ur->recv_err;
+			else
+				io_u->resid = io_u->xfer_buflen - io->done;
+			nu_complete(ur, io_u);
+			continue;
+		}
+
+		c = &ur->chunks[ur->ch_head & (ur->nr_bufs - 1)];
+		buf = ur->bufs + c->bid * ur->buf_len + c->off;
+		len = c->len - c->off;
+
+		if (!io->done && __is_close_msg(buf, len)) {
+			td->done = 1;
+			nu_consume_chunk(ur, c);
+			continue;
+		}
+
+		if (len > io_u->xfer_buflen - io->done)
+			len = io_u->xfer_buflen - io->done;
+		memcpy(io_u->xfer_buf + io->done, buf, len);
+		io->done += len;
+		c->off += len;
+		if (is_udp(o) || c->off == c->len)
+			nu_consume_chunk(ur, c);
+
+		if (!is_udp(o) && io->done < io_u->xfer_buflen)
+			continue;
+
+		ur->rq_head++;
+		if (is_udp(o) && td->o.verify == VERIFY_NONE) {
+			unsigned int buflen = io_u->xfer_buflen;
+
+			io_u->xfer_buflen = io->done;
+			verify_udp_seq(td, nd, io_u);
+			io_u->xfer_buflen = buflen;
+		}
+		nu_phase_done(td, io_u);
+	}
+
+	if (ur->rq_head != ur->rq_tail && !ur->recv_armed && !ur->recv_eof &&
+	    !ur->recv_err && ur->ch_tail - ur->ch_head < ur->nr_bufs) {
+		struct io_u *io_u = ur->recv_q[ur->rq_head & ur->rq_mask];
+
+		nu_arm_recv(ur, io_u->file->fd);
+	}
+}
+
+static void nu_reap(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+	unsigned head = *ur->cq_head;
+	unsigned tail = atomic_load_acquire(ur->cq_tail);
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &ur->cqes[head & ur->cq_mask];
+
+		switch (cqe->user_data) {
+		case NU_TAG_RECV:
+			nu_recv_cqe(td, cqe);
+			break;
+		case NU_TAG_ACCEPT:
+			nu_accept_cqe(ur, cqe);
+			break;
+		case NU_TAG_CANCEL:
+			break;
+		default:
+			nu_send_cqe(td, (struct io_u *) (uintptr_t) cqe->user_data,
+					cqe);
+			break;
+		}
+	}
+
+	atomic_store_release(ur->cq_head, head);
+	nu_fill_recv(td);
+}
+
+/*
+ * Submit anything pending and wait for at least one completion. Returns
+ * 0 or a negative error.
+ */
+static int nu_wait(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	int ret;
+
+	ret = nu_enter(nd->ur, 1, IORING_ENTER_GETEVENTS);
+	if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+		ret = -errno;
+		td_verror(td, -ret, "io_uring_enter");
+		return ret;
+	}
+
+	nu_reap(td);
+	return 0;
+}
+
+static enum fio_q_status fio_netio_uring_queue(struct thread_data *td,
+					       struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+
+	fio_ro_check(td, io_u);
+
+	if (!ddir_rw(io_u->ddir))
+		return FIO_Q_COMPLETED;
+
+	memset(&ur->ios[io_u->index], 0, sizeof(struct nu_io));
+
+	if (io_u->ddir == DDIR_WRITE) {
+		if (is_udp(o) && td->o.verify == VERIFY_NONE)
+			store_udp_seq(nd, io_u);
+		nu_queue_send(td, io_u);
+	} else
+		ur->recv_q[ur->rq_tail++ & ur->rq_mask] = io_u;
+
+	ur->issued[ur->nr_issued++] = io_u;
+	return FIO_Q_QUEUED;
+}
+
+static int fio_netio_uring_commit(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+	struct timespec now;
+	int ret, i;
+
+	if (fio_fill_issue_time(td)) {
+		fio_gettime(&now, NULL);
+
+		for (i = 0; i < ur->nr_issued; i++) {
+			memcpy(&ur->issued[i]->issue_time, &now, sizeof(now));
+			io_u_queued(td, ur->issued[i]);
+		}
+	}
+	io_u_mark_submit(td, ur->nr_issued);
+	ur->nr_issued = 0;
+
+	/* serve new reads from buffered data, or arm the receive */
+	nu_fill_recv(td);
+
+	while (ur->queued) {
+		ret = nu_enter(ur, 0, 0);
+		if (ret >= 0)
+			continue;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EBUSY) {
+			ret = nu_wait(td);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		ret = -errno;
+		td_verror(td, -ret, "io_uring_enter submit");
+		return ret;
+	}
+
+	return 0;
+}
+
+static int fio_netio_uring_getevents(struct thread_data *td, unsigned int min,
+				     unsigned int max,
+				     const struct timespec fio_unused *t)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+	unsigned int nr;
+	int ret;
+
+	nu_reap(td);
+
+	while (ur->ev_tail - ur->ev_head < min) {
+		ret = nu_wait(td);
+		if (ret)
+			return ret;
+	}
+
+	nr = min(ur->ev_tail - ur->ev_head, max);
+	ur->ev_off = ur->ev_head;
+	ur->ev_head += nr;
+	return nr;
+}
+
+static struct io_u *fio_netio_uring_event(struct thread_data *td, int event)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+
+	return ur->events[(ur->ev_off + event) & ur->ev_mask];
+}
+
+static int fio_netio_uring_accept(struct thread_data *td, struct fio_file *f)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	struct netio_uring *ur = nd->ur;
+	int state;
+
+	state = td->runstate;
+	td_set_runstate(td, TD_SETTING_UP);
+
+	/*
+	 * The multishot accept stays armed, so connections arriving early
+	 * are already queued when the file is reopened.
+	 */
+	if (ur->acc_head == ur->acc_tail)
+		log_info("fio: waiting for connection\n");
+
+	while (ur->acc_head == ur->acc_tail) {
+		if (ur->accept_err) {
+			td_verror(td, ur->accept_err, "accept");
+			goto err;
+		}
+		if (td->terminate)
+			goto err;
+		if (!ur->accept_armed)
+			nu_arm_accept(ur, nd->listenfd);
+		if (nu_wait(td))
+			goto err;
+	}
+
+	f->fd = ur->accept_fds[ur->acc_head++ % NU_ACCEPT_Q];
+
+#ifdef CONFIG_TCP_NODELAY
+	if (o->nodelay && is_tcp(o)) {
+		int optval = 1;
+
+		if (setsockopt(f->fd, IPPROTO_TCP, TCP_NODELAY, (void *) &optval, sizeof(int)) < 0) {
+			log_err("fio: cannot set TCP_NODELAY option on socket (%s), disable with 'nodelay=0'\n", strerror(errno));
+			close(f->fd);
+			goto err;
+		}
+	}
+#endif
+
+	reset_all_stats(td);
+	td_set_runstate(td, state);
+	return 0;
+err:
+	td_set_runstate(td, state);
+	return 1;
+}
+
+static int fio_netio_uring_open_file(struct thread_data *td,
+				     struct fio_file *f)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	int ret;
+
+	if (o->listen && !is_udp(o)) {
+		ret = fio_netio_uring_accept(td, f);
+		if (ret)
+			f->fd = -1;
+		return ret;
+	}
+
+	ret = fio_netio_open_file(td, f);
+	if (ret || !is_udp(o) || (o->listen && !o->pingpong))
+		return ret;
+
+	/*
+	 * Connect the datagram socket to the peer, so sends don't need a
+	 * destination address.
+	 */
+	if (is_ipv6(o))
+		ret = connect(f->fd, (struct sockaddr *) &nd->addr6,
+				sizeof(nd->addr6));
+	else
+		ret = connect(f->fd, (struct sockaddr *) &nd->addr,
+				sizeof(nd->addr));
+	if (ret < 0) {
+		td_verror(td, errno, "connect");
+		fio_netio_close_file(td, f);
+		f->fd = -1;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int fio_netio_uring_close_file(struct thread_data *td,
+				      struct fio_file *f)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur = nd->ur;
+
+	if (!ur)
+		return fio_netio_close_file(td, f);
+
+	FILE_SET_ENG_DATA(f, NULL);
+
+	if (ur->recv_armed && ur->recv_fd == f->fd) {
+		struct io_uring_sqe *sqe = nu_get_sqe(ur);
+
+		if (sqe) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = NU_TAG_RECV;
+			sqe->user_data = NU_TAG_CANCEL;
+
+			while (ur->recv_armed)
+				if (nu_wait(td))
+					break;
+		}
+	}
+
+	/* drop whatever the peer sent that nobody asked for */
+	while (ur->ch_head != ur->ch_tail)
+		nu_consume_chunk(ur, &ur->chunks[ur->ch_head & (ur->nr_bufs - 1)]);
+
+	ur->recv_eof = false;
+	ur->recv_err = 0;
+
+	return fio_netio_close_file(td, f);
+}
+
+static void nu_free(struct netio_uring *ur)
+{
+	int i;
+
+	while (ur->acc_head != ur->acc_tail)
+		close(ur->accept_fds[ur->acc_head++ % NU_ACCEPT_Q]);
+
+	if (ur->bufs)
+		munmap(ur->bufs, ur->nr_bufs * ur->buf_len);
+	if (ur->br)
+		munmap(ur->br, ur->nr_bufs * sizeof(struct io_uring_buf));
+	for (i = 0; i < FIO_ARRAY_SIZE(ur->mmap_ptr); i++)
+		if (ur->mmap_ptr[i])
+			munmap(ur->mmap_ptr[i], ur->mmap_len[i]);
+	if (ur->ring_fd != -1)
+		close(ur->ring_fd);
+
+	free(ur->issued);
+	free(ur->events);
+	free(ur->recv_q);
+	free(ur->send_q);
+	free(ur->chunks);
+	free(ur->ios);
+	free(ur);
+}
+
+static int nu_mmap(struct netio_uring *ur, struct io_uring_params *p)
+{
+	void *ptr;
+
+	ur->mmap_len[0] = p->sq_off.array + p->sq_entries * sizeof(__u32);
+	ptr = mmap(0, ur->mmap_len[0], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ur->ring_fd,
+			IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		return -1;
+	ur->mmap_ptr[0] = ptr;
+	ur->sq_head = ptr + p->sq_off.head;
+	ur->sq_tail = ptr + p->sq_off.tail;
+	ur->sq_mask = *(unsigned *) (ptr + p->sq_off.ring_mask);
+	ur->sq_entries = p->sq_entries;
+
+	/* SQ array is an identity map, set it up once */
+	for (unsigned int i = 0; i < p->sq_entries; i++)
+		((unsigned *) (ptr + p->sq_off.array))[i] = i;
+
+	ur->mmap_len[1] = p->sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(0, ur->mmap_len[1], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ur->ring_fd,
+			IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		return -1;
+	ur->mmap_ptr[1] = ptr;
+	ur->sqes = ptr;
+
+	ur->mmap_len[2] = p->cq_off.cqes +
+				p->cq_entries * sizeof(struct io_uring_cqe);
+	ptr = mmap(0, ur->mmap_len[2], PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ur->ring_fd,
+			IORING_OFF_CQ_RING);
+	if (ptr == MAP_FAILED)
+		return -1;
+	ur->mmap_ptr[2] = ptr;
+	ur->cq_head = ptr + p->cq_off.head;
+	ur->cq_tail = ptr + p->cq_off.tail;
+	ur->cq_mask = *(unsigned *) (ptr + p->cq_off.ring_mask);
+	ur->cqes = ptr + p->cq_off.cqes;
+	return 0;
+}
+
+static bool nu_probe_send_zc(struct netio_uring *ur)
+{
+	struct io_uring_probe *p;
+	bool ret = false;
+
+	p = calloc(1, sizeof(*p) + 256 * sizeof(struct io_uring_probe_op));
+	if (!p)
+		return false;
+
+	if (syscall(__NR_io_uring_register, ur->ring_fd,
+			IORING_REGISTER_PROBE, p, 256) < 0)
+		goto out;
+
+	if (IORING_OP_SEND_ZC < p->ops_len &&
+	    (p->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED))
+		ret = true;
+out:
+	free(p);
+	return ret;
+}
+
+static int nu_buf_ring_init(struct thread_data *td, struct netio_uring *ur)
+{
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+
+	ur->br = mmap(NULL, ur->nr_bufs * sizeof(struct io_uring_buf),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (ur->br == MAP_FAILED) {
+		ur->br = NULL;
+		td_verror(td, errno, "mmap buffer ring");
+		return 1;
+	}
+
+	ur->bufs = mmap(NULL, ur->nr_bufs * ur->buf_len,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (ur->bufs == MAP_FAILED) {
+		ur->bufs = NULL;
+		td_verror(td, errno, "mmap receive buffers");
+		return 1;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) ur->br;
+	reg.ring_entries = ur->nr_bufs;
+	reg.bgid = NU_BGID;
+	if (syscall(__NR_io_uring_register, ur->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		td_verror(td, errno, "register buffer ring");
+		return 1;
+	}
+
+	for (i = 0; i < ur->nr_bufs; i++)
+		nu_buf_recycle(ur, i);
+
+	return 0;
+}
+
+static int nu_queue_init(struct thread_data *td, struct netio_uring *ur)
+{
+	struct netio_options *o = td->eo;
+	unsigned int depth = td->o.iodepth;
+	struct io_uring_params p;
+	int ret;
+
+	ur->nr_bufs = o->recv_buffers ?: 2 * depth;
+	if (ur->nr_bufs < NU_MIN_BUFS)
+		ur->nr_bufs = NU_MIN_BUFS;
+	ur->nr_bufs = roundup_pow2(ur->nr_bufs);
+	if (ur->nr_bufs > NU_MAX_BUFS)
+		ur->nr_bufs = NU_MAX_BUFS;
+	ur->buf_len = td_max_bs(td);
+
+	ur->ev_mask = roundup_pow2(depth) - 1;
+	ur->rq_mask = ur->ev_mask;
+	ur->issued = calloc(depth, sizeof(struct io_u *));
+	ur->events = calloc(ur->ev_mask + 1, sizeof(struct io_u *));
+	ur->recv_q = calloc(ur->rq_mask + 1, sizeof(struct io_u *));
+	ur->send_q = calloc(ur->rq_mask + 1, sizeof(struct io_u *));
+	ur->chunks = calloc(ur->nr_bufs, sizeof(struct nu_chunk));
+	ur->ios = calloc(depth, sizeof(struct nu_io));
+	if (!ur->issued || !ur->events || !ur->recv_q || !ur->send_q ||
+	    !ur->chunks || !ur->ios) {
+		td_verror(td, ENOMEM, "calloc");
+		return 1;
+	}
+
+	memset(&p, 0, sizeof(p));
+
+	/*
+	 * Every io_u may have a send in flight, and each zero copy send
+	 * posts two CQEs. On top of that, every provided buffer can hold a
+	 * received chunk.
+	 */
+	p.flags |= IORING_SETUP_CQSIZE;
+	p.cq_entries = roundup_pow2(2 * (depth + 3) + ur->nr_bufs);
+	p.flags |= IORING_SETUP_COOP_TASKRUN;
+	p.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+
+	/* room for the accept, receive and cancel requests */
+	depth = roundup_pow2(depth + 3);
+retry:
+	ret = syscall(__NR_io_uring_setup, depth, &p);
+	if (ret < 0) {
+		if (errno == EINVAL && p.flags & IORING_SETUP_DEFER_TASKRUN) {
+			p.flags &= ~IORING_SETUP_DEFER_TASKRUN;
+			p.flags &= ~IORING_SETUP_SINGLE_ISSUER;
+			goto retry;
+		}
+		if (errno == EINVAL && p.flags & IORING_SETUP_COOP_TASKRUN) {
+			p.flags &= ~IORING_SETUP_COOP_TASKRUN;
+			goto retry;
+		}
+		td_verror(td, errno, "io_uring_setup");
+		return 1;
+	}
+
+	ur->ring_fd = ret;
+	if (nu_mmap(ur, &p)) {
+		td_verror(td, errno, "io_uring mmap");
+		return 1;
+	}
+
+	ur->use_zc = o->sendzc && o->proto != FIO_TYPE_UNIX &&
+			nu_probe_send_zc(ur);
+
+	if (td_read(td) || o->pingpong)
+		return nu_buf_ring_init(td, ur);
+
+	return 0;
+}
+
+static int fio_netio_uring_init(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_uring *ur;
+	int ret;
+
+	ret = fio_netio_init(td);
+	if (ret)
+		return ret;
+
+	ur = calloc(1, sizeof(*ur));
+	if (!ur)
+		return 1;
+
+	ur->ring_fd = -1;
+	ur->recv_fd = -1;
+	nd->ur = ur;
+
+	return nu_queue_init(td, ur);
+}
+
+static void fio_netio_uring_cleanup(struct thread_data *td)
+{
+	struct netio_data *nd = td->io_ops_data;
+
+	if (nd && nd->ur) {
+		nu_free(nd->ur);
+		nd->ur = NULL;
+	}
+
+	fio_netio_cleanup(td);
+}
+
+static struct ioengine_ops ioengine_uring = {
+	.name			= "net_uring",
+	.version		= FIO_IOOPS_VERSION,
+	.prep			= fio_netio_prep,
+	.queue			= fio_netio_uring_queue,
+	.commit			= fio_netio_uring_commit,
+	.getevents		= fio_netio_uring_getevents,
+	.event			= fio_netio_uring_event,
+	.setup			= fio_netio_setup,
+	.init			= fio_netio_uring_init,
+	.cleanup		= fio_netio_uring_cleanup,
+	.open_file		= fio_netio_uring_open_file,
+	.close_file		= fio_netio_uring_close_file,
+	.terminate		= fio_netio_terminate,
+	.options		= options,
+	.option_struct_size	= sizeof(struct netio_options),
+	.flags			= FIO_DISKLESSIO | FIO_UNIDIR | FIO_PIPEIO |
+				  FIO_BIT_BASED | FIO_NO_OFFLOAD |
+				  FIO_ASYNCIO_SETS_ISSUE_TIME,
+};
+#endif
+
 #ifdef CONFIG_LINUX_SPLICE
 static int fio_netio_setup_splice(struct thread_data *td)
 {
@@ -1582,6 +2667,9 @@ static void fio_init fio_netio_register(void)
 #ifdef CONFIG_LINUX_SPLICE
 	register_ioengine(&ioengine_splice);
 #endif
+#ifdef FIO_HAVE_NET_URING
+	register_ioengine(&ioengine_uring);
+#endif
 }
 
 static void fio_exit fio_netio_unregister(void)
@@ -1590,4 +2678,7 @@ static void fio_exit fio_netio_unregister(void)
 #ifdef CONFIG_LINUX_SPLICE
 	unregister_ioengine(&ioengine_splice);
 #endif
+#ifdef FIO_HAVE_NET_URING
+	unregister_ioengine(&ioengine_uring);
+#endif
 }
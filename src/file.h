@@ -13,6 +13,7 @@
 /* Forward declarations */
 struct zoned_block_device_info;
 struct fdp_ruh_info;
+struct blockmap;
 
 /*
  * The type of object we are working on
@@ -151,6 +152,11 @@ struct fio_file {
 		struct fio_lfsr lfsr;
 	};
 
+	/*
+	 * Written blocks for verify_tracking=bitmap
+	 */
+	struct blockmap *verify_map;
+
 	/*
 	 * Used for zipf random distribution
 	 */
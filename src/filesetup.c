@@ -13,6 +13,7 @@
 #include "os/os.h"
 #include "hash.h"
 #include "lib/axmap.h"
+#include "lib/blockmap.h"
 #include "rwlock.h"
 #include "zbd.h"
 #include "sprandom.h"
@@ -1599,6 +1600,7 @@ void fio_file_free(struct fio_file *f)
 {
 	if (fio_file_axmap(f))
 		axmap_free(f->io_axmap);
+	blockmap_free(f->verify_map);
 	if (f->ruhs_info)
 		sfree(f->ruhs_info);
 	if (f->spr_info)
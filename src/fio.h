@@ -26,6 +26,7 @@
 #include "io_ddir.h"
 #include "ioengines.h"
 #include "iolog.h"
+#include "iolog_bin.h"
 #include "helpers.h"
 #include "minmax.h"
 #include "options.h"
@@ -34,6 +35,7 @@
 #include "gettime.h"
 #include "oslib/getopt.h"
 #include "lib/rand.h"
+#include "lib/philox.h"
 #include "lib/rbtree.h"
 #include "lib/num2str.h"
 #include "lib/memalign.h"
@@ -108,6 +110,9 @@ enum {
 	__TD_F_DIRS_CREATED,
 	__TD_F_CHECK_RATE,
 	__TD_F_SYNCS,
+	__TD_F_STAT_SHARD,
+	__TD_F_STREAM_LOG,
+	__TD_F_ENGINE_BUFS,
 	__TD_F_LAST,		/* not a real bit, keep last */
 };
 
@@ -130,6 +135,9 @@ enum {
 	TD_F_DIRS_CREATED	= 1U << __TD_F_DIRS_CREATED,
 	TD_F_CHECK_RATE		= 1U << __TD_F_CHECK_RATE,
 	TD_F_SYNCS		= 1U << __TD_F_SYNCS,
+	TD_F_STAT_SHARD		= 1U << __TD_F_STAT_SHARD,
+	TD_F_STREAM_LOG		= 1U << __TD_F_STREAM_LOG,
+	TD_F_ENGINE_BUFS	= 1U << __TD_F_ENGINE_BUFS,
 };
 
 enum {
@@ -215,7 +223,13 @@ struct thread_data {
 	struct io_log *bw_log;
 	struct io_log *iops_log;
 
+	/*
+	 * write_timeline_log samples, see timeline.c
+	 */
+	struct timeline *timeline;
+
 	struct workqueue log_compress_wq;
+	struct workqueue log_stream_wq;
 
 	struct thread_data *parent;
 
@@ -267,6 +281,7 @@ struct thread_data {
 
 	void *iolog_buf;
 	FILE *iolog_f;
+	struct iolog_bin_writer *iolog_bin;
 
 	uint64_t rand_seeds[FIO_RAND_NR_OFFS];
 
@@ -284,7 +299,10 @@ struct thread_data {
 	struct frand_state zone_state;
 	struct frand_state prio_state;
 	struct frand_state dedupe_working_set_index_state;
-	struct frand_state *dedupe_working_set_states;
+	struct frand_state *dedupe_working_set_bases;
+	struct frand_state dedupe_working_set_base;
+	struct frand_jump dedupe_working_set_jump;
+	unsigned long long dedupe_pages_per_seed;
 	struct frand_state sprandom_state;
 
 	unsigned long long num_unique_pages;
@@ -333,21 +351,27 @@ struct thread_data {
 	unsigned int io_u_in_flight;
 
 	/*
-	 * List of free and busy io_u's
+	 * List of free and busy io_u's. The freelist is only touched by the
+	 * submitting thread. With async processing, other threads return
+	 * io_u's through io_u_freering instead, and only take io_u_lock to
+	 * wake the submitter if it announced it is waiting in io_u_free_wait.
 	 */
 	struct io_u_ring io_u_requeues;
+	struct io_u_ring io_u_freering;
 	struct io_u_queue io_u_freelist;
 	struct io_u_queue io_u_all;
 	pthread_mutex_t io_u_lock;
 	pthread_cond_t free_cond;
+	unsigned int io_u_free_wait;
 
 	/*
-	 * async verify offload
+	 * async verify offload. Every worker has its own queue, completions
+	 * are handed out round robin and idle workers steal from busy ones.
 	 */
-	struct flist_head verify_list;
-	pthread_t *verify_threads;
+	struct verify_worker *verify_workers;
 	unsigned int nr_verify_threads;
-	pthread_cond_t verify_cond;
+	unsigned int verify_next;
+	unsigned int verify_nr_sleeping;
 	int verify_thread_exit;
 
 	/*
@@ -406,6 +430,7 @@ struct thread_data {
 	 * State for random io, a bitmap of blocks done vs not done
 	 */
 	struct frand_state random_state;
+	struct philox_state random_philox;
 
 	struct timespec start;	/* start of this loop */
 	struct timespec epoch;	/* time job was started */
@@ -452,14 +477,28 @@ struct thread_data {
 	struct flist_head io_hist_list;
 	unsigned long io_hist_len;
 
+	/*
+	 * With verify_tracking=bitmap, written blocks are kept in a bitmap
+	 * per file instead. That loses the numberio of each block, so only
+	 * the range of numberio's logged since the last prune is kept, and
+	 * where get_next_verify() is in the bitmaps.
+	 */
+	uint64_t verify_map_numberio[2];
+	unsigned int verify_map_file;
+	uint64_t verify_map_next;
+
 	/*
 	 * For IO replaying
 	 */
 	struct flist_head io_log_list;
 	FILE *io_log_rfile;
+	struct iolog_bin_reader *io_log_bin;
+	struct iolog_text_reader *io_log_text;
 	unsigned int io_log_blktrace;
 	unsigned int io_log_blktrace_swap;
 	unsigned long long io_log_last_ttime;
+	unsigned long long io_log_shard_delay;
+	unsigned int io_log_nr_shards;
 	struct timespec io_log_start_time;
 	unsigned int io_log_current;
 	unsigned int io_log_checkmark;
@@ -881,6 +920,38 @@ static inline bool td_async_processing(struct thread_data *td)
 	return (td->flags & TD_F_NEED_LOCK) != 0;
 }
 
+/*
+ * With async processing, requeue_io_u() may drop an issue count from
+ * another thread, so both sides of io_issues[] must be atomic then.
+ * Returns the count before the update.
+ */
+static inline uint64_t td_io_issues(struct thread_data *td,
+				    enum fio_ddir ddir)
+{
+	if (td_async_processing(td))
+		return atomic_load_relaxed(&td->io_issues[ddir]);
+
+	return td->io_issues[ddir];
+}
+
+static inline uint64_t td_io_issues_inc(struct thread_data *td,
+					enum fio_ddir ddir)
+{
+	if (td_async_processing(td))
+		return atomic_add(&td->io_issues[ddir], 1);
+
+	return td->io_issues[ddir]++;
+}
+
+static inline void td_io_issues_dec(struct thread_data *td,
+				    enum fio_ddir ddir)
+{
+	if (td_async_processing(td))
+		atomic_sub(&td->io_issues[ddir], 1);
+	else
+		td->io_issues[ddir]--;
+}
+
 static inline bool td_offload_overlap(struct thread_data *td)
 {
 	return td->o.serialize_overlap && td->o.io_submit_mode == IO_MODE_OFFLOAD;
@@ -902,8 +973,19 @@ static inline void __td_io_u_unlock(struct thread_data *td)
 
 static inline void td_io_u_free_notify(struct thread_data *td)
 {
-	if (td_async_processing(td))
+	if (!td_async_processing(td))
+		return;
+
+	/*
+	 * Pairs with the barrier in __get_io_u(): either it sees the io_u
+	 * we just returned, or we see that it's about to sleep.
+	 */
+	__sync_synchronize();
+	if (atomic_load_relaxed(&td->io_u_free_wait)) {
+		pthread_mutex_lock(&td->io_u_lock);
 		pthread_cond_signal(&td->free_cond);
+		pthread_mutex_unlock(&td->io_u_lock);
+	}
 }
 
 static inline void td_flags_clear(struct thread_data *td, unsigned int *flags,
@@ -956,6 +1038,7 @@ enum {
 	FIO_RAND_GEN_TAUSWORTHE = 0,
 	FIO_RAND_GEN_LFSR,
 	FIO_RAND_GEN_TAUSWORTHE64,
+	FIO_RAND_GEN_PHILOX,
 };
 
 enum {
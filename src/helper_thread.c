@@ -20,7 +20,9 @@
 #include "smalloc.h"
 #include "helper_thread.h"
 #include "steadystate.h"
+#include "verify.h"
 #include "pshared.h"
+#include "timeline.h"
 
 static int sleep_accuracy_ms;
 static int timerfd = -1;
@@ -297,6 +299,16 @@ static void *helper_thread_main(void *data)
 				RAMP_PERIOD_CHECK_MSEC : 0,
 			.func = ramp_period_check,
 		},
+		{
+			.name = "verify_state",
+			.interval_ms = vstate_journal_msec,
+			.func = verify_state_journal_flush,
+		},
+		{
+			.name = "timeline",
+			.interval_ms = timeline_enabled ? TIMELINE_DRAIN_MSEC : 0,
+			.func = timeline_drain,
+		},
 	};
 	struct timespec ts;
 	long clk_tck;
@@ -365,6 +377,7 @@ static void *helper_thread_main(void *data)
 	}
 
 	fio_writeout_logs(false);
+	verify_state_journal_close();
 
 	sk_out_drop();
 	return NULL;
@@ -31,6 +31,7 @@
 #include "filelock.h"
 #include "steadystate.h"
 #include "blktrace.h"
+#include "timeline.h"
 
 #include "oslib/asprintf.h"
 #include "oslib/getopt.h"
@@ -194,6 +195,11 @@ static struct option l_opts[FIO_NR_OPTIONS] = {
 		.val		= 'X' | FIO_CLIENT_FLAG,
 	},
 #endif
+	{
+		.name		= (char *) "convert-iolog",
+		.has_arg	= required_argument,
+		.val		= 'Y',
+	},
 	{
 		.name		= (char *) "alloc-size",
 		.has_arg	= required_argument,
@@ -549,6 +555,25 @@ static void put_job(struct thread_data *td)
 	thread_number--;
 }
 
+/*
+ * --convert-iolog, write a binary version of an iolog to stdout
+ */
+static int convert_iolog(const char *fname)
+{
+	struct thread_data *td;
+	int ret;
+
+	td = get_new_job(false, &def_thread, false, "convert-iolog");
+	if (!td)
+		return 1;
+
+	ret = iolog_bin_convert(td, fname, stdout);
+	fflush(stdout);
+	close_and_free_files(td);
+	put_job(td);
+	return ret;
+}
+
 static int __setup_rate(struct thread_data *td, enum fio_ddir ddir)
 {
 	unsigned long long bs = td->o.min_bs[ddir];
@@ -625,6 +650,13 @@ static int fixup_options(struct thread_data *td)
 		ret |= 1;
 	}
 
+	if (o->log_format != LOG_FORMAT_TEXT && (o->log_gz || o->log_gz_store)) {
+		log_err("fio: log_format=%s can't be combined with log"
+			" compression\n",
+			o->log_format == LOG_FORMAT_BINARY ? "binary" : "columnar");
+		ret |= 1;
+	}
+
 	if (td_trimwrite(td) && o->num_range > 1) {
 		log_err("fio: trimwrite cannot be used with multiple"
 			" ranges.\n");
@@ -891,6 +923,33 @@ static int fixup_options(struct thread_data *td)
 			o->verify_interval = gcd(o->min_bs[DDIR_WRITE],
 							o->max_bs[DDIR_WRITE]);
 
+		if (o->verify_tracking == VERIFY_TRACK_BITMAP && td_write(td)) {
+			if (o->min_bs[DDIR_WRITE] != o->max_bs[DDIR_WRITE] ||
+			    o->bs_unaligned ||
+			    o->ba[DDIR_WRITE] % o->min_bs[DDIR_WRITE]) {
+				log_err("fio: verify_tracking=bitmap requires a "
+					"fixed, aligned write block size\n");
+				ret |= 1;
+			}
+			if (o->verify_backlog || td->trim_verify ||
+			    o->io_submit_mode == IO_MODE_OFFLOAD) {
+				log_err("fio: verify_tracking=bitmap doesn't "
+					"support verify_backlog, trim verify or "
+					"io_submit_mode=offload\n");
+				ret |= 1;
+			}
+		}
+
+		if (o->verify_state_interval) {
+			if (is_backend) {
+				log_info("fio: verify_state_interval is not "
+					 "supported in client/server mode\n");
+				o->verify_state_interval = 0;
+			} else if (verify_state_journal_enabled(td))
+				vstate_journal_msec = min_not_zero(vstate_journal_msec,
+							o->verify_state_interval);
+		}
+
 		if (o->verify_only) {
 			if (!fio_option_is_set(o, verify_write_sequence))
 				o->verify_write_sequence = 0;
@@ -928,7 +987,8 @@ static int fixup_options(struct thread_data *td)
 		 * Unless we were explicitly asked to enable it.
 		 */
 		if (!td_write(td) || (td->flags & TD_F_VER_BACKLOG) ||
-		    o->zrf.u.f || fio_offset_overlap_risk(td)) {
+		    o->zrf.u.f || fio_offset_overlap_risk(td) ||
+		    o->verify_tracking == VERIFY_TRACK_BITMAP) {
 			if (!fio_option_is_set(o, verify_header_seed))
 				o->verify_header_seed = 0;
 		}
@@ -1063,6 +1123,7 @@ static int fixup_options(struct thread_data *td)
 			o->max_latency[ddir] *= 1000ULL;
 
 		o->latency_target *= 1000ULL;
+		o->lat_hist_max *= 1000ULL;
 	}
 
 	/*
@@ -1142,7 +1203,8 @@ void td_fill_rand_seeds(struct thread_data *td)
 	int i;
 	bool use64;
 
-	if (td->o.random_generator == FIO_RAND_GEN_TAUSWORTHE64)
+	if (td->o.random_generator == FIO_RAND_GEN_TAUSWORTHE64 ||
+	    td->o.random_generator == FIO_RAND_GEN_PHILOX)
 		use64 = true;
 	else
 		use64 = false;
@@ -1184,6 +1246,7 @@ void td_fill_rand_seeds(struct thread_data *td)
 	init_rand_seed(&td->dedupe_working_set_index_state, td->rand_seeds[FIO_RAND_DEDUPE_WORKING_SET_IX], use64);
 
 	init_rand_seed(&td->random_state, td->rand_seeds[FIO_RAND_BLOCK_OFF], use64);
+	philox_init(&td->random_philox, td->rand_seeds[FIO_RAND_BLOCK_OFF]);
 
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		struct frand_state *s = &td->seq_rand_state[i];
@@ -1566,6 +1629,14 @@ static int verify_per_group_options(struct thread_data *td, const char *jobname)
 				jobname);
 			return 1;
 		}
+
+		if (td->o.stats &&
+		    (td->o.lat_hist_precision != td2->o.lat_hist_precision ||
+		     td->o.lat_hist_max != td2->o.lat_hist_max)) {
+			log_err("fio: lat_histogram_precision/max in job: %s "
+				"differs from group\n", jobname);
+			return 1;
+		}
 	} end_for_each();
 
 	return 0;
@@ -1676,6 +1747,16 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 	init_thread_stat_min_vals(&td->ts);
 
+	/*
+	 * Cloned jobs inherit the histogram pointers of the job they
+	 * were copied from, they need their own.
+	 */
+	td->ts.hist_bits = td->ts.hist_groups = 0;
+	memset(td->ts.hist_plat, 0, sizeof(td->ts.hist_plat));
+	if (o->stats && alloc_lat_hist_stats(&td->ts, o->lat_hist_precision,
+					     o->lat_hist_max))
+		goto err;
+
 	/*
 	 * td->>ddir_seq_nr needs to be initialized to 1, NOT o->ddir_seq_nr,
 	 * so that get_next_offset gets a new random offset the first time it
@@ -1718,6 +1799,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_issue_time = o->log_issue_time,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_gz_type = o->log_gz_type,
+			.log_format = o->log_format,
 		};
 		const char *pre = make_log_name(o->lat_log_file, o->name);
 		const char *suf;
@@ -1729,6 +1812,10 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_format == LOG_FORMAT_BINARY)
+			suf = "bin";
+		else if (p.log_format == LOG_FORMAT_COLUMNAR)
+			suf = "col";
 		else
 			suf = "log";
 
@@ -1767,12 +1854,15 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_issue_time = o->log_issue_time,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_gz_type = o->log_gz_type,
+			.log_format = o->log_format == LOG_FORMAT_COLUMNAR ?
+					LOG_FORMAT_COLUMNAR : LOG_FORMAT_TEXT,
 		};
 		const char *pre = make_log_name(o->hist_log_file, o->name);
 		const char *suf;
 
 #ifndef CONFIG_ZLIB
-		if (is_backend) {
+		if (is_backend && p.log_format == LOG_FORMAT_TEXT) {
 			log_err("fio: --write_hist_log requires zlib in client/server mode\n");
 			goto err;
 		}
@@ -1780,6 +1870,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_format == LOG_FORMAT_COLUMNAR)
+			suf = "col";
 		else
 			suf = "log";
 
@@ -1800,6 +1892,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_issue_time = o->log_issue_time,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_gz_type = o->log_gz_type,
+			.log_format = o->log_format,
 		};
 		const char *pre = make_log_name(o->bw_log_file, o->name);
 		const char *suf;
@@ -1814,6 +1908,10 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_format == LOG_FORMAT_BINARY)
+			suf = "bin";
+		else if (p.log_format == LOG_FORMAT_COLUMNAR)
+			suf = "col";
 		else
 			suf = "log";
 
@@ -1833,6 +1931,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 			.log_issue_time = o->log_issue_time,
 			.log_gz = o->log_gz,
 			.log_gz_store = o->log_gz_store,
+			.log_gz_type = o->log_gz_type,
+			.log_format = o->log_format,
 		};
 		const char *pre = make_log_name(o->iops_log_file, o->name);
 		const char *suf;
@@ -1847,6 +1947,10 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 
 		if (p.log_gz_store)
 			suf = "log.fz";
+		else if (p.log_format == LOG_FORMAT_BINARY)
+			suf = "bin";
+		else if (p.log_format == LOG_FORMAT_COLUMNAR)
+			suf = "col";
 		else
 			suf = "log";
 
@@ -1854,6 +1958,17 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 				td->thread_number, suf, o->per_job_logs);
 		setup_log(&td->iops_log, &p, logname);
 	}
+	if (o->write_timeline_log) {
+		const char *pre = make_log_name(o->timeline_log_file, o->name);
+
+		/*
+		 * Always per job, the jobs' samples are interleaved in time
+		 */
+		gen_log_name(logname, sizeof(logname), "timeline", pre,
+				td->thread_number, "log", true);
+		if (timeline_setup(td, logname))
+			goto err;
+	}
 
 	if (!o->name)
 		o->name = strdup(jobname);
@@ -1923,6 +2038,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 	 * as they don't apply to sub-jobs
 	 */
 	numjobs = o->numjobs;
+	if (!recursed)
+		td->io_log_nr_shards = numjobs;
 	while (--numjobs) {
 		struct thread_data *td_new = get_new_job(false, td, true, jobname);
 
@@ -2418,6 +2535,7 @@ static void usage(const char *name)
 #ifdef CONFIG_ZLIB
 	printf("  --inflate-log=log\tInflate and output compressed log\n");
 #endif
+	printf("  --convert-iolog=log\tConvert iolog or blktrace to binary iolog on stdout\n");
 	printf("  --trigger-file=file\tExecute trigger cmd when file exists\n");
 	printf("  --trigger-timeout=t\tExecute trigger at this time\n");
 	printf("  --trigger=cmd\t\tSet this command as local trigger\n");
@@ -2851,6 +2969,11 @@ int parse_cmd_line(int argc, char *argv[], int client_type)
 			do_exit++;
 			break;
 #endif
+		case 'Y':
+			exit_val = convert_iolog(optarg);
+			did_arg = true;
+			do_exit++;
+			break;
 		case 'p':
 			did_arg = true;
 			if (exec_profile)
@@ -115,6 +115,12 @@ static int __get_next_rand_offset(struct thread_data *td, struct fio_file *f,
 		dprint(FD_RANDOM, "off rand %llu\n", (unsigned long long) r);
 
 		*b = lastb * (r / (rand_max(&td->random_state) + 1.0));
+	} else if (td->o.random_generator == FIO_RAND_GEN_PHILOX) {
+		r = philox_next(&td->random_philox);
+
+		dprint(FD_RANDOM, "off rand %llu\n", (unsigned long long) r);
+
+		*b = lastb * (r / FRAND64_MAX_PLUS_ONE);
 	} else {
 		uint64_t off = 0;
 
@@ -651,7 +657,7 @@ static void set_rwmix_bytes(struct thread_data *td)
 	 * whereas reads do not.
 	 */
 	diff = td->o.rwmix[td->rwmix_ddir ^ 1];
-	td->rwmix_issues = (td->io_issues[td->rwmix_ddir] * diff) / 100;
+	td->rwmix_issues = (td_io_issues(td, td->rwmix_ddir) * diff) / 100;
 }
 
 static inline enum fio_ddir get_rand_ddir(struct thread_data *td)
@@ -775,16 +781,16 @@ static enum fio_ddir get_rw_ddir(struct thread_data *td)
 	 * and if not then move on to check regular I/Os.
 	 */
 	if (should_fsync(td) && td->last_ddir_issued == DDIR_WRITE) {
-		if (td->o.fsync_blocks && td->io_issues[DDIR_WRITE] &&
-		    !(td->io_issues[DDIR_WRITE] % td->o.fsync_blocks))
+		if (td->o.fsync_blocks && td_io_issues(td, DDIR_WRITE) &&
+		    !(td_io_issues(td, DDIR_WRITE) % td->o.fsync_blocks))
 			return DDIR_SYNC;
 
-		if (td->o.fdatasync_blocks && td->io_issues[DDIR_WRITE] &&
-		    !(td->io_issues[DDIR_WRITE] % td->o.fdatasync_blocks))
+		if (td->o.fdatasync_blocks && td_io_issues(td, DDIR_WRITE) &&
+		    !(td_io_issues(td, DDIR_WRITE) % td->o.fdatasync_blocks))
 			return DDIR_DATASYNC;
 
-		if (td->sync_file_range_nr && td->io_issues[DDIR_WRITE] &&
-		    !(td->io_issues[DDIR_WRITE] % td->sync_file_range_nr))
+		if (td->sync_file_range_nr && td_io_issues(td, DDIR_WRITE) &&
+		    !(td_io_issues(td, DDIR_WRITE) % td->sync_file_range_nr))
 			return DDIR_SYNC_FILE_RANGE;
 	}
 
@@ -792,7 +798,7 @@ static enum fio_ddir get_rw_ddir(struct thread_data *td)
 		/*
 		 * Check if it's time to seed a new data direction.
 		 */
-		if (td->io_issues[td->rwmix_ddir] >= td->rwmix_issues) {
+		if (td_io_issues(td, td->rwmix_ddir) >= td->rwmix_issues) {
 			/*
 			 * Put a top limit on how many bytes we do for
 			 * one data direction, to avoid overflowing the
@@ -846,8 +852,8 @@ static void set_rw_ddir(struct thread_data *td, struct io_u *io_u)
 
 	if (io_u->ddir == DDIR_WRITE && td_ioengine_flagged(td, FIO_BARRIER) &&
 	    td->o.barrier_blocks &&
-	   !(td->io_issues[DDIR_WRITE] % td->o.barrier_blocks) &&
-	     td->io_issues[DDIR_WRITE])
+	   !(td_io_issues(td, DDIR_WRITE) % td->o.barrier_blocks) &&
+	     td_io_issues(td, DDIR_WRITE))
 		io_u_set(td, io_u, IO_U_F_BARRIER);
 }
 
@@ -859,33 +865,79 @@ void put_file_log(struct thread_data *td, struct fio_file *f)
 		td_verror(td, ret, "file close");
 }
 
-void put_io_u(struct thread_data *td, struct io_u *io_u)
+static struct thread_data *__put_io_u(struct thread_data *td,
+				       struct io_u *io_u, bool needs_lock)
 {
-	const bool needs_lock = td_async_processing(td);
-
 	zbd_put_io_u(td, io_u);
 
 	if (td->parent)
 		td = td->parent;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
-	if (io_u->file && !(io_u->flags & IO_U_F_NO_FILE_PUT))
+	if (io_u->file && !(io_u->flags & IO_U_F_NO_FILE_PUT)) {
+		if (needs_lock)
+			__td_io_u_lock(td);
 		put_file_log(td, io_u->file);
+		if (needs_lock)
+			__td_io_u_unlock(td);
+	}
 
 	io_u->file = NULL;
 	io_u_set(td, io_u, IO_U_F_FREE);
 
 	if (io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		if (needs_lock)
+			atomic_sub(&td->cur_depth, 1);
+		else
+			td->cur_depth--;
 		assert(!(td->flags & TD_F_CHILD));
 	}
-	io_u_qpush(&td->io_u_freelist, io_u);
-	td_io_u_free_notify(td);
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
+	return td;
+}
+
+void put_io_u(struct thread_data *td, struct io_u *io_u)
+{
+	const bool needs_lock = td_async_processing(td);
+
+	td = __put_io_u(td, io_u, needs_lock);
+
+	/*
+	 * Only the submitting thread owns the freelist, everybody else
+	 * hands io_u's back through the lockless ring.
+	 */
+	if (needs_lock) {
+		if (!io_u_rpush(&td->io_u_freering, io_u))
+			assert(0);
+		td_io_u_free_notify(td);
+	} else
+		io_u_qpush(&td->io_u_freelist, io_u);
+}
+
+/*
+ * Return several io_u's at once. For async processing, they go back to the
+ * submitter with a single ring update and at most one wakeup.
+ */
+void put_io_u_batch(struct thread_data *td, struct io_u **io_us,
+		    unsigned int nr)
+{
+	const bool needs_lock = td_async_processing(td);
+	struct thread_data *ptd = td;
+	unsigned int i;
+
+	if (!nr)
+		return;
+
+	for (i = 0; i < nr; i++)
+		ptd = __put_io_u(td, io_us[i], needs_lock);
+
+	if (needs_lock) {
+		if (!io_u_rpush_batch(&ptd->io_u_freering, io_us, nr))
+			assert(0);
+		td_io_u_free_notify(ptd);
+	} else {
+		for (i = 0; i < nr; i++)
+			io_u_qpush(&ptd->io_u_freelist, io_us[i]);
+	}
 }
 
 static inline void io_u_clear_inflight_flags(struct thread_data *td,
@@ -912,25 +964,23 @@ void requeue_io_u(struct thread_data *td, struct io_u **io_u)
 	if (td->parent)
 		td = td->parent;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 	io_u_set(td, __io_u, IO_U_F_FREE);
 	if ((__io_u->flags & IO_U_F_FLIGHT) && ddir_rw(ddir))
-		td->io_issues[ddir]--;
+		td_io_issues_dec(td, ddir);
 
 	io_u_clear(td, __io_u, IO_U_F_FLIGHT);
 	if (__io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		if (needs_lock)
+			atomic_sub(&td->cur_depth, 1);
+		else
+			td->cur_depth--;
 		assert(!(td->flags & TD_F_CHILD));
 	}
 
-	io_u_rpush(&td->io_u_requeues, __io_u);
+	if (!io_u_rpush(&td->io_u_requeues, __io_u))
+		assert(0);
 	td_io_u_free_notify(td);
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
-
 	*io_u = NULL;
 }
 
@@ -1705,7 +1755,8 @@ void lat_target_check(struct thread_data *td)
  */
 bool queue_full(const struct thread_data *td)
 {
-	const int qempty = io_u_qempty(&td->io_u_freelist);
+	const int qempty = io_u_qempty(&td->io_u_freelist) &&
+				io_u_rempty(&td->io_u_freering);
 
 	if (qempty)
 		return true;
@@ -1715,63 +1766,86 @@ bool queue_full(const struct thread_data *td)
 	return td->cur_depth >= td->latency_qd;
 }
 
+/*
+ * Move io_u's that other threads have handed back to the local freelist
+ */
+static void io_u_free_drain(struct thread_data *td)
+{
+	struct io_u *io_u;
+
+	while ((io_u = io_u_rpop(&td->io_u_freering)) != NULL)
+		io_u_qpush(&td->io_u_freelist, io_u);
+}
+
 struct io_u *__get_io_u(struct thread_data *td)
 {
 	const bool needs_lock = td_async_processing(td);
 	struct io_u *io_u = NULL;
+	int ret = 0;
 
 	if (td->stop_io)
 		return NULL;
 
-	if (needs_lock)
-		__td_io_u_lock(td);
-
 again:
-	if (!io_u_rempty(&td->io_u_requeues)) {
+	if (!io_u_rempty(&td->io_u_requeues))
 		io_u = io_u_rpop(&td->io_u_requeues);
+	if (io_u) {
 		io_u->resid = 0;
 		if (io_u->file && td->runstate == TD_FSYNCING) {
 			put_file_log(td, io_u->file);
 			io_u->file = NULL;
 		}
 	} else if (!queue_full(td)) {
+		if (io_u_qempty(&td->io_u_freelist))
+			io_u_free_drain(td);
 		io_u = io_u_qpop(&td->io_u_freelist);
-
-		io_u->file = NULL;
-		io_u->buflen = 0;
-		io_u->resid = 0;
-		io_u->end_io = NULL;
+		if (io_u) {
+			io_u->file = NULL;
+			io_u->buflen = 0;
+			io_u->resid = 0;
+			io_u->end_io = NULL;
+		}
 	}
 
 	if (io_u) {
 		assert(io_u->flags & IO_U_F_FREE);
 		io_u_clear(td, io_u, IO_U_F_FREE | IO_U_F_NO_FILE_PUT |
 				 IO_U_F_TRIMMED | IO_U_F_BARRIER |
-				 IO_U_F_VER_LIST);
+				 IO_U_F_VER_LIST | IO_U_F_VER_BITMAP);
 
 		io_u->error = 0;
 		io_u->acct_ddir = -1;
-		td->cur_depth++;
+		if (needs_lock)
+			atomic_add(&td->cur_depth, 1);
+		else
+			td->cur_depth++;
 		assert(!(td->flags & TD_F_CHILD));
 		io_u_set(td, io_u, IO_U_F_IN_CUR_DEPTH);
 		io_u->ipo = NULL;
-	} else if (td_async_processing(td)) {
-		int ret;
+	} else if (needs_lock) {
 		/*
-		 * We ran out, wait for async verify threads to finish and
-		 * return one
+		 * We ran out, wait for async verify threads or offload
+		 * workers to return one. Announce that we are going to sleep
+		 * before checking one last time, so a producer that missed
+		 * our check is guaranteed to see the flag and wake us.
 		 */
 		assert(!(td->flags & TD_F_CHILD));
-		ret = pthread_cond_wait(&td->free_cond, &td->io_u_lock);
-		if (fio_unlikely(ret != 0)) {
+		__td_io_u_lock(td);
+		atomic_store_relaxed(&td->io_u_free_wait, 1);
+		__sync_synchronize();
+		io_u_free_drain(td);
+		if (queue_full(td) && io_u_rempty(&td->io_u_requeues) &&
+		    !td->error)
+			ret = pthread_cond_wait(&td->free_cond, &td->io_u_lock);
+		atomic_store_relaxed(&td->io_u_free_wait, 0);
+		__td_io_u_unlock(td);
+
+		if (fio_unlikely(ret != 0))
 			td->error = errno;
-		} else if (!td->error)
+		else if (!td->error)
 			goto again;
 	}
 
-	if (needs_lock)
-		__td_io_u_unlock(td);
-
 	return io_u;
 }
 
@@ -2040,10 +2114,18 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 				  const enum fio_ddir idx, unsigned int bytes)
 {
 	const int no_reduce = !gtod_reduce(td);
+	struct thread_data *stat_td = td;
 	unsigned long long llnsec = 0;
 
-	if (td->parent)
+	/*
+	 * Offload workers may keep latency samples in their own stats, the
+	 * parent folds them in when needed. Everything else is the parent's.
+	 */
+	if (td->parent) {
 		td = td->parent;
+		if (!(stat_td->flags & TD_F_STAT_SHARD))
+			stat_td = td;
+	}
 
 	if (!td->o.stats || td_ioengine_flagged(td, FIO_NOSTATS))
 		return;
@@ -2055,7 +2137,7 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 		unsigned long long tnsec;
 
 		tnsec = ntime_since(&io_u->start_time, &icd->time);
-		add_lat_sample(td, idx, tnsec, bytes, io_u);
+		add_lat_sample(stat_td, idx, tnsec, bytes, io_u);
 
 		if (td->flags & TD_F_PROFILE_OPS) {
 			struct prof_io_ops *ops = &td->prof_io_ops;
@@ -2076,7 +2158,7 @@ static void account_io_completion(struct thread_data *td, struct io_u *io_u,
 
 	if (ddir_rw(idx)) {
 		if (!td->o.disable_clat) {
-			add_clat_sample(td, idx, llnsec, bytes, io_u);
+			add_clat_sample(stat_td, idx, llnsec, bytes, io_u);
 			io_u_mark_latency(td, llnsec);
 		}
 
@@ -2141,6 +2223,12 @@ static void io_completed(struct thread_data *td, struct io_u **io_u_ptr,
 			atomic_store_release(&io_u->ipo->flags,
 					io_u->ipo->flags & ~IP_F_IN_FLIGHT);
 		}
+	} else if ((io_u->flags & IO_U_F_VER_BITMAP) &&
+		   io_u->ddir == DDIR_WRITE) {
+		if (io_u->error)
+			unlog_io_piece(td, io_u);
+		else
+			io_u_clear(td, io_u, IO_U_F_VER_BITMAP);
 	}
 
 	if (ddir_sync(ddir)) {
@@ -2334,7 +2422,7 @@ int io_u_queued_complete(struct thread_data *td, int min_evts)
 void io_u_queued(struct thread_data *td, struct io_u *io_u)
 {
 	if (!td->o.disable_slat && ramp_period_over(td) && td->o.stats) {
-		if (td->parent)
+		if (td->parent && !(td->flags & TD_F_STAT_SHARD))
 			td = td->parent;
 		add_slat_sample(td, io_u);
 	}
@@ -2370,7 +2458,7 @@ static struct frand_state *get_buf_state(struct thread_data *td)
 			return &td->buf_state_ret;
 		case DEDUPE_MODE_WORKING_SET:
 			i = rand_between(&td->dedupe_working_set_index_state, 0, td->num_unique_pages - 1);
-			frand_copy(&td->buf_state_ret, &td->dedupe_working_set_states[i]);
+			dedupe_working_set_state(td, i, &td->buf_state_ret);
 			return &td->buf_state_ret;
 		default:
 			log_err("unexpected dedupe mode %u\n", td->o.dedupe_mode);
@@ -24,6 +24,7 @@ enum {
 	IO_U_F_PATTERN_DONE	= 1 << 8,
 	IO_U_F_DEVICE_ERROR	= 1 << 9,
 	IO_U_F_VER_IN_DEV	= 1 << 10, /* Verify data in device */
+	IO_U_F_VER_BITMAP	= 1 << 11, /* Write logged or verify read from verify_map */
 };
 
 /*
@@ -101,10 +102,7 @@ struct io_u {
 	};
 	void *engine_data;
 
-	union {
-		struct flist_head verify_list;
-		struct workqueue_work work;
-	};
+	struct workqueue_work work;
 
 	/*
 	 * ZBD mode zbd_queue_io callback: called after engine->queue operation
@@ -156,6 +154,7 @@ struct io_u {
 extern struct io_u *__get_io_u(struct thread_data *);
 extern struct io_u *get_io_u(struct thread_data *);
 extern void put_io_u(struct thread_data *, struct io_u *);
+extern void put_io_u_batch(struct thread_data *, struct io_u **, unsigned int);
 extern void clear_io_u(struct thread_data *, struct io_u *);
 extern void requeue_io_u(struct thread_data *, struct io_u **);
 extern int __must_check io_u_sync_complete(struct thread_data *, struct io_u *);
@@ -28,6 +28,8 @@ void io_u_qexit(struct io_u_queue *q, bool shared)
 
 bool io_u_rinit(struct io_u_ring *ring, unsigned int nr)
 {
+	unsigned int i;
+
 	ring->max = nr + 1;
 	if (ring->max & (ring->max - 1)) {
 		ring->max--;
@@ -39,10 +41,13 @@ bool io_u_rinit(struct io_u_ring *ring, unsigned int nr)
 		ring->max++;
 	}
 
-	ring->ring = calloc(ring->max, sizeof(struct io_u *));
+	ring->ring = calloc(ring->max, sizeof(struct io_u_ring_slot));
 	if (!ring->ring)
 		return false;
 
+	for (i = 0; i < ring->max; i++)
+		ring->ring[i].seq = i;
+
 	ring->head = ring->tail = 0;
 	return true;
 }
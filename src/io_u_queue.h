@@ -5,6 +5,7 @@
 #include <stddef.h>
 
 #include "lib/types.h"
+#include "arch/arch.h"
 
 struct io_u;
 
@@ -48,42 +49,147 @@ static inline int io_u_qempty(const struct io_u_queue *q)
 bool io_u_qinit(struct io_u_queue *q, unsigned int nr, bool shared);
 void io_u_qexit(struct io_u_queue *q, bool shared);
 
+/*
+ * Bounded FIFO of io_u pointers. Any number of threads may push, but only
+ * one thread may pop. Each slot carries a sequence number that tells whether
+ * it has been filled for the current lap, so producers only contend on the
+ * head index and the consumer never needs a lock. The indices are written
+ * from different threads, keep them on separate cache lines.
+ *
+ * io_u_rinit() is given the number of io_us of the job, and an io_u is in
+ * at most one ring at a time, so a ring can't fill up. If it ever did, the
+ * push fails rather than waiting for a consumer that may be the caller,
+ * the callers assert that it doesn't happen.
+ */
+#define IO_U_RING_PAD	64
+
+struct io_u_ring_slot {
+	unsigned int seq;
+	struct io_u *io_u;
+};
+
 struct io_u_ring {
-	unsigned int head;
-	unsigned int tail;
+	unsigned int head;	/* producers */
+	char head_pad[IO_U_RING_PAD];
+	unsigned int tail;	/* consumer */
+	char tail_pad[IO_U_RING_PAD];
 	unsigned int max;
-	struct io_u **ring;
+	struct io_u_ring_slot *ring;
 };
 
 bool io_u_rinit(struct io_u_ring *ring, unsigned int nr);
 void io_u_rexit(struct io_u_ring *ring);
 
-static inline void io_u_rpush(struct io_u_ring *r, struct io_u *io_u)
+static inline bool io_u_rpush(struct io_u_ring *r, struct io_u *io_u)
 {
-	if (r->head + 1 != r->tail) {
-		r->ring[r->head] = io_u;
-		r->head = (r->head + 1) & (r->max - 1);
-		return;
+	unsigned int head = atomic_load_relaxed(&r->head);
+	struct io_u_ring_slot *slot;
+	unsigned int seq;
+
+	do {
+		slot = &r->ring[head & (r->max - 1)];
+		seq = atomic_load_acquire(&slot->seq);
+		if (seq == head) {
+			if (__sync_bool_compare_and_swap(&r->head, head, head + 1))
+				break;
+		} else if ((int) (seq - head) < 0)
+			return false;
+		head = atomic_load_relaxed(&r->head);
+	} while (1);
+
+	slot->io_u = io_u;
+	atomic_store_release(&slot->seq, head + 1);
+	return true;
+}
+
+/*
+ * Push several io_u's, claiming all their slots with a single update of the
+ * head index.
+ */
+static inline bool io_u_rpush_batch(struct io_u_ring *r, struct io_u **io_us,
+				    unsigned int nr)
+{
+	unsigned int head, i;
+
+	if (nr > r->max)
+		return false;
+
+	do {
+		head = atomic_load_relaxed(&r->head);
+		for (i = 0; i < nr; i++) {
+			struct io_u_ring_slot *slot;
+			unsigned int seq;
+
+			slot = &r->ring[(head + i) & (r->max - 1)];
+			seq = atomic_load_acquire(&slot->seq);
+			if ((int) (seq - (head + i)) < 0)
+				return false;
+			if (seq != head + i)
+				break;
+		}
+		if (i == nr &&
+		    __sync_bool_compare_and_swap(&r->head, head, head + nr))
+			break;
+	} while (1);
+
+	for (i = 0; i < nr; i++) {
+		struct io_u_ring_slot *slot = &r->ring[(head + i) & (r->max - 1)];
+
+		slot->io_u = io_us[i];
+		atomic_store_release(&slot->seq, head + i + 1);
 	}
 
-	assert(0);
+	return true;
 }
 
+/*
+ * May return NULL while io_u_rempty() says otherwise, if a producer has
+ * claimed a slot but not filled it yet.
+ */
 static inline struct io_u *io_u_rpop(struct io_u_ring *r)
 {
-	if (r->head != r->tail) {
-		struct io_u *io_u = r->ring[r->tail];
+	struct io_u_ring_slot *slot = &r->ring[r->tail & (r->max - 1)];
+	struct io_u *io_u;
 
-		r->tail = (r->tail + 1) & (r->max - 1);
-		return io_u;
-	}
+	if (atomic_load_acquire(&slot->seq) != r->tail + 1)
+		return NULL;
 
-	return NULL;
+	io_u = slot->io_u;
+	atomic_store_release(&slot->seq, r->tail + r->max);
+	r->tail++;
+	return io_u;
+}
+
+/*
+ * Like io_u_rpop(), but any number of threads may pop from the ring at the
+ * same time. A ring must either always be popped with this or never.
+ */
+static inline struct io_u *io_u_rpop_shared(struct io_u_ring *r)
+{
+	unsigned int tail = atomic_load_relaxed(&r->tail);
+	struct io_u_ring_slot *slot;
+	struct io_u *io_u;
+	unsigned int seq;
+
+	do {
+		slot = &r->ring[tail & (r->max - 1)];
+		seq = atomic_load_acquire(&slot->seq);
+		if (seq == tail + 1) {
+			if (__sync_bool_compare_and_swap(&r->tail, tail, tail + 1))
+				break;
+		} else if ((int) (seq - (tail + 1)) < 0)
+			return NULL;
+		tail = atomic_load_relaxed(&r->tail);
+	} while (1);
+
+	io_u = slot->io_u;
+	atomic_store_release(&slot->seq, tail + r->max);
+	return io_u;
 }
 
-static inline int io_u_rempty(struct io_u_ring *ring)
+static inline int io_u_rempty(const struct io_u_ring *ring)
 {
-	return ring->head == ring->tail;
+	return atomic_load_relaxed(&ring->head) == ring->tail;
 }
 
 #endif
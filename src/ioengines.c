@@ -379,7 +379,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 
 	if (ddir_rw(ddir)) {
 		if (!(io_u->flags & IO_U_F_VER_LIST)) {
-			td->io_issues[ddir]++;
+			td_io_issues_inc(td, ddir);
 			td->io_issue_bytes[ddir] += buflen;
 		}
 		td->rate_io_issue_bytes[ddir] += buflen;
@@ -392,7 +392,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 
 	if (ret == FIO_Q_BUSY) {
 	       if (ddir_rw(ddir)) {
-			td->io_issues[ddir]--;
+			td_io_issues_dec(td, ddir);
 			td->io_issue_bytes[ddir] -= buflen;
 			td->rate_io_issue_bytes[ddir] -= buflen;
 		}
@@ -412,7 +412,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 	 * IO, then it's likely an alignment problem or because the host fs
 	 * does not support O_DIRECT
 	 */
-	if (io_u->error == EINVAL && td->io_issues[io_u->ddir & 1] == 1 &&
+	if (io_u->error == EINVAL && td_io_issues(td, io_u->ddir & 1) == 1 &&
 	    td->o.odirect) {
 
 		log_info("fio: first direct IO errored. File system may not "
@@ -421,7 +421,7 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 	}
 
 	if (zbd_unaligned_write(io_u->error) &&
-	    td->io_issues[io_u->ddir & 1] == 1 &&
+	    td_io_issues(td, io_u->ddir & 1) == 1 &&
 	    td->o.zone_mode != ZONE_MODE_ZBD) {
 		log_info("fio: first I/O failed. If %s is a zoned block device, consider --zonemode=zbd\n",
 			 io_u->file->file_name);
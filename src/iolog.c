@@ -11,6 +11,12 @@
 #ifdef CONFIG_ZLIB
 #include <zlib.h>
 #endif
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+#ifdef CONFIG_LZ4
+#include <lz4frame.h>
+#endif
 
 #include "flist.h"
 #include "fio.h"
@@ -18,8 +24,12 @@
 #include "filelock.h"
 #include "smalloc.h"
 #include "blktrace.h"
+#include "iolog_decomp.h"
+#include "log_stream.h"
 #include "pshared.h"
 #include "lib/roundup.h"
+#include "lib/blockmap.h"
+#include "hash.h"
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -39,6 +49,36 @@ void queue_io_piece(struct thread_data *td, struct io_piece *ipo)
 	td->total_io_size += ipo->len;
 }
 
+static const enum iolog_bin_act ddir_bin_act[DDIR_LAST] = {
+	[DDIR_READ]		= IOLOG_BIN_READ,
+	[DDIR_WRITE]		= IOLOG_BIN_WRITE,
+	[DDIR_TRIM]		= IOLOG_BIN_TRIM,
+	[DDIR_SYNC]		= IOLOG_BIN_SYNC,
+	[DDIR_DATASYNC]		= IOLOG_BIN_DATASYNC,
+	[DDIR_SYNC_FILE_RANGE]	= IOLOG_BIN_ACT_NR,
+	[DDIR_WAIT]		= IOLOG_BIN_WAIT,
+};
+
+static void log_io_u_bin(const struct thread_data *td,
+			 const struct io_u *io_u)
+{
+	struct fio_file *f = io_u->file;
+
+	/*
+	 * sync_file_range can't be replayed, the text log drops it on read
+	 */
+	if (io_u->ddir >= DDIR_WAIT ||
+	    ddir_bin_act[io_u->ddir] == IOLOG_BIN_ACT_NR)
+		return;
+
+	if (iolog_bin_add_file(td->iolog_bin, f->fileno, f->file_name) ||
+	    iolog_bin_write(td->iolog_bin,
+			    utime_since_now(&td->io_log_start_time),
+			    ddir_bin_act[io_u->ddir], f->fileno, io_u->offset,
+			    io_u->buflen))
+		log_err("fio: failed writing binary iolog\n");
+}
+
 void log_io_u(const struct thread_data *td, const struct io_u *io_u)
 {
 	struct timespec now;
@@ -46,6 +86,11 @@ void log_io_u(const struct thread_data *td, const struct io_u *io_u)
 	if (!td->o.write_iolog_file)
 		return;
 
+	if (td->iolog_bin) {
+		log_io_u_bin(td, io_u);
+		return;
+	}
+
 	fio_gettime(&now, NULL);
 	fprintf(td->iolog_f, "%llu %s %s %llu %llu\n",
 		(unsigned long long) utime_since_now(&td->io_log_start_time),
@@ -58,6 +103,9 @@ void log_file(struct thread_data *td, struct fio_file *f,
 	      enum file_log_act what)
 {
 	const char *act[] = { "add", "open", "close" };
+	const enum iolog_bin_act bin_act[] = {
+		IOLOG_BIN_ADD, IOLOG_BIN_OPEN, IOLOG_BIN_CLOSE
+	};
 	struct timespec now;
 
 	assert(what < 3);
@@ -72,6 +120,15 @@ void log_file(struct thread_data *td, struct fio_file *f,
 	if (!td->iolog_f)
 		return;
 
+	if (td->iolog_bin) {
+		if (iolog_bin_add_file(td->iolog_bin, f->fileno, f->file_name) ||
+		    iolog_bin_write(td->iolog_bin,
+				    utime_since_now(&td->io_log_start_time),
+				    bin_act[what], f->fileno, 0, 0))
+			log_err("fio: failed writing binary iolog\n");
+		return;
+	}
+
 	fio_gettime(&now, NULL);
 	fprintf(td->iolog_f, "%llu %s %s\n",
 		(unsigned long long) utime_since_now(&td->io_log_start_time),
@@ -192,6 +249,62 @@ unsigned long long delay_since_ttime(const struct thread_data *td,
 	return tmp * scale;
 }
 
+/*
+ * True if the clones of this job split the replayed log between them. They
+ * then all replay against the same files, and a clone may end up with no
+ * I/O at all.
+ */
+bool iolog_sharded(struct thread_data *td)
+{
+	return td->o.replay_shard != REPLAY_SHARD_NONE &&
+		td->io_log_nr_shards > 1;
+}
+
+/*
+ * With replay_shard set, each clone of a job replays its own part of the
+ * log. Returns true if the entry belongs to another clone. The delay of a
+ * skipped entry is carried over to the next one that isn't skipped, so
+ * every shard keeps the timing of the original log.
+ */
+bool iolog_shard_skip(struct thread_data *td, enum fio_ddir ddir, int fileno,
+		      unsigned long long offset, unsigned long long *delay)
+{
+	unsigned int nr = td->io_log_nr_shards;
+	uint64_t key;
+
+	if (!iolog_sharded(td))
+		return false;
+
+	switch (td->o.replay_shard) {
+	case REPLAY_SHARD_FILE:
+		key = fileno;
+		break;
+	case REPLAY_SHARD_OFFSET:
+		key = offset / td->o.replay_shard_chunk;
+		break;
+	case REPLAY_SHARD_HASH:
+	default:
+		key = __hash_u64(((uint64_t) fileno << 48) ^
+				 (offset / td->o.replay_shard_chunk));
+		break;
+	}
+
+	/*
+	 * Syncs are issued once, by the shard owning the start of the file
+	 */
+	if (ddir_sync(ddir) && td->o.replay_shard != REPLAY_SHARD_FILE)
+		key = 0;
+
+	if (key % nr != td->subjob_number) {
+		td->io_log_shard_delay += *delay;
+		return true;
+	}
+
+	*delay += td->io_log_shard_delay;
+	td->io_log_shard_delay = 0;
+	return false;
+}
+
 int read_iolog_get(struct thread_data *td, struct io_u *io_u)
 {
 	struct io_piece *ipo;
@@ -205,6 +318,9 @@ int read_iolog_get(struct thread_data *td, struct io_u *io_u)
 				if (td->io_log_blktrace) {
 					if (!read_blktrace(td))
 						return 1;
+				} else if (td->io_log_bin) {
+					if (!read_iolog_bin(td))
+						return 1;
 				} else {
 					if (!read_iolog(td))
 						return 1;
@@ -255,11 +371,32 @@ int read_iolog_get(struct thread_data *td, struct io_u *io_u)
 	return 1;
 }
 
+static void prune_verify_maps(struct thread_data *td)
+{
+	struct fio_file *f;
+	unsigned int i;
+
+	for_each_file(td, f, i) {
+		if (!f->verify_map)
+			continue;
+		td->io_hist_len -= blockmap_weight(f->verify_map);
+		blockmap_reset(f->verify_map);
+	}
+
+	td->verify_map_numberio[0] = 0;
+	td->verify_map_numberio[1] = 0;
+	td->verify_map_file = 0;
+	td->verify_map_next = 0;
+}
+
 void prune_io_piece_log(struct thread_data *td)
 {
 	struct io_piece *ipo;
 	struct fio_rb_node *n;
 
+	if (td->o.verify_tracking == VERIFY_TRACK_BITMAP)
+		prune_verify_maps(td);
+
 	while ((n = rb_first(&td->io_hist_tree)) != NULL) {
 		ipo = rb_entry(n, struct io_piece, rb_node);
 		rb_erase(n, &td->io_hist_tree);
@@ -277,6 +414,61 @@ void prune_io_piece_log(struct thread_data *td)
 	}
 }
 
+/*
+ * Set the bit for a block in the file's verify map. A rewrite of the block
+ * sets the same bit again, so like the rbtree only the last write of a
+ * block gets verified. Writes that don't cover exactly one block fall back
+ * to an io_piece.
+ */
+static bool log_io_block(struct thread_data *td, struct io_u *io_u)
+{
+	unsigned long long bs = td->o.min_bs[DDIR_WRITE];
+	struct fio_file *f = io_u->file;
+	uint64_t block;
+
+	if (io_u->buflen != bs || io_u->offset < f->file_offset ||
+	    (io_u->offset - f->file_offset) % bs)
+		return false;
+
+	if (!f->verify_map) {
+		f->verify_map = blockmap_new();
+		if (!f->verify_map)
+			return false;
+	}
+
+	block = (io_u->offset - f->file_offset) / bs;
+	switch (blockmap_set(f->verify_map, block)) {
+	case 1:
+		td->io_hist_len++;
+		break;
+	case 0:
+		break;
+	default:
+		return false;
+	}
+
+	if (!td->verify_map_numberio[1])
+		td->verify_map_numberio[0] = io_u->numberio;
+	else
+		td->verify_map_numberio[0] = min(td->verify_map_numberio[0],
+						 io_u->numberio);
+	td->verify_map_numberio[1] = max(td->verify_map_numberio[1],
+					 io_u->numberio + 1);
+	io_u_set(td, io_u, IO_U_F_VER_BITMAP);
+	return true;
+}
+
+static void unlog_io_block(struct thread_data *td, struct io_u *io_u)
+{
+	unsigned long long bs = td->o.min_bs[DDIR_WRITE];
+	struct fio_file *f = io_u->file;
+
+	io_u_clear(td, io_u, IO_U_F_VER_BITMAP);
+	if (blockmap_clear(f->verify_map,
+			   (io_u->offset - f->file_offset) / bs) == 1)
+		td->io_hist_len--;
+}
+
 /*
  * log a successful write, so we can unwind the log for verify
  */
@@ -285,6 +477,10 @@ void log_io_piece(struct thread_data *td, struct io_u *io_u)
 	struct fio_rb_node **p, *parent;
 	struct io_piece *ipo, *__ipo;
 
+	if (td->o.verify_tracking == VERIFY_TRACK_BITMAP &&
+	    log_io_block(td, io_u))
+		return;
+
 	ipo = calloc(1, sizeof(struct io_piece));
 	init_ipo(ipo);
 	ipo->file = io_u->file;
@@ -377,6 +573,11 @@ void unlog_io_piece(struct thread_data *td, struct io_u *io_u)
 		}
 	}
 
+	if ((io_u->flags & IO_U_F_VER_BITMAP) && io_u->ddir == DDIR_WRITE) {
+		unlog_io_block(td, io_u);
+		return;
+	}
+
 	if (!ipo)
 		return;
 
@@ -405,6 +606,13 @@ void write_iolog_close(struct thread_data *td)
 	if (!td->iolog_f)
 		return;
 
+	if (td->iolog_bin) {
+		if (iolog_bin_writer_finish(td->iolog_bin))
+			log_err("fio: failed finishing binary iolog\n");
+		free(td->iolog_bin);
+		td->iolog_bin = NULL;
+	}
+
 	fflush(td->iolog_f);
 	fclose(td->iolog_f);
 	free(td->iolog_buf);
@@ -440,10 +648,433 @@ int64_t iolog_items_to_fetch(struct thread_data *td)
 	return items_to_fetch;
 }
 
-#define io_act(_td, _r) (((_td)->io_log_version == 3 && (r) == 5) || \
-					((_td)->io_log_version == 2 && (r) == 4))
-#define file_act(_td, _r) (((_td)->io_log_version == 3 && (r) == 3) || \
-					((_td)->io_log_version == 2 && (r) == 2))
+#define io_act(_td, _r) (((_td)->io_log_version == 3 && (_r) == 5) || \
+					((_td)->io_log_version == 2 && (_r) == 4))
+#define file_act(_td, _r) (((_td)->io_log_version == 3 && (_r) == 3) || \
+					((_td)->io_log_version == 2 && (_r) == 2))
+
+/*
+ * Queue one parsed iolog entry. Returns true once the current chunk is
+ * full when reading chunked.
+ */
+bool iolog_queue_entry(struct thread_data *td, struct iolog_read_state *st,
+		       enum fio_ddir rw, int fileno, int file_action,
+		       unsigned long long offset, unsigned int bytes,
+		       unsigned long long delay)
+{
+	struct io_piece *ipo;
+
+	if ((ddir_rw(rw) || ddir_sync(rw)) &&
+	    iolog_shard_skip(td, rw, fileno, offset, &delay))
+		return false;
+
+	if (rw == DDIR_READ)
+		st->reads++;
+	else if (rw == DDIR_WRITE) {
+		/*
+		 * Don't add a write for ro mode
+		 */
+		if (read_only)
+			return false;
+		st->writes++;
+	} else if (rw == DDIR_TRIM) {
+		/*
+		 * Don't add a trim for ro mode
+		 */
+		if (read_only)
+			return false;
+		st->trims++;
+	} else if (rw == DDIR_WAIT) {
+		if (td->o.no_stall)
+			return false;
+		st->waits++;
+	} else if (rw == DDIR_INVAL) {
+	} else if (ddir_sync(rw)) {
+		st->syncs++;
+	} else {
+		log_err("bad ddir: %d\n", rw);
+		return false;
+	}
+
+	/*
+	 * Make note of file
+	 */
+	ipo = calloc(1, sizeof(*ipo));
+	init_ipo(ipo);
+	ipo->ddir = rw;
+	ipo->delay = delay;
+	if (rw == DDIR_WAIT) {
+		ipo->delay = offset;
+	} else {
+		if (td->o.replay_scale)
+			ipo->offset = offset / td->o.replay_scale;
+		else
+			ipo->offset = offset;
+		ipo_bytes_align(td->o.replay_align, ipo);
+
+		ipo->len = bytes;
+		if (rw != DDIR_INVAL && bytes > td->o.max_bs[rw]) {
+			st->realloc = true;
+			td->o.max_bs[rw] = bytes;
+		}
+		ipo->fileno = fileno;
+		ipo->file_action = file_action;
+		td->o.size += bytes;
+	}
+
+	queue_io_piece(td, ipo);
+
+	if (td->o.read_iolog_chunked) {
+		td->io_log_current++;
+		st->items_to_fetch--;
+		if (st->items_to_fetch == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Wrap up reading a (chunk of an) iolog, returns false if nothing usable
+ * was read.
+ */
+bool iolog_read_finish(struct thread_data *td, struct iolog_read_state *st)
+{
+	if (td->o.read_iolog_chunked) {
+		td->io_log_highmark = td->io_log_current;
+		td->io_log_checkmark = (td->io_log_highmark + 1) / 2;
+		fio_gettime(&td->io_log_highmark_time, NULL);
+	}
+
+	if (st->writes && read_only) {
+		log_err("fio: <%s> skips replay of %d writes due to"
+			" read-only\n", td->o.name, st->writes);
+		st->writes = 0;
+	}
+	if (st->syncs)
+		td->flags |= TD_F_SYNCS;
+
+	if (td->o.read_iolog_chunked) {
+		if (td->io_log_current == 0 && !iolog_sharded(td)) {
+			return false;
+		}
+		td->o.td_ddir = TD_DDIR_RW;
+		if (st->realloc && td->orig_buffer)
+		{
+			io_u_quiesce(td);
+			free_io_mem(td);
+			if (init_io_u_buffers(td))
+				return false;
+		}
+		return true;
+	}
+
+	/*
+	 * A shard that got no I/O leaves an idle clone
+	 */
+	if (!st->reads && !st->writes && !st->waits && !st->trims)
+		return iolog_sharded(td);
+
+	td->o.td_ddir = 0;
+	if (st->reads)
+		td->o.td_ddir |= TD_DDIR_READ;
+	if (st->writes)
+		td->o.td_ddir |= TD_DDIR_WRITE;
+	if (st->trims)
+		td->o.td_ddir |= TD_DDIR_TRIM;
+
+	return true;
+}
+
+#define IOLOG_TEXT_BUF		(1024 * 1024)
+
+/*
+ * Reader state for text iologs. Lines are parsed in place in a large
+ * buffer that is refilled with read(2), so nothing is allocated per line.
+ * The buffer persists between calls when the log is read in chunks.
+ */
+struct iolog_text_reader {
+	FILE *f;
+	int fd;
+	char *buf;
+	size_t size;
+	size_t start;
+	size_t end;
+	bool eof;
+	int err;
+
+	/*
+	 * File name to fileno lookup. The table holds fileno + 1 and is
+	 * checked against td->files[], so it never owns a copy of a name.
+	 */
+	int last_fileno;
+	unsigned int *names;
+	unsigned int names_size;
+	unsigned int names_used;
+};
+
+static struct iolog_text_reader *iolog_text_reader_new(FILE *f)
+{
+	struct iolog_text_reader *r;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->f = f;
+	r->fd = fileno(f);
+	r->size = IOLOG_TEXT_BUF;
+	r->buf = malloc(r->size + 1);
+	if (!r->buf) {
+		free(r);
+		return NULL;
+	}
+
+	r->last_fileno = -1;
+	return r;
+}
+
+void iolog_text_read_close(struct thread_data *td)
+{
+	struct iolog_text_reader *r = td->io_log_text;
+
+	if (!r)
+		return;
+
+	free(r->names);
+	free(r->buf);
+	free(r);
+	td->io_log_text = NULL;
+}
+
+/*
+ * Returns the next line with its newline replaced by a NUL, or NULL at the
+ * end of the log. glibc's memchr() does the newline scan a vector at a time.
+ */
+static char *iolog_text_getline(struct iolog_text_reader *r)
+{
+	char *line, *nl;
+	ssize_t ret;
+
+	do {
+		line = r->buf + r->start;
+		nl = memchr(line, '\n', r->end - r->start);
+		if (nl) {
+			*nl = '\0';
+			r->start = nl + 1 - r->buf;
+			return line;
+		}
+		if (r->eof) {
+			if (r->start == r->end)
+				return NULL;
+			/* last line without a newline, the buffer has room */
+			r->buf[r->end] = '\0';
+			r->start = r->end;
+			return line;
+		}
+
+		/*
+		 * Move the partial line to the front, or grow the buffer if
+		 * the line fills all of it
+		 */
+		if (r->start) {
+			memmove(r->buf, line, r->end - r->start);
+			r->end -= r->start;
+			r->start = 0;
+		} else if (r->end == r->size) {
+			char *buf = realloc(r->buf, 2 * r->size + 1);
+
+			if (!buf) {
+				log_err("fio: iolog line too long\n");
+				r->err = ENOMEM;
+				r->eof = true;
+				continue;
+			}
+			r->buf = buf;
+			r->size *= 2;
+		}
+
+		ret = read(r->fd, r->buf + r->end, r->size - r->end);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			log_err("fio: iolog read: %s\n", strerror(errno));
+			r->err = errno;
+			r->eof = true;
+		} else if (!ret) {
+			/* a compressed log may have ended early */
+			r->err = iolog_ferror(r->f);
+			r->eof = true;
+		} else
+			r->end += ret;
+	} while (1);
+}
+
+static inline bool iolog_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * Returns the next whitespace separated token of a line and stores its
+ * length in *len, or returns NULL if the line has no more tokens.
+ */
+static char *iolog_token(char **p, size_t *len)
+{
+	char *s = *p, *e;
+
+	while (iolog_space(*s))
+		s++;
+	if (!*s)
+		return NULL;
+
+	for (e = s; *e && !iolog_space(*e); e++)
+		;
+
+	*len = e - s;
+	*p = e;
+	return s;
+}
+
+/*
+ * Parses an integer the way sscanf("%llu") does: an optional sign, then
+ * digits, stopping at the first non-digit. Whatever follows the digits is
+ * left for the next field, so "123abc" gives 123 and then "abc".
+ */
+static bool iolog_token_u64(char **p, unsigned long long *val)
+{
+	unsigned long long v = 0;
+	bool neg = false, ovf = false;
+	char *s = *p;
+
+	while (iolog_space(*s))
+		s++;
+	if (*s == '+' || *s == '-')
+		neg = *s++ == '-';
+	if (*s < '0' || *s > '9')
+		return false;
+
+	for (; *s >= '0' && *s <= '9'; s++) {
+		unsigned int d = *s - '0';
+
+		if (ovf || v > (ULLONG_MAX - d) / 10)
+			ovf = true;
+		else
+			v = v * 10 + d;
+	}
+
+	/* like strtoull(), saturate on overflow */
+	if (ovf)
+		*val = ULLONG_MAX;
+	else
+		*val = neg ? -v : v;
+	*p = s;
+	return true;
+}
+
+static const struct iolog_text_act {
+	const char *name;
+	unsigned int len;
+	enum fio_ddir ddir;
+	int file_action;
+} iolog_text_acts[] = {
+	{ "read",	4,	DDIR_READ,	0 },
+	{ "write",	5,	DDIR_WRITE,	0 },
+	{ "trim",	4,	DDIR_TRIM,	0 },
+	{ "sync",	4,	DDIR_SYNC,	0 },
+	{ "datasync",	8,	DDIR_DATASYNC,	0 },
+	{ "wait",	4,	DDIR_WAIT,	0 },
+	{ "add",	3,	DDIR_INVAL,	FIO_LOG_ADD_FILE },
+	{ "open",	4,	DDIR_INVAL,	FIO_LOG_OPEN_FILE },
+	{ "close",	5,	DDIR_INVAL,	FIO_LOG_CLOSE_FILE },
+};
+
+static const struct iolog_text_act *iolog_text_act(const char *s, size_t len)
+{
+	unsigned int i;
+
+	for (i = 0; i < FIO_ARRAY_SIZE(iolog_text_acts); i++) {
+		const struct iolog_text_act *a = &iolog_text_acts[i];
+
+		if (a->len == len && !memcmp(a->name, s, len))
+			return a;
+	}
+
+	return NULL;
+}
+
+static void iolog_text_name_insert(struct iolog_text_reader *r,
+				   struct thread_data *td, int fileno)
+{
+	unsigned int mask, i;
+
+	if (2 * (r->names_used + 1) > r->names_size) {
+		unsigned int *old = r->names, old_size = r->names_size;
+		unsigned int *names;
+
+		r->names_size = old_size ? 2 * old_size : 64;
+		names = calloc(r->names_size, sizeof(unsigned int));
+		if (!names) {
+			r->names_size = old_size;
+			return;
+		}
+		r->names = names;
+		r->names_used = 0;
+		for (i = 0; i < old_size; i++)
+			if (old[i])
+				iolog_text_name_insert(r, td, old[i] - 1);
+		free(old);
+	}
+
+	mask = r->names_size - 1;
+	i = jhash(td->files[fileno]->file_name,
+		  strlen(td->files[fileno]->file_name), 0) & mask;
+	while (r->names[i]) {
+		if (r->names[i] == fileno + 1)
+			return;
+		i = (i + 1) & mask;
+	}
+
+	r->names[i] = fileno + 1;
+	r->names_used++;
+}
+
+/*
+ * Like get_fileno(), but remembers the files it has seen so that traces
+ * with many files don't pay a string compare per file on every line.
+ */
+static int iolog_text_fileno(struct iolog_text_reader *r,
+			     struct thread_data *td, const char *fname,
+			     size_t len)
+{
+	unsigned int mask, i;
+	int fileno;
+
+	if (r->last_fileno >= 0 && r->last_fileno < td->files_index &&
+	    !strcmp(td->files[r->last_fileno]->file_name, fname))
+		return r->last_fileno;
+
+	if (r->names_size) {
+		mask = r->names_size - 1;
+		i = jhash(fname, len, 0) & mask;
+		while (r->names[i]) {
+			fileno = r->names[i] - 1;
+			if (fileno < td->files_index &&
+			    !strcmp(td->files[fileno]->file_name, fname)) {
+				r->last_fileno = fileno;
+				return fileno;
+			}
+			i = (i + 1) & mask;
+		}
+	}
+
+	fileno = get_fileno(td, fname);
+	if (fileno >= 0) {
+		iolog_text_name_insert(r, td, fileno);
+		r->last_fileno = fileno;
+	}
+	return fileno;
+}
 
 /*
  * Read version 2 and 3 iolog data. It is enhanced to include per-file logging,
@@ -451,20 +1082,18 @@ int64_t iolog_items_to_fetch(struct thread_data *td)
  */
 static bool read_iolog(struct thread_data *td)
 {
-	unsigned long long offset;
-	unsigned int bytes;
+	struct iolog_text_reader *r = td->io_log_text;
+	unsigned long long offset, bytes;
 	unsigned long long delay = 0;
-	int reads, writes, trims, waits, fileno = 0, file_action = 0; /* stupid gcc */
-	char *rfname, *fname, *act;
-	char *str, *p;
+	int fileno = 0, file_action = 0; /* stupid gcc */
+	const struct iolog_text_act *a;
+	struct iolog_read_state st = { };
 	enum fio_ddir rw;
-	bool realloc = false;
-	int64_t items_to_fetch = 0;
-	int syncs;
+	char *line;
 
 	if (td->o.read_iolog_chunked) {
-		items_to_fetch = iolog_items_to_fetch(td);
-		if (!items_to_fetch)
+		st.items_to_fetch = iolog_items_to_fetch(td);
+		if (!st.items_to_fetch)
 			return true;
 	}
 
@@ -472,202 +1101,118 @@ static bool read_iolog(struct thread_data *td)
 	 * Read in the read iolog and store it, reuse the infrastructure
 	 * for doing verifications.
 	 */
-	str = malloc(4096);
-	rfname = fname = malloc(256+16);
-	act = malloc(256+16);
-
-	syncs = reads = writes = trims = waits = 0;
-	while ((p = fgets(str, 4096, td->io_log_rfile)) != NULL) {
-		struct io_piece *ipo;
-		int r;
+	while ((line = iolog_text_getline(r)) != NULL) {
 		unsigned long long ttime;
+		char *p = line, *fname = NULL, *act = NULL;
+		size_t fname_len = 0, act_len = 0;
+		int nr = 0;
 
+		offset = bytes = 0;
+
+		/*
+		 * Same field counting as the sscanf() this replaces, nr is
+		 * the number of fields parsed before the first bad one
+		 */
 		if (td->io_log_version == 3) {
-			r = sscanf(p, "%llu %256s %256s %llu %u", &ttime, rfname, act,
-							&offset, &bytes);
+			if (!iolog_token_u64(&p, &ttime))
+				goto parsed;
+			nr++;
 			delay = delay_since_ttime(td, ttime);
 			td->io_log_last_ttime = ttime;
-			/*
-			 * "wait" is not allowed with version 3
-			 */
-			if (!strcmp(act, "wait")) {
-				log_err("iolog: ignoring wait command with"
-					" version 3 for file %s\n", fname);
-				continue;
-			}
-		} else /* version 2 */
-			r = sscanf(p, "%256s %256s %llu %u", rfname, act, &offset, &bytes);
+		}
+		fname = iolog_token(&p, &fname_len);
+		if (!fname)
+			goto parsed;
+		nr++;
+		act = iolog_token(&p, &act_len);
+		if (!act)
+			goto parsed;
+		nr++;
+		if (!iolog_token_u64(&p, &offset))
+			goto parsed;
+		nr++;
+		if (!iolog_token_u64(&p, &bytes))
+			goto parsed;
+		nr++;
+parsed:
+		if (!io_act(td, nr) && !file_act(td, nr)) {
+			log_err("bad iolog%d: %s\n", td->io_log_version, line);
+			continue;
+		}
+
+		/*
+		 * Both are known to be followed by whitespace or the end of
+		 * the line, terminate them in place
+		 */
+		fname[fname_len] = '\0';
+		act[act_len] = '\0';
+		a = iolog_text_act(act, act_len);
+
+		/*
+		 * "wait" is not allowed with version 3
+		 */
+		if (td->io_log_version == 3 && a && a->ddir == DDIR_WAIT) {
+			log_err("iolog: ignoring wait command with"
+				" version 3 for file %s\n", fname);
+			continue;
+		}
 
-		if (td->o.replay_redirect)
+		if (td->o.replay_redirect) {
 			fname = td->o.replay_redirect;
+			fname_len = strlen(fname);
+		}
 
-		if (io_act(td, r)) {
+		if (io_act(td, nr)) {
 			/*
 			 * Check action first
 			 */
-			if (!strcmp(act, "wait"))
-				rw = DDIR_WAIT;
-			else if (!strcmp(act, "read")) {
-				if (td->o.replay_skip & (1u << DDIR_READ))
-					continue;
-				rw = DDIR_READ;
-			} else if (!strcmp(act, "write")) {
-				if (td->o.replay_skip & (1u << DDIR_WRITE))
-					continue;
-				rw = DDIR_WRITE;
-			} else if (!strcmp(act, "sync")) {
-				if (td->o.replay_skip & (1u << DDIR_SYNC))
-					continue;
-				rw = DDIR_SYNC;
-			} else if (!strcmp(act, "datasync"))
-				rw = DDIR_DATASYNC;
-			else if (!strcmp(act, "trim")) {
-				if (td->o.replay_skip & (1u << DDIR_TRIM))
-					continue;
-				rw = DDIR_TRIM;
-			} else {
+			if (!a || a->ddir == DDIR_INVAL) {
+				log_err("fio: bad iolog file action: %s\n",
+									act);
+				continue;
+			}
+			rw = a->ddir;
+			if (rw != DDIR_WAIT &&
+			    (td->o.replay_skip & (1u << rw)))
+				continue;
+			fileno = iolog_text_fileno(r, td, fname, fname_len);
+		} else {
+			if (!a || a->ddir != DDIR_INVAL) {
 				log_err("fio: bad iolog file action: %s\n",
 									act);
 				continue;
 			}
-			fileno = get_fileno(td, fname);
-		} else if (file_act(td, r)) {
 			rw = DDIR_INVAL;
-			if (!strcmp(act, "add")) {
+			if (a->file_action == FIO_LOG_ADD_FILE) {
 				if (td->o.replay_redirect &&
-				    get_fileno(td, fname) != -1) {
+				    iolog_text_fileno(r, td, fname, fname_len) != -1) {
 					dprint(FD_FILE, "iolog: ignoring"
 						" re-add of file %s\n", fname);
 				} else {
-					fileno = add_file(td, fname, td->subjob_number, 1);
+					fileno = add_file(td, fname,
+						iolog_sharded(td) ? 0 :
+						td->subjob_number, 1);
 					file_action = FIO_LOG_ADD_FILE;
+					iolog_text_name_insert(r, td, fileno);
 				}
-			} else if (!strcmp(act, "open")) {
-				fileno = get_fileno(td, fname);
-				file_action = FIO_LOG_OPEN_FILE;
-			} else if (!strcmp(act, "close")) {
-				fileno = get_fileno(td, fname);
-				file_action = FIO_LOG_CLOSE_FILE;
 			} else {
-				log_err("fio: bad iolog file action: %s\n",
-									act);
-				continue;
-			}
-		} else {
-			log_err("bad iolog%d: %s\n", td->io_log_version, p);
-			continue;
-		}
-
-		if (rw == DDIR_READ)
-			reads++;
-		else if (rw == DDIR_WRITE) {
-			/*
-			 * Don't add a write for ro mode
-			 */
-			if (read_only)
-				continue;
-			writes++;
-		} else if (rw == DDIR_TRIM) {
-			/*
-			 * Don't add a trim for ro mode
-			 */
-			if (read_only)
-				continue;
-			trims++;
-		} else if (rw == DDIR_WAIT) {
-			if (td->o.no_stall)
-				continue;
-			waits++;
-		} else if (rw == DDIR_INVAL) {
-		} else if (ddir_sync(rw)) {
-			syncs++;
-		} else {
-			log_err("bad ddir: %d\n", rw);
-			continue;
-		}
-
-		/*
-		 * Make note of file
-		 */
-		ipo = calloc(1, sizeof(*ipo));
-		init_ipo(ipo);
-		ipo->ddir = rw;
-		if (td->io_log_version == 3)
-			ipo->delay = delay;
-		if (rw == DDIR_WAIT) {
-			ipo->delay = offset;
-		} else {
-			if (td->o.replay_scale)
-				ipo->offset = offset / td->o.replay_scale;
-			else
-				ipo->offset = offset;
-			ipo_bytes_align(td->o.replay_align, ipo);
-
-			ipo->len = bytes;
-			if (rw != DDIR_INVAL && bytes > td->o.max_bs[rw]) {
-				realloc = true;
-				td->o.max_bs[rw] = bytes;
+				fileno = iolog_text_fileno(r, td, fname,
+							   fname_len);
+				file_action = a->file_action;
 			}
-			ipo->fileno = fileno;
-			ipo->file_action = file_action;
-			td->o.size += bytes;
 		}
 
-		queue_io_piece(td, ipo);
-
-		if (td->o.read_iolog_chunked) {
-			td->io_log_current++;
-			items_to_fetch--;
-			if (items_to_fetch == 0)
-				break;
-		}
-	}
-
-	free(str);
-	free(act);
-	free(rfname);
-
-	if (td->o.read_iolog_chunked) {
-		td->io_log_highmark = td->io_log_current;
-		td->io_log_checkmark = (td->io_log_highmark + 1) / 2;
-		fio_gettime(&td->io_log_highmark_time, NULL);
-	}
-
-	if (writes && read_only) {
-		log_err("fio: <%s> skips replay of %d writes due to"
-			" read-only\n", td->o.name, writes);
-		writes = 0;
-	}
-	if (syncs)
-		td->flags |= TD_F_SYNCS;
-
-	if (td->o.read_iolog_chunked) {
-		if (td->io_log_current == 0) {
-			return false;
-		}
-		td->o.td_ddir = TD_DDIR_RW;
-		if (realloc && td->orig_buffer)
-		{
-			io_u_quiesce(td);
-			free_io_mem(td);
-			if (init_io_u_buffers(td))
-				return false;
-		}
-		return true;
+		if (iolog_queue_entry(td, &st, rw, fileno, file_action, offset,
+				      bytes, delay))
+			break;
 	}
 
-	if (!reads && !writes && !waits && !trims)
+	if (r->err) {
+		td_verror(td, r->err, "iolog read");
 		return false;
+	}
 
-	td->o.td_ddir = 0;
-	if (reads)
-		td->o.td_ddir |= TD_DDIR_READ;
-	if (writes)
-		td->o.td_ddir |= TD_DDIR_WRITE;
-	if (trims)
-		td->o.td_ddir |= TD_DDIR_TRIM;
-
-	return true;
+	return iolog_read_finish(td, &st);
 }
 
 static bool is_socket(const char *path)
@@ -711,8 +1256,9 @@ static int open_socket(const char *path)
  */
 static bool init_iolog_read(struct thread_data *td, char *fname)
 {
-	char buffer[256], *p;
+	struct iolog_text_reader *r;
 	FILE *f = NULL;
+	char *p;
 
 	dprint(FD_IO, "iolog: name=%s\n", fname);
 
@@ -725,38 +1271,50 @@ static bool init_iolog_read(struct thread_data *td, char *fname)
 	} else if (!strcmp(fname, "-")) {
 		f = stdin;
 	} else
-		f = fopen(fname, "r");
+		f = iolog_fopen(fname);
 
 	if (!f) {
 		perror("fopen read iolog");
 		return false;
 	}
 
-	p = fgets(buffer, sizeof(buffer), f);
+	iolog_text_read_close(td);
+	r = iolog_text_reader_new(f);
+	if (!r) {
+		log_err("fio: failed to allocate iolog read buffer\n");
+		iolog_fclose(f);
+		return false;
+	}
+
+	p = iolog_text_getline(r);
 	if (!p) {
-		td_verror(td, errno, "iolog read");
+		td_verror(td, r->err ? r->err : errno, "iolog read");
 		log_err("fio: unable to read iolog\n");
-		fclose(f);
-		return false;
+		goto err;
 	}
 
 	/*
 	 * versions 2 and 3 of the iolog store a specific string as the
 	 * first line, check for that
 	 */
-	if (!strncmp(iolog_ver2, buffer, strlen(iolog_ver2)))
+	if (!strncmp(iolog_ver2, p, strlen(iolog_ver2)))
 		td->io_log_version = 2;
-	else if (!strncmp(iolog_ver3, buffer, strlen(iolog_ver3)))
+	else if (!strncmp(iolog_ver3, p, strlen(iolog_ver3)))
 		td->io_log_version = 3;
 	else {
 		log_err("fio: iolog version 1 is no longer supported\n");
-		fclose(f);
-		return false;
+		goto err;
 	}
 
 	free_release_files(td);
 	td->io_log_rfile = f;
+	td->io_log_text = r;
 	return read_iolog(td);
+err:
+	free(r->buf);
+	free(r);
+	iolog_fclose(f);
+	return false;
 }
 
 /*
@@ -768,7 +1326,13 @@ static bool init_iolog_write(struct thread_data *td)
 	FILE *f;
 	unsigned int i;
 
-	f = fopen(td->o.write_iolog_file, "a");
+	/*
+	 * A binary log can't be appended to, its tables live at the end
+	 */
+	if (td->o.write_iolog_format == IOLOG_FORMAT_BINARY)
+		f = fopen(td->o.write_iolog_file, "w");
+	else
+		f = fopen(td->o.write_iolog_file, "a");
 	if (!f) {
 		perror("fopen write iolog");
 		return false;
@@ -782,10 +1346,16 @@ static bool init_iolog_write(struct thread_data *td)
 	setvbuf(f, td->iolog_buf, _IOFBF, 8192);
 	fio_gettime(&td->io_log_start_time, NULL);
 
-	/*
-	 * write our version line
-	 */
-	if (fprintf(f, "%s\n", iolog_ver3) < 0) {
+	if (td->o.write_iolog_format == IOLOG_FORMAT_BINARY) {
+		td->iolog_bin = malloc(sizeof(*td->iolog_bin));
+		if (iolog_bin_writer_init(td->iolog_bin, f)) {
+			perror("iolog init\n");
+			return false;
+		}
+	} else if (fprintf(f, "%s\n", iolog_ver3) < 0) {
+		/*
+		 * write our version line
+		 */
 		perror("iolog init\n");
 		return false;
 	}
@@ -811,7 +1381,10 @@ bool init_iolog(struct thread_data *td)
 		 * Check if it's a blktrace file and load that if possible.
 		 * Otherwise assume it's a normal log file and load that.
 		 */
-		if (is_blktrace(fname, &need_swap)) {
+		if (is_iolog_bin(fname)) {
+			td->io_log_blktrace = 0;
+			ret = init_iolog_bin_read(td, fname);
+		} else if (is_blktrace(fname, &need_swap)) {
 			td->io_log_blktrace = 1;
 			ret = init_blktrace_read(td, fname, need_swap);
 		} else {
@@ -832,6 +1405,109 @@ bool init_iolog(struct thread_data *td)
 	return ret;
 }
 
+/*
+ * Convert a text or blktrace iolog to the binary format. The source is
+ * read in chunks so that large traces don't need to fit in memory.
+ */
+int iolog_bin_convert(struct thread_data *td, const char *fname, FILE *out)
+{
+	struct iolog_bin_writer w;
+	struct io_piece *ipo;
+	/*
+	 * A zero time means there's no previous entry to delay_since_ttime(),
+	 * so start the clock at 1
+	 */
+	uint64_t time = 1;
+	int need_swap, ret = 1;
+	bool more;
+
+	if (is_iolog_bin(fname)) {
+		log_err("fio: %s is already a binary iolog\n", fname);
+		return 1;
+	}
+
+	INIT_FLIST_HEAD(&td->io_log_list);
+	td->o.read_iolog_chunked = 1;
+	if (is_blktrace(fname, &need_swap)) {
+		td->io_log_blktrace = 1;
+		more = init_blktrace_read(td, fname, need_swap);
+	} else
+		more = init_iolog_read(td, (char *) fname);
+
+	if (!more) {
+		log_err("fio: failed reading iolog %s\n", fname);
+		goto close;
+	}
+
+	if (iolog_bin_writer_init(&w, out))
+		goto close;
+
+	while (more) {
+		while (!flist_empty(&td->io_log_list)) {
+			struct fio_file *f = NULL;
+			uint64_t offset = 0;
+			uint32_t len = 0;
+			enum iolog_bin_act act;
+			const enum iolog_bin_act file_act[] = {
+				[FIO_LOG_ADD_FILE]	= IOLOG_BIN_ADD,
+				[FIO_LOG_OPEN_FILE]	= IOLOG_BIN_OPEN,
+				[FIO_LOG_CLOSE_FILE]	= IOLOG_BIN_CLOSE,
+			};
+
+			ipo = flist_first_entry(&td->io_log_list,
+						struct io_piece, list);
+			flist_del(&ipo->list);
+			remove_trim_entry(td, ipo);
+
+			if (ipo->ddir == DDIR_WAIT) {
+				act = IOLOG_BIN_WAIT;
+				offset = ipo->delay;
+			} else {
+				time += ipo->delay;
+				f = td->files[ipo->fileno];
+				if (ipo->ddir == DDIR_INVAL)
+					act = file_act[ipo->file_action];
+				else {
+					act = ddir_bin_act[ipo->ddir];
+					offset = ipo->offset;
+					len = ipo->len;
+				}
+			}
+			free(ipo);
+
+			if (f && iolog_bin_add_file(&w, f->fileno, f->file_name))
+				goto finish;
+			if (iolog_bin_write(&w, time, act, f ? f->fileno : 0,
+					    offset, len)) {
+				log_err("fio: failed writing binary iolog\n");
+				goto finish;
+			}
+		}
+
+		/*
+		 * Everything queued is written out, fetch the next chunk
+		 */
+		td->io_log_current = 0;
+		td->io_log_highmark = 0;
+		if (td->io_log_blktrace)
+			more = read_blktrace(td);
+		else
+			more = read_iolog(td);
+	}
+
+	ret = 0;
+finish:
+	if (iolog_bin_writer_finish(&w))
+		ret = 1;
+close:
+	if (td->io_log_rfile) {
+		iolog_fclose(td->io_log_rfile);
+		td->io_log_rfile = NULL;
+	}
+	iolog_text_read_close(td);
+	return ret;
+}
+
 void setup_log(struct io_log **log, struct log_params *p,
 	       const char *filename)
 {
@@ -849,19 +1525,38 @@ void setup_log(struct io_log **log, struct log_params *p,
 	l->log_issue_time = p->log_issue_time;
 	l->log_gz = p->log_gz;
 	l->log_gz_store = p->log_gz_store;
+	l->log_gz_type = p->log_gz_type;
+	l->log_format = p->log_format;
 	l->avg_msec = p->avg_msec;
 	l->hist_msec = p->hist_msec;
 	l->hist_coarseness = p->hist_coarseness;
 	l->filename = strdup(filename);
 	l->td = p->td;
 
+	/*
+	 * A histogram log snapshots the lat_histogram_precision= histogram
+	 * if the job has one, the fixed histogram otherwise. The coarseness
+	 * can't merge buckets across groups.
+	 */
+	if (l->log_type == IO_LOG_TYPE_HIST) {
+		unsigned int bits = FIO_IO_U_PLAT_BITS;
+
+		l->hist_nr = FIO_IO_U_PLAT_NR;
+		if (l->td && l->td->ts.hist_plat[FIO_CLAT]) {
+			l->hist_nr = lat_hist_nr(&l->td->ts);
+			bits = l->td->ts.hist_bits;
+		}
+		if (l->hist_coarseness > bits)
+			l->hist_coarseness = bits;
+	}
+
 	/* Initialize histogram lists for each r/w direction,
 	 * with initial io_u_plat of all zeros:
 	 */
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		list = &l->hist_window[i].list;
 		INIT_FLIST_HEAD(list);
-		entry = calloc(1, sizeof(struct io_u_plat_entry));
+		entry = calloc(1, io_u_plat_entry_sz(l->hist_nr));
 		flist_add(&entry->list, list);
 	}
 
@@ -902,6 +1597,17 @@ void setup_log(struct io_log **log, struct log_params *p,
 		p->td->flags |= TD_F_COMPRESS_LOG;
 	}
 
+	/*
+	 * Per I/O binary and columnar logs of jobs are streamed, see
+	 * log_stream.c
+	 */
+	if (l->log_format != LOG_FORMAT_TEXT && p->td && !l->avg_msec &&
+	    l->log_type != IO_LOG_TYPE_HIST) {
+		l->stream = true;
+		mutex_cond_init_pshared(&l->stream_lock, &l->stream_cond);
+		p->td->flags |= TD_F_STREAM_LOG;
+	}
+
 	*log = l;
 }
 
@@ -970,7 +1676,8 @@ uint64_t hist_sum(int j, int stride, uint64_t *io_u_plat,
 	return sum;
 }
 
-static void flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
+static void flush_hist_samples(FILE *f, int hist_coarseness,
+			       unsigned int hist_nr, void *samples,
 			       uint64_t sample_size)
 {
 	struct io_sample *s;
@@ -1002,12 +1709,12 @@ static void flush_hist_samples(FILE *f, int hist_coarseness, void *samples,
 
 		fprintf(f, "%lu, %u, %llu, ", (unsigned long) s->time,
 						io_sample_ddir(s), (unsigned long long) s->bs);
-		for (j = 0; j < FIO_IO_U_PLAT_NR - stride; j += stride) {
+		for (j = 0; j < hist_nr - stride; j += stride) {
 			fprintf(f, "%llu, ", (unsigned long long)
 			        hist_sum(j, stride, io_u_plat, io_u_plat_before));
 		}
 		fprintf(f, "%llu\n", (unsigned long long)
-		        hist_sum(FIO_IO_U_PLAT_NR - stride, stride, io_u_plat,
+		        hist_sum(hist_nr - stride, stride, io_u_plat,
 					io_u_plat_before));
 
 		flist_del(&entry_before->list);
@@ -1134,6 +1841,7 @@ static struct iolog_compress *get_new_chunk(unsigned int seq)
 	c->buf = malloc(GZ_CHUNK);
 	c->len = 0;
 	c->seq = seq;
+	c->type = LOG_COMP_ZLIB;
 	return c;
 }
 
@@ -1252,6 +1960,140 @@ static size_t inflate_chunk(struct iolog_compress *ic, int gz_hdr, FILE *f,
 	return ret;
 }
 
+static const char *log_comp_names[] = {
+	[LOG_COMP_ZLIB]	= "zlib",
+	[LOG_COMP_ZSTD]	= "zstd",
+	[LOG_COMP_LZ4]	= "lz4",
+};
+
+/*
+ * Tell the compressor of a chunk from the magic it starts with. zlib
+ * streams have no fixed magic, so anything else is taken to be one.
+ */
+static unsigned int log_comp_frame_type(const void *buf, size_t len)
+{
+	static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+	static const unsigned char lz4_magic[] = { 0x04, 0x22, 0x4d, 0x18 };
+
+	if (len >= sizeof(zstd_magic) &&
+	    !memcmp(buf, zstd_magic, sizeof(zstd_magic)))
+		return LOG_COMP_ZSTD;
+	if (len >= sizeof(lz4_magic) &&
+	    !memcmp(buf, lz4_magic, sizeof(lz4_magic)))
+		return LOG_COMP_LZ4;
+
+	return LOG_COMP_ZLIB;
+}
+
+#ifdef CONFIG_ZSTD
+static size_t inflate_zstd_frame(void *buf, size_t len, FILE *f)
+{
+	unsigned long long size;
+	size_t frame, ret;
+	void *out;
+
+	frame = ZSTD_findFrameCompressedSize(buf, len);
+	if (ZSTD_isError(frame)) {
+		log_err("fio: bad zstd log frame: %s\n",
+				ZSTD_getErrorName(frame));
+		return 0;
+	}
+
+	size = ZSTD_getFrameContentSize(buf, frame);
+	if (size == ZSTD_CONTENTSIZE_ERROR ||
+	    size == ZSTD_CONTENTSIZE_UNKNOWN) {
+		log_err("fio: zstd log frame without content size\n");
+		return 0;
+	}
+
+	out = malloc(size);
+	ret = ZSTD_decompress(out, size, buf, frame);
+	if (ZSTD_isError(ret) || ret != size) {
+		log_err("fio: failed inflating zstd log frame\n");
+		free(out);
+		return 0;
+	}
+
+	flush_samples(f, out, size);
+	free(out);
+	return frame;
+}
+#endif
+
+#ifdef CONFIG_LZ4
+static size_t inflate_lz4_frame(void *buf, size_t len, FILE *f)
+{
+	LZ4F_decompressionContext_t dctx;
+	LZ4F_frameInfo_t info;
+	size_t hint, in = len, done = 0;
+	void *out = NULL;
+
+	if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) {
+		log_err("fio: failed to init lz4 decompression\n");
+		return 0;
+	}
+
+	/*
+	 * On return, 'in' is the size of the frame header. Frames are written
+	 * with their content size, a zero one is an empty flush.
+	 */
+	hint = LZ4F_getFrameInfo(dctx, &info, buf, &in);
+	if (LZ4F_isError(hint)) {
+		log_err("fio: bad lz4 log frame\n");
+		goto err;
+	}
+
+	out = malloc(info.contentSize + 1);
+	while (hint) {
+		size_t dst = info.contentSize - done, src = len - in;
+
+		hint = LZ4F_decompress(dctx, out + done, &dst, buf + in, &src,
+					NULL);
+		if (LZ4F_isError(hint) || (hint && !dst && !src)) {
+			log_err("fio: failed inflating lz4 log frame\n");
+			goto err;
+		}
+		done += dst;
+		in += src;
+	}
+
+	flush_samples(f, out, done);
+	free(out);
+	LZ4F_freeDecompressionContext(dctx);
+	return in;
+err:
+	free(out);
+	LZ4F_freeDecompressionContext(dctx);
+	return 0;
+}
+#endif
+
+/*
+ * Inflate the zstd or lz4 frame at the start of buf and write out its
+ * samples. Returns the size of the frame, or 0 on error.
+ */
+static size_t inflate_frame(unsigned int type, void *buf, size_t len, FILE *f)
+{
+	dprint(FD_COMPRESS, "inflate %s frame, size=%lu\n",
+				log_comp_names[type], (unsigned long) len);
+
+	switch (type) {
+#ifdef CONFIG_ZSTD
+	case LOG_COMP_ZSTD:
+		return inflate_zstd_frame(buf, len, f);
+#endif
+#ifdef CONFIG_LZ4
+	case LOG_COMP_LZ4:
+		return inflate_lz4_frame(buf, len, f);
+#endif
+	default:
+		log_err("fio: log is %s compressed, but fio was built without "
+			"%s support\n", log_comp_names[type],
+			log_comp_names[type]);
+		return 0;
+	}
+}
+
 /*
  * Inflate stored compressed chunks, or write them directly to the log
  * file if so instructed.
@@ -1278,6 +2120,13 @@ static int inflate_gz_chunks(struct io_log *log, FILE *f)
 				iter.err = errno;
 				log_err("fio: error writing compressed log\n");
 			}
+		} else if (ic->type != LOG_COMP_ZLIB) {
+			if (iter.seq) {
+				finish_chunk(&stream, f, &iter);
+				iter.seq = 0;
+			}
+			if (!inflate_frame(ic->type, ic->buf, ic->len, f))
+				iter.err = EINVAL;
 		} else
 			inflate_chunk(ic, log->log_gz_store, f, &stream, &iter);
 
@@ -1343,13 +2192,26 @@ int iolog_file_inflate(const char *file)
 	 * Each chunk will return Z_STREAM_END. We don't know how many
 	 * chunks are in the file, so we just keep looping and incrementing
 	 * the sequence number until we have consumed the whole compressed
-	 * file.
+	 * file. zstd and lz4 chunks are single frames, recognized by their
+	 * magic.
 	 */
 	total = ic.len;
 	do {
+		unsigned int type = log_comp_frame_type(ic.buf, ic.len);
 		size_t iret;
 
-		iret = inflate_chunk(&ic,  1, stdout, &stream, &iter);
+		if (type != LOG_COMP_ZLIB) {
+			if (iter.seq) {
+				finish_chunk(&stream, stdout, &iter);
+				iter.seq = 0;
+			}
+			iret = inflate_frame(type, ic.buf, ic.len, stdout);
+			if (!iret) {
+				iter.err = EINVAL;
+				break;
+			}
+		} else
+			iret = inflate_chunk(&ic,  1, stdout, &stream, &iter);
 		total -= iret;
 		if (!total)
 			break;
@@ -1421,7 +2283,8 @@ void flush_log(struct io_log *log, bool do_append)
 		flist_del_init(&cur_log->list);
 		
 		if (log->td && log == log->td->clat_hist_log)
-			flush_hist_samples(f, log->hist_coarseness, cur_log->log,
+			flush_hist_samples(f, log->hist_coarseness, log->hist_nr,
+					   cur_log->log,
 			                   log_sample_sz(log, cur_log));
 		else
 			flush_samples(f, cur_log->log, log_sample_sz(log, cur_log));
@@ -1438,13 +2301,25 @@ static int finish_log(struct thread_data *td, struct io_log *log, int trylock)
 	if (td->flags & TD_F_COMPRESS_LOG)
 		iolog_flush(log);
 
+	/*
+	 * The log writer takes the lock of shared logs, let it finish first
+	 */
+	if (log->stream)
+		log_stream_wait(log);
+
 	if (trylock) {
 		if (fio_trylock_file(log->filename))
 			return 1;
 	} else
 		fio_lock_file(log->filename);
 
-	if (td->client_type == FIO_CLIENT_TYPE_GUI || is_backend)
+	/*
+	 * Binary and columnar logs are written where the job runs, also in
+	 * client/server mode, as streamed ones are already on disk
+	 */
+	if (log->log_format != LOG_FORMAT_TEXT)
+		log_stream_finish(log);
+	else if (td->client_type == FIO_CLIENT_TYPE_GUI || is_backend)
 		fio_send_iolog(td, log, log->filename);
 	else
 		flush_log(log, !td->o.per_job_logs);
@@ -1508,7 +2383,90 @@ static void iolog_free_deferred(struct io_log *log)
 	pthread_mutex_unlock(&log->deferred_free_lock);
 }
 
-static int gz_work(struct iolog_flush_data *data)
+/*
+ * zstd and lz4 compress a whole flush into a single frame, trimmed down to
+ * its compressed size
+ */
+static int frame_work(struct iolog_flush_data *data)
+{
+	struct io_log *log = data->log;
+	size_t in_len = data->nr_samples * log_entry_sz(log);
+	struct iolog_compress *c;
+	unsigned int seq;
+	size_t len = 0;
+
+	seq = ++log->chunk_seq;
+
+	dprint(FD_COMPRESS, "%s input size=%lu, seq=%u, log=%s\n",
+				log_comp_names[log->log_gz_type],
+				(unsigned long) in_len, seq, log->filename);
+
+	c = malloc(sizeof(*c));
+	INIT_FLIST_HEAD(&c->list);
+	c->buf = NULL;
+	c->seq = seq;
+	c->type = log->log_gz_type;
+
+	switch (log->log_gz_type) {
+#ifdef CONFIG_ZSTD
+	case LOG_COMP_ZSTD: {
+		size_t bound = ZSTD_compressBound(in_len);
+
+		c->buf = malloc(bound);
+		len = ZSTD_compress(c->buf, bound, data->samples, in_len, 1);
+		if (ZSTD_isError(len)) {
+			log_err("fio: zstd log compression: %s\n",
+					ZSTD_getErrorName(len));
+			goto err;
+		}
+		break;
+		}
+#endif
+#ifdef CONFIG_LZ4
+	case LOG_COMP_LZ4: {
+		LZ4F_preferences_t prefs = {
+			.frameInfo.contentSize = in_len,
+		};
+		size_t bound = LZ4F_compressFrameBound(in_len, &prefs);
+
+		c->buf = malloc(bound);
+		len = LZ4F_compressFrame(c->buf, bound, data->samples, in_len,
+						&prefs);
+		if (LZ4F_isError(len)) {
+			log_err("fio: lz4 log compression: %s\n",
+					LZ4F_getErrorName(len));
+			goto err;
+		}
+		break;
+		}
+#endif
+	default:
+		log_err("fio: unsupported log compression type %u\n",
+				log->log_gz_type);
+		goto err;
+	}
+
+	c->buf = realloc(c->buf, len);
+	c->len = len;
+	dprint(FD_COMPRESS, "compressed to size=%lu\n", (unsigned long) len);
+
+	iolog_put_deferred(log, data->samples);
+
+	pthread_mutex_lock(&log->chunk_lock);
+	flist_add_tail(&c->list, &log->chunk_list);
+	pthread_mutex_unlock(&log->chunk_lock);
+
+	if (data->free)
+		sfree(data);
+	return 0;
+err:
+	free_chunk(c);
+	if (data->free)
+		sfree(data);
+	return 1;
+}
+
+static int zlib_work(struct iolog_flush_data *data)
 {
 	struct iolog_compress *c = NULL;
 	struct flist_head list;
@@ -1623,6 +2581,14 @@ err:
 	goto done;
 }
 
+static int gz_work(struct iolog_flush_data *data)
+{
+	if (data->log->log_gz_type != LOG_COMP_ZLIB)
+		return frame_work(data);
+
+	return zlib_work(data);
+}
+
 /*
  * Invoked from our compress helper thread, when logging would have exceeded
  * the specified memory limitation. Compresses the previously stored
@@ -76,6 +76,11 @@ enum {
 
 #define DEF_LOG_ENTRIES		1024
 #define MAX_LOG_ENTRIES		(1024 * DEF_LOG_ENTRIES)
+/*
+ * Streamed logs are written out as their chunks fill, so they stop
+ * growing their chunks at this size
+ */
+#define STREAM_LOG_ENTRIES	(64 * DEF_LOG_ENTRIES)
 
 struct io_logs {
 	struct flist_head list;
@@ -138,6 +143,24 @@ struct io_log {
 	 */
 	unsigned int log_gz_store;
 
+	/*
+	 * Compressor used for chunks, LOG_COMP_*
+	 */
+	unsigned int log_gz_type;
+
+	/*
+	 * LOG_FORMAT_*. Binary and columnar per I/O logs are streamed: full
+	 * chunks are handed to the log writer thread, which appends them to
+	 * 'stream_f'. 'stream_inflight' counts the chunks it hasn't written
+	 * yet.
+	 */
+	unsigned int log_format;
+	bool stream;
+	FILE *stream_f;
+	unsigned int stream_inflight;
+	pthread_mutex_t stream_lock;
+	pthread_cond_t stream_cond;
+
 	/*
 	 * Windowed average, for logging single entries average over some
 	 * period of time.
@@ -154,6 +177,7 @@ struct io_log {
 	struct io_hist hist_window[DDIR_RWDIR_CNT];
 	unsigned long hist_msec;
 	unsigned int hist_coarseness;
+	unsigned int hist_nr;
 
 	pthread_mutex_t chunk_lock;
 	unsigned int chunk_seq;
@@ -296,6 +320,24 @@ extern size_t log_chunk_sizes(struct io_log *);
 extern int init_io_u_buffers(struct thread_data *);
 extern unsigned long long delay_since_ttime(const struct thread_data *,
 					     unsigned long long);
+extern bool iolog_sharded(struct thread_data *);
+extern bool iolog_shard_skip(struct thread_data *, enum fio_ddir, int,
+			     unsigned long long, unsigned long long *);
+
+/*
+ * Shared by the iolog readers to turn parsed entries into io_pieces
+ */
+struct iolog_read_state {
+	int reads, writes, trims, waits, syncs;
+	bool realloc;
+	int64_t items_to_fetch;
+};
+
+extern bool iolog_queue_entry(struct thread_data *, struct iolog_read_state *,
+			      enum fio_ddir, int, int, unsigned long long,
+			      unsigned int, unsigned long long);
+extern bool iolog_read_finish(struct thread_data *, struct iolog_read_state *);
+extern void iolog_text_read_close(struct thread_data *);
 
 #ifdef CONFIG_ZLIB
 extern int iolog_file_inflate(const char *);
@@ -315,6 +357,8 @@ struct log_params {
 	int log_issue_time;
 	int log_gz;
 	int log_gz_store;
+	int log_gz_type;
+	int log_format;
 	int log_compress;
 };
 
@@ -354,11 +398,24 @@ static inline void init_ipo(struct io_piece *ipo)
 	INIT_FLIST_HEAD(&ipo->trim_list);
 }
 
+/*
+ * Compressors for log_compression. zlib chunks of a flush share a stream,
+ * zstd and lz4 ones are each a standalone frame. Frames carry their own
+ * magic, so stored logs can be inflated chunk by chunk whatever mix of
+ * compressors wrote them.
+ */
+enum {
+	LOG_COMP_ZLIB = 0,
+	LOG_COMP_ZSTD,
+	LOG_COMP_LZ4,
+};
+
 struct iolog_compress {
 	struct flist_head list;
 	void *buf;
 	size_t len;
 	unsigned int seq;
+	unsigned int type;
 };
 
 #endif
@@ -0,0 +1,399 @@
+/*
+ * Binary iolog format: fixed size records that are mapped and turned into
+ * io_pieces without any text parsing, see iolog_bin.h for the layout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fio.h"
+#include "iolog_bin.h"
+#include "iolog_decomp.h"
+
+static const enum fio_ddir act_ddir[IOLOG_BIN_ACT_NR] = {
+	[IOLOG_BIN_READ]	= DDIR_READ,
+	[IOLOG_BIN_WRITE]	= DDIR_WRITE,
+	[IOLOG_BIN_TRIM]	= DDIR_TRIM,
+	[IOLOG_BIN_SYNC]	= DDIR_SYNC,
+	[IOLOG_BIN_DATASYNC]	= DDIR_DATASYNC,
+	[IOLOG_BIN_WAIT]	= DDIR_WAIT,
+	[IOLOG_BIN_ADD]		= DDIR_INVAL,
+	[IOLOG_BIN_OPEN]	= DDIR_INVAL,
+	[IOLOG_BIN_CLOSE]	= DDIR_INVAL,
+};
+
+bool is_iolog_bin(const char *filename)
+{
+	char magic[IOLOG_BIN_MAGIC_LEN];
+	ssize_t ret;
+
+	ret = iolog_peek(filename, magic, sizeof(magic));
+	return ret == sizeof(magic) &&
+		!memcmp(magic, IOLOG_BIN_MAGIC, IOLOG_BIN_MAGIC_LEN);
+}
+
+static void free_reader(struct iolog_bin_reader *r)
+{
+	unsigned int i;
+
+	for (i = 0; i < r->nr_files; i++)
+		free(r->files[i]);
+	free(r->files);
+	free(r->fileno_map);
+	if (r->map)
+		munmap(r->map, r->map_size);
+	free(r);
+}
+
+void iolog_bin_read_close(struct thread_data *td)
+{
+	if (!td->io_log_bin)
+		return;
+
+	free_reader(td->io_log_bin);
+	td->io_log_bin = NULL;
+}
+
+static int bin_bad(const char *filename, const char *what)
+{
+	log_err("fio: %s: bad binary iolog, %s\n", filename, what);
+	return 1;
+}
+
+/*
+ * Check the head and tail and load the file table
+ */
+static int setup_reader(struct iolog_bin_reader *r, const char *filename)
+{
+	const struct iolog_bin_head *head = r->map;
+	const struct iolog_bin_tail *tail;
+	uint64_t recs_end, files_off, tail_off;
+	const char *p;
+	unsigned int i;
+
+	if (r->map_size < sizeof(*head) + sizeof(*tail))
+		return bin_bad(filename, "file too short");
+
+	tail_off = r->map_size - sizeof(*tail);
+	tail = r->map + tail_off;
+
+	if (memcmp(head->magic, IOLOG_BIN_MAGIC, IOLOG_BIN_MAGIC_LEN) ||
+	    memcmp(tail->magic, IOLOG_BIN_MAGIC, IOLOG_BIN_MAGIC_LEN))
+		return bin_bad(filename, "truncated or no magic");
+	if (le32_to_cpu(head->version) != IOLOG_BIN_VERSION)
+		return bin_bad(filename, "unknown version");
+	if (le32_to_cpu(head->rec_size) != sizeof(struct iolog_bin_rec))
+		return bin_bad(filename, "unexpected record size");
+
+	r->nr_records = le64_to_cpu(tail->nr_records);
+	r->nr_files = le32_to_cpu(tail->nr_files);
+	files_off = le64_to_cpu(tail->files_off);
+
+	recs_end = sizeof(*head) + r->nr_records * sizeof(struct iolog_bin_rec);
+	if (r->nr_records > tail_off / sizeof(struct iolog_bin_rec) ||
+	    recs_end > files_off || files_off > tail_off)
+		return bin_bad(filename, "offsets out of range");
+
+	r->recs = r->map + sizeof(*head);
+
+	r->files = calloc(r->nr_files, sizeof(char *));
+	r->fileno_map = malloc(r->nr_files * sizeof(int));
+	if (r->nr_files && (!r->files || !r->fileno_map))
+		return 1;
+
+	p = r->map + files_off;
+	for (i = 0; i < r->nr_files; i++) {
+		uint32_t len;
+
+		if (p + sizeof(len) > (const char *) r->map + tail_off)
+			return bin_bad(filename, "file table out of range");
+		len = le32_to_cpu(*(const uint32_t *) p);
+		p += sizeof(len);
+		if (p + len > (const char *) r->map + tail_off)
+			return bin_bad(filename, "file name out of range");
+
+		r->files[i] = strndup(p, len);
+		if (!r->files[i])
+			return 1;
+		r->fileno_map[i] = -1;
+		p += (len + sizeof(len) + 7) / 8 * 8 - sizeof(len);
+	}
+
+	return 0;
+}
+
+/*
+ * Map a binary iolog and queue its first (or only) batch of io_pieces
+ */
+bool init_iolog_bin_read(struct thread_data *td, const char *filename)
+{
+	struct iolog_bin_reader *r;
+	struct stat sb;
+	int fd;
+
+	/*
+	 * The log is mapped, so it has to be stored uncompressed
+	 */
+	if (iolog_compression(filename) != IOLOG_COMP_NONE) {
+		log_err("fio: %s: compressed binary iologs must be "
+			"decompressed first\n", filename);
+		return false;
+	}
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		td_verror(td, errno, "open binary iolog");
+		return false;
+	}
+	if (fstat(fd, &sb) < 0) {
+		td_verror(td, errno, "stat binary iolog");
+		close(fd);
+		return false;
+	}
+
+	r = calloc(1, sizeof(*r));
+	r->map_size = sb.st_size;
+	r->map = mmap(NULL, r->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (r->map == MAP_FAILED) {
+		td_verror(td, errno, "mmap binary iolog");
+		r->map = NULL;
+		free_reader(r);
+		return false;
+	}
+
+	if (setup_reader(r, filename)) {
+		free_reader(r);
+		return false;
+	}
+
+	posix_madvise(r->map, r->map_size, POSIX_MADV_SEQUENTIAL);
+
+	free_release_files(td);
+	td->io_log_bin = r;
+	td->io_log_last_ttime = 0;
+	return read_iolog_bin(td);
+}
+
+/*
+ * Resolve a file table entry to a file of this job, remembering the
+ * result so that IO records don't need a lookup by name.
+ */
+static int bin_fileno(struct thread_data *td, struct iolog_bin_reader *r,
+		      unsigned int idx)
+{
+	const char *fname = td->o.replay_redirect ?: r->files[idx];
+
+	if (r->fileno_map[idx] == -1)
+		r->fileno_map[idx] = get_fileno(td, fname);
+
+	return r->fileno_map[idx];
+}
+
+bool read_iolog_bin(struct thread_data *td)
+{
+	struct iolog_bin_reader *r = td->io_log_bin;
+	struct iolog_read_state st = { };
+	bool read_all = !td->o.read_iolog_chunked;
+	bool ret;
+
+	if (td->o.read_iolog_chunked) {
+		st.items_to_fetch = iolog_items_to_fetch(td);
+		if (!st.items_to_fetch)
+			return true;
+	}
+
+	while (r->cur < r->nr_records) {
+		const struct iolog_bin_rec *rec = &r->recs[r->cur++];
+		unsigned int idx = le16_to_cpu(rec->fileno);
+		unsigned long long time = le64_to_cpu(rec->time);
+		unsigned long long delay;
+		int fileno, file_action = 0;
+		enum fio_ddir rw;
+
+		if (rec->act >= IOLOG_BIN_ACT_NR ||
+		    (rec->act != IOLOG_BIN_WAIT && idx >= r->nr_files)) {
+			log_err("fio: bad binary iolog record %llu\n",
+				(unsigned long long) r->cur - 1);
+			continue;
+		}
+
+		delay = delay_since_ttime(td, time);
+		td->io_log_last_ttime = time;
+
+		rw = act_ddir[rec->act];
+		if (ddir_rw(rw) || ddir_sync(rw)) {
+			if (td->o.replay_skip & (1u << rw))
+				continue;
+		}
+
+		switch (rec->act) {
+		case IOLOG_BIN_ADD:
+			if (td->o.replay_redirect &&
+			    bin_fileno(td, r, idx) != -1) {
+				dprint(FD_FILE, "iolog: ignoring re-add of "
+					"file %s\n", td->o.replay_redirect);
+				continue;
+			}
+			fileno = add_file(td, td->o.replay_redirect ?:
+					  r->files[idx], iolog_sharded(td) ? 0 :
+					  td->subjob_number, 1);
+			r->fileno_map[idx] = fileno;
+			file_action = FIO_LOG_ADD_FILE;
+			break;
+		case IOLOG_BIN_OPEN:
+			fileno = bin_fileno(td, r, idx);
+			file_action = FIO_LOG_OPEN_FILE;
+			break;
+		case IOLOG_BIN_CLOSE:
+			fileno = bin_fileno(td, r, idx);
+			file_action = FIO_LOG_CLOSE_FILE;
+			break;
+		case IOLOG_BIN_WAIT:
+			fileno = 0;
+			break;
+		default:
+			fileno = bin_fileno(td, r, idx);
+			break;
+		}
+
+		if (fileno == -1) {
+			log_err("fio: binary iolog refers to unknown file %s\n",
+				r->files[idx]);
+			continue;
+		}
+
+		if (iolog_queue_entry(td, &st, rw, fileno, file_action,
+				      le64_to_cpu(rec->offset),
+				      le32_to_cpu(rec->len), delay))
+			break;
+	}
+
+	ret = iolog_read_finish(td, &st);
+
+	/*
+	 * Everything is queued up already, the mapping isn't needed anymore
+	 */
+	if (read_all)
+		iolog_bin_read_close(td);
+
+	return ret;
+}
+
+int iolog_bin_writer_init(struct iolog_bin_writer *w, FILE *f)
+{
+	struct iolog_bin_head head = {
+		.version	= cpu_to_le32((uint32_t) IOLOG_BIN_VERSION),
+		.rec_size	= cpu_to_le32((uint32_t) sizeof(struct iolog_bin_rec)),
+	};
+
+	memset(w, 0, sizeof(*w));
+	w->f = f;
+
+	memcpy(head.magic, IOLOG_BIN_MAGIC, IOLOG_BIN_MAGIC_LEN);
+	if (fwrite(&head, sizeof(head), 1, f) != 1)
+		return 1;
+
+	w->off = sizeof(head);
+	return 0;
+}
+
+/*
+ * Note the name of file @fileno for the file table, if not already known
+ */
+int iolog_bin_add_file(struct iolog_bin_writer *w, unsigned int fileno,
+		       const char *name)
+{
+	if (fileno > UINT16_MAX) {
+		log_err("fio: binary iolog supports at most %u files\n",
+			UINT16_MAX + 1);
+		return 1;
+	}
+
+	if (fileno >= w->nr_files) {
+		char **files;
+
+		files = realloc(w->files, (fileno + 1) * sizeof(char *));
+		if (!files)
+			return 1;
+		memset(&files[w->nr_files], 0,
+			(fileno + 1 - w->nr_files) * sizeof(char *));
+		w->files = files;
+		w->nr_files = fileno + 1;
+	}
+
+	if (!w->files[fileno]) {
+		w->files[fileno] = strdup(name);
+		if (!w->files[fileno])
+			return 1;
+	}
+
+	return 0;
+}
+
+int iolog_bin_write(struct iolog_bin_writer *w, uint64_t time,
+		    enum iolog_bin_act act, unsigned int fileno,
+		    uint64_t offset, uint32_t len)
+{
+	struct iolog_bin_rec rec = {
+		.time	= cpu_to_le64(time),
+		.offset	= cpu_to_le64(offset),
+		.len	= cpu_to_le32(len),
+		.fileno	= cpu_to_le16((uint16_t) fileno),
+		.act	= act,
+	};
+
+	if (fwrite(&rec, sizeof(rec), 1, w->f) != 1)
+		return 1;
+
+	w->nr_records++;
+	w->off += sizeof(rec);
+	return 0;
+}
+
+/*
+ * Write out the file table and tail and free the writer state.
+ * The FILE itself is left to the caller.
+ */
+int iolog_bin_writer_finish(struct iolog_bin_writer *w)
+{
+	static const char zero[8];
+	struct iolog_bin_tail tail = { };
+	unsigned int i;
+	int ret = 1;
+
+	tail.nr_records = cpu_to_le64(w->nr_records);
+	tail.files_off = cpu_to_le64(w->off);
+	tail.nr_files = cpu_to_le32(w->nr_files);
+
+	for (i = 0; i < w->nr_files; i++) {
+		const char *name = w->files[i] ?: "";
+		uint32_t len = strlen(name);
+		uint32_t le_len = cpu_to_le32(len);
+		size_t pad = (len + sizeof(len) + 7) / 8 * 8 - len - sizeof(len);
+
+		if (fwrite(&le_len, sizeof(le_len), 1, w->f) != 1 ||
+		    (len && fwrite(name, len, 1, w->f) != 1) ||
+		    (pad && fwrite(zero, pad, 1, w->f) != 1))
+			goto out;
+		w->off += sizeof(len) + len + pad;
+	}
+
+	memcpy(tail.magic, IOLOG_BIN_MAGIC, IOLOG_BIN_MAGIC_LEN);
+	if (fwrite(&tail, sizeof(tail), 1, w->f) != 1)
+		goto out;
+
+	ret = 0;
+out:
+	for (i = 0; i < w->nr_files; i++)
+		free(w->files[i]);
+	free(w->files);
+	w->files = NULL;
+	w->nr_files = 0;
+	return ret;
+}
@@ -0,0 +1,107 @@
+#ifndef FIO_IOLOG_BIN_H
+#define FIO_IOLOG_BIN_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * Binary iolog format. All fields are little endian.
+ *
+ *	struct iolog_bin_head
+ *	struct iolog_bin_rec		x nr_records
+ *	file table			x nr_files, each a uint32_t name
+ *					length followed by the name, padded
+ *					to 8 bytes
+ *	struct iolog_bin_tail
+ *
+ * Everything that's only known once all records are written lives in the
+ * tail, so a log can be produced in one pass to a pipe. Records have the
+ * version 3 semantics: 'time' is usec since the start of the log, for
+ * IOLOG_BIN_WAIT 'offset' holds the wait time in msec.
+ */
+#define IOLOG_BIN_MAGIC		"fio binary iolog"
+#define IOLOG_BIN_MAGIC_LEN	16
+#define IOLOG_BIN_VERSION	1
+
+enum iolog_bin_act {
+	IOLOG_BIN_READ		= 0,
+	IOLOG_BIN_WRITE,
+	IOLOG_BIN_TRIM,
+	IOLOG_BIN_SYNC,
+	IOLOG_BIN_DATASYNC,
+	IOLOG_BIN_WAIT,
+	IOLOG_BIN_ADD,
+	IOLOG_BIN_OPEN,
+	IOLOG_BIN_CLOSE,
+	IOLOG_BIN_ACT_NR,
+};
+
+struct iolog_bin_head {
+	char magic[IOLOG_BIN_MAGIC_LEN];
+	uint32_t version;
+	uint32_t rec_size;
+};
+
+struct iolog_bin_rec {
+	uint64_t time;
+	uint64_t offset;
+	uint32_t len;
+	uint16_t fileno;
+	uint8_t act;
+	uint8_t pad;
+};
+
+struct iolog_bin_tail {
+	uint64_t nr_records;
+	uint64_t files_off;
+	uint32_t nr_files;
+	uint32_t pad;
+	char magic[IOLOG_BIN_MAGIC_LEN];
+};
+
+/*
+ * Writer side state, for write_iolog_format=binary and the converter
+ */
+struct iolog_bin_writer {
+	FILE *f;
+	uint64_t nr_records;
+	uint64_t off;
+
+	char **files;
+	unsigned int nr_files;
+};
+
+/*
+ * Reader side state, the log is mapped in full
+ */
+struct iolog_bin_reader {
+	void *map;
+	size_t map_size;
+	const struct iolog_bin_rec *recs;
+	uint64_t nr_records;
+	uint64_t cur;
+
+	char **files;
+	int *fileno_map;
+	unsigned int nr_files;
+};
+
+struct thread_data;
+
+extern bool is_iolog_bin(const char *);
+extern bool init_iolog_bin_read(struct thread_data *, const char *);
+extern bool read_iolog_bin(struct thread_data *);
+extern void iolog_bin_read_close(struct thread_data *);
+
+extern int iolog_bin_writer_init(struct iolog_bin_writer *, FILE *);
+extern int iolog_bin_add_file(struct iolog_bin_writer *, unsigned int,
+			      const char *);
+extern int iolog_bin_write(struct iolog_bin_writer *, uint64_t,
+			   enum iolog_bin_act, unsigned int, uint64_t,
+			   uint32_t);
+extern int iolog_bin_writer_finish(struct iolog_bin_writer *);
+
+extern int iolog_bin_convert(struct thread_data *, const char *, FILE *);
+
+#endif
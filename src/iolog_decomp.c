@@ -0,0 +1,558 @@
+/*
+ * Transparent decompression of gzip and zstd compressed replay input, text
+ * iologs and blktraces alike, so archived traces can be replayed without
+ * first inflating them to scratch storage.
+ *
+ * A compressed file is handed to the caller as the read end of a socket
+ * pair. A detached thread inflates the file into the other end, so it
+ * keeps up to its output chunk plus the socket buffer decompressed ahead
+ * of the replay cursor. When the reader closes its end early, the next
+ * send fails and the thread cleans up after itself.
+ *
+ * A socket can't carry an error, so a truncated or corrupt file would look
+ * like a short one to the reader. The thread records why it stopped before
+ * closing its end, readers check iolog_ferror() when they hit the end of
+ * the stream and close it with iolog_fclose().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#ifdef CONFIG_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+
+#include "fio.h"
+#include "flist.h"
+#include "iolog_decomp.h"
+
+#define DECOMP_IN_SZ	(256 * 1024)
+#define DECOMP_OUT_SZ	(1024 * 1024)
+#define DECOMP_SOCK_SZ	(4 * 1024 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL	0
+#endif
+
+static const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+struct decomp {
+	enum iolog_comp type;
+	int fd;
+	int sock;
+	unsigned char *in;
+	size_t in_len;
+	size_t in_pos;
+	bool in_eof;
+	unsigned char *out;
+#ifdef CONFIG_ZLIB
+	z_stream zs;
+	bool gz_member;
+#endif
+#ifdef CONFIG_ZSTD
+	ZSTD_DStream *zds;
+	size_t zstd_hint;
+#endif
+
+	/*
+	 * Streams handed out by iolog_fopen(), protected by decomp_lock.
+	 * Both the reader and the thread hold a reference.
+	 */
+	struct flist_head list;
+	FILE *f;
+	int err;
+	int refs;
+};
+
+static FLIST_HEAD(decomp_list);
+static pthread_mutex_t decomp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Returns the compression of a file, judged by its magic
+ */
+enum iolog_comp iolog_compression(const char *fname)
+{
+	unsigned char magic[4];
+	int fd, ret;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return IOLOG_COMP_NONE;
+
+	ret = read(fd, magic, sizeof(magic));
+	close(fd);
+
+	if (ret >= (int) sizeof(gzip_magic) &&
+	    !memcmp(magic, gzip_magic, sizeof(gzip_magic)))
+		return IOLOG_COMP_GZIP;
+	if (ret >= (int) sizeof(zstd_magic) &&
+	    !memcmp(magic, zstd_magic, sizeof(zstd_magic)))
+		return IOLOG_COMP_ZSTD;
+
+	return IOLOG_COMP_NONE;
+}
+
+static bool comp_supported(enum iolog_comp type)
+{
+	switch (type) {
+#ifdef CONFIG_ZLIB
+	case IOLOG_COMP_GZIP:
+		return true;
+#endif
+#ifdef CONFIG_ZSTD
+	case IOLOG_COMP_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/*
+ * Release the decompressor, the input and the sending end of the socket
+ */
+static void decomp_release(struct decomp *d)
+{
+#ifdef CONFIG_ZLIB
+	if (d->type == IOLOG_COMP_GZIP)
+		inflateEnd(&d->zs);
+#endif
+#ifdef CONFIG_ZSTD
+	if (d->zds)
+		ZSTD_freeDStream(d->zds);
+	d->zds = NULL;
+#endif
+	d->type = IOLOG_COMP_NONE;
+	if (d->fd != -1)
+		close(d->fd);
+	d->fd = -1;
+	if (d->sock != -1)
+		close(d->sock);
+	d->sock = -1;
+	free(d->in);
+	d->in = NULL;
+	free(d->out);
+	d->out = NULL;
+}
+
+static void decomp_free(struct decomp *d)
+{
+	decomp_release(d);
+	free(d);
+}
+
+static void decomp_put(struct decomp *d)
+{
+	bool last;
+
+	pthread_mutex_lock(&decomp_lock);
+	last = !--d->refs;
+	pthread_mutex_unlock(&decomp_lock);
+
+	if (last)
+		decomp_free(d);
+}
+
+static struct decomp *decomp_open(const char *fname, enum iolog_comp type)
+{
+	struct decomp *d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+	INIT_FLIST_HEAD(&d->list);
+	d->type = type;
+	d->sock = -1;
+	d->fd = open(fname, O_RDONLY);
+	if (d->fd < 0) {
+		log_err("fio: open %s: %s\n", fname, strerror(errno));
+		goto err;
+	}
+
+	switch (type) {
+	case IOLOG_COMP_GZIP:
+#ifdef CONFIG_ZLIB
+		/* 32 + 15: gzip header, maximum window */
+		if (inflateInit2(&d->zs, 32 + 15) != Z_OK) {
+			log_err("fio: failed to initialize inflate\n");
+			goto err;
+		}
+		break;
+#else
+		log_err("fio: %s is gzip compressed, but fio was built without "
+			"zlib support\n", fname);
+		goto err;
+#endif
+	case IOLOG_COMP_ZSTD:
+#ifdef CONFIG_ZSTD
+		d->zds = ZSTD_createDStream();
+		if (!d->zds) {
+			log_err("fio: failed to initialize zstd\n");
+			goto err;
+		}
+		break;
+#else
+		log_err("fio: %s is zstd compressed, but fio was built without "
+			"zstd support\n", fname);
+		goto err;
+#endif
+	default:
+		goto err;
+	}
+
+	d->in = malloc(DECOMP_IN_SZ);
+	if (!d->in)
+		goto err;
+	return d;
+err:
+	d->type = IOLOG_COMP_NONE;
+	decomp_free(d);
+	return NULL;
+}
+
+static int decomp_fill(struct decomp *d)
+{
+	ssize_t ret;
+
+	if (d->in_pos < d->in_len || d->in_eof)
+		return 0;
+
+	do {
+		ret = read(d->fd, d->in, DECOMP_IN_SZ);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		log_err("fio: read compressed input: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	if (!ret)
+		d->in_eof = true;
+	d->in_len = ret;
+	d->in_pos = 0;
+	return 0;
+}
+
+#ifdef CONFIG_ZLIB
+static ssize_t gzip_read(struct decomp *d, void *buf, size_t len)
+{
+	z_stream *zs = &d->zs;
+
+	zs->next_out = buf;
+	zs->avail_out = len;
+	while (zs->avail_out) {
+		unsigned int avail_out = zs->avail_out;
+		int ret;
+
+		if (decomp_fill(d))
+			return -EIO;
+
+		zs->next_in = d->in + d->in_pos;
+		zs->avail_in = d->in_len - d->in_pos;
+		if (zs->avail_in)
+			d->gz_member = true;
+		ret = inflate(zs, Z_NO_FLUSH);
+		d->in_pos = d->in_len - zs->avail_in;
+
+		/*
+		 * Keep going past the end of a member, parallel compressors
+		 * write files made of many concatenated ones
+		 */
+		if (ret == Z_STREAM_END) {
+			inflateReset(zs);
+			d->gz_member = false;
+		} else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			log_err("fio: inflate error %d\n", ret);
+			return -EIO;
+		}
+
+		if (d->in_eof && d->in_pos == d->in_len &&
+		    zs->avail_out == avail_out) {
+			if (d->gz_member) {
+				log_err("fio: gzip input is truncated\n");
+				return -EIO;
+			}
+			break;
+		}
+	}
+
+	return len - zs->avail_out;
+}
+#endif
+
+#ifdef CONFIG_ZSTD
+static ssize_t zstd_read(struct decomp *d, void *buf, size_t len)
+{
+	ZSTD_outBuffer out = { .dst = buf, .size = len, .pos = 0 };
+
+	while (out.pos < out.size) {
+		ZSTD_inBuffer in;
+		size_t pos = out.pos;
+		size_t ret;
+
+		if (decomp_fill(d))
+			return -EIO;
+
+		in.src = d->in;
+		in.size = d->in_len;
+		in.pos = d->in_pos;
+		ret = ZSTD_decompressStream(d->zds, &out, &in);
+		if (ZSTD_isError(ret)) {
+			log_err("fio: zstd error: %s\n", ZSTD_getErrorName(ret));
+			return -EIO;
+		}
+
+		/*
+		 * The return is 0 once a frame is fully decoded and flushed.
+		 * A call that made no progress only asks for the next header.
+		 */
+		if (in.pos != d->in_pos || out.pos != pos)
+			d->zstd_hint = ret;
+		d->in_pos = in.pos;
+
+		if (d->in_eof && d->in_pos == d->in_len && out.pos == pos) {
+			if (d->zstd_hint) {
+				log_err("fio: zstd input is truncated\n");
+				return -EIO;
+			}
+			break;
+		}
+	}
+
+	return out.pos;
+}
+#endif
+
+/*
+ * Decompress up to len bytes into buf. Returns the number of bytes stored,
+ * which is only short at the end of the input, or a negative error.
+ */
+static ssize_t decomp_read(struct decomp *d, void *buf, size_t len)
+{
+	switch (d->type) {
+#ifdef CONFIG_ZLIB
+	case IOLOG_COMP_GZIP:
+		return gzip_read(d, buf, len);
+#endif
+#ifdef CONFIG_ZSTD
+	case IOLOG_COMP_ZSTD:
+		return zstd_read(d, buf, len);
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Read the first len bytes of the contents of a file, decompressing it if
+ * needed. Used to check the magic of a log before picking its parser.
+ */
+ssize_t iolog_peek(const char *fname, void *buf, size_t len)
+{
+	enum iolog_comp type = iolog_compression(fname);
+	struct decomp *d;
+	ssize_t ret;
+	int fd;
+
+	if (type == IOLOG_COMP_NONE) {
+		fd = open(fname, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+		ret = read(fd, buf, len);
+		if (ret < 0)
+			ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	/*
+	 * Opening the log proper reports missing support
+	 */
+	if (!comp_supported(type))
+		return -EINVAL;
+
+	d = decomp_open(fname, type);
+	if (!d)
+		return -EINVAL;
+
+	ret = decomp_read(d, buf, len);
+	decomp_free(d);
+	return ret;
+}
+
+static void *decomp_thread(void *data)
+{
+	struct decomp *d = data;
+	ssize_t ret;
+
+	while ((ret = decomp_read(d, d->out, DECOMP_OUT_SZ)) > 0) {
+		unsigned char *p = d->out;
+
+		while (ret) {
+			ssize_t sent = send(d->sock, p, ret, MSG_NOSIGNAL);
+
+			if (sent < 0) {
+				if (errno == EINTR)
+					continue;
+				/* the reader is gone */
+				goto done;
+			}
+			p += sent;
+			ret -= sent;
+		}
+	}
+done:
+	/*
+	 * Record the error before closing the socket, so a reader that
+	 * sees the end of the stream also sees why it ended
+	 */
+	if (ret < 0) {
+		pthread_mutex_lock(&decomp_lock);
+		d->err = -ret;
+		pthread_mutex_unlock(&decomp_lock);
+	}
+	decomp_release(d);
+	decomp_put(d);
+	return NULL;
+}
+
+static struct decomp *decomp_find(FILE *f)
+{
+	struct flist_head *n;
+
+	flist_for_each(n, &decomp_list) {
+		struct decomp *d = flist_entry(n, struct decomp, list);
+
+		if (d->f == f)
+			return d;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the error that stopped decompression of a stream from
+ * iolog_fopen(), or 0. Only meaningful once the stream has hit its end.
+ */
+int iolog_ferror(FILE *f)
+{
+	struct decomp *d;
+	int err = 0;
+
+	pthread_mutex_lock(&decomp_lock);
+	d = decomp_find(f);
+	if (d)
+		err = d->err;
+	pthread_mutex_unlock(&decomp_lock);
+
+	return err;
+}
+
+/*
+ * Close a stream returned by iolog_fopen()
+ */
+int iolog_fclose(FILE *f)
+{
+	struct decomp *d;
+
+	pthread_mutex_lock(&decomp_lock);
+	d = decomp_find(f);
+	if (d)
+		flist_del_init(&d->list);
+	pthread_mutex_unlock(&decomp_lock);
+
+	if (d)
+		decomp_put(d);
+
+	return fclose(f);
+}
+
+/*
+ * Open a replay log for reading. Plain files are opened as they are,
+ * compressed ones return a stream of their decompressed contents that
+ * supports reading but not seeking.
+ */
+FILE *iolog_fopen(const char *fname)
+{
+	enum iolog_comp type = iolog_compression(fname);
+	struct decomp *d;
+	pthread_t thread;
+	int sv[2], sz = DECOMP_SOCK_SZ;
+	FILE *f;
+
+	if (type == IOLOG_COMP_NONE)
+		return fopen(fname, "rb");
+
+	d = decomp_open(fname, type);
+	if (!d) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+#ifdef WIN32
+	log_err("fio: compressed replay input isn't supported on Windows\n");
+	decomp_free(d);
+	errno = EINVAL;
+	return NULL;
+#else
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		log_err("fio: socketpair: %s\n", strerror(errno));
+		decomp_free(d);
+		return NULL;
+	}
+
+	/*
+	 * Best effort, the kernel caps this at its maximum socket buffer
+	 */
+	setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+	setsockopt(sv[0], SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+#ifdef SO_NOSIGPIPE
+	sz = 1;
+	setsockopt(sv[1], SOL_SOCKET, SO_NOSIGPIPE, &sz, sizeof(sz));
+#endif
+
+	f = fdopen(sv[0], "rb");
+	if (!f) {
+		close(sv[0]);
+		close(sv[1]);
+		decomp_free(d);
+		return NULL;
+	}
+
+	d->sock = sv[1];
+	d->out = malloc(DECOMP_OUT_SZ);
+	if (!d->out) {
+		fclose(f);
+		decomp_free(d);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	d->f = f;
+	d->refs = 2;
+	pthread_mutex_lock(&decomp_lock);
+	flist_add_tail(&d->list, &decomp_list);
+	pthread_mutex_unlock(&decomp_lock);
+
+	if (pthread_create(&thread, NULL, decomp_thread, d)) {
+		log_err("fio: failed to start decompression thread\n");
+		pthread_mutex_lock(&decomp_lock);
+		flist_del(&d->list);
+		pthread_mutex_unlock(&decomp_lock);
+		fclose(f);
+		decomp_free(d);
+		return NULL;
+	}
+	pthread_detach(thread);
+
+	return f;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef FIO_IOLOG_DECOMP_H
+#define FIO_IOLOG_DECOMP_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+enum iolog_comp {
+	IOLOG_COMP_NONE = 0,
+	IOLOG_COMP_GZIP,
+	IOLOG_COMP_ZSTD,
+};
+
+extern enum iolog_comp iolog_compression(const char *);
+extern ssize_t iolog_peek(const char *, void *, size_t);
+extern FILE *iolog_fopen(const char *);
+extern int iolog_ferror(FILE *);
+extern int iolog_fclose(FILE *);
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Sparse bitmap for remembering an arbitrary set of block numbers, for
+ * instance the blocks written by a job that later need to be verified.
+ *
+ * The bit space is cut into chunks of CHUNK_BITS bits. A chunk without any
+ * bits set takes no memory, a chunk with all of its bits set is collapsed
+ * into the FULL_CHUNK marker, and only partially set chunks carry a real
+ * bitmap. Writing a device sequentially or through a random map leaves
+ * mostly full chunks behind, and draining the map in order keeps at most a
+ * few chunks expanded at any time. The worst case, every other block
+ * written, costs slightly more than one bit per block.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "blockmap.h"
+#include "ffz.h"
+
+#define CHUNK_SHIFT	16
+#define CHUNK_BITS	(1U << CHUNK_SHIFT)
+#define CHUNK_MASK	(CHUNK_BITS - 1)
+#define CHUNK_WORDS	(CHUNK_BITS / 64)
+
+#define FULL_CHUNK	((uint64_t *) 1)
+
+struct blockmap {
+	uint64_t **chunks;
+	uint32_t *weight;
+	uint64_t nr_chunks;
+	uint64_t nr_set;
+};
+
+struct blockmap *blockmap_new(void)
+{
+	return calloc(1, sizeof(struct blockmap));
+}
+
+static void free_chunks(struct blockmap *bm)
+{
+	uint64_t i;
+
+	for (i = 0; i < bm->nr_chunks; i++)
+		if (bm->chunks[i] != FULL_CHUNK)
+			free(bm->chunks[i]);
+}
+
+void blockmap_free(struct blockmap *bm)
+{
+	if (!bm)
+		return;
+
+	free_chunks(bm);
+	free(bm->chunks);
+	free(bm->weight);
+	free(bm);
+}
+
+void blockmap_reset(struct blockmap *bm)
+{
+	free_chunks(bm);
+	memset(bm->chunks, 0, bm->nr_chunks * sizeof(uint64_t *));
+	memset(bm->weight, 0, bm->nr_chunks * sizeof(uint32_t));
+	bm->nr_set = 0;
+}
+
+static int blockmap_grow(struct blockmap *bm, uint64_t chunk)
+{
+	uint64_t nr = bm->nr_chunks ? bm->nr_chunks : 16;
+	uint64_t **chunks;
+	uint32_t *weight;
+
+	while (nr <= chunk)
+		nr *= 2;
+
+	chunks = realloc(bm->chunks, nr * sizeof(uint64_t *));
+	if (!chunks)
+		return -ENOMEM;
+	bm->chunks = chunks;
+
+	weight = realloc(bm->weight, nr * sizeof(uint32_t));
+	if (!weight)
+		return -ENOMEM;
+	bm->weight = weight;
+
+	memset(&bm->chunks[bm->nr_chunks], 0,
+		(nr - bm->nr_chunks) * sizeof(uint64_t *));
+	memset(&bm->weight[bm->nr_chunks], 0,
+		(nr - bm->nr_chunks) * sizeof(uint32_t));
+	bm->nr_chunks = nr;
+	return 0;
+}
+
+/*
+ * Returns 1 if the bit was newly set, 0 if it was already set and -ENOMEM
+ * if memory for it could not be allocated.
+ */
+int blockmap_set(struct blockmap *bm, uint64_t bit_nr)
+{
+	uint64_t chunk = bit_nr >> CHUNK_SHIFT;
+	unsigned int off = bit_nr & CHUNK_MASK;
+	uint64_t *map, mask;
+
+	if (chunk >= bm->nr_chunks && blockmap_grow(bm, chunk))
+		return -ENOMEM;
+
+	map = bm->chunks[chunk];
+	if (map == FULL_CHUNK)
+		return 0;
+	if (!map) {
+		map = calloc(CHUNK_WORDS, sizeof(uint64_t));
+		if (!map)
+			return -ENOMEM;
+		bm->chunks[chunk] = map;
+	}
+
+	mask = 1ULL << (off & 63);
+	if (map[off / 64] & mask)
+		return 0;
+
+	map[off / 64] |= mask;
+	bm->nr_set++;
+	if (++bm->weight[chunk] == CHUNK_BITS) {
+		free(map);
+		bm->chunks[chunk] = FULL_CHUNK;
+	}
+
+	return 1;
+}
+
+/*
+ * Returns 1 if the bit was set, 0 if it wasn't and -ENOMEM if a full chunk
+ * could not be expanded to clear it.
+ */
+int blockmap_clear(struct blockmap *bm, uint64_t bit_nr)
+{
+	uint64_t chunk = bit_nr >> CHUNK_SHIFT;
+	unsigned int off = bit_nr & CHUNK_MASK;
+	uint64_t *map, mask;
+
+	if (chunk >= bm->nr_chunks || !bm->chunks[chunk])
+		return 0;
+
+	map = bm->chunks[chunk];
+	if (map == FULL_CHUNK) {
+		map = malloc(CHUNK_WORDS * sizeof(uint64_t));
+		if (!map)
+			return -ENOMEM;
+		memset(map, 0xff, CHUNK_WORDS * sizeof(uint64_t));
+		bm->chunks[chunk] = map;
+	}
+
+	mask = 1ULL << (off & 63);
+	if (!(map[off / 64] & mask))
+		return 0;
+
+	map[off / 64] &= ~mask;
+	bm->nr_set--;
+	if (!--bm->weight[chunk]) {
+		free(map);
+		bm->chunks[chunk] = NULL;
+	}
+
+	return 1;
+}
+
+bool blockmap_isset(struct blockmap *bm, uint64_t bit_nr)
+{
+	uint64_t chunk = bit_nr >> CHUNK_SHIFT;
+	unsigned int off = bit_nr & CHUNK_MASK;
+	uint64_t *map;
+
+	if (chunk >= bm->nr_chunks || !bm->chunks[chunk])
+		return false;
+
+	map = bm->chunks[chunk];
+	if (map == FULL_CHUNK)
+		return true;
+
+	return (map[off / 64] & (1ULL << (off & 63))) != 0;
+}
+
+/*
+ * Find the first set bit at or after *bit_nr. Returns false if there is
+ * none.
+ */
+bool blockmap_next_set(struct blockmap *bm, uint64_t *bit_nr)
+{
+	uint64_t chunk = *bit_nr >> CHUNK_SHIFT;
+	unsigned int off = *bit_nr & CHUNK_MASK;
+
+	for (; chunk < bm->nr_chunks; chunk++, off = 0) {
+		uint64_t *map = bm->chunks[chunk];
+		unsigned int i;
+		uint64_t word;
+
+		if (!map)
+			continue;
+		if (map == FULL_CHUNK) {
+			*bit_nr = (chunk << CHUNK_SHIFT) + off;
+			return true;
+		}
+
+		i = off / 64;
+		word = map[i] & (~0ULL << (off & 63));
+		do {
+			if (word) {
+				*bit_nr = (chunk << CHUNK_SHIFT) + i * 64 +
+						ffs64(word);
+				return true;
+			}
+			if (++i == CHUNK_WORDS)
+				break;
+			word = map[i];
+		} while (1);
+	}
+
+	return false;
+}
+
+uint64_t blockmap_weight(struct blockmap *bm)
+{
+	return bm->nr_set;
+}
+
+/*
+ * Memory used, not counting the blockmap itself
+ */
+size_t blockmap_mem(struct blockmap *bm)
+{
+	size_t mem;
+	uint64_t i;
+
+	mem = bm->nr_chunks * (sizeof(uint64_t *) + sizeof(uint32_t));
+	for (i = 0; i < bm->nr_chunks; i++)
+		if (bm->chunks[i] && bm->chunks[i] != FULL_CHUNK)
+			mem += CHUNK_WORDS * sizeof(uint64_t);
+
+	return mem;
+}
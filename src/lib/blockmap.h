@@ -0,0 +1,20 @@
+#ifndef FIO_BLOCKMAP_H
+#define FIO_BLOCKMAP_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "types.h"
+
+struct blockmap;
+struct blockmap *blockmap_new(void);
+void blockmap_free(struct blockmap *bm);
+
+int blockmap_set(struct blockmap *bm, uint64_t bit_nr);
+int blockmap_clear(struct blockmap *bm, uint64_t bit_nr);
+bool blockmap_isset(struct blockmap *bm, uint64_t bit_nr);
+bool blockmap_next_set(struct blockmap *bm, uint64_t *bit_nr);
+uint64_t blockmap_weight(struct blockmap *bm);
+size_t blockmap_mem(struct blockmap *bm);
+void blockmap_reset(struct blockmap *bm);
+
+#endif
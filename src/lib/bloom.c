@@ -116,6 +116,32 @@ bool bloom_set(struct bloom *b, uint32_t *data, unsigned int nwords)
 	return __bloom_check(b, data, nwords * sizeof(uint32_t), true);
 }
 
+/*
+ * For data that already is a good 128-bit hash, like a block checksum.
+ * The bit indices are derived from the hash itself instead of running it
+ * through N_HASHES hash functions again, and they span the full 64-bit
+ * range of entries. Bits are set atomically, so several threads can share
+ * the filter without a lock.
+ */
+bool bloom_set_hash(struct bloom *b, const uint32_t *hash)
+{
+	uint64_t h1 = ((uint64_t) hash[1] << 32) | hash[0];
+	uint64_t h2 = ((uint64_t) hash[3] << 32) | hash[2] | 1;
+	int i, was_set = 0;
+
+	for (i = 0; i < N_HASHES; i++) {
+		const uint64_t h = (h1 + i * h2) % b->nentries;
+		const uint32_t mask = 1U << (h & BITS_INDEX_MASK);
+
+		if (b->map[h / BITS_PER_INDEX] & mask)
+			was_set++;
+		else if (__sync_fetch_and_or(&b->map[h / BITS_PER_INDEX], mask) & mask)
+			was_set++;
+	}
+
+	return was_set == N_HASHES;
+}
+
 bool bloom_string(struct bloom *b, const char *data, unsigned int len,
 		  bool set)
 {
@@ -9,6 +9,7 @@ struct bloom;
 struct bloom *bloom_new(uint64_t entries);
 void bloom_free(struct bloom *b);
 bool bloom_set(struct bloom *b, uint32_t *data, unsigned int nwords);
+bool bloom_set_hash(struct bloom *b, const uint32_t *hash);
 bool bloom_string(struct bloom *b, const char *data, unsigned int len, bool);
 
 #endif
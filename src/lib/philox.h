@@ -0,0 +1,37 @@
+#ifndef FIO_PHILOX_H
+#define FIO_PHILOX_H
+
+#include <inttypes.h>
+
+/*
+ * Number of 64-bit values generated per refill of the batch buffer. Each
+ * Philox block yields two of them.
+ */
+#define PHILOX_BATCH	8
+
+struct philox_state {
+	uint32_t key[2];
+	uint64_t ctr;
+	unsigned int pos;
+	uint64_t buf[PHILOX_BATCH];
+};
+
+void philox_init(struct philox_state *s, uint64_t seed);
+void philox_block(const uint32_t key[2], const uint32_t ctr[4],
+		  uint32_t out[4]);
+
+void __philox_refill(struct philox_state *s);
+
+/*
+ * Returns the next value in the stream. s->ctr is the index of the value
+ * at s->buf[0].
+ */
+static inline uint64_t philox_next(struct philox_state *s)
+{
+	if (s->pos == PHILOX_BATCH)
+		__philox_refill(s);
+
+	return s->buf[s->pos++];
+}
+
+#endif
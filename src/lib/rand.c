@@ -33,6 +33,7 @@
 
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include "rand.h"
 #include "pattern.h"
@@ -110,6 +111,118 @@ void __fill_random_buf_small(void *buf, unsigned int len, uint64_t seed)
 		__builtin_memcpy(e, &seed, rest);
 }
 
+static uint64_t *fill_rows(uint64_t *b, uint64_t *e, uint64_t *seeds)
+{
+	uint64_t s[CONFIG_SEED_BUCKETS];
+	int p;
+
+	/*
+	 * Local copy, so the seeds aren't reloaded after every store to b
+	 */
+	for (p = 0; p < CONFIG_SEED_BUCKETS; p++)
+		s[p] = seeds[p];
+
+	for (; b != e; b += CONFIG_SEED_BUCKETS) {
+		for (p = 0; p < CONFIG_SEED_BUCKETS; ++p) {
+			b[p] = s[p];
+			s[p] = __hash_u64(s[p]);
+		}
+	}
+
+	seeds[0] = s[0];
+	return b;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/*
+ * Each seed bucket is a chain of __hash_u64() steps, one word per row.
+ * That's fine for scalar code, but a vector multiply has a long latency
+ * and one row doesn't give it enough independent work. As a step is a
+ * multiply by GOLDEN_RATIO_64, row r + FILL_ROWS of a bucket is row r
+ * times GOLDEN_RATIO_64^FILL_ROWS, so FILL_ROWS rows can be generated at
+ * once while producing exactly the same bytes.
+ */
+#define FILL_WORDS	64
+#define FILL_ROWS	(FILL_WORDS / CONFIG_SEED_BUCKETS)
+
+static inline __attribute__((always_inline))
+uint64_t *__fill_rows_wide(uint64_t *b, uint64_t *e, uint64_t *s)
+{
+	uint64_t v[FILL_ROWS][CONFIG_SEED_BUCKETS];
+	uint64_t step = 1;
+	int r, p;
+
+	/*
+	 * Not worth setting up the rows for small fills, like the random
+	 * part of a compressible buffer segment
+	 */
+	if (e - b < 4 * FILL_WORDS)
+		return fill_rows(b, e, s);
+
+	for (r = 0; r < FILL_ROWS; r++) {
+		step = __hash_u64(step);
+		for (p = 0; p < CONFIG_SEED_BUCKETS; p++)
+			v[r][p] = r ? __hash_u64(v[r - 1][p]) : s[p];
+	}
+
+	for (; e - b >= FILL_ROWS * CONFIG_SEED_BUCKETS;
+	     b += FILL_ROWS * CONFIG_SEED_BUCKETS) {
+		for (r = 0; r < FILL_ROWS; r++) {
+			for (p = 0; p < CONFIG_SEED_BUCKETS; p++) {
+				b[r * CONFIG_SEED_BUCKETS + p] = v[r][p];
+				v[r][p] *= step;
+			}
+		}
+	}
+
+	for (r = 0; b != e; r++, b += CONFIG_SEED_BUCKETS)
+		for (p = 0; p < CONFIG_SEED_BUCKETS; p++)
+			b[p] = v[r][p];
+
+	s[0] = v[r][0];
+	return b;
+}
+
+/*
+ * With AVX-512DQ the 64-bit multiply is a single instruction, AVX2 has to
+ * piece it together from 32-bit ones but still beats scalar code. There's
+ * no 64-bit vector multiply on aarch64, so the scalar version is used
+ * everywhere else.
+ */
+static __attribute__((target("avx2")))
+uint64_t *fill_rows_avx2(uint64_t *b, uint64_t *e, uint64_t *s)
+{
+	return __fill_rows_wide(b, e, s);
+}
+
+static __attribute__((target("avx512f,avx512dq,avx512vl")))
+uint64_t *fill_rows_avx512(uint64_t *b, uint64_t *e, uint64_t *s)
+{
+	return __fill_rows_wide(b, e, s);
+}
+
+static uint64_t *fill_rows_probe(uint64_t *, uint64_t *, uint64_t *);
+static uint64_t *(*fill_rows_fn)(uint64_t *, uint64_t *, uint64_t *) = fill_rows_probe;
+
+static uint64_t *fill_rows_probe(uint64_t *b, uint64_t *e, uint64_t *s)
+{
+	__builtin_cpu_init();
+	if (CONFIG_SEED_BUCKETS & (CONFIG_SEED_BUCKETS - 1))
+		fill_rows_fn = fill_rows;
+	else if (__builtin_cpu_supports("avx512dq") &&
+	    __builtin_cpu_supports("avx512vl"))
+		fill_rows_fn = fill_rows_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		fill_rows_fn = fill_rows_avx2;
+	else
+		fill_rows_fn = fill_rows;
+
+	return fill_rows_fn(b, e, s);
+}
+#else
+#define fill_rows_fn	fill_rows
+#endif
+
 void __fill_random_buf(void *buf, unsigned int len, uint64_t seed)
 {
 	static uint64_t prime[] = {1, 2, 3, 5, 7, 11, 13, 17,
@@ -131,12 +244,7 @@ void __fill_random_buf(void *buf, unsigned int len, uint64_t seed)
 	for (p = 0; p < CONFIG_SEED_BUCKETS; p++)
 		s[p] = seed * prime[p];
 
-	for (; b != e; b += CONFIG_SEED_BUCKETS) {
-		for (p = 0; p < CONFIG_SEED_BUCKETS; ++p) {
-			b[p] = s[p];
-			s[p] = __hash_u64(s[p]);
-		}
-	}
+	b = fill_rows_fn(b, e, s);
 
 	__fill_random_buf_small(b, rest, s[0]);
 }
@@ -210,3 +318,165 @@ uint64_t fill_random_buf_percentage(struct frand_state *fs, void *buf,
 					pattern, pbytes);
 	return r;
 }
+
+/*
+ * Each component of the Tausworthe generators is a linear map over GF(2),
+ * and the components don't depend on each other. Advancing a component by
+ * 2^j * stride steps is then a fixed bit matrix, which is kept as one
+ * lookup table per nibble of the input: applying it takes a table lookup
+ * per nibble instead of 2^j * stride steps. Any n * stride jump is the
+ * product of the matrices for the bits set in n.
+ */
+#define JUMP_NIBBLE_VALS	16
+
+static unsigned int jump_comps(bool use64)
+{
+	return use64 ? 5 : 3;
+}
+
+static unsigned int jump_bits(bool use64)
+{
+	return use64 ? 64 : 32;
+}
+
+static uint64_t comp_get(struct frand_state *fs, unsigned int comp)
+{
+	if (fs->use64) {
+		uint64_t *s = &fs->state64.s1;
+
+		return s[comp];
+	} else {
+		unsigned int *s = &fs->state32.s1;
+
+		return s[comp];
+	}
+}
+
+static void comp_set(struct frand_state *fs, unsigned int comp, uint64_t v)
+{
+	if (fs->use64) {
+		uint64_t *s = &fs->state64.s1;
+
+		s[comp] = v;
+	} else {
+		unsigned int *s = &fs->state32.s1;
+
+		s[comp] = v;
+	}
+}
+
+static uint64_t *jump_table(struct frand_jump *j, unsigned int pow,
+			    unsigned int comp)
+{
+	const unsigned int nibbles = jump_bits(j->use64) / 4;
+
+	return j->tables + ((pow * jump_comps(j->use64) + comp) * nibbles) *
+				JUMP_NIBBLE_VALS;
+}
+
+static uint64_t jump_apply(struct frand_jump *j, unsigned int pow,
+			   unsigned int comp, uint64_t v)
+{
+	const unsigned int nibbles = jump_bits(j->use64) / 4;
+	uint64_t *t = jump_table(j, pow, comp);
+	uint64_t ret = 0;
+	unsigned int i;
+
+	for (i = 0; i < nibbles; i++, v >>= 4, t += JUMP_NIBBLE_VALS)
+		ret ^= t[v & 15];
+
+	return ret;
+}
+
+/*
+ * Fill the nibble tables of one matrix from the images of the basis
+ * vectors.
+ */
+static void jump_fill(struct frand_jump *j, unsigned int pow,
+		      unsigned int comp, uint64_t *cols)
+{
+	const unsigned int nibbles = jump_bits(j->use64) / 4;
+	uint64_t *t = jump_table(j, pow, comp);
+	unsigned int i, v, b;
+
+	for (i = 0; i < nibbles; i++, t += JUMP_NIBBLE_VALS) {
+		for (v = 0; v < JUMP_NIBBLE_VALS; v++) {
+			t[v] = 0;
+			for (b = 0; b < 4; b++)
+				if (v & (1U << b))
+					t[v] ^= cols[i * 4 + b];
+		}
+	}
+}
+
+/*
+ * Set up tables to advance a generator of the given width by n * stride
+ * steps of __rand(), for any n up to max_n.
+ */
+int frand_jump_init(struct frand_jump *j, bool use64, uint64_t stride,
+		    uint64_t max_n)
+{
+	const unsigned int bits = jump_bits(use64);
+	const unsigned int nibbles = bits / 4;
+	struct frand_state fs = { .use64 = use64 };
+	unsigned int pow, comp, k;
+	uint64_t cols[64], s;
+
+	j->use64 = use64;
+	j->nr_pows = 1;
+	while (j->nr_pows < 64 && (max_n >> j->nr_pows))
+		j->nr_pows++;
+
+	j->tables = malloc(j->nr_pows * jump_comps(use64) * nibbles *
+				JUMP_NIBBLE_VALS * sizeof(uint64_t));
+	if (!j->tables)
+		return 1;
+
+	for (comp = 0; comp < jump_comps(use64); comp++) {
+		/* stride steps, one basis vector at a time */
+		for (k = 0; k < bits; k++) {
+			memset(&fs.state64, 0, sizeof(fs.state64));
+			comp_set(&fs, comp, 1ULL << k);
+			for (s = 0; s < stride; s++)
+				__rand(&fs);
+			cols[k] = comp_get(&fs, comp);
+		}
+		jump_fill(j, 0, comp, cols);
+
+		/* squaring the previous matrix doubles the distance */
+		for (pow = 1; pow < j->nr_pows; pow++) {
+			for (k = 0; k < bits; k++) {
+				s = jump_apply(j, pow - 1, comp, 1ULL << k);
+				cols[k] = jump_apply(j, pow - 1, comp, s);
+			}
+			jump_fill(j, pow, comp, cols);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Advance fs by n * stride steps, as if __rand() was called that often.
+ */
+void frand_jump(struct frand_jump *j, struct frand_state *fs, uint64_t n)
+{
+	unsigned int pow, comp;
+
+	assert(fs->use64 == j->use64);
+	assert(j->nr_pows == 64 || !(n >> j->nr_pows));
+
+	for (pow = 0; n; pow++, n >>= 1) {
+		if (!(n & 1))
+			continue;
+		for (comp = 0; comp < jump_comps(j->use64); comp++)
+			comp_set(fs, comp, jump_apply(j, pow, comp,
+						      comp_get(fs, comp)));
+	}
+}
+
+void frand_jump_free(struct frand_jump *j)
+{
+	free(j->tables);
+	j->tables = NULL;
+}
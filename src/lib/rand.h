@@ -160,6 +160,16 @@ static inline uint64_t __get_next_seed(struct frand_state *fs)
 	return r;
 }
 
+/*
+ * Precomputed tables to advance a frand_state by n * stride steps without
+ * stepping through them. See frand_jump_init().
+ */
+struct frand_jump {
+	unsigned int use64;
+	unsigned int nr_pows;
+	uint64_t *tables;
+};
+
 extern void init_rand(struct frand_state *, bool);
 extern void init_rand_seed(struct frand_state *, uint64_t seed, bool);
 void __init_rand64(struct taus258_state *state, uint64_t seed);
@@ -167,5 +177,8 @@ extern void __fill_random_buf(void *buf, unsigned int len, uint64_t seed);
 extern uint64_t fill_random_buf(struct frand_state *, void *buf, unsigned int len);
 extern void __fill_random_buf_percentage(uint64_t, void *, unsigned int, unsigned int, unsigned int, char *, unsigned int);
 extern uint64_t fill_random_buf_percentage(struct frand_state *, void *, unsigned int, unsigned int, unsigned int, char *, unsigned int);
+extern int frand_jump_init(struct frand_jump *, bool, uint64_t, uint64_t);
+extern void frand_jump(struct frand_jump *, struct frand_state *, uint64_t);
+extern void frand_jump_free(struct frand_jump *);
 
 #endif
@@ -0,0 +1,177 @@
+/*
+ * LEB128 variable length integer encodings of value arrays, for columnar
+ * logs:
+ *
+ * varint	each value as is
+ * delta	the zigzag encoded difference to the previous value, the first
+ *		value is relative to 0
+ * rle		pairs of value and run length
+ * sparse	rows of row_len values, each as the number of non-zero values
+ *		followed by pairs of the gap since the previous non-zero index
+ *		and the value
+ */
+#include <string.h>
+
+#include "varint.h"
+
+size_t varint_enc(uint8_t *out, const uint64_t *in, size_t nr)
+{
+	size_t i, len = 0;
+
+	for (i = 0; i < nr; i++)
+		len += varint_put(out + len, in[i]);
+
+	return len;
+}
+
+size_t varint_enc_delta(uint8_t *out, const uint64_t *in, size_t nr)
+{
+	uint64_t prev = 0;
+	size_t i, len = 0;
+
+	for (i = 0; i < nr; i++) {
+		len += varint_put(out + len, zigzag_enc(in[i] - prev));
+		prev = in[i];
+	}
+
+	return len;
+}
+
+size_t varint_enc_rle(uint8_t *out, const uint64_t *in, size_t nr)
+{
+	size_t i = 0, len = 0;
+
+	while (i < nr) {
+		size_t run = 1;
+
+		while (i + run < nr && in[i + run] == in[i])
+			run++;
+
+		len += varint_put(out + len, in[i]);
+		len += varint_put(out + len, run);
+		i += run;
+	}
+
+	return len;
+}
+
+size_t varint_enc_sparse(uint8_t *out, const uint64_t *in, size_t nr_rows,
+			 size_t row_len)
+{
+	size_t r, i, len = 0;
+
+	for (r = 0; r < nr_rows; r++) {
+		const uint64_t *row = in + r * row_len;
+		size_t nz = 0, last = 0;
+
+		for (i = 0; i < row_len; i++)
+			nz += row[i] != 0;
+
+		len += varint_put(out + len, nz);
+		for (i = 0; i < row_len; i++) {
+			if (!row[i])
+				continue;
+			len += varint_put(out + len, i - last);
+			len += varint_put(out + len, row[i]);
+			last = i;
+		}
+	}
+
+	return len;
+}
+
+ssize_t varint_dec(const uint8_t *in, size_t len, uint64_t *out, size_t nr)
+{
+	const uint8_t *p = in, *end = in + len;
+	size_t i, l;
+
+	for (i = 0; i < nr; i++) {
+		l = varint_get(p, end, &out[i]);
+		if (!l)
+			return -1;
+		p += l;
+	}
+
+	return p - in;
+}
+
+ssize_t varint_dec_delta(const uint8_t *in, size_t len, uint64_t *out,
+			 size_t nr)
+{
+	uint64_t prev = 0;
+	ssize_t ret;
+	size_t i;
+
+	ret = varint_dec(in, len, out, nr);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < nr; i++) {
+		prev += zigzag_dec(out[i]);
+		out[i] = prev;
+	}
+
+	return ret;
+}
+
+ssize_t varint_dec_rle(const uint8_t *in, size_t len, uint64_t *out,
+		       size_t nr)
+{
+	const uint8_t *p = in, *end = in + len;
+	size_t i = 0;
+
+	while (i < nr) {
+		uint64_t val, run;
+		size_t l;
+
+		l = varint_get(p, end, &val);
+		if (!l)
+			return -1;
+		p += l;
+		l = varint_get(p, end, &run);
+		if (!l || !run || run > nr - i)
+			return -1;
+		p += l;
+
+		while (run--)
+			out[i++] = val;
+	}
+
+	return p - in;
+}
+
+ssize_t varint_dec_sparse(const uint8_t *in, size_t len, uint64_t *out,
+			  size_t nr_rows, size_t row_len)
+{
+	const uint8_t *p = in, *end = in + len;
+	size_t r;
+
+	memset(out, 0, nr_rows * row_len * sizeof(uint64_t));
+
+	for (r = 0; r < nr_rows; r++) {
+		uint64_t *row = out + r * row_len;
+		uint64_t nz, gap, idx = 0;
+		size_t l;
+
+		l = varint_get(p, end, &nz);
+		if (!l || nz > row_len)
+			return -1;
+		p += l;
+
+		while (nz--) {
+			l = varint_get(p, end, &gap);
+			if (!l)
+				return -1;
+			p += l;
+			idx += gap;
+			if (idx >= row_len)
+				return -1;
+			l = varint_get(p, end, &row[idx]);
+			if (!l)
+				return -1;
+			p += l;
+		}
+	}
+
+	return p - in;
+}
@@ -0,0 +1,81 @@
+#ifndef FIO_VARINT_H
+#define FIO_VARINT_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Longest LEB128 encoding of a 64-bit value
+ */
+#define VARINT_MAX_LEN	10
+
+static inline uint64_t zigzag_enc(int64_t v)
+{
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t zigzag_dec(uint64_t v)
+{
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static inline size_t varint_put(uint8_t *p, uint64_t v)
+{
+	size_t len = 0;
+
+	while (v >= 0x80) {
+		p[len++] = (uint8_t) v | 0x80;
+		v >>= 7;
+	}
+	p[len++] = (uint8_t) v;
+	return len;
+}
+
+/*
+ * Returns the length of the value at p, or 0 if it runs past end
+ */
+static inline size_t varint_get(const uint8_t *p, const uint8_t *end,
+				uint64_t *v)
+{
+	uint64_t ret = 0;
+	unsigned int shift = 0;
+	size_t len = 0;
+
+	while (p + len < end && shift < 64) {
+		uint8_t b = p[len++];
+
+		ret |= (uint64_t) (b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*v = ret;
+			return len;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+/*
+ * Array encoders. 'out' must have room for VARINT_MAX_LEN bytes per value,
+ * twice that for the run length encoding. They return the encoded length.
+ */
+size_t varint_enc(uint8_t *out, const uint64_t *in, size_t nr);
+size_t varint_enc_delta(uint8_t *out, const uint64_t *in, size_t nr);
+size_t varint_enc_rle(uint8_t *out, const uint64_t *in, size_t nr);
+size_t varint_enc_sparse(uint8_t *out, const uint64_t *in, size_t nr_rows,
+			 size_t row_len);
+
+/*
+ * Decoders, they return the number of bytes consumed to fill out[], or -1
+ * if the input is short or malformed
+ */
+ssize_t varint_dec(const uint8_t *in, size_t len, uint64_t *out, size_t nr);
+ssize_t varint_dec_delta(const uint8_t *in, size_t len, uint64_t *out,
+			 size_t nr);
+ssize_t varint_dec_rle(const uint8_t *in, size_t len, uint64_t *out,
+		       size_t nr);
+ssize_t varint_dec_sparse(const uint8_t *in, size_t len, uint64_t *out,
+			  size_t nr_rows, size_t row_len);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * log_format=columnar: logs stored column by column in batches of rows, see
+ * log_columnar.h for the layout. Each column is gathered from the samples
+ * into an array and encoded in one pass, there's no per value formatting.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fio.h"
+#include "log_columnar.h"
+#include "lib/varint.h"
+
+enum col_id {
+	COL_TIME = 0,
+	COL_VAL,
+	COL_VAL_MAX,
+	COL_DDIR,
+	COL_BS,
+	COL_OFFSET,
+	COL_PRIO,
+	COL_ISSUE_TIME,
+	COL_BINS,
+	COL_NR,
+};
+
+static const struct col_def {
+	const char *name;
+	enum log_col_type type;
+	enum log_col_enc enc;
+} col_defs[COL_NR] = {
+	[COL_TIME]	= { "time",		LOG_COL_U64,	LOG_COL_DELTA },
+	[COL_VAL]	= { "value",		LOG_COL_U64,	LOG_COL_VARINT },
+	[COL_VAL_MAX]	= { "value1",		LOG_COL_U64,	LOG_COL_VARINT },
+	[COL_DDIR]	= { "ddir",		LOG_COL_U8,	LOG_COL_RLE },
+	[COL_BS]	= { "bs",		LOG_COL_U64,	LOG_COL_RLE },
+	[COL_OFFSET]	= { "offset",		LOG_COL_U64,	LOG_COL_DELTA },
+	[COL_PRIO]	= { "prio",		LOG_COL_U16,	LOG_COL_RLE },
+	[COL_ISSUE_TIME] = { "issue_time",	LOG_COL_U64,	LOG_COL_DELTA },
+	[COL_BINS]	= { "bins",		LOG_COL_U64,	LOG_COL_SPARSE },
+};
+
+static bool hist_log(struct io_log *log)
+{
+	return log->log_type == IO_LOG_TYPE_HIST;
+}
+
+static unsigned int hist_bins(struct io_log *log)
+{
+	return log->hist_nr >> log->hist_coarseness;
+}
+
+/*
+ * The columns of a log, only the fields it logs are stored
+ */
+static unsigned int log_cols(struct io_log *log, enum col_id *cols)
+{
+	unsigned int nr = 0;
+
+	cols[nr++] = COL_TIME;
+	if (hist_log(log)) {
+		cols[nr++] = COL_DDIR;
+		cols[nr++] = COL_BS;
+		cols[nr++] = COL_BINS;
+		return nr;
+	}
+
+	cols[nr++] = COL_VAL;
+	if (log->log_ddir_mask & LOG_AVG_MAX_SAMPLE_BIT)
+		cols[nr++] = COL_VAL_MAX;
+	cols[nr++] = COL_DDIR;
+	cols[nr++] = COL_BS;
+	if (log->log_offset)
+		cols[nr++] = COL_OFFSET;
+	cols[nr++] = COL_PRIO;
+	if (log->log_issue_time)
+		cols[nr++] = COL_ISSUE_TIME;
+	return nr;
+}
+
+int log_col_write_head(struct io_log *log, FILE *f)
+{
+	enum col_id cols[COL_NR];
+	struct log_col_head head;
+	unsigned int i, nr_cols;
+
+	nr_cols = log_cols(log, cols);
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, LOG_COL_MAGIC, LOG_COL_MAGIC_LEN);
+	head.version = cpu_to_le32((uint32_t) LOG_COL_VERSION);
+	head.log_type = cpu_to_le32(log->log_type);
+	head.flags = cpu_to_le32(log->log_ddir_mask);
+	head.nr_cols = cpu_to_le32(nr_cols);
+	if (fwrite(&head, sizeof(head), 1, f) != 1)
+		return 1;
+
+	for (i = 0; i < nr_cols; i++) {
+		const struct col_def *def = &col_defs[cols[i]];
+		struct log_col_desc desc;
+
+		memset(&desc, 0, sizeof(desc));
+		strncpy(desc.name, def->name, sizeof(desc.name) - 1);
+		desc.type = cpu_to_le32((uint32_t) def->type);
+		desc.list_size = cpu_to_le32(cols[i] == COL_BINS ?
+						hist_bins(log) : 1);
+		if (fwrite(&desc, sizeof(desc), 1, f) != 1)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Compute the histogram rows, like flush_hist_samples() does. Each sample
+ * holds the cumulative histogram, the row is its difference with the
+ * previous one, which is freed once used.
+ */
+static void gather_bins(struct io_log *log, struct io_logs *cur_log,
+			uint64_t start, uint32_t nr, uint64_t *out)
+{
+	int stride = 1 << log->hist_coarseness;
+	unsigned int bins = hist_bins(log);
+	uint32_t i;
+	int j;
+
+	for (i = 0; i < nr; i++) {
+		struct io_sample *s = get_sample(log, cur_log, start + i);
+		struct io_u_plat_entry *entry, *entry_before;
+		uint64_t *row = out + (uint64_t) i * bins;
+
+		entry = s->data.plat_entry;
+		entry_before = flist_first_entry(&entry->list,
+						 struct io_u_plat_entry, list);
+		for (j = 0; j < log->hist_nr; j += stride)
+			row[j / stride] = hist_sum(j, stride, entry->io_u_plat,
+						   entry_before->io_u_plat);
+
+		flist_del(&entry_before->list);
+		free(entry_before);
+	}
+}
+
+static void gather(struct io_log *log, struct io_logs *cur_log,
+		   uint64_t start, uint32_t nr, enum col_id col, uint64_t *out)
+{
+	uint32_t i;
+
+#define for_each_row(expr)						\
+	for (i = 0; i < nr; i++) {					\
+		struct io_sample *s = get_sample(log, cur_log, start + i); \
+		out[i] = (expr);					\
+	}
+
+	switch (col) {
+	case COL_TIME:
+		for_each_row(s->time);
+		break;
+	case COL_VAL:
+		for_each_row(s->data.val.val0);
+		break;
+	case COL_VAL_MAX:
+		for_each_row(s->data.val.val1);
+		break;
+	case COL_DDIR:
+		for_each_row(io_sample_ddir(s));
+		break;
+	case COL_BS:
+		for_each_row(s->bs);
+		break;
+	case COL_OFFSET:
+		for_each_row(s->aux[IOS_AUX_OFFSET_INDEX]);
+		break;
+	case COL_PRIO:
+		for_each_row(s->priority);
+		break;
+	case COL_ISSUE_TIME:
+		for_each_row(s->aux[IOS_AUX_ISSUE_TIME_INDEX]);
+		break;
+	case COL_BINS:
+		gather_bins(log, cur_log, start, nr, out);
+		break;
+	default:
+		assert(0);
+	}
+
+#undef for_each_row
+}
+
+static size_t encode(enum log_col_enc enc, uint8_t *out, const uint64_t *vals,
+		     uint32_t nr, unsigned int list_size)
+{
+	switch (enc) {
+	case LOG_COL_DELTA:
+		return varint_enc_delta(out, vals, nr);
+	case LOG_COL_RLE:
+		return varint_enc_rle(out, vals, nr);
+	case LOG_COL_SPARSE:
+		return varint_enc_sparse(out, vals, nr, list_size);
+	case LOG_COL_VARINT:
+	default:
+		return varint_enc(out, vals, nr);
+	}
+}
+
+/*
+ * Append the samples of a chunk to the log, as batches of at most
+ * LOG_COL_BATCH rows, or LOG_COL_HIST_BATCH for histograms
+ */
+int log_col_write(struct io_log *log, struct io_logs *cur_log, FILE *f)
+{
+	unsigned int i, nr_cols, list_size = 1;
+	enum col_id cols[COL_NR];
+	uint32_t batch_rows = LOG_COL_BATCH;
+	uint64_t *vals, start;
+	uint8_t *out;
+	int ret = 1;
+
+	if (!cur_log->nr_samples)
+		return 0;
+
+	nr_cols = log_cols(log, cols);
+	if (hist_log(log)) {
+		batch_rows = LOG_COL_HIST_BATCH;
+		list_size = hist_bins(log);
+	}
+
+	/*
+	 * Worst cases: sparse rows take a count and two values per entry,
+	 * run length encoding two values per row
+	 */
+	vals = malloc((size_t) batch_rows * list_size * sizeof(uint64_t));
+	out = malloc((size_t) batch_rows * (2 * list_size + 1) * VARINT_MAX_LEN);
+	if (!vals || !out)
+		goto done;
+
+	for (start = 0; start < cur_log->nr_samples; start += batch_rows) {
+		uint32_t nr = min(cur_log->nr_samples - start, (uint64_t) batch_rows);
+		struct log_col_batch batch = {
+			.magic		= cpu_to_le32((uint32_t) LOG_COL_BATCH_MAGIC),
+			.nr_rows	= cpu_to_le32(nr),
+		};
+
+		if (fwrite(&batch, sizeof(batch), 1, f) != 1)
+			goto done;
+
+		for (i = 0; i < nr_cols; i++) {
+			const struct col_def *def = &col_defs[cols[i]];
+			struct log_col_chunk chunk;
+			size_t len;
+
+			gather(log, cur_log, start, nr, cols[i], vals);
+			len = encode(def->enc, out, vals, nr,
+					cols[i] == COL_BINS ? list_size : 1);
+
+			chunk.enc = cpu_to_le32((uint32_t) def->enc);
+			chunk.len = cpu_to_le32((uint32_t) len);
+			if (fwrite(&chunk, sizeof(chunk), 1, f) != 1 ||
+			    fwrite(out, 1, len, f) != len)
+				goto done;
+		}
+	}
+
+	ret = 0;
+done:
+	free(vals);
+	free(out);
+	return ret;
+}
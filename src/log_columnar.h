@@ -0,0 +1,80 @@
+#ifndef FIO_LOG_COLUMNAR_H
+#define FIO_LOG_COLUMNAR_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+ * Columnar log format, for log_format=columnar. All fields are little
+ * endian.
+ *
+ *	struct log_col_head
+ *	struct log_col_desc		x nr_cols
+ *	batches until the end of the file, each:
+ *		struct log_col_batch
+ *		per column, in head order:
+ *			struct log_col_chunk
+ *			encoded values, 'len' bytes
+ *
+ * Like Arrow IPC record batches, every batch holds a run of rows stored
+ * column by column, and can be decoded on its own. Values are encoded
+ * with one of the LEB128 encodings of lib/varint.c. Histogram logs have a
+ * 'bins' column with list_size values per row.
+ */
+#define LOG_COL_MAGIC		"fio column log\0"
+#define LOG_COL_MAGIC_LEN	16
+#define LOG_COL_VERSION		1
+
+/*
+ * Rows per batch, sample logs and histogram logs
+ */
+#define LOG_COL_BATCH		(64 * 1024)
+#define LOG_COL_HIST_BATCH	16
+
+enum log_col_type {
+	LOG_COL_U8	= 0,
+	LOG_COL_U16,
+	LOG_COL_U32,
+	LOG_COL_U64,
+};
+
+enum log_col_enc {
+	LOG_COL_VARINT	= 0,
+	LOG_COL_DELTA,
+	LOG_COL_RLE,
+	LOG_COL_SPARSE,
+};
+
+struct log_col_head {
+	char magic[LOG_COL_MAGIC_LEN];
+	uint32_t version;
+	uint32_t log_type;	/* IO_LOG_TYPE_* */
+	uint32_t flags;		/* LOG_*_SAMPLE_BIT of the fields logged */
+	uint32_t nr_cols;
+};
+
+struct log_col_desc {
+	char name[16];
+	uint32_t type;		/* enum log_col_type */
+	uint32_t list_size;	/* values per row */
+};
+
+struct log_col_batch {
+	uint32_t magic;		/* LOG_COL_BATCH_MAGIC */
+	uint32_t nr_rows;
+};
+
+#define LOG_COL_BATCH_MAGIC	0x48435442	/* "BTCH" */
+
+struct log_col_chunk {
+	uint32_t enc;		/* enum log_col_enc */
+	uint32_t len;
+};
+
+struct io_log;
+struct io_logs;
+
+extern int log_col_write_head(struct io_log *, FILE *);
+extern int log_col_write(struct io_log *, struct io_logs *, FILE *);
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * log_format=binary: fixed size sample records, see log_stream.h for the
+ * layout. log_format=columnar logs are written by log_columnar.c, and go
+ * through the same path. Per I/O logs are streamed by a log writer thread
+ * as their chunks fill up, so a job holds at most the chunk it is filling
+ * and the one being written, however long it runs. Logs of windowed
+ * averages are small, they are written when the job is done like text logs
+ * are.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "fio.h"
+#include "filelock.h"
+#include "smalloc.h"
+#include "log_stream.h"
+#include "log_columnar.h"
+
+/*
+ * Records converted per fwrite()
+ */
+#define LOG_BIN_BATCH	256
+
+struct log_stream_work {
+	struct workqueue_work work;
+	struct io_log *log;
+	struct io_logs *cur_log;
+};
+
+/*
+ * Jobs share a log with per_job_logs=0, writes must then hold the file lock
+ */
+static bool log_shared(struct io_log *log)
+{
+	return log->td && !log->td->o.per_job_logs;
+}
+
+static int log_bin_write_head(struct io_log *log, FILE *f)
+{
+	struct log_bin_head head;
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, LOG_BIN_MAGIC, LOG_BIN_MAGIC_LEN);
+	head.version = cpu_to_le32((uint32_t) LOG_BIN_VERSION);
+	head.rec_size = cpu_to_le32((uint32_t) sizeof(struct log_bin_rec));
+	head.log_type = cpu_to_le32(log->log_type);
+	head.flags = cpu_to_le32(log->log_ddir_mask);
+
+	return fwrite(&head, sizeof(head), 1, f) != 1;
+}
+
+static int log_bin_write(struct io_log *log, struct io_logs *cur_log, FILE *f)
+{
+	bool avg_max = log->log_ddir_mask & LOG_AVG_MAX_SAMPLE_BIT;
+	struct log_bin_rec recs[LOG_BIN_BATCH];
+	uint64_t i = 0;
+
+	while (i < cur_log->nr_samples) {
+		unsigned int j, nr;
+
+		nr = min(cur_log->nr_samples - i, (uint64_t) LOG_BIN_BATCH);
+		for (j = 0; j < nr; j++, i++) {
+			struct io_sample *s = get_sample(log, cur_log, i);
+			struct log_bin_rec *r = &recs[j];
+
+			r->time = cpu_to_le64(s->time);
+			r->val = cpu_to_le64(s->data.val.val0);
+			r->val_max = avg_max ? cpu_to_le64(s->data.val.val1) : 0;
+			r->bs = cpu_to_le64(s->bs);
+			r->offset = 0;
+			if (log->log_offset)
+				r->offset = cpu_to_le64(s->aux[IOS_AUX_OFFSET_INDEX]);
+			r->issue_time = 0;
+			if (log->log_issue_time)
+				r->issue_time = cpu_to_le64(s->aux[IOS_AUX_ISSUE_TIME_INDEX]);
+			r->ddir = cpu_to_le32(io_sample_ddir(s));
+			r->prio = cpu_to_le16(s->priority);
+			r->pad = 0;
+		}
+
+		if (fwrite(recs, sizeof(recs[0]), nr, f) != nr)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Open the log and write its head. With a shared log, only the first job
+ * to get here writes the head.
+ */
+static int log_stream_open(struct io_log *log)
+{
+	bool append = log_shared(log);
+	struct stat sb;
+	int ret;
+
+	log->stream_f = fopen(log->filename, append ? "ab" : "wb");
+	if (!log->stream_f) {
+		log_err("fio: open log %s: %s\n", log->filename,
+			strerror(errno));
+		return 1;
+	}
+
+	if (append && !fstat(fileno(log->stream_f), &sb) && sb.st_size)
+		return 0;
+
+	if (log->log_format == LOG_FORMAT_COLUMNAR)
+		ret = log_col_write_head(log, log->stream_f);
+	else
+		ret = log_bin_write_head(log, log->stream_f);
+
+	if (ret) {
+		log_err("fio: write log %s: %s\n", log->filename,
+			strerror(errno));
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Append the samples of a chunk to the log
+ */
+static int log_stream_write(struct io_log *log, struct io_logs *cur_log)
+{
+	int ret;
+
+	if (!log->stream_f && log_stream_open(log))
+		return 1;
+
+	if (log->log_format == LOG_FORMAT_COLUMNAR)
+		ret = log_col_write(log, cur_log, log->stream_f);
+	else
+		ret = log_bin_write(log, cur_log, log->stream_f);
+
+	if (!ret && fflush(log->stream_f))
+		ret = 1;
+
+	if (ret)
+		log_err("fio: write log %s: %s\n", log->filename,
+			strerror(errno));
+	return ret;
+}
+
+static void free_chunk(struct io_logs *cur_log)
+{
+	free(cur_log->log);
+	sfree(cur_log);
+}
+
+static int log_stream_work_fn(struct submit_worker *sw,
+			      struct workqueue_work *work)
+{
+	struct log_stream_work *w;
+	struct io_log *log;
+	int ret = 0;
+
+	w = container_of(work, struct log_stream_work, work);
+	log = w->log;
+
+	if (!log->disabled) {
+		if (log_shared(log))
+			fio_lock_file(log->filename);
+		ret = log_stream_write(log, w->cur_log);
+		if (log_shared(log))
+			fio_unlock_file(log->filename);
+		if (ret) {
+			log_err("fio: failed streaming log! Will stop logging.\n");
+			log->disabled = true;
+		}
+	}
+
+	free_chunk(w->cur_log);
+	free(w);
+
+	pthread_mutex_lock(&log->stream_lock);
+	log->stream_inflight--;
+	pthread_cond_signal(&log->stream_cond);
+	pthread_mutex_unlock(&log->stream_lock);
+	return ret;
+}
+
+void log_stream_wait(struct io_log *log)
+{
+	pthread_mutex_lock(&log->stream_lock);
+	while (log->stream_inflight)
+		pthread_cond_wait(&log->stream_cond, &log->stream_lock);
+	pthread_mutex_unlock(&log->stream_lock);
+}
+
+/*
+ * Hand a full chunk of a streamed log to the log writer. If it's still
+ * busy with the previous chunk of this log, wait for it, that's what
+ * bounds the memory a log uses when the disk can't keep up.
+ */
+int log_stream_queue(struct io_log *log, struct io_logs *cur_log)
+{
+	struct log_stream_work *w;
+
+	w = malloc(sizeof(*w));
+	if (!w)
+		return 1;
+
+	pthread_mutex_lock(&log->stream_lock);
+	while (log->stream_inflight)
+		pthread_cond_wait(&log->stream_cond, &log->stream_lock);
+	log->stream_inflight++;
+	pthread_mutex_unlock(&log->stream_lock);
+
+	flist_del_init(&cur_log->list);
+	w->log = log;
+	w->cur_log = cur_log;
+	workqueue_enqueue(&log->td->log_stream_wq, &w->work);
+	return 0;
+}
+
+/*
+ * Write out the rest of a binary or columnar log once its job is done.
+ * Called with the log file locked, after log_stream_wait().
+ */
+int log_stream_finish(struct io_log *log)
+{
+	int ret = 0;
+
+	if (!log->stream_f)
+		ret = log_stream_open(log);
+
+	while (!flist_empty(&log->io_logs)) {
+		struct io_logs *cur_log;
+
+		cur_log = flist_first_entry(&log->io_logs, struct io_logs, list);
+		flist_del_init(&cur_log->list);
+		if (!ret)
+			ret = log_stream_write(log, cur_log);
+		free_chunk(cur_log);
+	}
+
+	/*
+	 * Samples logged after the last chunk filled up, that haven't been
+	 * moved to a new chunk yet
+	 */
+	if (!ret && log->pending && log->pending->nr_samples) {
+		ret = log_stream_write(log, log->pending);
+		log->pending->nr_samples = 0;
+	}
+
+	if (log->stream_f) {
+		if (fclose(log->stream_f) && !ret) {
+			log_err("fio: close log %s: %s\n", log->filename,
+				strerror(errno));
+			ret = 1;
+		}
+		log->stream_f = NULL;
+	}
+
+	return ret;
+}
+
+static struct workqueue_ops log_stream_wq_ops = {
+	.fn		= log_stream_work_fn,
+	.nice		= 1,
+};
+
+int log_stream_init(struct thread_data *td, struct sk_out *sk_out)
+{
+	if (!(td->flags & TD_F_STREAM_LOG))
+		return 0;
+
+	return workqueue_init(td, &td->log_stream_wq, &log_stream_wq_ops, 1,
+				sk_out);
+}
+
+void log_stream_exit(struct thread_data *td)
+{
+	if (!(td->flags & TD_F_STREAM_LOG))
+		return;
+
+	workqueue_exit(&td->log_stream_wq);
+}
@@ -0,0 +1,58 @@
+#ifndef FIO_LOG_STREAM_H
+#define FIO_LOG_STREAM_H
+
+#include <inttypes.h>
+
+/*
+ * Binary latency, bandwidth and IOPS log format, for log_format=binary. All
+ * fields are little endian.
+ *
+ *	struct log_bin_head
+ *	struct log_bin_rec		x nr_records
+ *
+ * Records are appended while the job runs and there's no trailer, so the
+ * number of records follows from the file size, and a log that was cut
+ * short is readable up to its last whole record. Jobs sharing a log with
+ * per_job_logs=0 append whole chunks of records after a single head.
+ */
+#define LOG_BIN_MAGIC		"fio sample log\0"
+#define LOG_BIN_MAGIC_LEN	16
+#define LOG_BIN_VERSION		1
+
+struct log_bin_head {
+	char magic[LOG_BIN_MAGIC_LEN];
+	uint32_t version;
+	uint32_t rec_size;
+	uint32_t log_type;	/* IO_LOG_TYPE_* */
+	uint32_t flags;		/* LOG_*_SAMPLE_BIT of the fields logged */
+};
+
+/*
+ * 'val' is the value column of the text log, 'val_max' is only set with
+ * log_max=2. 'offset' and 'issue_time' are zero unless log_offset and
+ * log_issue_time are set. 'prio' is the full I/O priority.
+ */
+struct log_bin_rec {
+	uint64_t time;
+	uint64_t val;
+	uint64_t val_max;
+	uint64_t bs;
+	uint64_t offset;
+	uint64_t issue_time;
+	uint32_t ddir;
+	uint16_t prio;
+	uint16_t pad;
+};
+
+struct thread_data;
+struct sk_out;
+struct io_log;
+struct io_logs;
+
+extern int log_stream_init(struct thread_data *, struct sk_out *);
+extern void log_stream_exit(struct thread_data *);
+extern int log_stream_queue(struct io_log *, struct io_logs *);
+extern void log_stream_wait(struct io_log *);
+extern int log_stream_finish(struct io_log *);
+
+#endif
@@ -15,6 +15,7 @@
 #include "options.h"
 #include "optgroup.h"
 #include "zbd.h"
+#include "timeline.h"
 
 char client_sockaddr_str[INET6_ADDRSTRLEN] = { 0 };
 
@@ -1874,6 +1875,17 @@ static int str_write_hist_log_cb(void *data, const char *str)
 	return 0;
 }
 
+static int str_write_timeline_log_cb(void *data, const char *str)
+{
+	struct thread_data *td = cb_data_to_td(data);
+
+	if (str)
+		td->o.timeline_log_file = strdup(str);
+
+	td->o.write_timeline_log = 1;
+	return 0;
+}
+
 /*
  * str is supposed to be a substring of the strdup'd original string,
  * and is valid only if it's a regular file path.
@@ -2710,6 +2722,11 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = FIO_RAND_GEN_TAUSWORTHE64,
 			    .help = "64-bit Tausworthe variant",
 			  },
+			  {
+			    .ival = "philox",
+			    .oval = FIO_RAND_GEN_PHILOX,
+			    .help = "Counter based Philox4x32-10 generator",
+			  },
 		},
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_RANDOM,
@@ -3498,6 +3515,40 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_VERIFY,
 	},
+	{
+		.name	= "verify_tracking",
+		.lname	= "Verify tracking",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, verify_tracking),
+		.help	= "How written blocks are remembered for verification",
+		.def	= "list",
+		.parent	= "verify",
+		.hide	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_VERIFY,
+		.posval = {
+			  { .ival = "list",
+			    .oval = VERIFY_TRACK_LIST,
+			    .help = "Keep an entry per written block",
+			  },
+			  { .ival = "bitmap",
+			    .oval = VERIFY_TRACK_BITMAP,
+			    .help = "Keep a bitmap of written blocks per file",
+			  },
+		},
+	},
+	{
+		.name	= "verify_state_interval",
+		.lname	= "Verify state journal interval (msec)",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, verify_state_interval),
+		.help	= "Checkpoint verify state to a journal this often (msec)",
+		.def	= "0",
+		.parent	= "verify_state_save",
+		.hide	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_VERIFY,
+	},
 	{
 		.name	= "verify_write_sequence",
 		.lname	= "Verify write sequence number",
@@ -3607,6 +3658,27 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_IOLOG,
 	},
+	{
+		.name	= "write_iolog_format",
+		.lname	= "Write I/O log format",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, write_iolog_format),
+		.parent	= "write_iolog",
+		.help	= "Format of the IO pattern log",
+		.def	= "text",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IOLOG,
+		.posval	= {
+			   { .ival = "text",
+			     .oval = IOLOG_FORMAT_TEXT,
+			     .help = "Version 3 text iolog",
+			   },
+			   { .ival = "binary",
+			     .oval = IOLOG_FORMAT_BINARY,
+			     .help = "Binary iolog, see read_iolog",
+			   },
+		},
+	},
 	{
 		.name	= "read_iolog",
 		.lname	= "Read I/O log",
@@ -3696,6 +3768,47 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_IOLOG,
 	},
+	{
+		.name	= "replay_shard",
+		.lname	= "Replay Shard",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, replay_shard),
+		.parent	= "read_iolog",
+		.help	= "Split the replayed IO across the clones of a job",
+		.def	= "none",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IOLOG,
+		.posval	= {
+			  { .ival = "none",
+			    .oval = REPLAY_SHARD_NONE,
+			    .help = "Every clone replays the whole log",
+			  },
+			  { .ival = "file",
+			    .oval = REPLAY_SHARD_FILE,
+			    .help = "Split by file",
+			  },
+			  { .ival = "offset",
+			    .oval = REPLAY_SHARD_OFFSET,
+			    .help = "Split by offset, striped in replay_shard_chunk units",
+			  },
+			  { .ival = "hash",
+			    .oval = REPLAY_SHARD_HASH,
+			    .help = "Split by hash of file and replay_shard_chunk",
+			  },
+		},
+	},
+	{
+		.name	= "replay_shard_chunk",
+		.lname	= "Replay Shard Chunk",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, replay_shard_chunk),
+		.parent	= "replay_shard",
+		.def	= "1M",
+		.minval	= 512,
+		.help	= "Granularity of offset and hash replay sharding",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IOLOG,
+	},
 	{
 		.name	= "merge_blktrace_file",
 		.lname	= "Merged blktrace output filename",
@@ -4744,6 +4857,30 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_LOG,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "write_timeline_log",
+		.lname	= "Write timeline log",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, timeline_log_file),
+		.cb	= str_write_timeline_log_cb,
+		.help	= "Write log of bytes and IOs done per sampling interval",
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
+	{
+		.name	= "log_timeline_usec",
+		.lname	= "Timeline interval (usec)",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, log_timeline_usec),
+		.help	= "Sampling interval of the timeline log",
+		.def	= "100",
+		.minval	= TIMELINE_MIN_USEC,
+		.maxval	= 1000000,
+		.parent	= "write_timeline_log",
+		.hide	= 1,
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "log_entries",
 		.lname	= "Log entries",
@@ -4864,6 +5001,30 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_LOG,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "log_format",
+		.lname	= "Log format",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, log_format),
+		.help	= "Format of the latency, bandwidth and IOPS logs",
+		.def	= "text",
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+		.posval	= {
+			   { .ival = "text",
+			     .oval = LOG_FORMAT_TEXT,
+			     .help = "One text line per sample",
+			   },
+			   { .ival = "binary",
+			     .oval = LOG_FORMAT_BINARY,
+			     .help = "Fixed size binary records, streamed to disk",
+			   },
+			   { .ival = "columnar",
+			     .oval = LOG_FORMAT_COLUMNAR,
+			     .help = "Compressed column batches, streamed to disk",
+			   },
+		},
+	},
 #ifdef CONFIG_ZLIB
 	{
 		.name	= "log_compression",
@@ -4905,6 +5066,35 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_LOG,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "log_compression_type",
+		.lname	= "Log compression type",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, log_gz_type),
+		.parent	= "log_compression",
+		.help	= "Compressor used for log chunks",
+		.def	= "zlib",
+		.posval	= {
+			  { .ival = "zlib",
+			    .oval = LOG_COMP_ZLIB,
+			    .help = "zlib deflate",
+			  },
+#ifdef CONFIG_ZSTD
+			  { .ival = "zstd",
+			    .oval = LOG_COMP_ZSTD,
+			    .help = "Zstandard, one frame per chunk",
+			  },
+#endif
+#ifdef CONFIG_LZ4
+			  { .ival = "lz4",
+			    .oval = LOG_COMP_LZ4,
+			    .help = "LZ4, one frame per chunk",
+			  },
+#endif
+		},
+		.category = FIO_OPT_C_LOG,
+		.group	= FIO_OPT_G_INVALID,
+	},
 #else
 	{
 		.name	= "log_compression",
@@ -4918,6 +5108,12 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.type	= FIO_OPT_UNSUPPORTED,
 		.help	= "Install libz-dev(el) to get compression support",
 	},
+	{
+		.name	= "log_compression_type",
+		.lname	= "Log compression type",
+		.type	= FIO_OPT_UNSUPPORTED,
+		.help	= "Install libz-dev(el) to get compression support",
+	},
 #endif
 	{
 		.name = "log_alternate_epoch",
@@ -5160,6 +5356,29 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_STAT,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "lat_histogram_precision",
+		.lname	= "Latency histogram precision",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, lat_hist_precision),
+		.help	= "Significant decimal digits kept by the latency percentile histogram (0 for the default histogram)",
+		.def	= "0",
+		.minval	= 0,
+		.maxval	= FIO_LAT_HIST_MAX_PRECISION,
+		.interval = 1,
+		.category = FIO_OPT_C_STAT,
+		.group	= FIO_OPT_G_INVALID,
+	},
+	{
+		.name	= "lat_histogram_max",
+		.lname	= "Latency histogram range",
+		.type	= FIO_OPT_STR_VAL_TIME,
+		.off1	= offsetof(struct thread_options, lat_hist_max),
+		.help	= "Largest latency tracked at full lat_histogram_precision",
+		.is_time = 1,
+		.category = FIO_OPT_C_STAT,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "significant_figures",
 		.lname	= "Significant figures",
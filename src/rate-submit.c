@@ -154,6 +154,28 @@ static void io_workqueue_free_fn(struct submit_worker *sw)
 	sw->priv = NULL;
 }
 
+/*
+ * Workers can keep latency samples to themselves unless the parent needs
+ * to see each of them as they happen: for per IO logs, per prio stats
+ * and lat_histogram_precision= (workers share the parent arrays) and
+ * steady state detection.
+ */
+static bool stat_shard_ok(struct thread_data *parent)
+{
+	int ddir;
+
+	if (parent->clat_log || parent->slat_log || parent->lat_log ||
+	    parent->clat_hist_log || parent->o.ss_dur ||
+	    parent->ts.hist_bits)
+		return false;
+
+	for (ddir = 0; ddir < DDIR_RWDIR_CNT; ddir++)
+		if (parent->ts.clat_prio[ddir])
+			return false;
+
+	return true;
+}
+
 static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 {
 	struct thread_data *parent = sw->wq->td;
@@ -174,11 +196,11 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 
 	INIT_FLIST_HEAD(&td->io_log_list);
 	INIT_FLIST_HEAD(&td->io_hist_list);
-	INIT_FLIST_HEAD(&td->verify_list);
 	INIT_FLIST_HEAD(&td->trim_list);
 	td->io_hist_tree = RB_ROOT;
 
 	td->o.iodepth = 1;
+	td->ramp_period_state = parent->ramp_period_state;
 	if (td_io_init(td))
 		goto err_io_init;
 
@@ -191,6 +213,8 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 
 	td_set_runstate(td, TD_RUNNING);
 	td->flags |= TD_F_CHILD | TD_F_NEED_LOCK;
+	if (stat_shard_ok(parent))
+		td->flags |= TD_F_STAT_SHARD;
 	td->parent = parent;
 	return 0;
 
@@ -314,6 +338,32 @@ int rate_submit_init(struct thread_data *td, struct sk_out *sk_out)
 	return workqueue_init(td, &td->io_wq, &rated_wq_ops, td->o.iodepth, sk_out);
 }
 
+/*
+ * Workers add latency samples to their own thread_stat, so completions on
+ * different workers never touch the same histogram. Fold what they have
+ * gathered into the parent when somebody is about to look at its stats.
+ * Must be called from the parent.
+ */
+void rate_submit_sum_stats(struct thread_data *td)
+{
+	struct workqueue *wq = &td->io_wq;
+	int i;
+
+	if (td->o.io_submit_mode != IO_MODE_OFFLOAD || !wq->workers)
+		return;
+
+	for (i = 0; i < wq->max_workers; i++) {
+		struct thread_data *wtd = wq->workers[i].priv;
+
+		if (!wtd)
+			continue;
+
+		__td_io_u_lock(wtd);
+		move_lat_stats(&td->ts, &wtd->ts);
+		__td_io_u_unlock(wtd);
+	}
+}
+
 void rate_submit_exit(struct thread_data *td)
 {
 	if (td->o.io_submit_mode != IO_MODE_OFFLOAD)
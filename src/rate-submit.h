@@ -3,5 +3,6 @@
 
 int rate_submit_init(struct thread_data *, struct sk_out *);
 void rate_submit_exit(struct thread_data *);
+void rate_submit_sum_stats(struct thread_data *);
 
 #endif
@@ -24,6 +24,7 @@
 #include "server.h"
 #include "crc/crc16.h"
 #include "lib/ieee754.h"
+#include "lib/varint.h"
 #include "verify-state.h"
 #include "smalloc.h"
 
@@ -119,6 +120,7 @@ static const char *fio_server_ops[FIO_NET_CMD_NR] = {
 	"VTRIGGER",
 	"SENDFILE",
 	"JOB_OPT",
+	"DELTA",
 };
 
 static void sk_lock(struct sk_out *sk_out)
@@ -364,6 +366,29 @@ static int verify_convert_cmd(struct fio_net_cmd *cmd)
 	return 0;
 }
 
+static void fio_net_cmd_finish(struct fio_net_cmd *cmd)
+{
+	/* zero-terminate text input */
+	if (cmd->pdu_len) {
+		if (cmd->opcode == FIO_NET_CMD_TEXT) {
+			struct cmd_text_pdu *__pdu = (struct cmd_text_pdu *) cmd->payload;
+			char *buf = (char *) __pdu->buf;
+			int len = le32_to_cpu(__pdu->buf_len);
+
+			buf[len] = '\0';
+		} else if (cmd->opcode == FIO_NET_CMD_JOB) {
+			struct cmd_job_pdu *__pdu = (struct cmd_job_pdu *) cmd->payload;
+			char *buf = (char *) __pdu->buf;
+			int len = le32_to_cpu(__pdu->buf_len);
+
+			buf[len] = '\0';
+		}
+	}
+
+	/* frag flag is internal */
+	cmd->flags &= ~FIO_NET_CMD_F_MORE;
+}
+
 /*
  * Read (and defragment, if necessary) incoming commands
  */
@@ -442,29 +467,136 @@ struct fio_net_cmd *fio_net_recv_cmd(int sk, bool wait)
 	if (ret) {
 		free(cmdret);
 		cmdret = NULL;
-	} else if (cmdret) {
-		/* zero-terminate text input */
-		if (cmdret->pdu_len) {
-			if (cmdret->opcode == FIO_NET_CMD_TEXT) {
-				struct cmd_text_pdu *__pdu = (struct cmd_text_pdu *) cmdret->payload;
-				char *buf = (char *) __pdu->buf;
-				int len = le32_to_cpu(__pdu->buf_len);
-
-				buf[len] = '\0';
-			} else if (cmdret->opcode == FIO_NET_CMD_JOB) {
-				struct cmd_job_pdu *__pdu = (struct cmd_job_pdu *) cmdret->payload;
-				char *buf = (char *) __pdu->buf;
-				int len = le32_to_cpu(__pdu->buf_len);
-
-				buf[len] = '\0';
+	} else if (cmdret)
+		fio_net_cmd_finish(cmdret);
+
+	return cmdret;
+}
+
+/*
+ * Read what the socket has for us, at most FIO_NET_RX_CHUNK bytes. Returns
+ * the number of bytes read, 0 if there was nothing, or -1 if the connection
+ * is gone. Commands are taken out with fio_net_rx_cmd().
+ */
+ssize_t fio_net_rx_fill(int sk, struct fio_net_rx *rx)
+{
+	ssize_t ret;
+
+	if (rx->start) {
+		memmove(rx->buf, rx->buf + rx->start, rx->len - rx->start);
+		rx->len -= rx->start;
+		rx->start = 0;
+	}
+
+	if (rx->size - rx->len < FIO_NET_RX_CHUNK) {
+		size_t size = rx->len + FIO_NET_RX_CHUNK;
+		uint8_t *buf;
+
+		buf = realloc(rx->buf, size);
+		if (!buf) {
+			log_err("fio: failed allocating receive buffer\n");
+			return -1;
+		}
+		rx->buf = buf;
+		rx->size = size;
+	}
+
+	do {
+		ret = recv(sk, rx->buf + rx->len, rx->size - rx->len,
+				OS_MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret > 0) {
+		rx->len += ret;
+		return ret;
+	} else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+
+	return -1;
+}
+
+/*
+ * Take the next complete command out of the received data, defragmenting
+ * it if need be. Returns NULL if it isn't all there yet, or if it is bad,
+ * in which case 'err' is set and the connection should be dropped.
+ */
+struct fio_net_cmd *fio_net_rx_cmd(struct fio_net_rx *rx, int *err)
+{
+	struct fio_net_cmd cmd, *cmdret;
+	uint8_t *pdu;
+	uint16_t crc;
+
+	*err = 0;
+
+	while (rx->len - rx->start >= sizeof(cmd)) {
+		memcpy(&cmd, rx->buf + rx->start, sizeof(cmd));
+		if (verify_convert_cmd(&cmd))
+			goto err;
+		if (rx->len - rx->start < sizeof(cmd) + cmd.pdu_len)
+			break;
+
+		pdu = rx->buf + rx->start + sizeof(cmd);
+		crc = fio_crc16(pdu, cmd.pdu_len);
+		if (cmd.pdu_len && crc != cmd.pdu_crc16) {
+			log_err("fio: server bad crc on payload ");
+			log_err("(got %x, wanted %x)\n", cmd.pdu_crc16, crc);
+			goto err;
+		}
+
+		if (!rx->cmd) {
+			/* if this is text, add room for \0 at the end */
+			rx->cmd_size = sizeof(cmd) + cmd.pdu_len + 1;
+		} else {
+			if (rx->cmd->opcode != cmd.opcode) {
+				log_err("fio: fragment opcode mismatch (%d != %d)\n",
+						rx->cmd->opcode, cmd.opcode);
+				goto err;
 			}
+			rx->cmd_size += cmd.pdu_len;
+		}
+
+		if (rx->cmd_size / 1024 > FIO_SERVER_MAX_CMD_MB * 1024) {
+			log_err("fio: cmd+pdu too large (%llu)\n",
+					(unsigned long long) rx->cmd_size);
+			goto err;
 		}
 
-		/* frag flag is internal */
-		cmdret->flags &= ~FIO_NET_CMD_F_MORE;
+		cmdret = realloc(rx->cmd, rx->cmd_size);
+		if (!cmdret) {
+			log_err("fio: server failed allocating cmd\n");
+			goto err;
+		}
+
+		if (!rx->cmd) {
+			memcpy(cmdret, &cmd, sizeof(cmd));
+			memcpy(cmdret->payload, pdu, cmd.pdu_len);
+		} else {
+			memcpy(cmdret->payload + cmdret->pdu_len, pdu, cmd.pdu_len);
+			cmdret->pdu_len += cmd.pdu_len;
+		}
+		rx->cmd = cmdret;
+		rx->start += sizeof(cmd) + cmd.pdu_len;
+
+		if (!cmd.pdu_len || !(cmd.flags & FIO_NET_CMD_F_MORE)) {
+			rx->cmd = NULL;
+			fio_net_cmd_finish(cmdret);
+			return cmdret;
+		}
 	}
 
-	return cmdret;
+	return NULL;
+err:
+	free(rx->cmd);
+	rx->cmd = NULL;
+	*err = 1;
+	return NULL;
+}
+
+void fio_net_rx_free(struct fio_net_rx *rx)
+{
+	free(rx->cmd);
+	free(rx->buf);
+	memset(rx, 0, sizeof(*rx));
 }
 
 static void add_reply(uint64_t tag, struct flist_head *list)
@@ -621,6 +753,276 @@ static int fio_net_queue_cmd(uint16_t opcode, void *buf, off_t size,
 	return 1;
 }
 
+/*
+ * Last payload of a delta stream, see struct cmd_delta_pdu
+ */
+struct net_delta_base {
+	struct flist_head list;
+	uint16_t opcode;
+	uint64_t stream;
+	uint32_t len;
+	uint64_t *words;
+};
+
+static unsigned int use_delta;
+static FLIST_HEAD(delta_bases);
+static pthread_mutex_t delta_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int delta_words(uint32_t len)
+{
+	return (len + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+static struct net_delta_base *delta_base(struct flist_head *list,
+					 uint16_t opcode, uint64_t stream)
+{
+	struct net_delta_base *base;
+	struct flist_head *entry;
+
+	flist_for_each(entry, list) {
+		base = flist_entry(entry, struct net_delta_base, list);
+		if (base->opcode == opcode && base->stream == stream)
+			return base;
+	}
+
+	base = calloc(1, sizeof(*base));
+	if (!base)
+		return NULL;
+
+	base->opcode = opcode;
+	base->stream = stream;
+	flist_add_tail(&base->list, list);
+	return base;
+}
+
+/*
+ * Make 'words' the base of the next payload of the stream
+ */
+static void delta_base_update(struct net_delta_base *base, uint32_t len,
+			      uint64_t *words)
+{
+	free(base->words);
+	base->words = words;
+	base->len = len;
+}
+
+void fio_net_delta_free(struct flist_head *list)
+{
+	struct net_delta_base *base;
+
+	while (!flist_empty(list)) {
+		base = flist_first_entry(list, struct net_delta_base, list);
+		flist_del(&base->list);
+		free(base->words);
+		free(base);
+	}
+}
+
+/*
+ * Sparse encode the difference of 'buf' with the base of the stream, and
+ * queue it as FIO_NET_CMD_DELTA. Only the sender of a stream may update
+ * its base, the lock keeps the queue order the same as the update order.
+ */
+static int __fio_net_queue_delta(uint16_t opcode, uint64_t stream, void *buf,
+				 off_t size, uint64_t *tagptr)
+{
+	unsigned int i, nwords = delta_words(size), nz = 0;
+	struct cmd_delta_pdu *pdu = NULL;
+	struct net_delta_base *base;
+	uint64_t *words, *diff = NULL;
+	uint8_t *enc = NULL;
+	size_t enc_len, pdu_len;
+	int ret = 1;
+
+	words = calloc(nwords, sizeof(uint64_t));
+	diff = calloc(nwords, sizeof(uint64_t));
+	if (!words || !diff)
+		goto err;
+
+	memcpy(words, buf, size);
+	for (i = 0; i < nwords; i++)
+		words[i] = le64_to_cpu(words[i]);
+
+	pthread_mutex_lock(&delta_lock);
+
+	base = delta_base(&delta_bases, opcode, stream);
+	if (!base) {
+		pthread_mutex_unlock(&delta_lock);
+		goto err;
+	}
+
+	for (i = 0; i < nwords; i++) {
+		uint64_t prev = base->len == size ? base->words[i] : 0;
+
+		diff[i] = zigzag_enc(words[i] - prev);
+		nz += diff[i] != 0;
+	}
+
+	enc = malloc((2 * nz + 1) * VARINT_MAX_LEN);
+	pdu = malloc(sizeof(*pdu) + (2 * nz + 1) * VARINT_MAX_LEN);
+	if (!enc || !pdu) {
+		pthread_mutex_unlock(&delta_lock);
+		goto err;
+	}
+
+	enc_len = varint_enc_sparse(enc, diff, 1, nwords);
+
+	memset(pdu, 0, sizeof(*pdu));
+	pdu->opcode = cpu_to_le16(opcode);
+	pdu->len = cpu_to_le32((uint32_t) size);
+	pdu->stream = cpu_to_le64(stream);
+	pdu->enc_len = cpu_to_le32((uint32_t) enc_len);
+	if (base->len == size)
+		pdu->flags |= FIO_DELTA_F_BASE;
+
+	pdu->buf_len = enc_len;
+#ifdef CONFIG_ZLIB
+	if (use_zlib) {
+		uLongf zlen = enc_len;
+
+		/*
+		 * Only worth it if it's smaller, don't bother otherwise
+		 */
+		if (compress2(pdu->buf, &zlen, enc, enc_len, Z_BEST_SPEED) == Z_OK &&
+		    zlen < enc_len) {
+			pdu->flags |= FIO_DELTA_F_ZLIB;
+			pdu->buf_len = zlen;
+		}
+	}
+#endif
+	if (!(pdu->flags & FIO_DELTA_F_ZLIB))
+		memcpy(pdu->buf, enc, enc_len);
+
+	dprint(FD_NET, "server: delta %s, %u -> %u bytes\n",
+		fio_server_op(opcode), (unsigned int) size, pdu->buf_len);
+
+	pdu->flags = cpu_to_le16(pdu->flags);
+	pdu_len = sizeof(*pdu) + pdu->buf_len;
+	pdu->buf_len = cpu_to_le32(pdu->buf_len);
+
+	delta_base_update(base, size, words);
+	words = NULL;
+	ret = fio_net_queue_cmd(FIO_NET_CMD_DELTA, pdu, pdu_len, tagptr,
+				SK_F_COPY);
+
+	pthread_mutex_unlock(&delta_lock);
+err:
+	free(words);
+	free(diff);
+	free(enc);
+	free(pdu);
+	return ret;
+}
+
+/*
+ * Queue a TS or ETA payload, as a delta if the client takes them. Same
+ * flags as fio_net_queue_cmd(), the payload is always copied.
+ */
+static int fio_net_queue_delta(uint16_t opcode, uint64_t stream, void *buf,
+			       off_t size, uint64_t *tagptr, int flags)
+{
+	int ret;
+
+	if (!use_delta)
+		return fio_net_queue_cmd(opcode, buf, size, tagptr, flags);
+
+	ret = __fio_net_queue_delta(opcode, stream, buf, size, tagptr);
+	if (flags & SK_F_FREE)
+		free(buf);
+	return ret;
+}
+
+/*
+ * Turn a received FIO_NET_CMD_DELTA back into the command it holds, using
+ * and updating the bases in 'list'. The delta is freed, returns the new
+ * command or NULL if the delta is malformed.
+ */
+struct fio_net_cmd *fio_net_delta_decode(struct flist_head *list,
+					 struct fio_net_cmd *cmd)
+{
+	struct cmd_delta_pdu *pdu = (struct cmd_delta_pdu *) cmd->payload;
+	uint32_t len, enc_len, buf_len;
+	struct fio_net_cmd *ret = NULL;
+	struct net_delta_base *base;
+	uint64_t *words = NULL;
+	uint8_t *enc = NULL;
+	unsigned int i, nwords;
+	uint16_t flags;
+
+	if (cmd->pdu_len < sizeof(*pdu))
+		goto err;
+
+	flags = le16_to_cpu(pdu->flags);
+	len = le32_to_cpu(pdu->len);
+	enc_len = le32_to_cpu(pdu->enc_len);
+	buf_len = le32_to_cpu(pdu->buf_len);
+	if (buf_len != cmd->pdu_len - sizeof(*pdu))
+		goto err;
+
+	nwords = delta_words(len);
+	if (enc_len > (2 * (uint64_t) nwords + 1) * VARINT_MAX_LEN)
+		goto err;
+
+	if (flags & FIO_DELTA_F_ZLIB) {
+#ifdef CONFIG_ZLIB
+		uLongf zlen = enc_len;
+
+		enc = malloc(enc_len);
+		if (!enc)
+			goto err;
+		if (uncompress(enc, &zlen, pdu->buf, buf_len) != Z_OK ||
+		    zlen != enc_len)
+			goto err;
+#else
+		log_err("fio: compressed delta, but no zlib support\n");
+		goto err;
+#endif
+	} else if (buf_len != enc_len)
+		goto err;
+
+	words = calloc(nwords, sizeof(uint64_t));
+	if (!words)
+		goto err;
+	if (varint_dec_sparse(enc ? enc : pdu->buf, enc_len, words, 1,
+			      nwords) != enc_len)
+		goto err;
+
+	base = delta_base(list, le16_to_cpu(pdu->opcode),
+			  le64_to_cpu(pdu->stream));
+	if (!base)
+		goto err;
+	if (flags & FIO_DELTA_F_BASE) {
+		if (base->len != len)
+			goto err;
+		for (i = 0; i < nwords; i++)
+			words[i] = base->words[i] + zigzag_dec(words[i]);
+	} else {
+		for (i = 0; i < nwords; i++)
+			words[i] = zigzag_dec(words[i]);
+	}
+
+	ret = malloc(sizeof(*ret) + nwords * sizeof(uint64_t));
+	if (!ret)
+		goto err;
+
+	memcpy(ret, cmd, sizeof(*ret));
+	ret->opcode = le16_to_cpu(pdu->opcode);
+	ret->pdu_len = len;
+	for (i = 0; i < nwords; i++) {
+		uint64_t w = cpu_to_le64(words[i]);
+
+		memcpy(ret->payload + i * sizeof(w), &w, sizeof(w));
+	}
+
+	delta_base_update(base, len, words);
+	words = NULL;
+err:
+	free(words);
+	free(enc);
+	free(cmd);
+	return ret;
+}
+
 static int fio_net_send_simple_stack_cmd(int sk, uint16_t opcode, uint64_t tag)
 {
 	struct fio_net_cmd cmd;
@@ -993,6 +1395,7 @@ static int handle_probe_cmd(struct fio_net_cmd *cmd)
 {
 	struct cmd_client_probe_pdu *pdu = (struct cmd_client_probe_pdu *) cmd->payload;
 	uint64_t tag = cmd->tag;
+	uint64_t flags = 0;
 	struct cmd_probe_reply_pdu probe = {
 #ifdef CONFIG_BIG_ENDIAN
 		.bigendian	= 1,
@@ -1015,12 +1418,21 @@ static int handle_probe_cmd(struct fio_net_cmd *cmd)
 	 * If the client supports compression and we do too, then enable it
 	 */
 	if (has_zlib && le64_to_cpu(pdu->flags) & FIO_PROBE_FLAG_ZLIB) {
-		probe.flags = __cpu_to_le64(FIO_PROBE_FLAG_ZLIB);
+		flags |= FIO_PROBE_FLAG_ZLIB;
 		use_zlib = 1;
-	} else {
-		probe.flags = 0;
+	} else
 		use_zlib = 0;
-	}
+
+	/*
+	 * Send TS and ETA updates as deltas, if the client can take them
+	 */
+	if (le64_to_cpu(pdu->flags) & FIO_PROBE_FLAG_DELTA) {
+		flags |= FIO_PROBE_FLAG_DELTA;
+		use_delta = 1;
+	} else
+		use_delta = 0;
+
+	probe.flags = __cpu_to_le64(flags);
 
 	return fio_net_queue_cmd(FIO_NET_CMD_PROBE, &probe, sizeof(probe), &tag, SK_F_COPY);
 }
@@ -1065,7 +1477,7 @@ static int handle_send_eta_cmd(struct fio_net_cmd *cmd)
 		je->unit_base		= cpu_to_le32(je->unit_base);
 	}
 
-	fio_net_queue_cmd(FIO_NET_CMD_ETA, je, size, &tag, SK_F_FREE);
+	fio_net_queue_delta(FIO_NET_CMD_ETA, 0, je, size, &tag, SK_F_FREE);
 	return 0;
 }
 
@@ -1689,10 +2101,15 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	struct cmd_ts_pdu p;
 	int i, j, k;
 	size_t clat_prio_stats_extra_size = 0;
+	size_t hist_extra_size = 0;
 	size_t ss_extra_size = 0;
 	size_t extended_buf_size = 0;
 	void *extended_buf;
 	void *extended_buf_wp;
+	/*
+	 * Status updates of a job are deltas of its previous one
+	 */
+	uint64_t stream = ((uint64_t) ts->groupid << 32) | ts->thread_number;
 
 	dprint(FD_NET, "server sending end stats\n");
 
@@ -1808,6 +2225,9 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	p.ts.cachehit		= cpu_to_le64(ts->cachehit);
 	p.ts.cachemiss		= cpu_to_le64(ts->cachemiss);
 
+	p.ts.hist_bits		= cpu_to_le32(ts->hist_bits);
+	p.ts.hist_groups	= cpu_to_le32(ts->hist_groups);
+
 	convert_gs(&p.rs, rs);
 
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
@@ -1816,13 +2236,21 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 	}
 	extended_buf_size += clat_prio_stats_extra_size;
 
+	for (i = 0; i < FIO_LAT_CNT; i++) {
+		if (ts->hist_plat[i])
+			hist_extra_size += DDIR_RWDIR_CNT * lat_hist_nr(ts) *
+						sizeof(uint64_t);
+	}
+	extended_buf_size += hist_extra_size;
+
 	dprint(FD_NET, "ts->ss_state = %d\n", ts->ss_state);
 	if (ts->ss_state & FIO_SS_DATA)
 		ss_extra_size = 3 * ts->ss_dur * sizeof(uint64_t);
 
 	extended_buf_size += ss_extra_size;
 	if (!extended_buf_size) {
-		fio_net_queue_cmd(FIO_NET_CMD_TS, &p, sizeof(p), NULL, SK_F_COPY);
+		fio_net_queue_delta(FIO_NET_CMD_TS, stream, &p, sizeof(p), NULL,
+					SK_F_COPY);
 		return;
 	}
 
@@ -1862,6 +2290,26 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 		}
 	}
 
+	if (hist_extra_size) {
+		size_t nr = DDIR_RWDIR_CNT * lat_hist_nr(ts);
+		struct cmd_ts_pdu *ptr = extended_buf;
+
+		for (i = 0; i < FIO_LAT_CNT; i++) {
+			uint64_t *plat = extended_buf_wp;
+			uint64_t offset;
+
+			if (!ts->hist_plat[i])
+				continue;
+
+			for (j = 0; j < nr; j++)
+				plat[j] = cpu_to_le64(ts->hist_plat[i][j]);
+
+			offset = (char *)extended_buf_wp - (char *)extended_buf;
+			ptr->ts.hist_plat_offset[i] = cpu_to_le64(offset);
+			extended_buf_wp = plat + nr;
+		}
+	}
+
 	if (ss_extra_size) {
 		uint64_t *ss_iops, *ss_bw, *ss_lat;
 		uint64_t offset;
@@ -1896,7 +2344,8 @@ void fio_server_send_ts(struct thread_stat *ts, struct group_run_stats *rs)
 		ptr->ts.ss_lat_data_offset = cpu_to_le64(offset);
 	}
 
-	fio_net_queue_cmd(FIO_NET_CMD_TS, extended_buf, extended_buf_size, NULL, SK_F_COPY);
+	fio_net_queue_delta(FIO_NET_CMD_TS, stream, extended_buf,
+				extended_buf_size, NULL, SK_F_COPY);
 	free(extended_buf);
 }
 
@@ -2085,14 +2534,15 @@ static int __fio_append_iolog_gz_hist(struct sk_entry *first, struct io_log *log
 		cur_plat  = cur_plat_entry->io_u_plat;
 		prev_plat = prev_plat_entry->io_u_plat;
 
-		for (j = 0; j < FIO_IO_U_PLAT_NR; j++) {
+		for (j = 0; j < log->hist_nr; j++) {
 			cur_plat[j] -= prev_plat[j];
 		}
 
 		flist_del(&prev_plat_entry->list);
 		free(prev_plat_entry);
 
-		ret = __deflate_pdu_buffer(cur_plat_entry, sizeof(*cur_plat_entry),
+		ret = __deflate_pdu_buffer(cur_plat_entry,
+					   io_u_plat_entry_sz(log->hist_nr),
 					   &out_pdu, &entry, stream, first);
 
 		if (ret)
@@ -2270,6 +2720,7 @@ int fio_send_iolog(struct thread_data *td, struct io_log *log, const char *name)
 		.thread_number		= cpu_to_le32(td->thread_number),
 		.log_type		= cpu_to_le32(log->log_type),
 		.log_hist_coarseness	= cpu_to_le32(log->hist_coarseness),
+		.log_hist_nr		= cpu_to_le32(log->hist_nr),
 		.per_job_logs		= cpu_to_le32(td->o.per_job_logs),
 	};
 	struct sk_entry *first;
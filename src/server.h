@@ -43,6 +43,21 @@ struct fio_net_cmd {
 	uint8_t payload[];	/* payload */
 };
 
+/*
+ * Data received on a connection that isn't a whole command yet, see
+ * fio_net_rx_fill() and fio_net_rx_cmd()
+ */
+struct fio_net_rx {
+	uint8_t *buf;
+	size_t start;		/* first byte not yet parsed */
+	size_t len;		/* bytes received */
+	size_t size;
+	struct fio_net_cmd *cmd;	/* command being defragmented */
+	size_t cmd_size;
+};
+
+#define FIO_NET_RX_CHUNK	(256 * 1024)
+
 struct fio_net_cmd_reply {
 	struct flist_head list;
 	struct timespec ts;
@@ -51,7 +66,7 @@ struct fio_net_cmd_reply {
 };
 
 enum {
-	FIO_SERVER_VER			= 116,
+	FIO_SERVER_VER			= 126,
 
 	FIO_SERVER_MAX_FRAGMENT_PDU	= 1024,
 	FIO_SERVER_MAX_CMD_MB		= 2048,
@@ -78,7 +93,8 @@ enum {
 	FIO_NET_CMD_VTRIGGER		= 20,
 	FIO_NET_CMD_SENDFILE		= 21,
 	FIO_NET_CMD_JOB_OPT		= 22,
-	FIO_NET_CMD_NR			= 23,
+	FIO_NET_CMD_DELTA		= 23,
+	FIO_NET_CMD_NR			= 24,
 
 	FIO_NET_CMD_F_MORE		= 1UL << 0,
 
@@ -91,6 +107,7 @@ enum {
 	FIO_NET_CLIENT_TIMEOUT		= 5000,
 
 	FIO_PROBE_FLAG_ZLIB		= 1UL << 0,
+	FIO_PROBE_FLAG_DELTA		= 1UL << 1,
 };
 
 struct cmd_sendfile {
@@ -199,11 +216,36 @@ struct cmd_iolog_pdu {
 	uint32_t log_prio;
 	uint32_t log_issue_time;
 	uint32_t log_hist_coarseness;
+	uint32_t log_hist_nr;
 	uint32_t per_job_logs;
 	uint8_t name[FIO_NET_NAME_MAX];
 	struct io_sample samples[0];
 };
 
+/*
+ * FIO_NET_CMD_DELTA carries a TS or ETA payload, if the client announced
+ * FIO_PROBE_FLAG_DELTA. The payload is taken as little endian 64-bit words,
+ * each replaced with the zigzag encoded difference to the same word of the
+ * previous payload of the stream (FIO_DELTA_F_BASE), or to 0. The non-zero
+ * differences are sparse encoded with lib/varint.c, and the result is
+ * deflated if that's enabled and makes it smaller (FIO_DELTA_F_ZLIB).
+ * Mostly empty histograms and counters that didn't change take no space.
+ */
+struct cmd_delta_pdu {
+	uint16_t opcode;	/* opcode of the payload */
+	uint16_t flags;		/* FIO_DELTA_F_* */
+	uint32_t len;		/* payload length */
+	uint64_t stream;	/* stream of payloads the delta is within */
+	uint32_t enc_len;	/* sparse encoded length */
+	uint32_t buf_len;	/* length of buf */
+	uint8_t buf[];
+};
+
+enum {
+	FIO_DELTA_F_BASE	= 1U << 0,
+	FIO_DELTA_F_ZLIB	= 1U << 1,
+};
+
 struct cmd_job_option {
 	uint16_t global;
 	uint16_t truncated;
@@ -231,6 +273,11 @@ extern int fio_server_get_verify_state(const char *, int, void **);
 extern bool fio_server_poll_fd(int fd, short events, int timeout);
 
 extern struct fio_net_cmd *fio_net_recv_cmd(int sk, bool wait);
+extern ssize_t fio_net_rx_fill(int sk, struct fio_net_rx *);
+extern struct fio_net_cmd *fio_net_rx_cmd(struct fio_net_rx *, int *);
+extern void fio_net_rx_free(struct fio_net_rx *);
+extern struct fio_net_cmd *fio_net_delta_decode(struct flist_head *, struct fio_net_cmd *);
+extern void fio_net_delta_free(struct flist_head *);
 
 extern int fio_send_iolog(struct thread_data *, struct io_log *, const char *);
 extern void fio_server_send_add_job(struct thread_data *);
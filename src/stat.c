@@ -17,6 +17,7 @@
 #include "smalloc.h"
 #include "zbd.h"
 #include "oslib/asprintf.h"
+#include "log_stream.h"
 
 #ifdef WIN32
 #define LOG_MSEC_SLACK	2
@@ -64,14 +65,15 @@ void update_rusage_stat(struct thread_data *td)
 
 /*
  * Given a latency, return the index of the corresponding bucket in
- * the structure tracking percentiles.
+ * a histogram with @bits index bits per group and @nr buckets.
  *
  * (1) find the group (and error bits) that the value (latency)
  * belongs to by looking at its MSB. (2) find the bucket number in the
  * group by looking at the index bits.
  *
  */
-static unsigned int plat_val_to_idx(unsigned long long val)
+static unsigned int __plat_val_to_idx(unsigned long long val,
+				      unsigned int bits, unsigned int nr)
 {
 	unsigned int msb, error_bits, base, offset, idx;
 
@@ -82,56 +84,100 @@ static unsigned int plat_val_to_idx(unsigned long long val)
 		msb = (sizeof(val)*8) - __builtin_clzll(val) - 1;
 
 	/*
-	 * MSB <= (FIO_IO_U_PLAT_BITS-1), cannot be rounded off. Use
-	 * all bits of the sample as index
+	 * MSB <= (bits-1), cannot be rounded off. Use all bits of the
+	 * sample as index
 	 */
-	if (msb <= FIO_IO_U_PLAT_BITS)
+	if (msb <= bits)
 		return val;
 
 	/* Compute the number of error bits to discard*/
-	error_bits = msb - FIO_IO_U_PLAT_BITS;
+	error_bits = msb - bits;
 
 	/* Compute the number of buckets before the group */
-	base = (error_bits + 1) << FIO_IO_U_PLAT_BITS;
+	base = (error_bits + 1) << bits;
 
 	/*
 	 * Discard the error bits and apply the mask to find the
 	 * index for the buckets in the group
 	 */
-	offset = (FIO_IO_U_PLAT_VAL - 1) & (val >> error_bits);
+	offset = ((1U << bits) - 1) & (val >> error_bits);
 
 	/* Make sure the index does not exceed (array size - 1) */
-	idx = (base + offset) < (FIO_IO_U_PLAT_NR - 1) ?
-		(base + offset) : (FIO_IO_U_PLAT_NR - 1);
+	idx = (base + offset) < (nr - 1) ? (base + offset) : (nr - 1);
 
 	return idx;
 }
 
+/*
+ * Given a latency, return the index of the corresponding bucket in
+ * the structure tracking percentiles.
+ */
+static unsigned int plat_val_to_idx(unsigned long long val)
+{
+	return __plat_val_to_idx(val, FIO_IO_U_PLAT_BITS, FIO_IO_U_PLAT_NR);
+}
+
 /*
  * Convert the given index of the bucket array to the value
  * represented by the bucket
  */
-static unsigned long long plat_idx_to_val(unsigned int idx)
+static unsigned long long __plat_idx_to_val(unsigned int idx,
+					    unsigned int bits)
 {
 	unsigned int error_bits;
 	unsigned long long k, base;
 
-	assert(idx < FIO_IO_U_PLAT_NR);
-
-	/* MSB <= (FIO_IO_U_PLAT_BITS-1), cannot be rounded off. Use
-	 * all bits of the sample as index */
-	if (idx < (FIO_IO_U_PLAT_VAL << 1))
+	/* MSB <= (bits-1), cannot be rounded off. Use all bits of the
+	 * sample as index */
+	if (idx < (2U << bits))
 		return idx;
 
 	/* Find the group and compute the minimum value of that group */
-	error_bits = (idx >> FIO_IO_U_PLAT_BITS) - 1;
-	base = ((unsigned long long) 1) << (error_bits + FIO_IO_U_PLAT_BITS);
+	error_bits = (idx >> bits) - 1;
+	base = ((unsigned long long) 1) << (error_bits + bits);
 
 	/* Find its bucket number of the group */
-	k = idx % FIO_IO_U_PLAT_VAL;
+	k = idx & ((1U << bits) - 1);
 
 	/* Return the mean of the range of the bucket */
-	return base + ((k + 0.5) * (1 << error_bits));
+	return base + ((k + 0.5) * (1ULL << error_bits));
+}
+
+/*
+ * A latency histogram to compute percentiles from: either one of the
+ * fixed io_u_plat arrays, or a lat_histogram_precision= one.
+ */
+struct lat_hist {
+	const uint64_t *plat;
+	unsigned int bits;
+	unsigned int nr;
+};
+
+static struct lat_hist fixed_lat_hist(const uint64_t *io_u_plat)
+{
+	return (struct lat_hist) {
+		.plat	= io_u_plat,
+		.bits	= FIO_IO_U_PLAT_BITS,
+		.nr	= FIO_IO_U_PLAT_NR,
+	};
+}
+
+/*
+ * Pick the most precise histogram @ts has for @lat and @ddir
+ */
+static struct lat_hist ts_lat_hist(const struct thread_stat *ts,
+				   enum fio_lat lat, int ddir)
+{
+	unsigned int nr = lat_hist_nr(ts);
+
+	if (!ts->hist_plat[lat])
+		return fixed_lat_hist(ts->io_u_plat[lat][ddir]);
+
+	return (struct lat_hist) {
+		.plat	= ts->hist_plat[lat] + ddir * nr,
+		.bits	= ts->hist_bits,
+		.nr	= nr,
+	};
 }
 
 static int double_cmp(const void *a, const void *b)
@@ -148,9 +194,12 @@ static int double_cmp(const void *a, const void *b)
 	return cmp;
 }
 
-unsigned int calc_clat_percentiles(const uint64_t *io_u_plat, unsigned long long nr,
-				   fio_fp64_t *plist, unsigned long long **output,
-				   unsigned long long *maxv, unsigned long long *minv)
+static unsigned int __calc_clat_percentiles(struct lat_hist h,
+					    unsigned long long nr,
+					    fio_fp64_t *plist,
+					    unsigned long long **output,
+					    unsigned long long *maxv,
+					    unsigned long long *minv)
 {
 	unsigned long long sum = 0;
 	unsigned int len, i, j = 0;
@@ -183,12 +232,12 @@ unsigned int calc_clat_percentiles(const uint64_t *io_u_plat, unsigned long long
 	 * Calculate bucket values, note down max and min values
 	 */
 	is_last = false;
-	for (i = 0; i < FIO_IO_U_PLAT_NR && !is_last; i++) {
-		sum += io_u_plat[i];
+	for (i = 0; i < h.nr && !is_last; i++) {
+		sum += h.plat[i];
 		while (sum >= ((long double) plist[j].u.f / 100.0 * nr)) {
 			assert(plist[j].u.f <= 100.0);
 
-			ovals[j] = plat_idx_to_val(i);
+			ovals[j] = __plat_idx_to_val(i, h.bits);
 			if (ovals[j] < *minv)
 				*minv = ovals[j];
 			if (ovals[j] > *maxv)
@@ -209,10 +258,18 @@ unsigned int calc_clat_percentiles(const uint64_t *io_u_plat, unsigned long long
 	return len;
 }
 
+unsigned int calc_clat_percentiles(const uint64_t *io_u_plat, unsigned long long nr,
+				   fio_fp64_t *plist, unsigned long long **output,
+				   unsigned long long *maxv, unsigned long long *minv)
+{
+	return __calc_clat_percentiles(fixed_lat_hist(io_u_plat), nr, plist,
+				       output, maxv, minv);
+}
+
 /*
  * Find and display the p-th percentile of clat
  */
-static void show_clat_percentiles(const uint64_t *io_u_plat, unsigned long long nr,
+static void show_clat_percentiles(struct lat_hist h, unsigned long long nr,
 				  fio_fp64_t *plist, unsigned int precision,
 				  const char *pre, struct buf_output *out)
 {
@@ -223,7 +280,7 @@ static void show_clat_percentiles(const uint64_t *io_u_plat, unsigned long long
 	bool is_last;
 	char fmt[32];
 
-	len = calc_clat_percentiles(io_u_plat, nr, plist, &ovals, &maxv, &minv);
+	len = __calc_clat_percentiles(h, nr, plist, &ovals, &maxv, &minv);
 	if (!len || !ovals)
 		return;
 
@@ -541,7 +598,7 @@ static void show_ddir_status(const struct group_run_stats *rs, struct thread_sta
 		if (calc_lat(&ts->sync_stat, &min, &max, &mean, &dev)) {
 			log_buf(out, "  %s:\n", "fsync/fdatasync/sync_file_range");
 			display_lat(io_ddir_name(ddir), min, max, mean, dev, out);
-			show_clat_percentiles(ts->io_u_sync_plat,
+			show_clat_percentiles(fixed_lat_hist(ts->io_u_sync_plat),
 						ts->sync_stat.samples,
 						ts->percentile_list,
 						ts->percentile_precision,
@@ -617,17 +674,17 @@ static void show_ddir_status(const struct group_run_stats *rs, struct thread_sta
 	}
 
 	if (ts->slat_percentiles && ts->slat_stat[ddir].samples > 0)
-		show_clat_percentiles(ts->io_u_plat[FIO_SLAT][ddir],
+		show_clat_percentiles(ts_lat_hist(ts, FIO_SLAT, ddir),
 					ts->slat_stat[ddir].samples,
 					ts->percentile_list,
 					ts->percentile_precision, "slat", out);
 	if (ts->clat_percentiles && ts->clat_stat[ddir].samples > 0)
-		show_clat_percentiles(ts->io_u_plat[FIO_CLAT][ddir],
+		show_clat_percentiles(ts_lat_hist(ts, FIO_CLAT, ddir),
 					ts->clat_stat[ddir].samples,
 					ts->percentile_list,
 					ts->percentile_precision, "clat", out);
 	if (ts->lat_percentiles && ts->lat_stat[ddir].samples > 0)
-		show_clat_percentiles(ts->io_u_plat[FIO_LAT][ddir],
+		show_clat_percentiles(ts_lat_hist(ts, FIO_LAT, ddir),
 					ts->lat_stat[ddir].samples,
 					ts->percentile_list,
 					ts->percentile_precision, "lat", out);
@@ -657,7 +714,7 @@ static void show_ddir_status(const struct group_run_stats *rs, struct thread_sta
 					 ioprio(ts->clat_prio[ddir][i].ioprio),
 					 ioprio_hint(ts->clat_prio[ddir][i].ioprio),
 					 100. * (double) prio_samples / (double) samples);
-				show_clat_percentiles(ts->clat_prio[ddir][i].io_u_plat,
+				show_clat_percentiles(fixed_lat_hist(ts->clat_prio[ddir][i].io_u_plat),
 						prio_samples, ts->percentile_list,
 						ts->percentile_precision,
 						prio_name, out);
@@ -717,6 +774,7 @@ static void show_mixed_ddir_status(const struct group_run_stats *rs,
 		show_ddir_status(rs, ts_lcl, DDIR_READ, out);
 
 	free_clat_prio_stats(ts_lcl);
+	free_lat_hist_stats(ts_lcl);
 	free(ts_lcl);
 }
 
@@ -1356,12 +1414,12 @@ static void show_ddir_status_terse(struct thread_stat *ts,
 		log_buf(out, ";%llu;%llu;%f;%f", 0ULL, 0ULL, 0.0, 0.0);
 
 	if (ts->lat_percentiles) {
-		len = calc_clat_percentiles(ts->io_u_plat[FIO_LAT][ddir],
+		len = __calc_clat_percentiles(ts_lat_hist(ts, FIO_LAT, ddir),
 					ts->lat_stat[ddir].samples,
 					ts->percentile_list, &ovals, &maxv,
 					&minv);
 	} else if (ts->clat_percentiles) {
-		len = calc_clat_percentiles(ts->io_u_plat[FIO_CLAT][ddir],
+		len = __calc_clat_percentiles(ts_lat_hist(ts, FIO_CLAT, ddir),
 					ts->clat_stat[ddir].samples,
 					ts->percentile_list, &ovals, &maxv,
 					&minv);
@@ -1423,13 +1481,14 @@ static void show_mixed_ddir_status_terse(const struct thread_stat *ts,
 		show_ddir_status_terse(ts_lcl, rs, DDIR_READ, ver, out);
 
 	free_clat_prio_stats(ts_lcl);
+	free_lat_hist_stats(ts_lcl);
 	free(ts_lcl);
 }
 
 static struct json_object *add_ddir_lat_json(struct thread_stat *ts,
 					     uint32_t percentiles,
 					     const struct io_stat *lat_stat,
-					     const uint64_t *io_u_plat)
+					     struct lat_hist h)
 {
 	char buf[120];
 	double mean, dev;
@@ -1449,7 +1508,7 @@ static struct json_object *add_ddir_lat_json(struct thread_stat *ts,
 	json_object_add_value_int(lat_object, "N", lat_stat->samples);
 
 	if (percentiles && lat_stat->samples) {
-		len = calc_clat_percentiles(io_u_plat, lat_stat->samples,
+		len = __calc_clat_percentiles(h, lat_stat->samples,
 				ts->percentile_list, &ovals, &maxv, &minv);
 
 		if (len > FIO_IO_U_LIST_MAX_LEN)
@@ -1467,10 +1526,11 @@ static struct json_object *add_ddir_lat_json(struct thread_stat *ts,
 			clat_bins_object = json_create_object();
 			json_object_add_value_object(lat_object, "bins", clat_bins_object);
 
-			for(i = 0; i < FIO_IO_U_PLAT_NR; i++)
-				if (io_u_plat[i]) {
-					snprintf(buf, sizeof(buf), "%llu", plat_idx_to_val(i));
-					json_object_add_value_int(clat_bins_object, buf, io_u_plat[i]);
+			for(i = 0; i < h.nr; i++)
+				if (h.plat[i]) {
+					snprintf(buf, sizeof(buf), "%llu",
+						 __plat_idx_to_val(i, h.bits));
+					json_object_add_value_int(clat_bins_object, buf, h.plat[i]);
 				}
 		}
 	}
@@ -1520,20 +1580,20 @@ static void add_ddir_status_json(struct thread_stat *ts,
 		json_object_add_value_int(dir_object, "drop_ios", ts->drop_io_u[ddir]);
 
 		tmp_object = add_ddir_lat_json(ts, ts->slat_percentiles,
-				&ts->slat_stat[ddir], ts->io_u_plat[FIO_SLAT][ddir]);
+				&ts->slat_stat[ddir], ts_lat_hist(ts, FIO_SLAT, ddir));
 		json_object_add_value_object(dir_object, "slat_ns", tmp_object);
 
 		tmp_object = add_ddir_lat_json(ts, ts->clat_percentiles,
-				&ts->clat_stat[ddir], ts->io_u_plat[FIO_CLAT][ddir]);
+				&ts->clat_stat[ddir], ts_lat_hist(ts, FIO_CLAT, ddir));
 		json_object_add_value_object(dir_object, "clat_ns", tmp_object);
 
 		tmp_object = add_ddir_lat_json(ts, ts->lat_percentiles,
-				&ts->lat_stat[ddir], ts->io_u_plat[FIO_LAT][ddir]);
+				&ts->lat_stat[ddir], ts_lat_hist(ts, FIO_LAT, ddir));
 		json_object_add_value_object(dir_object, "lat_ns", tmp_object);
 	} else {
 		json_object_add_value_int(dir_object, "total_ios", ts->total_io_u[DDIR_SYNC]);
 		tmp_object = add_ddir_lat_json(ts, ts->lat_percentiles | ts->clat_percentiles,
-				&ts->sync_stat, ts->io_u_sync_plat);
+				&ts->sync_stat, fixed_lat_hist(ts->io_u_sync_plat));
 		json_object_add_value_object(dir_object, "lat_ns", tmp_object);
 	}
 
@@ -1571,7 +1631,7 @@ static void add_ddir_status_json(struct thread_stat *ts,
 			tmp_object = add_ddir_lat_json(ts,
 					ts->clat_percentiles | ts->lat_percentiles,
 					&ts->clat_prio[ddir][i].clat_stat,
-					ts->clat_prio[ddir][i].io_u_plat);
+					fixed_lat_hist(ts->clat_prio[ddir][i].io_u_plat));
 			json_object_add_value_object(obj, obj_name, tmp_object);
 			json_array_add_value_object(array, obj);
 		}
@@ -1624,6 +1684,7 @@ static void add_mixed_ddir_status_json(struct thread_stat *ts,
 		add_ddir_status_json(ts_lcl, rs, DDIR_READ, parent);
 
 	free_clat_prio_stats(ts_lcl);
+	free_lat_hist_stats(ts_lcl);
 	free(ts_lcl);
 }
 
@@ -2119,6 +2180,93 @@ void free_clat_prio_stats(struct thread_stat *ts)
 	}
 }
 
+static uint32_t ts_lat_percentiles(const struct thread_stat *ts,
+				   enum fio_lat lat)
+{
+	switch (lat) {
+	case FIO_SLAT:
+		return ts->slat_percentiles;
+	case FIO_CLAT:
+		return ts->clat_percentiles;
+	case FIO_LAT:
+		return ts->lat_percentiles;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Free the histograms allocated by alloc_lat_hist_stats().
+ */
+void free_lat_hist_stats(struct thread_stat *ts)
+{
+	enum fio_lat lat;
+
+	if (!ts)
+		return;
+
+	for (lat = 0; lat < FIO_LAT_CNT; lat++) {
+		sfree(ts->hist_plat[lat]);
+		ts->hist_plat[lat] = NULL;
+	}
+	ts->hist_bits = ts->hist_groups = 0;
+}
+
+static int __alloc_lat_hist_stats(struct thread_stat *ts, unsigned int bits,
+				  unsigned int groups,
+				  const struct thread_stat *like)
+{
+	size_t size;
+	enum fio_lat lat;
+
+	ts->hist_bits = bits;
+	ts->hist_groups = groups;
+	size = DDIR_RWDIR_CNT * lat_hist_nr(ts) * sizeof(uint64_t);
+
+	for (lat = 0; lat < FIO_LAT_CNT; lat++) {
+		if (like ? !like->hist_plat[lat] : !ts_lat_percentiles(ts, lat))
+			continue;
+
+		ts->hist_plat[lat] = scalloc(1, size);
+		if (!ts->hist_plat[lat]) {
+			log_err("fio: failed to allocate %zu bytes of latency "
+				"histogram, consider raising --alloc-size\n",
+				size);
+			free_lat_hist_stats(ts);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Allocate the lat_histogram_precision= histograms for the latency types
+ * that have percentiles enabled in @ts. Like the clat_prio_stat arrays,
+ * these have to be allocated/freed using smalloc/sfree.
+ */
+int alloc_lat_hist_stats(struct thread_stat *ts, unsigned int precision,
+			 unsigned long long max_nsec)
+{
+	static const unsigned int digit_bits[] = { 0, 4, 7, 10, 14 };
+	unsigned int bits, msb;
+
+	if (!precision)
+		return 0;
+
+	assert(precision <= FIO_LAT_HIST_MAX_PRECISION);
+	bits = digit_bits[precision];
+
+	if (max_nsec)
+		msb = (sizeof(max_nsec) * 8) - __builtin_clzll(max_nsec) - 1;
+	else
+		msb = FIO_LAT_HIST_DEF_MSB;
+	if (msb < bits)
+		msb = bits;
+
+	return __alloc_lat_hist_stats(ts, bits, msb - bits + 2, NULL);
+}
+
 /*
  * Allocate a clat_prio_stat array. The array has to be allocated/freed using
  * smalloc/sfree, so that it is accessible by the process/thread summing the
@@ -2314,6 +2462,56 @@ static int sum_clat_prio_stats(struct thread_stat *dst, const struct thread_stat
 	return sum_clat_prio_stats_src_multi_prio(dst, src, dst_ddir, src_ddir);
 }
 
+/*
+ * The lat_histogram_precision= histograms can only be summed if they
+ * share a geometry. The first member decides it for @dst, a later member
+ * that doesn't match drops @dst back to the fixed histograms.
+ */
+static void sum_lat_hist_stats(struct thread_stat *dst,
+			       const struct thread_stat *src)
+{
+	unsigned int nr, i, j;
+	enum fio_lat lat;
+
+	if (!dst->members && !dst->hist_bits && src->hist_bits) {
+		if (__alloc_lat_hist_stats(dst, src->hist_bits,
+					   src->hist_groups, src))
+			return;
+	}
+
+	if (dst->hist_bits != src->hist_bits ||
+	    dst->hist_groups != src->hist_groups) {
+		free_lat_hist_stats(dst);
+		return;
+	}
+
+	nr = lat_hist_nr(dst);
+	for (lat = 0; lat < FIO_LAT_CNT; lat++) {
+		uint64_t *dplat = dst->hist_plat[lat];
+		const uint64_t *splat = src->hist_plat[lat];
+
+		if (!dplat)
+			continue;
+		if (!splat) {
+			sfree(dplat);
+			dst->hist_plat[lat] = NULL;
+			continue;
+		}
+		/* offload workers share their parent's histograms */
+		if (dplat == splat)
+			continue;
+
+		for (i = 0; i < DDIR_RWDIR_CNT; i++) {
+			uint64_t *d = dplat;
+
+			if (dst->unified_rw_rep != UNIFIED_MIXED)
+				d += i * nr;
+			for (j = 0; j < nr; j++)
+				d[j] += splat[i * nr + j];
+		}
+	}
+}
+
 void sum_thread_stats(struct thread_stat *dst, const struct thread_stat *src)
 {
 	int k, l, m;
@@ -2391,6 +2589,8 @@ void sum_thread_stats(struct thread_stat *dst, const struct thread_stat *src)
 	for (k = 0; k < FIO_IO_U_PLAT_NR; k++)
 		dst->io_u_sync_plat[k] += src->io_u_sync_plat[k];
 
+	sum_lat_hist_stats(dst, src);
+
 	dst->total_run_time += src->total_run_time;
 	dst->total_submit += src->total_submit;
 	dst->total_complete += src->total_complete;
@@ -2784,6 +2984,7 @@ void __show_run_stats(void)
 	for (i = 0; i < nr_ts; i++) {
 		ts = &threadstats[i];
 		free_clat_prio_stats(ts);
+		free_lat_hist_stats(ts);
 	}
 	free(threadstats);
 	free(opt_lists);
@@ -2942,9 +3143,13 @@ static struct io_logs *get_new_log(struct io_log *iolog)
 		else
 			new_samples = DEF_LOG_ENTRIES;
 	} else {
+		size_t max_samples = MAX_LOG_ENTRIES;
+
+		if (iolog->stream)
+			max_samples = STREAM_LOG_ENTRIES;
 		new_samples = iolog->cur_log_max * 2;
-		if (new_samples > MAX_LOG_ENTRIES)
-			new_samples = MAX_LOG_ENTRIES;
+		if (new_samples > max_samples)
+			new_samples = max_samples;
 	}
 
 	cur_log = smalloc(sizeof(*cur_log));
@@ -2987,13 +3192,18 @@ static struct io_logs *regrow_log(struct io_log *iolog)
 
 	/*
 	 * No room for a new sample. If we're compressing on the fly, flush
-	 * out the current chunk
+	 * out the current chunk. If we're streaming, hand it to the writer.
 	 */
 	if (iolog->log_gz) {
 		if (iolog_cur_flush(iolog, cur_log)) {
 			log_err("fio: failed flushing iolog! Will stop logging.\n");
 			return NULL;
 		}
+	} else if (iolog->stream) {
+		if (log_stream_queue(iolog, cur_log)) {
+			log_err("fio: failed streaming iolog! Will stop logging.\n");
+			return NULL;
+		}
 	}
 
 	/*
@@ -3170,6 +3380,12 @@ void reset_io_stats(struct thread_data *td)
 		for (j = 0; j < DDIR_RWDIR_CNT; j++)
 			reset_io_u_plat(ts->io_u_plat[i][j]);
 
+	/* offload workers share their parent's histograms, leave those be */
+	for (i = 0; i < FIO_LAT_CNT; i++)
+		if (ts->hist_plat[i] && !td->parent)
+			memset(ts->hist_plat[i], 0, DDIR_RWDIR_CNT *
+				lat_hist_nr(ts) * sizeof(uint64_t));
+
 	reset_clat_prio_stats(ts);
 
 	ts->total_io_u[DDIR_SYNC] = 0;
@@ -3194,6 +3410,38 @@ void reset_io_stats(struct thread_data *td)
 	ts->cachehit = ts->cachemiss = 0;
 }
 
+/*
+ * Move the latency samples gathered in @src over to @dst and reset them in
+ * @src. Used to fold per-worker shards into their owner on demand, the
+ * caller must hold the lock that @src samples are added under.
+ */
+void move_lat_stats(struct thread_stat *dst, struct thread_stat *src)
+{
+	int i, j, k;
+
+	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
+		sum_stat(&dst->clat_stat[i], &src->clat_stat[i], false);
+		sum_stat(&dst->slat_stat[i], &src->slat_stat[i], false);
+		sum_stat(&dst->lat_stat[i], &src->lat_stat[i], false);
+		reset_io_stat(&src->clat_stat[i]);
+		reset_io_stat(&src->slat_stat[i]);
+		reset_io_stat(&src->lat_stat[i]);
+	}
+
+	for (i = 0; i < FIO_LAT_CNT; i++) {
+		for (j = 0; j < DDIR_RWDIR_CNT; j++) {
+			uint64_t *plat = src->io_u_plat[i][j];
+
+			for (k = 0; k < FIO_IO_U_PLAT_NR; k++) {
+				if (!plat[k])
+					continue;
+				dst->io_u_plat[i][j][k] += plat[k];
+				plat[k] = 0;
+			}
+		}
+	}
+}
+
 static void __add_stat_to_log(struct io_log *iolog, enum fio_ddir ddir,
 			      unsigned long elapsed, int log_max)
 {
@@ -3328,6 +3576,13 @@ static inline void add_lat_percentile_sample(struct thread_stat *ts,
 	assert(idx < FIO_IO_U_PLAT_NR);
 
 	ts->io_u_plat[lat][ddir][idx]++;
+
+	if (ts->hist_plat[lat]) {
+		unsigned int nr = lat_hist_nr(ts);
+
+		idx = __plat_val_to_idx(nsec, ts->hist_bits, nr);
+		ts->hist_plat[lat][ddir * nr + idx]++;
+	}
 }
 
 static inline void
@@ -3417,15 +3672,20 @@ void add_clat_sample(struct thread_data *td, enum fio_ddir ddir,
 
 			/*
 			 * Make a byte-for-byte copy of the latency histogram
-			 * stored in td->ts.io_u_plat[ddir], recording it in a
-			 * log sample. Note that the matching call to free() is
-			 * located in iolog.c after printing this sample to the
-			 * log file.
+			 * stored in td->ts.io_u_plat[ddir], or in the
+			 * lat_histogram_precision= one if we have it,
+			 * recording it in a log sample. Note that the matching
+			 * call to free() is located in iolog.c after printing
+			 * this sample to the log file.
 			 */
-			io_u_plat = (uint64_t *) td->ts.io_u_plat[FIO_CLAT][ddir];
-			dst = malloc(sizeof(struct io_u_plat_entry));
+			if (ts->hist_plat[FIO_CLAT])
+				io_u_plat = ts->hist_plat[FIO_CLAT] +
+						ddir * iolog->hist_nr;
+			else
+				io_u_plat = ts->io_u_plat[FIO_CLAT][ddir];
+			dst = malloc(io_u_plat_entry_sz(iolog->hist_nr));
 			memcpy(&(dst->io_u_plat), io_u_plat,
-				FIO_IO_U_PLAT_NR * sizeof(uint64_t));
+				iolog->hist_nr * sizeof(uint64_t));
 			flist_add(&dst->list, &hw->list);
 
 			sample.data = sample_plat(dst);
@@ -120,6 +120,16 @@ struct group_run_stats {
  *  ** If a sample's MSB is greater than 33, it will be counted as 33.
  */
 
+/*
+ * lat_histogram_precision= keeps a second histogram with the same layout,
+ * but with M picked from the number of significant decimal digits asked
+ * for (1 -> 4 bits, 2 -> 7, 3 -> 10, 4 -> 14) and as many groups as it
+ * takes to reach lat_histogram_max=, or MSB 33 like the above by default.
+ * It is allocated per thread_stat, so memory follows the precision used.
+ */
+#define FIO_LAT_HIST_MAX_PRECISION	4
+#define FIO_LAT_HIST_DEF_MSB		(FIO_IO_U_PLAT_GROUP_NR + FIO_IO_U_PLAT_BITS - 2)
+
 /*
  * Trim cycle count measurements
  */
@@ -306,6 +316,21 @@ struct thread_stat {
 
 	uint64_t cachehit;
 	uint64_t cachemiss;
+
+	/*
+	 * lat_histogram_precision= buckets, DDIR_RWDIR_CNT * lat_hist_nr()
+	 * of them for each latency type with percentiles enabled.
+	 */
+	uint32_t hist_bits;
+	uint32_t hist_groups;
+	union {
+		uint64_t *hist_plat[FIO_LAT_CNT];
+		/*
+		 * For FIO_NET_CMD_TS, the pointed to data will temporarily
+		 * be stored at this offset from the start of the payload.
+		 */
+		uint64_t hist_plat_offset[FIO_LAT_CNT];
+	};
 } __attribute__((packed));
 
 #define JOBS_ETA {							\
@@ -342,11 +367,21 @@ struct thread_stat {
 struct jobs_eta JOBS_ETA;
 struct jobs_eta_packed JOBS_ETA __attribute__((packed));
 
+/*
+ * A clat_hist log sample's copy of the histogram. It holds either the
+ * fixed histogram or the lat_histogram_precision= one, see the hist_nr
+ * of the log for how many buckets that is.
+ */
 struct io_u_plat_entry {
 	struct flist_head list;
-	uint64_t io_u_plat[FIO_IO_U_PLAT_NR];
+	uint64_t io_u_plat[];
 };
 
+static inline size_t io_u_plat_entry_sz(unsigned int nr)
+{
+	return sizeof(struct io_u_plat_entry) + nr * sizeof(uint64_t);
+}
+
 extern struct fio_sem *stat_sem;
 
 extern struct jobs_eta *get_jobs_eta(bool force, size_t *size);
@@ -374,6 +409,7 @@ extern void stat_calc_lat_m(const struct thread_stat *ts, double *io_u_lat);
 extern void stat_calc_lat_u(const struct thread_stat *ts, double *io_u_lat);
 extern void stat_calc_dist(const uint64_t *map, unsigned long total, double *io_u_dist);
 extern void reset_io_stats(struct thread_data *);
+extern void move_lat_stats(struct thread_stat *, struct thread_stat *);
 extern void update_rusage_stat(struct thread_data *);
 extern void clear_rusage_stat(struct thread_data *);
 
@@ -393,6 +429,9 @@ extern void add_sync_clat_sample(struct thread_stat *ts,
 				unsigned long long nsec);
 extern int calc_log_samples(void);
 extern void free_clat_prio_stats(struct thread_stat *);
+extern int alloc_lat_hist_stats(struct thread_stat *, unsigned int,
+				unsigned long long);
+extern void free_lat_hist_stats(struct thread_stat *);
 extern int alloc_clat_prio_stat_ddir(struct thread_stat *, enum fio_ddir, int);
 
 extern void print_disk_util(const struct disk_util_stat *, const struct disk_util_agg *, int terse, struct buf_output *);
@@ -432,6 +471,14 @@ static inline bool nsec_to_msec(unsigned long long *min,
 	return false;
 }
 
+/*
+ * Number of lat_histogram_precision= buckets per data direction
+ */
+static inline unsigned int lat_hist_nr(const struct thread_stat *ts)
+{
+	return ts->hist_groups << ts->hist_bits;
+}
+
 /*
  * Worst level condensing would be 1:5, so allow enough room for that
  */
@@ -2,12 +2,17 @@
  * Small tool to check for dedupable blocks in a file or device. Basically
  * just scans the filename for extents of the given size, checksums them,
  * and orders them up.
+ *
+ * Checksums go into a hash table that is split into HASH_SHARDS shards,
+ * each with its own lock, so the reader threads rarely contend. With the
+ * bloom filter, no table is kept at all and no lock is taken.
  */
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #include "../fio.h"
@@ -17,18 +22,25 @@
 #include "../smalloc.h"
 #include "../minmax.h"
 #include "../crc/md5.h"
+#include "../crc/xxhash.h"
+#include "../crc/crc32c.h"
 #include "../os/os.h"
 #include "../gettime.h"
 #include "../fio_time.h"
-#include "../lib/rbtree.h"
 
 #include "../lib/bloom.h"
 #include "debug.h"
 #include "zlib.h"
 
+#if defined(__linux__) && defined(ARCH_HAVE_IOURING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "../os/linux/io_uring.h"
+#define DEDUPE_URING
+#endif
+
 struct zlib_ctrl {
 	z_stream stream;
-	unsigned char *buf_in;
 	unsigned char *buf_out;
 };
 
@@ -40,6 +52,7 @@ struct worker_thread {
 	unsigned long long unique_capacity;
 	unsigned long items;
 	unsigned long dupes;
+	struct item *items_buf;
 	int err;
 	int fd;
 	volatile int done;
@@ -50,21 +63,44 @@ struct extent {
 	uint64_t offset;
 };
 
+#define HASH_WORDS	4
+
 struct chunk {
-	struct fio_rb_node rb_node;
+	struct chunk *next;
 	uint64_t count;
-	uint32_t hash[MD5_HASH_WORDS];
+	uint32_t hash[HASH_WORDS];
 	struct flist_head extent_list[0];
 };
 
 struct item {
 	uint64_t offset;
-	uint32_t hash[MD5_HASH_WORDS];
+	void *buf;
+	uint32_t hash[HASH_WORDS];
 };
 
-static struct rb_root rb_root;
+/*
+ * The first hash word picks the shard, the second the bucket in it.
+ */
+#define HASH_SHARDS	256
+#define HASH_MIN_BUCKETS	1024
+
+struct hash_shard {
+	pthread_mutex_t lock;
+	struct chunk **buckets;
+	uint64_t nr_buckets;
+	uint64_t nr_chunks;
+} __attribute__((aligned(64)));
+
+static struct hash_shard *shards;
 static struct bloom *bloom;
-static struct fio_sem *rb_lock;
+
+enum {
+	DEDUPE_HASH_MD5 = 0,
+	DEDUPE_HASH_XXHASH,
+	DEDUPE_HASH_CRC32C,
+};
+
+static const char *hash_names[] = { "md5", "xxhash", "crc32c" };
 
 static unsigned int blocksize = 4096;
 static unsigned int num_threads;
@@ -75,6 +111,11 @@ static unsigned int collision_check;
 static unsigned int print_progress = 1;
 static unsigned int use_bloom = 1;
 static unsigned int compression = 0;
+static unsigned int hash_type = DEDUPE_HASH_MD5;
+static unsigned int use_uring;
+static unsigned int uring_depth = 32;
+static unsigned int json_output;
+static unsigned int progress_msec = 250;
 
 static uint64_t total_size;
 static uint64_t cur_offset;
@@ -143,17 +184,15 @@ static int read_block(int fd, void *buf, off_t offset)
 	return __read_block(fd, buf, offset, blocksize);
 }
 
-static int account_unique_capacity(uint64_t offset, uint64_t *unique_capacity,
+static int account_unique_capacity(struct item *i, uint64_t *unique_capacity,
 				   struct zlib_ctrl *zc)
 {
 	z_stream *stream = &zc->stream;
 	unsigned int compressed_len;
+	uint64_t offset = i->offset;
 	int ret;
 
-	if (read_block(file.fd, zc->buf_in, offset))
-		return 1;
-
-	stream->next_in = zc->buf_in;
+	stream->next_in = i->buf;
 	stream->avail_in = blocksize;
 	stream->avail_out = deflateBound(stream, blocksize);
 	stream->next_out = zc->buf_out;
@@ -193,23 +232,18 @@ static void add_item(struct chunk *c, struct item *i)
 static int col_check(struct chunk *c, struct item *i)
 {
 	struct extent *e;
-	char *cbuf, *ibuf;
+	char *cbuf;
 	int ret = 1;
 
 	cbuf = fio_memalign(blocksize, blocksize, false);
-	ibuf = fio_memalign(blocksize, blocksize, false);
 
 	e = flist_entry(c->extent_list[0].next, struct extent, list);
 	if (read_block(file.fd, cbuf, e->offset))
 		goto out;
 
-	if (read_block(file.fd, ibuf, i->offset))
-		goto out;
-
-	ret = memcmp(ibuf, cbuf, blocksize);
+	ret = memcmp(i->buf, cbuf, blocksize);
 out:
 	fio_memfree(cbuf, blocksize, false);
-	fio_memfree(ibuf, blocksize, false);
 	return ret;
 }
 
@@ -227,50 +261,125 @@ static struct chunk *alloc_chunk(void)
 	return c;
 }
 
-static int insert_chunk(struct item *i, uint64_t *unique_capacity,
-			struct zlib_ctrl *zc)
+static int init_shards(void)
 {
-	struct fio_rb_node **p, *parent;
-	struct chunk *c;
-	int ret, diff;
-
-	p = &rb_root.rb_node;
-	parent = NULL;
-	while (*p) {
-		parent = *p;
-
-		c = rb_entry(parent, struct chunk, rb_node);
-		diff = memcmp(i->hash, c->hash, sizeof(i->hash));
-		if (diff < 0) {
-			p = &(*p)->rb_left;
-		} else if (diff > 0) {
-			p = &(*p)->rb_right;
-		} else {
-			if (!collision_check)
-				goto add;
-
-			fio_sem_up(rb_lock);
-			ret = col_check(c, i);
-			fio_sem_down(rb_lock);
-
-			if (!ret)
-				goto add;
-
-			p = &(*p)->rb_right;
+	int i;
+
+	shards = calloc(HASH_SHARDS, sizeof(struct hash_shard));
+	if (!shards)
+		return 1;
+
+	for (i = 0; i < HASH_SHARDS; i++) {
+		struct hash_shard *sh = &shards[i];
+
+		pthread_mutex_init(&sh->lock, NULL);
+		sh->nr_buckets = HASH_MIN_BUCKETS;
+		sh->buckets = calloc(sh->nr_buckets, sizeof(struct chunk *));
+		if (!sh->buckets)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void free_shards(void)
+{
+	struct flist_head *n, *tmp;
+	struct chunk *c, *next;
+	uint64_t j;
+	int i;
+
+	if (!shards)
+		return;
+
+	for (i = 0; i < HASH_SHARDS; i++) {
+		struct hash_shard *sh = &shards[i];
+
+		for (j = 0; j < sh->nr_buckets; j++) {
+			for (c = sh->buckets[j]; c; c = next) {
+				next = c->next;
+				if (collision_check || dump_output) {
+					flist_for_each_safe(n, tmp, &c->extent_list[0])
+						free(flist_entry(n, struct extent, list));
+				}
+				free(c);
+			}
+		}
+		free(sh->buckets);
+		pthread_mutex_destroy(&sh->lock);
+	}
+
+	free(shards);
+	shards = NULL;
+}
+
+static inline struct hash_shard *hash_to_shard(uint32_t *hash)
+{
+	return &shards[hash[0] & (HASH_SHARDS - 1)];
+}
+
+static inline struct chunk **hash_to_bucket(struct hash_shard *sh,
+					    uint32_t *hash)
+{
+	return &sh->buckets[hash[1] & (sh->nr_buckets - 1)];
+}
+
+/*
+ * Double the number of buckets once a shard holds more chunks than
+ * buckets. If that fails, just keep going with longer chains.
+ */
+static void grow_shard(struct hash_shard *sh)
+{
+	uint64_t i, nr = sh->nr_buckets * 2;
+	struct chunk **buckets, *c, *next;
+
+	buckets = calloc(nr, sizeof(struct chunk *));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < sh->nr_buckets; i++) {
+		for (c = sh->buckets[i]; c; c = next) {
+			struct chunk **b = &buckets[c->hash[1] & (nr - 1)];
+
+			next = c->next;
+			c->next = *b;
+			*b = c;
 		}
 	}
 
+	free(sh->buckets);
+	sh->buckets = buckets;
+	sh->nr_buckets = nr;
+}
+
+/*
+ * Returns 1 if the item is the first of its chunk, 0 if it is a dupe and
+ * -1 on error. Called with the shard locked.
+ */
+static int insert_chunk(struct hash_shard *sh, struct item *i)
+{
+	struct chunk **bucket, *c;
+
+	bucket = hash_to_bucket(sh, i->hash);
+	for (c = *bucket; c; c = c->next) {
+		if (memcmp(i->hash, c->hash, sizeof(i->hash)))
+			continue;
+		if (!collision_check || !col_check(c, i))
+			goto add;
+	}
+
 	c = alloc_chunk();
-	RB_CLEAR_NODE(&c->rb_node);
+	if (!c)
+		return -1;
 	c->count = 0;
 	memcpy(c->hash, i->hash, sizeof(i->hash));
-	rb_link_node(&c->rb_node, parent, p);
-	rb_insert_color(&c->rb_node, &rb_root);
-	if (compression) {
-		ret = account_unique_capacity(i->offset, unique_capacity, zc);
-		if (ret)
-			return ret;
-	}
+	c->next = *bucket;
+	*bucket = c;
+	add_item(c, i);
+
+	if (++sh->nr_chunks > sh->nr_buckets)
+		grow_shard(sh);
+	return 1;
 add:
 	add_item(c, i);
 	return 0;
@@ -282,28 +391,31 @@ static int insert_chunks(struct item *items, unsigned int nitems,
 {
 	int i, ret = 0;
 
-	fio_sem_down(rb_lock);
-
 	for (i = 0; i < nitems; i++) {
+		struct hash_shard *sh;
+
 		if (bloom) {
-			unsigned int s;
-			int r;
-
-			s = sizeof(items[i].hash) / sizeof(uint32_t);
-			r = bloom_set(bloom, items[i].hash, s);
-			*ndupes += r;
-		} else {
-			ret = insert_chunk(&items[i], unique_capacity, zc);
-			if (ret)
-				break;
+			*ndupes += bloom_set_hash(bloom, items[i].hash);
+			continue;
 		}
+
+		sh = hash_to_shard(items[i].hash);
+		pthread_mutex_lock(&sh->lock);
+		ret = insert_chunk(sh, &items[i]);
+		pthread_mutex_unlock(&sh->lock);
+
+		if (ret < 0)
+			return 1;
+		if (ret && compression &&
+		    account_unique_capacity(&items[i], unique_capacity, zc))
+			return 1;
+		ret = 0;
 	}
 
-	fio_sem_up(rb_lock);
 	return ret;
 }
 
-static void crc_buf(void *buf, uint32_t *hash)
+static void md5_buf(void *buf, uint32_t *hash)
 {
 	struct fio_md5_ctx ctx = { .hash = hash };
 
@@ -312,6 +424,49 @@ static void crc_buf(void *buf, uint32_t *hash)
 	fio_md5_final(&ctx);
 }
 
+/*
+ * The fast hashes only give 32 bits, so checksum each quarter of the block
+ * separately to fill the 128-bit hash. Use -c to rule out false dupes.
+ */
+static void xxhash_buf(void *buf, uint32_t *hash)
+{
+	const unsigned int len = blocksize / HASH_WORDS;
+	const void *in[HASH_WORDS];
+	uint32_t lens[HASH_WORDS];
+	int i;
+
+	for (i = 0; i < HASH_WORDS; i++) {
+		in[i] = buf + i * len;
+		lens[i] = len;
+	}
+
+	XXH32_multi(in, lens, 0, hash, HASH_WORDS);
+}
+
+static void crc32c_buf(void *buf, uint32_t *hash)
+{
+	const unsigned int len = blocksize / HASH_WORDS;
+	int i;
+
+	for (i = 0; i < HASH_WORDS; i++)
+		hash[i] = fio_crc32c(buf + i * len, len);
+}
+
+static void hash_buf(void *buf, uint32_t *hash)
+{
+	switch (hash_type) {
+	case DEDUPE_HASH_XXHASH:
+		xxhash_buf(buf, hash);
+		break;
+	case DEDUPE_HASH_CRC32C:
+		crc32c_buf(buf, hash);
+		break;
+	default:
+		md5_buf(buf, hash);
+		break;
+	}
+}
+
 static unsigned int read_blocks(int fd, void *buf, off_t offset, size_t size)
 {
 	if (__read_block(fd, buf, offset, size))
@@ -320,39 +475,27 @@ static unsigned int read_blocks(int fd, void *buf, off_t offset, size_t size)
 	return size / blocksize;
 }
 
-static int do_work(struct worker_thread *thread, void *buf)
+static int process_blocks(struct worker_thread *thread, void *buf,
+			  uint64_t offset, unsigned int nblocks)
 {
-	unsigned int nblocks, i;
-	off_t offset;
-	int nitems = 0;
+	struct item *items = thread->items_buf;
 	uint64_t ndupes = 0;
 	uint64_t unique_capacity = 0;
-	struct item *items;
+	unsigned int i;
 	int ret;
 
-	offset = thread->cur_offset;
-
-	nblocks = read_blocks(thread->fd, buf, offset,
-				min(thread->size, (uint64_t) chunk_size));
-	if (!nblocks)
-		return 1;
-
-	items = malloc(sizeof(*items) * nblocks);
-
 	for (i = 0; i < nblocks; i++) {
 		void *thisptr = buf + (i * blocksize);
 
 		items[i].offset = offset;
-		crc_buf(thisptr, items[i].hash);
+		items[i].buf = thisptr;
+		hash_buf(thisptr, items[i].hash);
 		offset += blocksize;
-		nitems++;
 	}
 
-	ret = insert_chunks(items, nitems, &ndupes, &unique_capacity, &thread->zc);
-
-	free(items);
+	ret = insert_chunks(items, nblocks, &ndupes, &unique_capacity, &thread->zc);
 	if (!ret) {
-		thread->items += nitems;
+		thread->items += nblocks;
 		thread->dupes += ndupes;
 		thread->unique_capacity += unique_capacity;
 		return 0;
@@ -361,6 +504,212 @@ static int do_work(struct worker_thread *thread, void *buf)
 	return ret;
 }
 
+static int do_work(struct worker_thread *thread, void *buf)
+{
+	unsigned int nblocks;
+
+	nblocks = read_blocks(thread->fd, buf, thread->cur_offset,
+				min(thread->size, (uint64_t) chunk_size));
+	if (!nblocks)
+		return 1;
+
+	return process_blocks(thread, buf, thread->cur_offset, nblocks);
+}
+
+#ifdef DEDUPE_URING
+struct uring {
+	int fd;
+	void *sq_ring;
+	size_t sq_ring_len;
+	void *cq_ring;
+	size_t cq_ring_len;
+	size_t sqes_len;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+struct uring_read {
+	void *buf;
+	uint64_t offset;
+	uint64_t size;
+};
+
+static int uring_setup(struct uring *r, unsigned int depth)
+{
+	struct io_uring_params p;
+	void *ptr;
+	unsigned *array;
+	int i;
+
+	memset(&p, 0, sizeof(p));
+	r->fd = syscall(__NR_io_uring_setup, depth, &p);
+	if (r->fd < 0) {
+		perror("io_uring_setup");
+		return 1;
+	}
+
+	r->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(__u32);
+	ptr = mmap(0, r->sq_ring_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	r->sq_ring = ptr;
+	r->sq_tail = ptr + p.sq_off.tail;
+	r->sq_mask = *(unsigned *) (ptr + p.sq_off.ring_mask);
+	array = ptr + p.sq_off.array;
+	for (i = 0; i < p.sq_entries; i++)
+		array[i] = i;
+
+	r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(0, r->sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		goto err;
+
+	r->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ptr = mmap(0, r->cq_ring_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	r->cq_ring = ptr;
+	r->cq_head = ptr + p.cq_off.head;
+	r->cq_tail = ptr + p.cq_off.tail;
+	r->cq_mask = *(unsigned *) (ptr + p.cq_off.ring_mask);
+	r->cqes = ptr + p.cq_off.cqes;
+	return 0;
+err:
+	perror("mmap");
+	close(r->fd);
+	return 1;
+}
+
+static void uring_exit(struct uring *r)
+{
+	munmap(r->sq_ring, r->sq_ring_len);
+	munmap(r->sqes, r->sqes_len);
+	munmap(r->cq_ring, r->cq_ring_len);
+	close(r->fd);
+}
+
+static void uring_prep_read(struct uring *r, int fd, struct uring_read *rd,
+			    unsigned int index)
+{
+	unsigned tail = *r->sq_tail;
+	struct io_uring_sqe *sqe = &r->sqes[tail & r->sq_mask];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long) rd->buf;
+	sqe->len = rd->size;
+	sqe->off = rd->offset;
+	sqe->user_data = index;
+	atomic_store_release(r->sq_tail, tail + 1);
+}
+
+/*
+ * Keep up to uring_depth chunk reads in flight, and checksum each chunk as
+ * its read completes.
+ */
+static int uring_work(struct worker_thread *thread)
+{
+	struct uring_read *reads;
+	unsigned int *free_idx, nr_free, inflight = 0, to_submit = 0;
+	struct uring r;
+	bool more = true;
+	int i, ret, err = 0;
+
+	if (uring_setup(&r, uring_depth))
+		return 1;
+
+	reads = calloc(uring_depth, sizeof(*reads));
+	free_idx = calloc(uring_depth, sizeof(*free_idx));
+	for (i = 0; i < uring_depth; i++) {
+		reads[i].buf = fio_memalign(blocksize, chunk_size, false);
+		free_idx[i] = i;
+	}
+	nr_free = uring_depth;
+
+	while (more || inflight) {
+		unsigned head, tail;
+
+		while (more && nr_free) {
+			struct uring_read *rd = &reads[free_idx[nr_free - 1]];
+
+			if (get_work(&rd->offset, &rd->size)) {
+				more = false;
+				break;
+			}
+			rd->size = min(rd->size, (uint64_t) chunk_size);
+			uring_prep_read(&r, thread->fd, rd, free_idx[--nr_free]);
+			inflight++;
+			to_submit++;
+		}
+
+		ret = syscall(__NR_io_uring_enter, r.fd, to_submit,
+				inflight ? 1 : 0, IORING_ENTER_GETEVENTS,
+				NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("io_uring_enter");
+			err = 1;
+			break;
+		}
+		to_submit -= ret;
+
+		head = *r.cq_head;
+		tail = atomic_load_acquire(r.cq_tail);
+		for (; head != tail; head++) {
+			struct io_uring_cqe *cqe = &r.cqes[head & r.cq_mask];
+			struct uring_read *rd = &reads[cqe->user_data];
+
+			inflight--;
+			free_idx[nr_free++] = cqe->user_data;
+			if (cqe->res != rd->size) {
+				if (cqe->res < 0)
+					log_err("dedupe: read: %s\n",
+						strerror(-cqe->res));
+				else
+					log_err("dedupe: short read on block\n");
+				err = 1;
+			} else if (!err) {
+				err = process_blocks(thread, rd->buf, rd->offset,
+						     rd->size / blocksize);
+			}
+		}
+		atomic_store_release(r.cq_head, head);
+
+		if (err)
+			more = false;
+	}
+
+	uring_exit(&r);
+
+	/*
+	 * Only io_uring_enter() failing leaves reads in flight. Don't free
+	 * buffers the kernel may still write to then.
+	 */
+	if (!inflight) {
+		for (i = 0; i < uring_depth; i++)
+			fio_memfree(reads[i].buf, chunk_size, false);
+	}
+	free(reads);
+	free(free_idx);
+	return err;
+}
+#else
+static int uring_work(struct worker_thread *thread)
+{
+	return 1;
+}
+#endif
+
 static void thread_init_zlib_control(struct worker_thread *thread)
 {
 	size_t sz;
@@ -373,7 +722,6 @@ static void thread_init_zlib_control(struct worker_thread *thread)
 	if (deflateInit(stream, Z_DEFAULT_COMPRESSION) != Z_OK)
 		return;
 
-	thread->zc.buf_in = fio_memalign(blocksize, blocksize, false);
 	sz = deflateBound(stream, blocksize);
 	thread->zc.buf_out = fio_memalign(blocksize, sz, false);
 }
@@ -383,9 +731,18 @@ static void *thread_fn(void *data)
 	struct worker_thread *thread = data;
 	void *buf;
 
-	buf = fio_memalign(blocksize, chunk_size, false);
+	thread->items_buf = malloc(sizeof(struct item) * (chunk_size / blocksize));
 	thread_init_zlib_control(thread);
 
+	if (use_uring) {
+		thread->err = uring_work(thread);
+		thread->done = 1;
+		free(thread->items_buf);
+		return NULL;
+	}
+
+	buf = fio_memalign(blocksize, chunk_size, false);
+
 	do {
 		if (get_work(&thread->cur_offset, &thread->size)) {
 			thread->err = 1;
@@ -399,15 +756,53 @@ static void *thread_fn(void *data)
 
 	thread->done = 1;
 	fio_memfree(buf, chunk_size, false);
+	free(thread->items_buf);
 	return NULL;
 }
 
+/*
+ * Unique chunks found so far. Read without the shard locks, it's only
+ * for progress output.
+ */
+static uint64_t unique_so_far(struct worker_thread *threads, uint64_t nitems)
+{
+	uint64_t nchunks = 0;
+	int i;
+
+	if (bloom) {
+		for (i = 0; i < num_threads; i++)
+			nchunks += threads[i].dupes;
+		return nitems - nchunks;
+	}
+
+	for (i = 0; i < HASH_SHARDS; i++)
+		nchunks += shards[i].nr_chunks;
+	return nchunks;
+}
+
+/*
+ * One JSON object per line, so the output can be consumed while the scan
+ * is still running.
+ */
+static void show_progress_json(struct worker_thread *threads,
+			       struct timespec *start, uint64_t nitems,
+			       float perc, unsigned long kib_sec)
+{
+	printf("{\"progress\": {\"elapsed_ms\": %llu, \"percent\": %.2f, "
+		"\"extents\": %llu, \"unique_extents\": %llu, "
+		"\"kib_per_sec\": %lu}}\n",
+		(unsigned long long) mtime_since_now(start),
+		perc, (unsigned long long) nitems,
+		(unsigned long long) unique_so_far(threads, nitems), kib_sec);
+}
+
 static void show_progress(struct worker_thread *threads, unsigned long total)
 {
 	unsigned long last_nitems = 0;
-	struct timespec last_tv;
+	struct timespec start, last_tv;
 
-	fio_gettime(&last_tv, NULL);
+	fio_gettime(&start, NULL);
+	last_tv = start;
 
 	while (print_progress) {
 		unsigned long this_items;
@@ -434,14 +829,18 @@ static void show_progress(struct worker_thread *threads, unsigned long total)
 		tdiff = mtime_since_now(&last_tv);
 		if (tdiff) {
 			this_items = (this_items * 1000) / (tdiff * 1024);
-			printf("%3.2f%% done (%luKiB/sec)\r", perc, this_items);
+			if (json_output)
+				show_progress_json(threads, &start, nitems, perc,
+						   this_items);
+			else
+				printf("%3.2f%% done (%luKiB/sec)\r", perc, this_items);
 			last_nitems = nitems;
 			fio_gettime(&last_tv, NULL);
-		} else {
+		} else if (!json_output) {
 			printf("%3.2f%% done\r", perc);
 		}
 		fflush(stdout);
-		usleep(250000);
+		usleep(progress_msec * 1000);
 	};
 }
 
@@ -484,7 +883,8 @@ static int run_dedupe_threads(struct fio_file *f, uint64_t dev_size,
 		*unique_capacity += threads[i].unique_capacity;
 	}
 
-	printf("Threads(%u): %lu items processed\n", num_threads, nitems);
+	if (!json_output)
+		printf("Threads(%u): %lu items processed\n", num_threads, nitems);
 
 	*nextents = nitems;
 	*nchunks = nitems - *nchunks;
@@ -528,10 +928,15 @@ static int dedupe_check(const char *filename, uint64_t *nextents,
 
 		bloom_entries = 8 * (dev_size / blocksize);
 		bloom = bloom_new(bloom_entries);
+	} else if (init_shards()) {
+		log_err("dedupe: failed allocating hash table\n");
+		goto err;
 	}
 
-	printf("Will check <%s>, size <%llu>, using %u threads\n", filename,
-				(unsigned long long) dev_size, num_threads);
+	if (!json_output)
+		printf("Will check <%s>, size <%llu>, using %u threads\n",
+				filename, (unsigned long long) dev_size,
+				num_threads);
 
 	return run_dedupe_threads(&file, dev_size, nextents, nchunks,
 					unique_capacity);
@@ -606,27 +1011,56 @@ static void show_stat(uint64_t nextents, uint64_t nchunks, uint64_t ndupextents,
 	}
 }
 
-static void iter_rb_tree(uint64_t *nextents, uint64_t *nchunks, uint64_t *ndupextents)
+static void show_stat_json(const char *filename, uint64_t nextents,
+			   uint64_t nchunks, uint64_t ndupextents,
+			   uint64_t unique_capacity)
 {
-	struct fio_rb_node *n;
-	*nchunks = *nextents = *ndupextents = 0;
+	double perc = 0.0;
 
-	n = rb_first(&rb_root);
-	if (!n)
-		return;
+	if (nextents)
+		perc = 100.0 * (1.00 - ((double) nchunks / (double) nextents));
 
-	do {
-		struct chunk *c;
+	printf("{\"result\": {\"file\": \"%s\", \"blocksize\": %u, "
+		"\"hash\": \"%s\", \"bloom\": %s, \"extents\": %llu, "
+		"\"unique_extents\": %llu", filename, blocksize,
+		hash_names[hash_type], bloom ? "true" : "false",
+		(unsigned long long) nextents, (unsigned long long) nchunks);
+	if (!bloom)
+		printf(", \"duplicated_extents\": %llu",
+			(unsigned long long) ndupextents);
+	if (nchunks)
+		printf(", \"dedupe_ratio\": %.2f",
+			(double) nextents / (double) nchunks - 1.0);
+	printf(", \"dedupe_percentage\": %u", (int) (perc + 0.50));
+	if (compression)
+		printf(", \"unique_capacity\": %llu",
+			(unsigned long long) unique_capacity);
+	printf("}}\n");
+}
+
+static void iter_hash_table(uint64_t *nextents, uint64_t *nchunks,
+			    uint64_t *ndupextents)
+{
+	struct chunk *c;
+	uint64_t j;
+	int i;
 
-		c = rb_entry(n, struct chunk, rb_node);
-		(*nchunks)++;
-		*nextents += c->count;
-		*ndupextents += (c->count > 1);
+	*nchunks = *nextents = *ndupextents = 0;
+
+	for (i = 0; i < HASH_SHARDS; i++) {
+		struct hash_shard *sh = &shards[i];
 
-		if (dump_output)
-			show_chunk(c);
+		for (j = 0; j < sh->nr_buckets; j++) {
+			for (c = sh->buckets[j]; c; c = c->next) {
+				(*nchunks)++;
+				*nextents += c->count;
+				*ndupextents += (c->count > 1);
 
-	} while ((n = rb_next(n)) != NULL);
+				if (dump_output)
+					show_chunk(c);
+			}
+		}
+	}
 }
 
 static int usage(char *argv[])
@@ -641,18 +1075,23 @@ static int usage(char *argv[])
 	log_err("\t-B\tUse probabilistic bloom filter\n");
 	log_err("\t-p\tPrint progress indicator\n");
 	log_err("\t-C\tCalculate compressible size\n");
+	log_err("\t-H\tHash to use: md5 (default), xxhash or crc32c\n");
+	log_err("\t-u\tRead with io_uring\n");
+	log_err("\t-q\tio_uring queue depth per thread\n");
+	log_err("\t-j\tJSON output, one object per line\n");
+	log_err("\t-i\tProgress interval in msec\n");
 	return 1;
 }
 
 int main(int argc, char *argv[])
 {
 	uint64_t nextents = 0, nchunks = 0, ndupextents = 0, unique_capacity;
-	int c, ret;
+	int c, i, ret;
 
 	arch_init(argv);
 	debug_init();
 
-	while ((c = getopt(argc, argv, "b:t:d:o:c:p:B:C:")) != -1) {
+	while ((c = getopt(argc, argv, "b:t:d:o:c:p:B:C:H:u:q:j:i:")) != -1) {
 		switch (c) {
 		case 'b':
 			blocksize = atoi(optarg);
@@ -678,6 +1117,28 @@ int main(int argc, char *argv[])
 		case 'C':
 			compression = atoi(optarg);
 			break;
+		case 'H':
+			for (i = 0; i < FIO_ARRAY_SIZE(hash_names); i++)
+				if (!strcmp(optarg, hash_names[i]))
+					break;
+			if (i == FIO_ARRAY_SIZE(hash_names)) {
+				log_err("dedupe: unknown hash %s\n", optarg);
+				return usage(argv);
+			}
+			hash_type = i;
+			break;
+		case 'u':
+			use_uring = atoi(optarg);
+			break;
+		case 'q':
+			uring_depth = atoi(optarg);
+			break;
+		case 'j':
+			json_output = atoi(optarg);
+			break;
+		case 'i':
+			progress_msec = atoi(optarg);
+			break;
 		case '?':
 		default:
 			return usage(argv);
@@ -690,24 +1151,51 @@ int main(int argc, char *argv[])
 	if (!num_threads)
 		num_threads = cpus_configured();
 
+	if (blocksize % (HASH_WORDS * sizeof(uint32_t))) {
+		log_err("dedupe: block size must be a multiple of 16\n");
+		return 1;
+	}
+	if (chunk_size % blocksize)
+		chunk_size -= chunk_size % blocksize;
+	if (!chunk_size)
+		chunk_size = blocksize;
+
+#ifndef DEDUPE_URING
+	if (use_uring) {
+		log_err("dedupe: io_uring not supported on this platform\n");
+		return 1;
+	}
+#endif
+	if (use_uring && !uring_depth)
+		uring_depth = 1;
+	if (!progress_msec)
+		progress_msec = 250;
+
 	if (argc == optind)
 		return usage(argv);
 
-	sinit();
+	if (hash_type == DEDUPE_HASH_CRC32C) {
+		crc32c_arm64_probe();
+		crc32c_intel_probe();
+	}
 
-	rb_root = RB_ROOT;
-	rb_lock = fio_sem_init(FIO_SEM_UNLOCKED);
+	sinit();
 
 	ret = dedupe_check(argv[optind], &nextents, &nchunks, &unique_capacity);
 
 	if (!ret) {
 		if (!bloom)
-			iter_rb_tree(&nextents, &nchunks, &ndupextents);
+			iter_hash_table(&nextents, &nchunks, &ndupextents);
 
-		show_stat(nextents, nchunks, ndupextents, unique_capacity);
+		if (json_output)
+			show_stat_json(argv[optind], nextents, nchunks,
+					ndupextents, unique_capacity);
+		else
+			show_stat(nextents, nchunks, ndupextents,
+					unique_capacity);
 	}
 
-	fio_sem_remove(rb_lock);
+	free_shards();
 	if (bloom)
 		bloom_free(bloom);
 	scleanup();
@@ -599,6 +599,32 @@ class FioJobFileTest_t0034(FioJobFileTest_LogFileFormat):
             'log_iops.3.log': '\\d+, \\d+, \\d+, \\d+, \\d+, \\d+, 0\\n',
         }
 
+class FioJobFileTest_t0039(FioJobFileTest):
+    """Test consists of fio test job t0039
+    Confirm that each group of four clones replays the 16 writes of the
+    iolog between them, and that the clones of an empty shard finish
+    without an error."""
+
+    def check_result(self):
+        super().check_result()
+
+        if not self.passed:
+            return
+
+        for name, busy in [('file', 2), ('offset', 1)]:
+            jobs = [job for job in self.json_data['jobs'] if job['jobname'] == name]
+            ios = [job['write']['total_ios'] for job in jobs]
+            errors = [job['error'] for job in jobs]
+            logging.debug("Test %d: %s ios %s errors %s", self.testnum, name,
+                          ios, errors)
+            if len(jobs) != 4 or any(errors) or sum(ios) != 16:
+                self.failure_reason += f" {name} sharding replayed {ios} with errors {errors},"
+                self.passed = False
+            elif len([nr for nr in ios if nr]) != busy:
+                self.failure_reason += f" {name} sharding expected {busy} busy clones, got {ios},"
+                self.passed = False
+
+
 class FioJobFileTest_iops_rate(FioJobFileTest):
     """Test consists of fio test job t0011
     Confirm that job0 iops == 1000
@@ -969,6 +995,25 @@ TEST_LIST = [
         'pre_success':      SUCCESS_DEFAULT,
         'requirements':     [Requirements.linux, Requirements.libaio],
     },
+    {
+        'test_id':          38,
+        'test_class':       FioJobFileTest,
+        'job':              't0038.fio',
+        'success':          SUCCESS_DEFAULT,
+        'pre_job':          None,
+        'pre_success':      None,
+        'requirements':     [Requirements.linux, Requirements.io_uring],
+    },
+    {
+        'test_id':          39,
+        'test_class':       FioJobFileTest_t0039,
+        'job':              't0039.fio',
+        'success':          SUCCESS_DEFAULT,
+        'pre_job':          't0039-pre.fio',
+        'pre_success':      SUCCESS_DEFAULT,
+        'output_format':    'json',
+        'requirements':     [],
+    },
     {
         'test_id':          1000,
         'test_class':       FioExeTest,
@@ -1,5 +1,5 @@
 /*
- * Dump the contents of a verify state file in plain text
+ * Dump the contents of a verify state file or journal in plain text
  */
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -95,8 +95,63 @@ static void show_verify_state(void *buf, size_t size)
 		log_err("Unsupported version %d\n", (int) hdr->version);
 }
 
+static void show_verify_journal(void *buf, size_t size)
+{
+	size_t slot_sz = size / 2;
+	int i;
+
+	if (!size || (size & 1)) {
+		log_err("Bad journal size %lu\n", (unsigned long) size);
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		struct verify_state_journal_rec *rec = buf + i * slot_sz;
+		struct thread_io_list *s;
+		uint32_t crc;
+
+		rec->version = le64_to_cpu(rec->version);
+		rec->seq = le64_to_cpu(rec->seq);
+		rec->size = le64_to_cpu(rec->size);
+		rec->crc = le64_to_cpu(rec->crc);
+
+		printf("Slot:\t\t%d\n", i);
+		printf("Version:\t0x%x\n", (unsigned int) rec->version);
+		printf("Sequence:\t%llu\n", (unsigned long long) rec->seq);
+		printf("Size:\t\t%u\n", (unsigned int) rec->size);
+		printf("CRC:\t\t0x%x\n", (unsigned int) rec->crc);
+
+		if (rec->version != VSTATE_JOURNAL_VERSION) {
+			log_err("Unsupported version %d\n", (int) rec->version);
+			continue;
+		}
+		if (rec->size < sizeof(struct thread_io_list) ||
+		    rec->size > slot_sz - sizeof(*rec)) {
+			log_err("Size mismatch\n");
+			continue;
+		}
+
+		/* crc was computed over the little endian fields */
+		rec->version = cpu_to_le64(rec->version);
+		rec->seq = cpu_to_le64(rec->seq);
+		rec->size = cpu_to_le64(rec->size);
+		crc = fio_crc32c((unsigned char *) &rec->version,
+				sizeof(*rec) - sizeof(rec->crc) +
+				le64_to_cpu(rec->size));
+		if (crc != rec->crc) {
+			log_err("crc mismatch %x != %x\n", crc,
+					(unsigned int) rec->crc);
+			continue;
+		}
+
+		s = (struct thread_io_list *) (rec + 1);
+		show(s, thread_io_list_sz(s));
+	}
+}
+
 static int show_file(const char *file)
 {
+	size_t len = strlen(file);
 	struct stat sb;
 	void *buf;
 	int ret, fd;
@@ -128,7 +183,10 @@ static int show_file(const char *file)
 	}
 
 	close(fd);
-	show_verify_state(buf, sb.st_size);
+	if (len > 8 && !strcmp(file + len - 8, ".journal"))
+		show_verify_journal(buf, sb.st_size);
+	else
+		show_verify_state(buf, sb.st_size);
 
 	free(buf);
 	return 0;
@@ -141,7 +199,7 @@ int main(int argc, char *argv[])
 	debug_init();
 
 	if (argc < 2) {
-		log_err("Usage: %s <state file>\n", argv[0]);
+		log_err("Usage: %s <state file or journal>\n", argv[0]);
 		return 1;
 	}
 
@@ -31,6 +31,41 @@ enum fio_memtype {
 	MEM_CUDA_MALLOC,/* use GPU memory */
 };
 
+/*
+ * How read_iolog entries are split across the clones of a job
+ */
+enum replay_shard_mode {
+	REPLAY_SHARD_NONE = 0,
+	REPLAY_SHARD_FILE,
+	REPLAY_SHARD_OFFSET,
+	REPLAY_SHARD_HASH,
+};
+
+/*
+ * Format used for write_iolog
+ */
+enum iolog_format {
+	IOLOG_FORMAT_TEXT = 0,
+	IOLOG_FORMAT_BINARY = 1,
+};
+
+/*
+ * Format of the latency, bandwidth and IOPS logs
+ */
+enum log_format {
+	LOG_FORMAT_TEXT = 0,
+	LOG_FORMAT_BINARY = 1,
+	LOG_FORMAT_COLUMNAR = 2,
+};
+
+/*
+ * How written blocks are remembered for the verify phase
+ */
+enum verify_tracking {
+	VERIFY_TRACK_LIST = 0,
+	VERIFY_TRACK_BITMAP = 1,
+};
+
 /*
  * What mode to use for deduped data generation
  */
@@ -158,6 +193,8 @@ struct thread_options {
 	unsigned int experimental_verify;
 	unsigned int verify_state;
 	unsigned int verify_state_save;
+	unsigned int verify_state_interval;
+	unsigned int verify_tracking;
 	unsigned int verify_write_sequence;
 	unsigned int verify_header_seed;
 	unsigned int use_thread;
@@ -174,6 +211,8 @@ struct thread_options {
 	unsigned int log_offset;
 	unsigned int log_gz;
 	unsigned int log_gz_store;
+	unsigned int log_gz_type;
+	unsigned int log_format;
 	unsigned int log_alternate_epoch;
 	unsigned int log_alternate_epoch_clock_id;
 	unsigned int norandommap;
@@ -292,10 +331,13 @@ struct thread_options {
 	unsigned int lat_percentiles;
 	unsigned int percentile_precision;	/* digits after decimal for percentiles */
 	fio_fp64_t percentile_list[FIO_IO_U_LIST_MAX_LEN];
+	unsigned int lat_hist_precision;
+	unsigned long long lat_hist_max;
 
 	char *read_iolog_file;
 	bool read_iolog_chunked;
 	char *write_iolog_file;
+	unsigned int write_iolog_format;
 	char *merge_blktrace_file;
 	fio_fp64_t merge_blktrace_scalars[FIO_IO_U_LIST_MAX_LEN];
 	fio_fp64_t merge_blktrace_iters[FIO_IO_U_LIST_MAX_LEN];
@@ -304,11 +346,14 @@ struct thread_options {
 	unsigned int write_lat_log;
 	unsigned int write_iops_log;
 	unsigned int write_hist_log;
+	unsigned int write_timeline_log;
+	unsigned int log_timeline_usec;
 
 	char *bw_log_file;
 	char *lat_log_file;
 	char *iops_log_file;
 	char *hist_log_file;
+	char *timeline_log_file;
 	char *replay_redirect;
 
 	/*
@@ -385,6 +430,8 @@ struct thread_options {
 	unsigned int replay_scale;
 	unsigned int replay_time_scale;
 	unsigned int replay_skip;
+	unsigned int replay_shard;
+	unsigned int replay_shard_chunk;
 
 	unsigned int per_job_logs;
 
@@ -494,6 +541,8 @@ struct thread_options_pack {
 	uint32_t experimental_verify;
 	uint32_t verify_state;
 	uint32_t verify_state_save;
+	uint32_t verify_state_interval;
+	uint32_t verify_tracking;
 	uint32_t verify_write_sequence;
 	uint32_t verify_header_seed;
 	uint32_t use_thread;
@@ -510,6 +559,8 @@ struct thread_options_pack {
 	uint32_t log_offset;
 	uint32_t log_gz;
 	uint32_t log_gz_store;
+	uint32_t log_gz_type;
+	uint32_t log_format;
 	uint32_t log_alternate_epoch;
 	uint32_t log_alternate_epoch_clock_id;
 	uint32_t norandommap;
@@ -623,7 +674,7 @@ struct thread_options_pack {
 	uint32_t lat_percentiles;
 	uint32_t slat_percentiles;
 	uint32_t percentile_precision;
-	uint32_t pad;
+	uint32_t lat_hist_precision;
 	fio_fp64_t percentile_list[FIO_IO_U_LIST_MAX_LEN];
 
 	uint8_t read_iolog_file[FIO_TOP_STR_MAX];
@@ -636,11 +687,14 @@ struct thread_options_pack {
 	uint32_t write_lat_log;
 	uint32_t write_iops_log;
 	uint32_t write_hist_log;
+	uint32_t write_timeline_log;
+	uint32_t log_timeline_usec;
 
 	uint8_t bw_log_file[FIO_TOP_STR_MAX];
 	uint8_t lat_log_file[FIO_TOP_STR_MAX];
 	uint8_t iops_log_file[FIO_TOP_STR_MAX];
 	uint8_t hist_log_file[FIO_TOP_STR_MAX];
+	uint8_t timeline_log_file[FIO_TOP_STR_MAX];
 	uint8_t replay_redirect[FIO_TOP_STR_MAX];
 
 	/*
@@ -695,6 +749,7 @@ struct thread_options_pack {
 
 	uint64_t latency_target;
 	uint64_t latency_window;
+	uint64_t lat_hist_max;
 	uint64_t max_latency[DDIR_RWDIR_CNT];
 	uint32_t latency_run;
 	fio_fp64_t latency_percentile;
@@ -714,6 +769,9 @@ struct thread_options_pack {
 	uint32_t replay_scale;
 	uint32_t replay_time_scale;
 	uint32_t replay_skip;
+	uint32_t write_iolog_format;
+	uint32_t replay_shard;
+	uint32_t replay_shard_chunk;
 
 	uint32_t per_job_logs;
 
@@ -200,11 +200,21 @@ bool ramp_period_over(struct thread_data *td)
 	if (td->ramp_period_state == RAMP_DONE)
 		return true;
 
-	if (td->ramp_period_state == RAMP_RUNNING)
+	/*
+	 * Offload workers aren't checked by ramp_period_check(), they
+	 * follow their parent instead.
+	 */
+	if (td->ramp_period_state == RAMP_RUNNING &&
+	    (!td->parent || td->parent->ramp_period_state == RAMP_RUNNING))
 		return false;
 
 	td->ramp_period_state = RAMP_DONE;
-	reset_all_stats(td);
+	/*
+	 * Offload workers hand their counters to the parent, which gets
+	 * reset below. Only their own latency samples need clearing.
+	 */
+	if (!td->parent)
+		reset_all_stats(td);
 	reset_io_stats(td);
 	td_set_runstate(td, TD_RAMP);
 
@@ -213,8 +223,10 @@ bool ramp_period_over(struct thread_data *td)
 	 * the parent never enters do_io(), which will switch us
 	 * from RAMP -> RUNNING. Do this manually here.
 	 */
-	if (parent_update_ramp(td))
+	if (td->parent) {
+		parent_update_ramp(td);
 		td_set_runstate(td, TD_RUNNING);
+	}
 
 	return true;
 }
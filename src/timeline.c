@@ -0,0 +1,281 @@
+/*
+ * write_timeline_log: the byte and I/O counters of jobs, sampled every
+ * log_timeline_usec by a dedicated thread. Sampling is a few relaxed loads
+ * of counters the jobs update anyway, into a ring per job, so it costs the
+ * jobs nothing and shows stalls far shorter than log_avg_msec windows can.
+ * The helper thread drains the rings to the logs.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "fio.h"
+#include "timeline.h"
+
+bool timeline_enabled = false;
+
+/*
+ * How long the sampler sleeps when no job is running
+ */
+#define TIMELINE_IDLE_NSEC	1000000ULL
+
+static struct timeline_data {
+	volatile int exit;
+	pthread_t thread;
+} *timeline_data;
+
+int timeline_setup(struct thread_data *td, const char *filename)
+{
+	struct timeline *tl;
+
+	tl = calloc(1, sizeof(*tl));
+	if (!tl)
+		return 1;
+
+	tl->filename = strdup(filename);
+	tl->interval_ns = td->o.log_timeline_usec * 1000ULL;
+	td->timeline = tl;
+	timeline_enabled = true;
+	return 0;
+}
+
+static bool timeline_running(struct thread_data *td)
+{
+	switch (td->runstate) {
+	case TD_RUNNING:
+	case TD_VERIFYING:
+	case TD_FINISHING:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint64_t ts_to_nsec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/*
+ * The counters are only written by the job, a relaxed load is enough to
+ * read them whole. If the helper thread fell behind, the sample is dropped,
+ * the next one covers its interval.
+ */
+static void timeline_sample(struct thread_data *td, struct timeline *tl)
+{
+	unsigned int head = tl->head;
+	struct timeline_sample *s;
+	struct timespec now;
+	int ddir;
+
+	if (head - atomic_load_acquire(&tl->tail) == TIMELINE_RING_ENTRIES) {
+		tl->dropped++;
+		return;
+	}
+
+	s = &tl->ring[head & (TIMELINE_RING_ENTRIES - 1)];
+	fio_gettime(&now, NULL);
+	s->time = utime_since(&td->epoch, &now);
+	for (ddir = 0; ddir < DDIR_RWDIR_CNT; ddir++) {
+		s->bytes[ddir] = atomic_load_relaxed(&td->io_bytes[ddir]);
+		s->ios[ddir] = atomic_load_relaxed(&td->io_blocks[ddir]);
+	}
+
+	atomic_store_release(&tl->head, head + 1);
+}
+
+static void *timeline_thread_main(void *data)
+{
+	struct timeline_data *tld = data;
+	struct timespec ts;
+
+#ifdef CONFIG_PTHREAD_SIGMASK
+	{
+		sigset_t sigmask;
+
+		sigfillset(&sigmask);
+		pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+	}
+#endif
+#if defined(__linux__) && defined(PR_SET_TIMERSLACK)
+	/*
+	 * The default slack of 50 usec would be most of an interval
+	 */
+	prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+
+	while (!tld->exit) {
+		uint64_t now_ns, next_ns = -1ULL;
+
+		fio_get_mono_time(&ts);
+		now_ns = ts_to_nsec(&ts);
+
+		for_each_td(td) {
+			struct timeline *tl = td->timeline;
+
+			if (!tl)
+				continue;
+			if (!timeline_running(td)) {
+				/*
+				 * Catch the I/O done since the last sample
+				 * when the job stops
+				 */
+				if (tl->next_ns)
+					timeline_sample(td, tl);
+				tl->next_ns = 0;
+				continue;
+			}
+
+			if (now_ns >= tl->next_ns) {
+				timeline_sample(td, tl);
+				/*
+				 * Don't try to catch up on missed intervals,
+				 * the sample times show them
+				 */
+				tl->next_ns += tl->interval_ns;
+				if (tl->next_ns <= now_ns)
+					tl->next_ns = now_ns + tl->interval_ns;
+			}
+			next_ns = min(next_ns, tl->next_ns);
+		} end_for_each();
+
+		if (next_ns == -1ULL)
+			next_ns = now_ns + TIMELINE_IDLE_NSEC;
+
+		fio_get_mono_time(&ts);
+		now_ns = ts_to_nsec(&ts);
+		if (next_ns > now_ns) {
+			struct timespec req = {
+				.tv_sec		= (next_ns - now_ns) / 1000000000ULL,
+				.tv_nsec	= (next_ns - now_ns) % 1000000000ULL,
+			};
+
+			nanosleep(&req, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+static uint64_t counter_delta(uint64_t cur, uint64_t last)
+{
+	/*
+	 * Counters start over when a job is reset, e.g. after ramp_time
+	 */
+	return cur >= last ? cur - last : cur;
+}
+
+static int timeline_drain_one(struct timeline *tl)
+{
+	unsigned int tail = tl->tail;
+	unsigned int head = atomic_load_acquire(&tl->head);
+
+	if (tail == head)
+		return 0;
+
+	if (!tl->f && !tl->disabled) {
+		tl->f = fopen(tl->filename, "w");
+		if (!tl->f) {
+			log_err("fio: open timeline log %s: %s\n", tl->filename,
+				strerror(errno));
+			tl->disabled = true;
+		}
+	}
+
+	for (; tail != head; tail++) {
+		struct timeline_sample *s;
+		int ddir;
+
+		s = &tl->ring[tail & (TIMELINE_RING_ENTRIES - 1)];
+		if (!tl->disabled) {
+			fprintf(tl->f, "%llu", (unsigned long long) s->time);
+			for (ddir = 0; ddir < DDIR_RWDIR_CNT; ddir++)
+				fprintf(tl->f, ", %llu, %llu",
+					(unsigned long long) counter_delta(s->bytes[ddir],
+							tl->last.bytes[ddir]),
+					(unsigned long long) counter_delta(s->ios[ddir],
+							tl->last.ios[ddir]));
+			fputc('\n', tl->f);
+		}
+		tl->last = *s;
+	}
+
+	atomic_store_release(&tl->tail, tail);
+	return 0;
+}
+
+/*
+ * Called from the helper thread every TIMELINE_DRAIN_MSEC
+ */
+int timeline_drain(void)
+{
+	for_each_td(td) {
+		if (td->timeline)
+			timeline_drain_one(td->timeline);
+	} end_for_each();
+
+	return 0;
+}
+
+int timeline_create(void)
+{
+	struct timeline_data *tld;
+	int ret;
+
+	if (!timeline_enabled)
+		return 0;
+
+	tld = calloc(1, sizeof(*tld));
+	if (!tld)
+		return 1;
+
+	ret = pthread_create(&tld->thread, NULL, timeline_thread_main, tld);
+	if (ret) {
+		log_err("fio: can't create timeline thread: %s\n",
+			strerror(ret));
+		free(tld);
+		return 1;
+	}
+
+	timeline_data = tld;
+	return 0;
+}
+
+/*
+ * Stop the sampler and write out what's left. The helper thread must be
+ * gone, it's the only other user of the rings.
+ */
+void timeline_exit(void)
+{
+	if (timeline_data) {
+		timeline_data->exit = 1;
+		pthread_join(timeline_data->thread, NULL);
+		free(timeline_data);
+		timeline_data = NULL;
+	}
+
+	for_each_td(td) {
+		struct timeline *tl = td->timeline;
+
+		if (!tl)
+			continue;
+
+		if (tl->next_ns)
+			timeline_sample(td, tl);
+		timeline_drain_one(tl);
+		if (tl->dropped)
+			log_info("fio: %s: %llu timeline samples dropped\n",
+				 td->o.name, (unsigned long long) tl->dropped);
+		if (tl->f && fclose(tl->f))
+			log_err("fio: close timeline log %s: %s\n",
+				tl->filename, strerror(errno));
+		free(tl->filename);
+		free(tl);
+		td->timeline = NULL;
+	} end_for_each();
+}
@@ -0,0 +1,57 @@
+#ifndef FIO_TIMELINE_H
+#define FIO_TIMELINE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "io_ddir.h"
+
+/*
+ * Samples a job can have waiting for the helper thread. It drains them every
+ * TIMELINE_DRAIN_MSEC, that's three times as long at the shortest interval.
+ */
+#define TIMELINE_RING_ENTRIES	16384
+#define TIMELINE_DRAIN_MSEC	50
+
+#define TIMELINE_MIN_USEC	10
+
+/*
+ * Counters of a job, as of 'time' usec after it started
+ */
+struct timeline_sample {
+	uint64_t time;
+	uint64_t bytes[DDIR_RWDIR_CNT];
+	uint64_t ios[DDIR_RWDIR_CNT];
+};
+
+/*
+ * Single producer, single consumer ring of samples. Only the sampler thread
+ * moves 'head', only the helper thread moves 'tail', the ring keeps the two
+ * on separate cache lines.
+ */
+struct timeline {
+	unsigned int head;
+	uint64_t next_ns;
+	uint64_t interval_ns;
+	uint64_t dropped;
+
+	struct timeline_sample ring[TIMELINE_RING_ENTRIES];
+
+	unsigned int tail;
+	struct timeline_sample last;
+	char *filename;
+	FILE *f;
+	bool disabled;
+};
+
+struct thread_data;
+
+extern bool timeline_enabled;
+
+extern int timeline_setup(struct thread_data *, const char *);
+extern int timeline_create(void);
+extern void timeline_exit(void);
+extern int timeline_drain(void);
+
+#endif
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+#
+# fiologparser_columnar.py
+#
+# Read fio logs written with log_format=columnar or log_format=binary, and
+# print them in the format of text logs:
+#
+# fiologparser_columnar.py job_clat.1.col > job_clat.1.log
+#
+# or only some of their columns, as CSV with a header:
+#
+# fiologparser_columnar.py -c time,value,bs job_clat.1.col
+#
+# The file layouts are described in log_columnar.h and log_stream.h.
+
+import argparse
+import struct
+import sys
+
+COL_MAGIC = b'fio column log\0\0'
+BIN_MAGIC = b'fio sample log\0\0'
+BATCH_MAGIC = 0x48435442
+
+ENC_VARINT, ENC_DELTA, ENC_RLE, ENC_SPARSE = range(4)
+IO_LOG_TYPE_HIST = 6
+
+OFFSET_BIT = 0x80000000
+PRIO_BIT = 0x40000000
+AVG_MAX_BIT = 0x20000000
+ISSUE_TIME_BIT = 0x10000000
+
+IOPRIO_CLASS_SHIFT = 13
+IOPRIO_CLASS_RT = 1
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Print columnar or binary fio logs as text logs')
+    parser.add_argument('-c', '--columns', default=None,
+                        help='comma separated columns to print, as CSV with a header')
+    parser.add_argument('-s', '--schema', action='store_true', default=False,
+                        help='print the columns of the log and exit')
+    parser.add_argument('files', nargs='+', help='log files')
+    return parser.parse_args()
+
+
+def varints(buf, pos, end, n):
+    out = []
+    while len(out) < n:
+        val = shift = 0
+        while True:
+            if pos >= end:
+                raise ValueError('truncated column')
+            b = buf[pos]
+            pos += 1
+            val |= (b & 0x7f) << shift
+            if not b & 0x80:
+                break
+            shift += 7
+        out.append(val)
+    return out, pos
+
+
+def zigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def decode(enc, buf, nr_rows, list_size):
+    end = len(buf)
+    if enc == ENC_VARINT:
+        return varints(buf, 0, end, nr_rows)[0]
+    if enc == ENC_DELTA:
+        out, prev = [], 0
+        for d in varints(buf, 0, end, nr_rows)[0]:
+            prev = (prev + zigzag(d)) & 0xffffffffffffffff
+            out.append(prev)
+        return out
+    if enc == ENC_RLE:
+        out, pos = [], 0
+        while len(out) < nr_rows:
+            (val, run), pos = varints(buf, pos, end, 2)
+            if not run or len(out) + run > nr_rows:
+                raise ValueError('bad run length')
+            out.extend([val] * run)
+        return out
+    if enc == ENC_SPARSE:
+        out, pos = [], 0
+        for _ in range(nr_rows):
+            row = [0] * list_size
+            (nz,), pos = varints(buf, pos, end, 1)
+            idx = 0
+            for _ in range(nz):
+                (gap, val), pos = varints(buf, pos, end, 2)
+                idx += gap
+                row[idx] = val
+            out.append(row)
+        return out
+    raise ValueError('unknown encoding %d' % enc)
+
+
+def read_columnar(f):
+    """Yield (names, log_type, flags), then one dict of columns per batch"""
+    version, log_type, flags, nr_cols = struct.unpack('<4I', f.read(16))
+    if version != 1:
+        raise ValueError('unsupported version %d' % version)
+
+    cols = []
+    for _ in range(nr_cols):
+        name, _type, list_size = struct.unpack('<16s2I', f.read(24))
+        cols.append((name.rstrip(b'\0').decode(), list_size))
+    yield [c[0] for c in cols], log_type, flags
+
+    while True:
+        hdr = f.read(8)
+        if not hdr:
+            return
+        magic, nr_rows = struct.unpack('<2I', hdr)
+        if magic != BATCH_MAGIC:
+            raise ValueError('bad batch at offset %d' % (f.tell() - 8))
+        batch = {}
+        for name, list_size in cols:
+            enc, length = struct.unpack('<2I', f.read(8))
+            batch[name] = decode(enc, f.read(length), nr_rows, list_size)
+        yield batch
+
+
+BIN_FIELDS = ('time', 'value', 'value1', 'bs', 'offset', 'issue_time',
+              'ddir', 'prio')
+
+
+def read_binary(f):
+    """Same as read_columnar(), for the fixed size records of binary logs"""
+    version, rec_size, log_type, flags = struct.unpack('<4I', f.read(16))
+    if version != 1 or rec_size < 56:
+        raise ValueError('unsupported version %d' % version)
+
+    names = ['time', 'value']
+    if flags & AVG_MAX_BIT:
+        names.append('value1')
+    names += ['ddir', 'bs']
+    if flags & OFFSET_BIT:
+        names.append('offset')
+    names.append('prio')
+    if flags & ISSUE_TIME_BIT:
+        names.append('issue_time')
+    yield names, log_type, flags
+
+    while True:
+        data = f.read(rec_size * 4096)
+        if not data:
+            return
+        batch = dict((n, []) for n in BIN_FIELDS)
+        for i in range(0, len(data) - rec_size + 1, rec_size):
+            rec = struct.unpack_from('<6QIH', data, i)
+            for n, v in zip(BIN_FIELDS, rec):
+                batch[n].append(v)
+        yield batch
+
+
+def signed(v):
+    return v - (1 << 64) if v & (1 << 63) else v
+
+
+def text_line(names, flags, row):
+    """Format a row like flush_samples() in iolog.c"""
+    fields = []
+    for n in names:
+        v = row[n]
+        if n in ('value', 'value1'):
+            fields.append(str(signed(v)))
+        elif n == 'prio':
+            if flags & PRIO_BIT:
+                fields.append('0x%04x' % v)
+            else:
+                rt = (v >> IOPRIO_CLASS_SHIFT) == IOPRIO_CLASS_RT
+                fields.append('1' if rt else '0')
+        elif n == 'bins':
+            fields.append(', '.join(str(b) for b in v))
+        else:
+            fields.append(str(v))
+    return ', '.join(fields)
+
+
+def print_log(fname, args, out):
+    with open(fname, 'rb') as f:
+        magic = f.read(16)
+        if magic == COL_MAGIC:
+            reader = read_columnar(f)
+        elif magic == BIN_MAGIC:
+            reader = read_binary(f)
+        else:
+            raise ValueError('%s: not a columnar or binary fio log' % fname)
+
+        names, log_type, flags = next(reader)
+        if args.schema:
+            out.write('%s: %s\n' % (fname, ', '.join(names)))
+            return
+
+        sel = None
+        if args.columns:
+            sel = args.columns.split(',')
+            for n in sel:
+                if n not in names:
+                    raise ValueError('%s: no column %s' % (fname, n))
+            out.write(','.join(sel) + '\n')
+
+        for batch in reader:
+            cols = [batch[n] for n in names]
+            for vals in zip(*cols):
+                row = dict(zip(names, vals))
+                if sel:
+                    out.write(','.join(
+                        ' '.join(map(str, row[n])) if n == 'bins'
+                        else str(row[n]) for n in sel) + '\n')
+                else:
+                    out.write(text_line(names, flags, row) + '\n')
+
+
+def main():
+    args = parse_args()
+    try:
+        for fname in args.files:
+            print_log(fname, args, sys.stdout)
+    except (ValueError, struct.error) as e:
+        sys.stderr.write('fiologparser_columnar: %s\n' % e)
+        return 1
+    except BrokenPipeError:
+        pass
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -222,18 +222,19 @@ def _plat_idx_to_val(idx, edge=0.5, FIO_IO_U_PLAT_BITS=6, FIO_IO_U_PLAT_VAL=64):
     # Return the mean (if edge=0.5) of the range of the bucket
     return base + ((k + edge) * (1 << error_bits))
     
-def plat_idx_to_val_coarse(idx, coarseness, edge=0.5):
+def plat_idx_to_val_coarse(idx, coarseness, edge=0.5, plat_bits=6):
     """ Converts the given *coarse* index into a non-coarse index as used by fio
         in stat.h:plat_idx_to_val(), subsequently computing the appropriate
-        latency value for that bin.
+        latency value for that bin. plat_bits is the number of bits per group
+        of the histogram, 6 unless fio used lat_histogram_precision.
         """
 
     # Multiply the index by the power of 2 coarseness to get the bin
     # bin index with a max of 1536 bins (FIO_IO_U_PLAT_GROUP_NR = 24 in stat.h)
     stride = 1 << coarseness
     idx = idx * stride
-    lower = _plat_idx_to_val(idx, edge=0.0)
-    upper = _plat_idx_to_val(idx + stride, edge=1.0)
+    lower = _plat_idx_to_val(idx, 0.0, plat_bits, 1 << plat_bits)
+    upper = _plat_idx_to_val(idx + stride, 1.0, plat_bits, 1 << plat_bits)
     return lower + (upper - lower) * edge
 
 def print_all_stats(ctx, end, mn, ss_cnt, vs, ws, mx, dir=dir):
@@ -334,7 +335,10 @@ def guess_max_from_bins(ctx, hist_cols):
     """ Try to guess the GROUP_NR from given # of histogram
         columns seen in an input file """
     max_coarse = 8
-    if ctx.group_nr < 19 or ctx.group_nr > 26:
+    if ctx.plat_bits != 6:
+        # lat_histogram_precision, the groups follow lat_histogram_max
+        bins = [x << ctx.plat_bits for x in range(2, 65)]
+    elif ctx.group_nr < 19 or ctx.group_nr > 26:
         bins = [ctx.group_nr * (1 << 6)]
     else:
         bins = [1216,1280,1344,1408,1472,1536,1600,1664]
@@ -513,9 +517,9 @@ def main(ctx):
 
         max_cols = guess_max_from_bins(ctx, __HIST_COLUMNS)
         coarseness = int(np.log2(float(max_cols) / __HIST_COLUMNS))
-        bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness) for x in np.arange(__HIST_COLUMNS)], dtype=float)
-        lower_bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness, 0.0) for x in np.arange(__HIST_COLUMNS)], dtype=float)
-        upper_bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness, 1.0) for x in np.arange(__HIST_COLUMNS)], dtype=float)
+        bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness, 0.5, ctx.plat_bits) for x in np.arange(__HIST_COLUMNS)], dtype=float)
+        lower_bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness, 0.0, ctx.plat_bits) for x in np.arange(__HIST_COLUMNS)], dtype=float)
+        upper_bin_vals = np.array([plat_idx_to_val_coarse(x, coarseness, 1.0, ctx.plat_bits) for x in np.arange(__HIST_COLUMNS)], dtype=float)
 
     # indicate which directions to output (read(0), write(1), trim(2), mixed(3))
     directions = set()
@@ -577,6 +581,12 @@ if __name__ == '__main__':
         type=int,
         help='FIO_IO_U_PLAT_GROUP_NR as defined in stat.h')
 
+    arg('--plat_bits',
+        default=6,
+        type=int,
+        help='bits per histogram group: 6, or 4, 7, 10 or 14 for fio\'s '
+             'lat_histogram_precision of 1 to 4')
+
     arg('--job-file',
         default=None,
         type=str,
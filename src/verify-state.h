@@ -1,6 +1,7 @@
 #ifndef FIO_VERIFY_STATE_H
 #define FIO_VERIFY_STATE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <limits.h>
@@ -49,6 +50,20 @@ struct verify_state_hdr {
 	uint64_t crc;
 };
 
+#define VSTATE_JOURNAL_VERSION	0x01
+
+/*
+ * The verify state journal holds two of these, each at the start of its
+ * own slot and followed by a thread_io_list. Checkpoints alternate between
+ * the slots, so the newest complete one is never being overwritten.
+ */
+struct verify_state_journal_rec {
+	uint64_t crc;		/* of everything that follows */
+	uint64_t version;
+	uint64_t seq;
+	uint64_t size;		/* of the thread_io_list */
+};
+
 #define IO_LIST_ALL		0xffffffff
 
 struct io_u;
@@ -60,6 +75,12 @@ extern void verify_free_state(struct thread_data *);
 extern int verify_state_should_stop(struct thread_data *, uint64_t);
 extern void verify_assign_state(struct thread_data *, void *);
 extern int verify_state_hdr(struct verify_state_hdr *, struct thread_io_list *);
+extern bool verify_state_journal_enabled(struct thread_data *);
+extern int verify_state_journal_init(struct thread_data *);
+extern int verify_state_journal_flush(void);
+extern void verify_state_journal_close(void);
+
+extern unsigned int vstate_journal_msec;
 
 static inline size_t __thread_io_list_sz(uint32_t depth)
 {
@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <libgen.h>
+#include <sys/stat.h>
 
 #include "arch/arch.h"
 #include "fio.h"
@@ -15,6 +16,7 @@
 #include "lib/rand.h"
 #include "lib/hweight.h"
 #include "lib/pattern.h"
+#include "lib/blockmap.h"
 #include "oslib/asprintf.h"
 
 #include "crc/md5.h"
@@ -112,6 +114,9 @@ static unsigned int get_hdr_inc(struct thread_data *td, struct io_u *io_u)
 	return hdr_inc;
 }
 
+static bool fill_mb_headers(struct thread_data *td, struct io_u *io_u,
+			    unsigned int hdr_inc);
+
 static void fill_pattern_headers(struct thread_data *td, struct io_u *io_u,
 				 uint64_t seed, int use_seed)
 {
@@ -122,6 +127,9 @@ static void fill_pattern_headers(struct thread_data *td, struct io_u *io_u,
 	fill_verify_pattern(td, p, io_u->buflen, io_u, seed, use_seed);
 
 	hdr_inc = get_hdr_inc(td, io_u);
+	if (fill_mb_headers(td, io_u, hdr_inc))
+		return;
+
 	header_num = 0;
 	for (; p < io_u->buf + io_u->buflen; p += hdr_inc) {
 		hdr = p;
@@ -243,6 +251,7 @@ struct vcont {
 	struct io_u *io_u;
 	unsigned int hdr_num;
 	struct thread_data *td;
+	bool mb_ok;		/* checksum already matched by verify_mb_fill() */
 
 	/*
 	 * Output, only valid in case of error
@@ -521,13 +530,13 @@ static int verify_io_u_xxhash(struct verify_header *hdr, struct vcont *vc)
 	void *p = io_u_verify_off(hdr, vc);
 	struct vhdr_xxhash *vh = hdr_priv(hdr);
 	uint32_t hash;
-	void *state;
 
 	dprint(FD_VERIFY, "xxhash verify io_u %p, len %u\n", vc->io_u, hdr->len);
 
-	state = XXH32_init(1);
-	XXH32_update(state, p, hdr->len - hdr_size(vc->td, hdr));
-	hash = XXH32_digest(state);
+	if (vc->mb_ok)
+		return 0;
+
+	hash = XXH32(p, hdr->len - hdr_size(vc->td, hdr), 1);
 
 	if (vh->hash == hash)
 		return 0;
@@ -655,6 +664,9 @@ static int verify_io_u_sha256(struct verify_header *hdr, struct vcont *vc)
 
 	dprint(FD_VERIFY, "sha256 verify io_u %p, len %u\n", vc->io_u, hdr->len);
 
+	if (vc->mb_ok)
+		return 0;
+
 	fio_sha256_init(&sha256_ctx);
 	fio_sha256_update(&sha256_ctx, p, hdr->len - hdr_size(vc->td, hdr));
 	fio_sha256_final(&sha256_ctx);
@@ -827,27 +839,216 @@ static int verify_io_u_md5(struct verify_header *hdr, struct vcont *vc)
 	return EILSEQ;
 }
 
+/*
+ * sha256 and xxhash can hash several independent buffers at once with
+ * SIMD. Before the headers are walked one by one, hash the next run of
+ * intervals, from one large block or from a batch of io_u's, in one go
+ * and note which ones matched. The per-header check then only has to
+ * redo the work for a mismatch, so failures are reported as before.
+ */
+#define VERIFY_MB_LANES	16
+
+struct verify_mb {
+	struct io_u **io_us;
+	unsigned int nr_io_us;
+
+	unsigned int nr, pos;
+	bool end;
+	unsigned int idx[VERIFY_MB_LANES];
+	unsigned int hdr_num[VERIFY_MB_LANES];
+	bool ok[VERIFY_MB_LANES];
+};
+
+static bool verify_mb_type(struct thread_data *td)
+{
+	return td->o.verify == VERIFY_SHA256 || td->o.verify == VERIFY_XXHASH;
+}
+
+static void verify_mb_init(struct thread_data *td, struct verify_mb *mb,
+			   struct io_u **io_us, unsigned int nr)
+{
+	mb->io_us = io_us;
+	mb->nr_io_us = nr;
+	mb->nr = mb->pos = 0;
+	mb->end = !verify_mb_type(td) || td->o.verify_offset ||
+			td_ioengine_flagged(td, FIO_FAKEIO);
+}
+
+static void verify_mb_hash(struct thread_data *td, const uint8_t **data,
+			   uint32_t *len, struct verify_header **hdrs,
+			   bool *ok, unsigned int nr)
+{
+	unsigned int i;
+
+	if (td->o.verify == VERIFY_SHA256) {
+		uint8_t sha256[VERIFY_MB_LANES][64];
+		uint8_t *out[VERIFY_MB_LANES];
+
+		for (i = 0; i < nr; i++)
+			out[i] = sha256[i];
+		fio_sha256_multi(data, len, out, nr);
+		for (i = 0; i < nr; i++) {
+			struct vhdr_sha256 *vh = hdr_priv(hdrs[i]);
+
+			ok[i] = !memcmp(vh->sha256, sha256[i], sizeof(sha256[i]));
+		}
+	} else {
+		uint32_t hash[VERIFY_MB_LANES];
+
+		XXH32_multi((const void **) data, len, 1, hash, nr);
+		for (i = 0; i < nr; i++) {
+			struct vhdr_xxhash *vh = hdr_priv(hdrs[i]);
+
+			ok[i] = vh->hash == hash[i];
+		}
+	}
+}
+
+/*
+ * Hash up to VERIFY_MB_LANES intervals starting at header 'hdr_num' of
+ * io_u 'idx'. Intervals whose header doesn't describe exactly one
+ * interval are left to the regular path.
+ */
+static void verify_mb_fill(struct thread_data *td, struct verify_mb *mb,
+			   unsigned int idx, unsigned int hdr_num)
+{
+	struct verify_header *hdrs[VERIFY_MB_LANES];
+	const uint8_t *data[VERIFY_MB_LANES];
+	uint32_t len[VERIFY_MB_LANES];
+	unsigned int header_size = __hdr_size(td->o.verify);
+
+	mb->nr = mb->pos = 0;
+	for (; idx < mb->nr_io_us && mb->nr < VERIFY_MB_LANES;
+	     idx++, hdr_num = 0) {
+		struct io_u *io_u = mb->io_us[idx];
+		unsigned int hdr_inc;
+
+		if (io_u->ddir != DDIR_READ ||
+		    (io_u->flags & (IO_U_F_VER_IN_DEV | IO_U_F_TRIMMED)))
+			continue;
+
+		hdr_inc = get_hdr_inc(td, io_u);
+		if (hdr_inc <= header_size)
+			continue;
+
+		for (; (hdr_num + 1) * hdr_inc <= io_u->buflen &&
+		       mb->nr < VERIFY_MB_LANES; hdr_num++) {
+			struct verify_header *hdr;
+
+			hdr = io_u->buf + hdr_num * hdr_inc;
+			if (hdr->len != hdr_inc ||
+			    hdr->verify_type != td->o.verify)
+				continue;
+
+			hdrs[mb->nr] = hdr;
+			data[mb->nr] = (uint8_t *) hdr + header_size;
+			len[mb->nr] = hdr_inc - header_size;
+			mb->idx[mb->nr] = idx;
+			mb->hdr_num[mb->nr] = hdr_num;
+			mb->nr++;
+		}
+	}
+
+	/* nothing left after this run */
+	if (idx >= mb->nr_io_us)
+		mb->end = true;
+
+	if (mb->nr)
+		verify_mb_hash(td, data, len, hdrs, mb->ok, mb->nr);
+}
+
+/*
+ * Intervals are checked in the order they were hashed, return whether
+ * header 'hdr_num' of io_u 'idx' already matched its stored checksum.
+ */
+static bool verify_mb_ok(struct thread_data *td, struct verify_mb *mb,
+			 unsigned int idx, unsigned int hdr_num)
+{
+	while (mb->pos < mb->nr &&
+	       (mb->idx[mb->pos] < idx ||
+		(mb->idx[mb->pos] == idx && mb->hdr_num[mb->pos] < hdr_num)))
+		mb->pos++;
+
+	if (mb->pos == mb->nr) {
+		if (mb->end)
+			return false;
+		verify_mb_fill(td, mb, idx, hdr_num);
+	}
+
+	return mb->pos < mb->nr && mb->idx[mb->pos] == idx &&
+		mb->hdr_num[mb->pos] == hdr_num && mb->ok[mb->pos];
+}
+
+/*
+ * One per verify_async thread. The ring is popped by its owner and, when
+ * they run dry, by the other workers.
+ */
+struct verify_worker {
+	struct io_u_ring ring;
+	struct thread_data *td;
+	pthread_t thread;
+	unsigned int index;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int sleeping;
+};
+
+static void verify_worker_wake(struct verify_worker *w)
+{
+	pthread_mutex_lock(&w->lock);
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
 /*
  * Push IO verification to a separate thread
  */
 int verify_io_u_async(struct thread_data *td, struct io_u **io_u_ptr)
 {
 	struct io_u *io_u = *io_u_ptr;
+	struct verify_worker *w;
+	unsigned int i;
 
-	pthread_mutex_lock(&td->io_u_lock);
-
-	if (io_u->file)
+	if (io_u->file) {
+		__td_io_u_lock(td);
 		put_file_log(td, io_u->file);
+		__td_io_u_unlock(td);
+	}
 
 	if (io_u->flags & IO_U_F_IN_CUR_DEPTH) {
-		td->cur_depth--;
+		atomic_sub(&td->cur_depth, 1);
 		io_u_clear(td, io_u, IO_U_F_IN_CUR_DEPTH);
 	}
-	flist_add_tail(&io_u->verify_list, &td->verify_list);
+
+	if (td->parent)
+		td = td->parent;
+
+	i = __sync_fetch_and_add(&td->verify_next, 1) % td->o.verify_async;
+	w = &td->verify_workers[i];
+	if (!io_u_rpush(&w->ring, io_u))
+		assert(0);
 	*io_u_ptr = NULL;
 
-	pthread_cond_signal(&td->verify_cond);
-	pthread_mutex_unlock(&td->io_u_lock);
+	/*
+	 * Pairs with the barrier in verify_worker_sleep(). If the owner is
+	 * busy, wake an idle worker instead so it can steal the io_u.
+	 */
+	__sync_synchronize();
+	if (atomic_load_relaxed(&w->sleeping)) {
+		verify_worker_wake(w);
+		return 0;
+	}
+	if (!atomic_load_relaxed(&td->verify_nr_sleeping))
+		return 0;
+
+	for (i = 0; i < td->o.verify_async; i++) {
+		w = &td->verify_workers[i];
+		if (atomic_load_relaxed(&w->sleeping)) {
+			verify_worker_wake(w);
+			break;
+		}
+	}
+
 	return 0;
 }
 
@@ -954,13 +1155,28 @@ static int verify_header(struct io_u *io_u, struct thread_data *td,
 	 */
 	if (td_write(td) && (td_min_bs(td) == td_max_bs(td)) &&
 	    !td->o.time_based)
-		if (td->o.verify_write_sequence)
-			if (hdr->numberio != io_u->numberio) {
+		if (td->o.verify_write_sequence) {
+			/*
+			 * The verify map doesn't remember which write hit a
+			 * block last, only the range of writes it holds.
+			 */
+			if ((io_u->flags & IO_U_F_VER_BITMAP) &&
+			    (hdr->numberio < td->verify_map_numberio[0] ||
+			     hdr->numberio >= td->verify_map_numberio[1])) {
+				log_err("verify: bad header numberio %"PRIu64
+					", wanted %"PRIu64"-%"PRIu64,
+					hdr->numberio,
+					td->verify_map_numberio[0],
+					td->verify_map_numberio[1] - 1);
+				goto err;
+			} else if (!(io_u->flags & IO_U_F_VER_BITMAP) &&
+				   hdr->numberio != io_u->numberio) {
 				log_err("verify: bad header numberio %"PRIu64
 					", wanted %"PRIu64,
 					hdr->numberio, io_u->numberio);
 				goto err;
 			}
+		}
 
 	crc = fio_crc32c(p, offsetof(struct verify_header, crc32));
 	if (crc != hdr->crc32) {
@@ -984,10 +1200,10 @@ err:
 	return EILSEQ;
 }
 
-int verify_io_u(struct thread_data *td, struct io_u **io_u_ptr)
+static int __verify_io_u(struct thread_data *td, struct io_u *io_u,
+			 struct verify_mb *mb, unsigned int idx)
 {
 	struct verify_header *hdr;
-	struct io_u *io_u = *io_u_ptr;
 	unsigned int header_size, hdr_inc, hdr_num = 0;
 	void *p;
 	int ret;
@@ -1044,6 +1260,8 @@ int verify_io_u(struct thread_data *td, struct io_u **io_u_ptr)
 		else
 			verify_type = hdr->verify_type;
 
+		vc.mb_ok = verify_mb_ok(td, mb, idx, hdr_num);
+
 		switch (verify_type) {
 		case VERIFY_HDR_ONLY:
 			/* Header is always verified, check if pattern is left
@@ -1115,14 +1333,19 @@ done:
 	return ret;
 }
 
+int verify_io_u(struct thread_data *td, struct io_u **io_u_ptr)
+{
+	struct verify_mb mb;
+
+	verify_mb_init(td, &mb, io_u_ptr, 1);
+	return __verify_io_u(td, *io_u_ptr, &mb, 0);
+}
+
 static void fill_xxhash(struct verify_header *hdr, void *p, unsigned int len)
 {
 	struct vhdr_xxhash *vh = hdr_priv(hdr);
-	void *state;
 
-	state = XXH32_init(1);
-	XXH32_update(state, p, len);
-	vh->hash = XXH32_digest(state);
+	vh->hash = XXH32(p, len, 1);
 }
 
 static void fill_sha3(struct fio_sha3_ctx *sha3_ctx, void *p, unsigned int len)
@@ -1391,6 +1614,64 @@ static void populate_hdr(struct thread_data *td, struct io_u *io_u,
 		memswp(p, p + td->o.verify_offset, hdr_size(td, hdr));
 }
 
+/*
+ * With several sha256 or xxhash intervals per block, write all the headers
+ * first and then checksum the intervals VERIFY_MB_LANES at a time. The
+ * header crc32 doesn't cover the checksum, so the result is the same as
+ * populate_hdr() on each interval.
+ */
+static bool fill_mb_headers(struct thread_data *td, struct io_u *io_u,
+			    unsigned int hdr_inc)
+{
+	unsigned int header_size = __hdr_size(td->o.verify);
+	unsigned int nr_hdrs = io_u->buflen / hdr_inc;
+	struct verify_header *hdrs[VERIFY_MB_LANES];
+	const uint8_t *data[VERIFY_MB_LANES];
+	uint32_t len[VERIFY_MB_LANES];
+	unsigned int i, j, nr;
+
+	if (!verify_mb_type(td) || td->o.verify_offset || nr_hdrs < 2 ||
+	    io_u->buflen % hdr_inc || hdr_inc <= header_size)
+		return false;
+
+	dprint(FD_VERIFY, "fill %s io_u %p, %u intervals\n",
+		td->o.verify == VERIFY_SHA256 ? "sha256" : "xxhash", io_u,
+		nr_hdrs);
+
+	for (i = 0; i < nr_hdrs; i += nr) {
+		nr = min(nr_hdrs - i, (unsigned int) VERIFY_MB_LANES);
+		for (j = 0; j < nr; j++) {
+			hdrs[j] = io_u->buf + (i + j) * hdr_inc;
+			__fill_hdr(td, io_u, hdrs[j], i + j, hdr_inc,
+				   io_u->rand_seed);
+			data[j] = (uint8_t *) hdrs[j] + header_size;
+			len[j] = hdr_inc - header_size;
+		}
+
+		if (td->o.verify == VERIFY_SHA256) {
+			uint8_t *out[VERIFY_MB_LANES];
+
+			for (j = 0; j < nr; j++) {
+				struct vhdr_sha256 *vh = hdr_priv(hdrs[j]);
+
+				out[j] = vh->sha256;
+			}
+			fio_sha256_multi(data, len, out, nr);
+		} else {
+			uint32_t hash[VERIFY_MB_LANES];
+
+			XXH32_multi((const void **) data, len, 1, hash, nr);
+			for (j = 0; j < nr; j++) {
+				struct vhdr_xxhash *vh = hdr_priv(hdrs[j]);
+
+				vh->hash = hash[j];
+			}
+		}
+	}
+
+	return true;
+}
+
 /*
  * fill body of io_u->buf with random data and add a header with the
  * checksum of choice
@@ -1403,6 +1684,43 @@ void populate_verify_io_u(struct thread_data *td, struct io_u *io_u)
 	fill_pattern_headers(td, io_u, 0, 0);
 }
 
+/*
+ * Take the next written block out of the verify maps. Blocks come back in
+ * file and offset order, like the rbtree would return them.
+ */
+static bool get_next_verify_block(struct thread_data *td, struct io_u *io_u)
+{
+	unsigned long long bs = td->o.min_bs[DDIR_WRITE];
+
+	for (; td->verify_map_file < td->o.nr_files;
+	     td->verify_map_file++, td->verify_map_next = 0) {
+		struct fio_file *f = td->files[td->verify_map_file];
+		uint64_t block = td->verify_map_next;
+
+		if (!f || !f->verify_map ||
+		    !blockmap_next_set(f->verify_map, &block))
+			continue;
+
+		/*
+		 * Clearing can only fail to expand a full chunk. Leave the
+		 * block set then, the cursor moves past it anyway.
+		 */
+		if (blockmap_clear(f->verify_map, block) == 1)
+			td->io_hist_len--;
+		td->verify_map_next = block + 1;
+
+		io_u->offset = f->file_offset + block * bs;
+		io_u->verify_offset = io_u->offset;
+		io_u->buflen = bs;
+		io_u->numberio = td->verify_map_numberio[0];
+		io_u->file = f;
+		io_u_set(td, io_u, IO_U_F_VER_LIST | IO_U_F_VER_BITMAP);
+		return true;
+	}
+
+	return false;
+}
+
 int get_next_verify(struct thread_data *td, struct io_u *io_u)
 {
 	struct io_piece *ipo = NULL;
@@ -1439,6 +1757,30 @@ int get_next_verify(struct thread_data *td, struct io_u *io_u)
 		flist_del(&ipo->list);
 		assert(ipo->flags & IP_F_ONLIST);
 		ipo->flags &= ~IP_F_ONLIST;
+	} else if (td->o.verify_tracking == VERIFY_TRACK_BITMAP &&
+		   get_next_verify_block(td, io_u)) {
+		if (!fio_file_open(io_u->file)) {
+			int r = td_io_open_file(td, io_u->file);
+
+			if (r) {
+				dprint(FD_VERIFY, "failed file %s open\n",
+						io_u->file->file_name);
+				return 1;
+			}
+		}
+
+		get_file(io_u->file);
+		io_u->ddir = DDIR_READ;
+		io_u->xfer_buf = io_u->buf;
+		io_u->xfer_buflen = io_u->buflen;
+
+		if (!td->o.verify_pattern_bytes) {
+			io_u->rand_seed = __rand(&td->verify_state);
+			if (sizeof(int) != sizeof(long *))
+				io_u->rand_seed *= __rand(&td->verify_state);
+		}
+		dprint(FD_VERIFY, "get_next_verify: ret io_u %p\n", io_u);
+		return 0;
 	}
 
 	if (ipo) {
@@ -1496,67 +1838,128 @@ void fio_verify_init(struct thread_data *td)
 	}
 }
 
-static void *verify_async_thread(void *data)
+/*
+ * Max number of io_u's a worker takes at once. Small enough to leave work
+ * for others to steal, large enough to return io_u's in bulk.
+ */
+#define VERIFY_BATCH	8
+
+static unsigned int verify_worker_fill(struct verify_worker *w,
+				       struct io_u **io_us)
 {
-	struct thread_data *td = data;
+	struct thread_data *td = w->td;
+	unsigned int i, nr = 0;
 	struct io_u *io_u;
-	int ret = 0;
 
-	if (fio_option_is_set(&td->o, verify_cpumask) &&
-	    fio_setaffinity(td->pid, td->o.verify_cpumask)) {
-		log_err("fio: failed setting verify thread affinity\n");
-		goto done;
+	while (nr < VERIFY_BATCH && (io_u = io_u_rpop_shared(&w->ring)))
+		io_us[nr++] = io_u;
+	if (nr)
+		return nr;
+
+	/*
+	 * Our own queue is empty, take up to half a batch from the first
+	 * worker that has something queued.
+	 */
+	for (i = 1; i < td->o.verify_async; i++) {
+		struct verify_worker *v;
+
+		v = &td->verify_workers[(w->index + i) % td->o.verify_async];
+		while (nr < VERIFY_BATCH / 2 &&
+		       (io_u = io_u_rpop_shared(&v->ring)))
+			io_us[nr++] = io_u;
+		if (nr)
+			break;
 	}
 
-	do {
-		FLIST_HEAD(list);
+	return nr;
+}
 
-		read_barrier();
-		if (td->verify_thread_exit)
-			break;
+static bool verify_pending(struct thread_data *td)
+{
+	unsigned int i;
 
-		pthread_mutex_lock(&td->io_u_lock);
+	for (i = 0; i < td->o.verify_async; i++)
+		if (!io_u_rempty(&td->verify_workers[i].ring))
+			return true;
 
-		while (flist_empty(&td->verify_list) &&
-		       !td->verify_thread_exit) {
-			ret = pthread_cond_wait(&td->verify_cond,
-							&td->io_u_lock);
-			if (ret) {
-				break;
-			}
-		}
+	return false;
+}
 
-		flist_splice_init(&td->verify_list, &list);
-		pthread_mutex_unlock(&td->io_u_lock);
+static void verify_worker_sleep(struct verify_worker *w)
+{
+	struct thread_data *td = w->td;
+
+	pthread_mutex_lock(&w->lock);
+	w->sleeping = 1;
+	atomic_add(&td->verify_nr_sleeping, 1);
 
-		if (flist_empty(&list))
+	/*
+	 * Pairs with the barrier in verify_io_u_async(): either we see the
+	 * io_u it queued, or it sees that we are going to sleep.
+	 */
+	__sync_synchronize();
+	if (!verify_pending(td) && !td->verify_thread_exit)
+		pthread_cond_wait(&w->cond, &w->lock);
+
+	atomic_sub(&td->verify_nr_sleeping, 1);
+	w->sleeping = 0;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void *verify_async_thread(void *data)
+{
+	struct verify_worker *w = data;
+	struct thread_data *td = w->td;
+	struct io_u *io_us[VERIFY_BATCH];
+	struct verify_mb mb;
+	unsigned int i, nr;
+	int ret = 0;
+
+	if (fio_option_is_set(&td->o, verify_cpumask) &&
+	    fio_setaffinity(td->pid, td->o.verify_cpumask))
+		log_err("fio: failed setting verify thread affinity\n");
+
+	/*
+	 * Keep going until told to exit and all queues are drained. After
+	 * an error, io_u's are still handed back, just not verified.
+	 */
+	do {
+		nr = verify_worker_fill(w, io_us);
+		if (!nr) {
+			read_barrier();
+			if (td->verify_thread_exit)
+				break;
+			verify_worker_sleep(w);
 			continue;
+		}
 
-		while (!flist_empty(&list)) {
-			io_u = flist_first_entry(&list, struct io_u, verify_list);
-			flist_del_init(&io_u->verify_list);
+		verify_mb_init(td, &mb, io_us, nr);
+		for (i = 0; i < nr; i++) {
+			struct io_u *io_u = io_us[i];
+			int err;
 
 			io_u_set(td, io_u, IO_U_F_NO_FILE_PUT);
-			ret = verify_io_u(td, &io_u);
+			if (ret)
+				continue;
 
-			put_io_u(td, io_u);
-			if (!ret)
+			err = __verify_io_u(td, io_u, &mb, i);
+			if (!err)
 				continue;
-			if (td_non_fatal_error(td, ERROR_TYPE_VERIFY_BIT, ret)) {
-				update_error_count(td, ret);
+			if (td_non_fatal_error(td, ERROR_TYPE_VERIFY_BIT, err)) {
+				update_error_count(td, err);
 				td_clear_error(td);
-				ret = 0;
+				continue;
 			}
+
+			ret = err;
+			td_verror(td, ret, "async_verify");
+			if (td->o.verify_fatal)
+				fio_mark_td_terminate(td);
 		}
-	} while (!ret);
 
-	if (ret) {
-		td_verror(td, ret, "async_verify");
-		if (td->o.verify_fatal)
-			fio_mark_td_terminate(td);
-	}
+		put_io_u_batch(td, io_us, nr);
+	} while (1);
 
-done:
 	pthread_mutex_lock(&td->io_u_lock);
 	td->nr_verify_threads--;
 	pthread_cond_signal(&td->free_cond);
@@ -1565,44 +1968,92 @@ done:
 	return NULL;
 }
 
+static void verify_workers_free(struct thread_data *td, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		struct verify_worker *w = &td->verify_workers[i];
+
+		io_u_rexit(&w->ring);
+		pthread_cond_destroy(&w->cond);
+		pthread_mutex_destroy(&w->lock);
+	}
+
+	free(td->verify_workers);
+	td->verify_workers = NULL;
+}
+
+static void verify_workers_wake_all(struct thread_data *td)
+{
+	unsigned int i;
+
+	td->verify_thread_exit = 1;
+	write_barrier();
+
+	for (i = 0; i < td->o.verify_async; i++)
+		verify_worker_wake(&td->verify_workers[i]);
+}
+
 int verify_async_init(struct thread_data *td)
 {
-	int i, ret;
+	unsigned int i;
+	int ret;
 	pthread_attr_t attr;
 
+	td->verify_thread_exit = 0;
+	td->verify_next = 0;
+	td->verify_nr_sleeping = 0;
+
+	/*
+	 * Any worker may end up holding every io_u, size the rings for that
+	 */
+	td->verify_workers = calloc(td->o.verify_async,
+				    sizeof(struct verify_worker));
+	if (!td->verify_workers)
+		return 1;
+	for (i = 0; i < td->o.verify_async; i++) {
+		struct verify_worker *w = &td->verify_workers[i];
+
+		w->td = td;
+		w->index = i;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+		if (!io_u_rinit(&w->ring, td->o.iodepth)) {
+			log_err("fio: failed allocating verify queues\n");
+			verify_workers_free(td, i + 1);
+			return 1;
+		}
+	}
+
 	pthread_attr_init(&attr);
 	pthread_attr_setstacksize(&attr, 2 * PTHREAD_STACK_MIN);
 
-	td->verify_thread_exit = 0;
-
-	td->verify_threads = malloc(sizeof(pthread_t) * td->o.verify_async);
 	for (i = 0; i < td->o.verify_async; i++) {
-		ret = pthread_create(&td->verify_threads[i], &attr,
-					verify_async_thread, td);
+		struct verify_worker *w = &td->verify_workers[i];
+
+		ret = pthread_create(&w->thread, &attr, verify_async_thread, w);
 		if (ret) {
 			log_err("fio: async verify creation failed: %s\n",
 					strerror(ret));
 			break;
 		}
-		ret = pthread_detach(td->verify_threads[i]);
+		ret = pthread_detach(w->thread);
 		if (ret) {
 			log_err("fio: async verify thread detach failed: %s\n",
 					strerror(ret));
 			break;
 		}
+		pthread_mutex_lock(&td->io_u_lock);
 		td->nr_verify_threads++;
+		pthread_mutex_unlock(&td->io_u_lock);
 	}
 
 	pthread_attr_destroy(&attr);
 
 	if (i != td->o.verify_async) {
 		log_err("fio: only %d verify threads started, exiting\n", i);
-
-		pthread_mutex_lock(&td->io_u_lock);
-		td->verify_thread_exit = 1;
-		pthread_cond_broadcast(&td->verify_cond);
-		pthread_mutex_unlock(&td->io_u_lock);
-
+		verify_workers_wake_all(td);
 		return 1;
 	}
 
@@ -1611,16 +2062,17 @@ int verify_async_init(struct thread_data *td)
 
 void verify_async_exit(struct thread_data *td)
 {
-	pthread_mutex_lock(&td->io_u_lock);
-	td->verify_thread_exit = 1;
-	pthread_cond_broadcast(&td->verify_cond);
+	if (!td->verify_workers)
+		return;
 
+	verify_workers_wake_all(td);
+
+	pthread_mutex_lock(&td->io_u_lock);
 	while (td->nr_verify_threads)
 		pthread_cond_wait(&td->free_cond, &td->io_u_lock);
-
 	pthread_mutex_unlock(&td->io_u_lock);
-	free(td->verify_threads);
-	td->verify_threads = NULL;
+
+	verify_workers_free(td, td->o.verify_async);
 }
 
 int paste_blockoff(char *buf, unsigned int len, void *priv)
@@ -1635,6 +2087,38 @@ int paste_blockoff(char *buf, unsigned int len, void *priv)
 	return 0;
 }
 
+static void fill_thread_io_list(struct thread_data *td,
+				struct thread_io_list *s, int index)
+{
+	/*
+	 * Read the issue count first. A write is put in the inflight list
+	 * before the count covers it, so anything below the count that isn't
+	 * found in the list has completed.
+	 */
+	s->numberio = cpu_to_le64((uint64_t) atomic_load_acquire(&td->inflight_issued));
+	for (int i = 0; i < td->o.iodepth; i++)
+		s->inflight[i].numberio = cpu_to_le64(atomic_load_acquire(&td->inflight_numberio[i]));
+
+	s->depth = cpu_to_le32((uint32_t) td->o.iodepth);
+	s->index = cpu_to_le64((uint64_t) index);
+	if (td->random_state.use64) {
+		s->rand.state64.s[0] = cpu_to_le64(td->random_state.state64.s1);
+		s->rand.state64.s[1] = cpu_to_le64(td->random_state.state64.s2);
+		s->rand.state64.s[2] = cpu_to_le64(td->random_state.state64.s3);
+		s->rand.state64.s[3] = cpu_to_le64(td->random_state.state64.s4);
+		s->rand.state64.s[4] = cpu_to_le64(td->random_state.state64.s5);
+		s->rand.state64.s[5] = 0;
+		s->rand.use64 = cpu_to_le64((uint64_t)1);
+	} else {
+		s->rand.state32.s[0] = cpu_to_le32(td->random_state.state32.s1);
+		s->rand.state32.s[1] = cpu_to_le32(td->random_state.state32.s2);
+		s->rand.state32.s[2] = cpu_to_le32(td->random_state.state32.s3);
+		s->rand.state32.s[3] = 0;
+		s->rand.use64 = 0;
+	}
+	snprintf((char *) s->name, sizeof(s->name), "%s", td->o.name);
+}
+
 struct all_io_list *get_all_io_list(int save_mask, size_t *sz)
 {
 	struct all_io_list *rep;
@@ -1676,28 +2160,7 @@ struct all_io_list *get_all_io_list(int save_mask, size_t *sz)
 		if (save_mask != IO_LIST_ALL && (__td_index + 1) != save_mask)
 			continue;
 
-		for (int i = 0; i < td->o.iodepth; i++)
-			s->inflight[i].numberio = cpu_to_le64(atomic_load_acquire(&td->inflight_numberio[i]));
-
-		s->depth = cpu_to_le32((uint32_t) td->o.iodepth);
-		s->numberio = cpu_to_le64((uint64_t) atomic_load_acquire(&td->inflight_issued));
-		s->index = cpu_to_le64((uint64_t) __td_index);
-		if (td->random_state.use64) {
-			s->rand.state64.s[0] = cpu_to_le64(td->random_state.state64.s1);
-			s->rand.state64.s[1] = cpu_to_le64(td->random_state.state64.s2);
-			s->rand.state64.s[2] = cpu_to_le64(td->random_state.state64.s3);
-			s->rand.state64.s[3] = cpu_to_le64(td->random_state.state64.s4);
-			s->rand.state64.s[4] = cpu_to_le64(td->random_state.state64.s5);
-			s->rand.state64.s[5] = 0;
-			s->rand.use64 = cpu_to_le64((uint64_t)1);
-		} else {
-			s->rand.state32.s[0] = cpu_to_le32(td->random_state.state32.s1);
-			s->rand.state32.s[1] = cpu_to_le32(td->random_state.state32.s2);
-			s->rand.state32.s[2] = cpu_to_le32(td->random_state.state32.s3);
-			s->rand.state32.s[3] = 0;
-			s->rand.use64 = 0;
-		}
-		snprintf((char *) s->name, sizeof(s->name), "%s", td->o.name);
+		fill_thread_io_list(td, s, __td_index);
 		next = io_list_next(s);
 	} end_for_each();
 
@@ -1778,6 +2241,14 @@ void __verify_save_state(struct all_io_list *state, const char *prefix)
 	}
 }
 
+static void verify_state_prefix(char *prefix)
+{
+	if (aux_path)
+		sprintf(prefix, "%s%clocal", aux_path, FIO_OS_PATH_SEPARATOR);
+	else
+		strcpy(prefix, "local");
+}
+
 void verify_save_state(int mask)
 {
 	struct all_io_list *state;
@@ -1787,11 +2258,7 @@ void verify_save_state(int mask)
 	if (state) {
 		char prefix[PATH_MAX];
 
-		if (aux_path)
-			sprintf(prefix, "%s%clocal", aux_path, FIO_OS_PATH_SEPARATOR);
-		else
-			strcpy(prefix, "local");
-
+		verify_state_prefix(prefix);
 		__verify_save_state(state, prefix);
 		free(state);
 	}
@@ -1846,9 +2313,12 @@ int verify_state_hdr(struct verify_state_hdr *hdr, struct thread_io_list *s)
 	return 0;
 }
 
+static int verify_load_journal(struct thread_data *td, const char *prefix);
+
 int verify_load_state(struct thread_data *td, const char *prefix)
 {
 	struct verify_state_hdr hdr;
+	char out[PATH_MAX];
 	void *s = NULL;
 	uint64_t crc;
 	ssize_t ret;
@@ -1857,6 +2327,18 @@ int verify_load_state(struct thread_data *td, const char *prefix)
 	if (!td->o.verify_state)
 		return 0;
 
+	/*
+	 * Without a state file the write job didn't exit cleanly, fall back
+	 * to its last checkpoint if it kept a journal.
+	 */
+	verify_state_gen_name(out, sizeof(out), td->o.name, prefix,
+				td->thread_number - 1);
+	if (access(out, F_OK) && errno == ENOENT) {
+		ret = verify_load_journal(td, prefix);
+		if (ret >= 0)
+			return ret;
+	}
+
 	fd = open_state_file(td->o.name, prefix, td->thread_number - 1, 0);
 	if (fd == -1)
 		return 1;
@@ -1936,3 +2418,269 @@ int verify_state_should_stop(struct thread_data *td, uint64_t numberio)
 
 	return 0;
 }
+
+/*
+ * Periodic verify state checkpoints. The write job creates the journal,
+ * the helper thread snapshots its progress into it every
+ * verify_state_interval msec. A snapshot counts completed writes, which
+ * are only durable if the job writes with sync= or direct=, nothing here
+ * flushes the data files.
+ */
+unsigned int vstate_journal_msec;
+
+struct vstate_journal {
+	int fd;
+	uint64_t seq;
+	uint64_t crc;
+	size_t slot_sz;
+	struct timespec last;
+	struct verify_state_journal_rec *rec;
+};
+
+static struct vstate_journal *vstate_journals;
+static int nr_vstate_journals;
+
+bool verify_state_journal_enabled(struct thread_data *td)
+{
+	struct thread_options *o = &td->o;
+
+	return o->verify_state_interval && o->verify_state_save &&
+		o->verify != VERIFY_NONE && td_write(td) && !o->verify_only;
+}
+
+/*
+ * Round slots up to 4k so each one is written with whole sectors
+ */
+static size_t vstate_journal_slot_sz(unsigned int depth)
+{
+	size_t sz = sizeof(struct verify_state_journal_rec) +
+			__thread_io_list_sz(depth);
+
+	return (sz + 4095) & ~(size_t) 4095;
+}
+
+static void vstate_journal_name(char *out, size_t size, const char *name,
+				const char *prefix, int num)
+{
+	verify_state_gen_name(out, size - 8, name, prefix, num);
+	strcat(out, ".journal");
+}
+
+/*
+ * Called by the job before it issues any I/O. Any state file left behind
+ * by an earlier run is stale now and would be preferred over the journal
+ * when loading, so remove it.
+ */
+int verify_state_journal_init(struct thread_data *td)
+{
+	char prefix[PATH_MAX], out[PATH_MAX];
+	int flags = O_CREAT | O_TRUNC | O_WRONLY;
+	int fd;
+
+#ifdef _WIN32
+	flags |= O_BINARY;
+#endif
+
+	verify_state_prefix(prefix);
+	verify_state_gen_name(out, sizeof(out), td->o.name, prefix,
+				td->thread_number - 1);
+	if (unlink(out) < 0 && errno != ENOENT)
+		log_err("fio: failed removing stale state file %s: %s\n", out,
+				strerror(errno));
+
+	vstate_journal_name(out, sizeof(out), td->o.name, prefix,
+				td->thread_number - 1);
+	fd = open(out, flags, 0644);
+	if (fd == -1) {
+		td_verror(td, errno, "open verify state journal");
+		return 1;
+	}
+	if (ftruncate(fd, 2 * vstate_journal_slot_sz(td->o.iodepth)) < 0 ||
+	    fsync(fd) < 0) {
+		td_verror(td, errno, "create verify state journal");
+		close(fd);
+		return 1;
+	}
+
+	close(fd);
+	return 0;
+}
+
+static int vstate_journal_write(struct thread_data *td,
+				struct vstate_journal *j, int index)
+{
+	struct verify_state_journal_rec *rec;
+	struct thread_io_list *s;
+	size_t size;
+	uint64_t crc;
+
+	if (j->fd == -1) {
+		char prefix[PATH_MAX], out[PATH_MAX];
+		int flags = O_WRONLY | O_SYNC;
+
+#ifdef _WIN32
+		flags |= O_BINARY;
+#endif
+		verify_state_prefix(prefix);
+		vstate_journal_name(out, sizeof(out), td->o.name, prefix, index);
+		j->fd = open(out, flags);
+		if (j->fd == -1) {
+			log_err("fio: open verify state journal %s: %s\n", out,
+					strerror(errno));
+			return 1;
+		}
+
+		j->slot_sz = vstate_journal_slot_sz(td->o.iodepth);
+		j->rec = calloc(1, j->slot_sz);
+	}
+
+	rec = j->rec;
+	s = (struct thread_io_list *) (rec + 1);
+	fill_thread_io_list(td, s, index);
+	size = thread_io_list_sz(s);
+
+	/*
+	 * Nothing was issued or completed since the last checkpoint
+	 */
+	crc = fio_crc32c((void *) s, size);
+	if (j->seq && crc == j->crc)
+		return 0;
+	j->crc = crc;
+
+	rec->version = cpu_to_le64((uint64_t) VSTATE_JOURNAL_VERSION);
+	rec->seq = cpu_to_le64(++j->seq);
+	rec->size = cpu_to_le64((uint64_t) size);
+	rec->crc = cpu_to_le64((uint64_t) fio_crc32c((void *) &rec->version,
+				sizeof(*rec) - sizeof(rec->crc) + size));
+
+	if (pwrite(j->fd, rec, j->slot_sz, (j->seq & 1) * j->slot_sz) !=
+	    j->slot_sz) {
+		log_err("fio: failed to write verify state journal: %s\n",
+				strerror(errno));
+		return 1;
+	}
+
+	dprint(FD_VERIFY, "vstate journal %d seq=%"PRIu64" numberio=%"PRIu64"\n",
+			index, j->seq, (uint64_t) le64_to_cpu(s->numberio));
+	return 0;
+}
+
+int verify_state_journal_flush(void)
+{
+	if (!vstate_journals) {
+		vstate_journals = calloc(thread_number, sizeof(*vstate_journals));
+		if (!vstate_journals)
+			return 0;
+		nr_vstate_journals = thread_number;
+		for (int i = 0; i < nr_vstate_journals; i++)
+			vstate_journals[i].fd = -1;
+	}
+
+	for_each_td(td) {
+		struct vstate_journal *j;
+
+		if (__td_index >= nr_vstate_journals)
+			break;
+		if (!verify_state_journal_enabled(td) || !td->inflight_numberio)
+			continue;
+		if (td->runstate < TD_RUNNING || td->runstate >= TD_FINISHING)
+			continue;
+
+		/* the timer runs at the shortest interval of all jobs */
+		j = &vstate_journals[__td_index];
+		if (j->seq && mtime_since_now(&j->last) + vstate_journal_msec / 2 <
+		    td->o.verify_state_interval)
+			continue;
+
+		fio_gettime(&j->last, NULL);
+		if (vstate_journal_write(td, j, __td_index)) {
+			/* don't retry every interval */
+			td->o.verify_state_interval = 0;
+		}
+	} end_for_each();
+
+	return 0;
+}
+
+void verify_state_journal_close(void)
+{
+	for (int i = 0; i < nr_vstate_journals; i++) {
+		if (vstate_journals[i].fd != -1)
+			close(vstate_journals[i].fd);
+		free(vstate_journals[i].rec);
+	}
+
+	free(vstate_journals);
+	vstate_journals = NULL;
+	nr_vstate_journals = 0;
+}
+
+/*
+ * Load the newest valid checkpoint from the journal. Returns -1 if there
+ * is no journal.
+ */
+static int verify_load_journal(struct thread_data *td, const char *prefix)
+{
+	struct verify_state_journal_rec *rec, *best = NULL;
+	char out[PATH_MAX];
+	struct stat sb;
+	size_t slot_sz;
+	void *buf, *s;
+	int fd, i;
+
+	vstate_journal_name(out, sizeof(out), td->o.name, prefix,
+				td->thread_number - 1);
+	fd = open(out, O_RDONLY);
+	if (fd == -1)
+		return -1;
+
+	if (fstat(fd, &sb) < 0 || !sb.st_size || (sb.st_size & 1)) {
+		log_err("fio: bad verify state journal %s\n", out);
+		close(fd);
+		return 1;
+	}
+
+	buf = malloc(sb.st_size);
+	if (read(fd, buf, sb.st_size) != sb.st_size) {
+		log_err("fio: failed reading verify state journal %s\n", out);
+		goto err;
+	}
+
+	slot_sz = sb.st_size / 2;
+	for (i = 0; i < 2; i++) {
+		uint64_t size;
+
+		rec = buf + i * slot_sz;
+		size = le64_to_cpu(rec->size);
+		if (le64_to_cpu(rec->version) != VSTATE_JOURNAL_VERSION ||
+		    size > slot_sz - sizeof(*rec) ||
+		    size < sizeof(struct thread_io_list))
+			continue;
+		if (fio_crc32c((void *) &rec->version,
+		    sizeof(*rec) - sizeof(rec->crc) + size) !=
+		    le64_to_cpu(rec->crc))
+			continue;
+		if (!best || le64_to_cpu(rec->seq) > le64_to_cpu(best->seq))
+			best = rec;
+	}
+
+	if (!best) {
+		log_err("fio: no valid checkpoint in verify state journal %s\n",
+				out);
+		goto err;
+	}
+
+	log_info("fio: loaded verify state checkpoint %llu from %s\n",
+			(unsigned long long) le64_to_cpu(best->seq), out);
+
+	s = malloc(le64_to_cpu(best->size));
+	memcpy(s, best + 1, le64_to_cpu(best->size));
+	free(buf);
+	close(fd);
+	verify_assign_state(td, s);
+	return 0;
+err:
+	free(buf);
+	close(fd);
+	return 1;
+}
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include "../../lib/blockmap.h"
+#include "../unittest.h"
+
+#define CHUNK_BITS	65536ULL
+
+static void test_blockmap_set_clear(void)
+{
+	struct blockmap *bm = blockmap_new();
+	uint64_t bit;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(bm);
+
+	CU_ASSERT_EQUAL(blockmap_set(bm, 5), 1);
+	CU_ASSERT_EQUAL(blockmap_set(bm, 5), 0);
+	CU_ASSERT_EQUAL(blockmap_set(bm, 3 * CHUNK_BITS + 7), 1);
+	CU_ASSERT_EQUAL(blockmap_weight(bm), 2);
+	CU_ASSERT_TRUE(blockmap_isset(bm, 5));
+	CU_ASSERT_FALSE(blockmap_isset(bm, 6));
+	CU_ASSERT_FALSE(blockmap_isset(bm, 100 * CHUNK_BITS));
+
+	bit = 6;
+	CU_ASSERT_TRUE(blockmap_next_set(bm, &bit));
+	CU_ASSERT_EQUAL(bit, 3 * CHUNK_BITS + 7);
+	bit++;
+	CU_ASSERT_FALSE(blockmap_next_set(bm, &bit));
+
+	CU_ASSERT_EQUAL(blockmap_clear(bm, 5), 1);
+	CU_ASSERT_EQUAL(blockmap_clear(bm, 5), 0);
+	CU_ASSERT_EQUAL(blockmap_clear(bm, 100 * CHUNK_BITS), 0);
+	CU_ASSERT_EQUAL(blockmap_weight(bm), 1);
+
+	blockmap_reset(bm);
+	CU_ASSERT_EQUAL(blockmap_weight(bm), 0);
+	bit = 0;
+	CU_ASSERT_FALSE(blockmap_next_set(bm, &bit));
+
+	blockmap_free(bm);
+}
+
+/*
+ * A completely set chunk is collapsed, and must behave exactly like the
+ * expanded bitmap when walked and when bits are cleared from it again.
+ */
+static void test_blockmap_full_chunk(void)
+{
+	struct blockmap *bm = blockmap_new();
+	uint64_t i, bit;
+	size_t mem;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(bm);
+
+	for (i = CHUNK_BITS; i < 2 * CHUNK_BITS; i++)
+		blockmap_set(bm, i);
+	CU_ASSERT_EQUAL(blockmap_weight(bm), CHUNK_BITS);
+	mem = blockmap_mem(bm);
+	CU_ASSERT_TRUE(mem < CHUNK_BITS / 8);
+	CU_ASSERT_EQUAL(blockmap_set(bm, CHUNK_BITS + 10), 0);
+
+	bit = 0;
+	CU_ASSERT_TRUE(blockmap_next_set(bm, &bit));
+	CU_ASSERT_EQUAL(bit, CHUNK_BITS);
+	bit = CHUNK_BITS + 1000;
+	CU_ASSERT_TRUE(blockmap_next_set(bm, &bit));
+	CU_ASSERT_EQUAL(bit, CHUNK_BITS + 1000);
+
+	CU_ASSERT_EQUAL(blockmap_clear(bm, CHUNK_BITS + 1000), 1);
+	CU_ASSERT_FALSE(blockmap_isset(bm, CHUNK_BITS + 1000));
+	CU_ASSERT_TRUE(blockmap_isset(bm, CHUNK_BITS + 999));
+	CU_ASSERT_TRUE(blockmap_isset(bm, CHUNK_BITS + 1001));
+	bit = CHUNK_BITS + 1000;
+	CU_ASSERT_TRUE(blockmap_next_set(bm, &bit));
+	CU_ASSERT_EQUAL(bit, CHUNK_BITS + 1001);
+
+	/* draining it in order visits every remaining bit once */
+	for (i = 0, bit = 0; blockmap_next_set(bm, &bit); bit++, i++)
+		CU_ASSERT_EQUAL(blockmap_clear(bm, bit), 1);
+	CU_ASSERT_EQUAL(i, CHUNK_BITS - 1);
+	CU_ASSERT_EQUAL(blockmap_weight(bm), 0);
+	CU_ASSERT_TRUE(blockmap_mem(bm) <= mem);
+
+	blockmap_free(bm);
+}
+
+static struct fio_unittest_entry tests[] = {
+	{
+		.name	= "blockmap/set_clear",
+		.fn	= test_blockmap_set_clear,
+	},
+	{
+		.name	= "blockmap/full_chunk",
+		.fn	= test_blockmap_full_chunk,
+	},
+	{
+		.name	= NULL,
+	},
+};
+
+CU_ErrorCode fio_unittest_lib_blockmap(void)
+{
+	return fio_unittest_add_suite("lib/blockmap.c", NULL, NULL, tests);
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../../compiler/compiler.h"
+#include "../../lib/rand.h"
+#include "../unittest.h"
+
+/*
+ * Straightforward version of __fill_random_buf(), one row of seed buckets
+ * at a time. The vectorized versions must produce the same bytes, or
+ * verification of data written by another fio build breaks.
+ */
+static uint64_t ref_step(uint64_t x)
+{
+	return x * 0x61C8864680B583EBull;
+}
+
+static void ref_fill_random_buf(void *buf, unsigned int len, uint64_t seed)
+{
+	static const uint64_t prime[] = {1, 2, 3, 5, 7, 11, 13, 17,
+					 19, 23, 29, 31, 37, 41, 43, 47};
+	uint64_t s[CONFIG_SEED_BUCKETS];
+	unsigned int rows, i, p;
+	uint64_t *b = buf;
+
+	for (p = 0; p < CONFIG_SEED_BUCKETS; p++)
+		s[p] = seed * prime[p];
+
+	rows = len / sizeof(uint64_t) / CONFIG_SEED_BUCKETS;
+	for (i = 0; i < rows; i++) {
+		for (p = 0; p < CONFIG_SEED_BUCKETS; p++) {
+			*b++ = s[p];
+			s[p] = ref_step(s[p]);
+		}
+	}
+
+	seed = s[0];
+	len -= rows * CONFIG_SEED_BUCKETS * sizeof(uint64_t);
+	for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+		*b++ = seed;
+		seed = ref_step(seed);
+	}
+	memcpy(b, &seed, len);
+}
+
+static void check_fill(unsigned int len, unsigned int offset, uint64_t seed)
+{
+	unsigned char *buf, *ref;
+
+	buf = calloc(1, len + offset + 16);
+	ref = calloc(1, len + offset + 16);
+
+	__fill_random_buf(buf + offset, len, seed);
+	ref_fill_random_buf(ref + offset, len, seed);
+	CU_ASSERT_EQUAL(memcmp(buf, ref, len + offset + 16), 0);
+
+	free(buf);
+	free(ref);
+}
+
+static void test_fill_random_buf_small(void)
+{
+	unsigned int len;
+
+	for (len = 0; len < 4096; len++)
+		check_fill(len, len & 7, len * 7919 + 1);
+}
+
+static void test_fill_random_buf_large(void)
+{
+	unsigned int len;
+
+	for (len = 128 * 1024 - 520; len <= 128 * 1024; len += 8)
+		check_fill(len, 0, len);
+
+	check_fill(1024 * 1024, 0, 0x61c8864680b583ebULL);
+}
+
+static void check_jump(bool use64, uint64_t stride)
+{
+	static const uint64_t ns[] = { 0, 1, 2, 3, 17, 255, 1000, 4097 };
+	struct frand_state fs, ref;
+	struct frand_jump j;
+	uint64_t steps;
+	unsigned int i;
+
+	CU_ASSERT_EQUAL_FATAL(frand_jump_init(&j, use64, stride, 4097), 0);
+
+	for (i = 0; i < FIO_ARRAY_SIZE(ns); i++) {
+		init_rand_seed(&fs, 0x12345 + i, use64);
+		frand_copy(&ref, &fs);
+
+		frand_jump(&j, &fs, ns[i]);
+		for (steps = 0; steps < ns[i] * stride; steps++)
+			__rand(&ref);
+
+		CU_ASSERT_EQUAL(__rand(&fs), __rand(&ref));
+	}
+
+	frand_jump_free(&j);
+}
+
+static void test_frand_jump(void)
+{
+	check_jump(false, 1);
+	check_jump(false, 6);
+	check_jump(true, 1);
+	check_jump(true, 2);
+	check_jump(true, 16);
+}
+
+static struct fio_unittest_entry tests[] = {
+	{
+		.name	= "fill_random_buf/small",
+		.fn	= test_fill_random_buf_small,
+	},
+	{
+		.name	= "fill_random_buf/large",
+		.fn	= test_fill_random_buf_large,
+	},
+	{
+		.name	= "frand_jump",
+		.fn	= test_frand_jump,
+	},
+	{
+		.name	= NULL,
+	},
+};
+
+CU_ErrorCode fio_unittest_lib_rand(void)
+{
+	return fio_unittest_add_suite("lib/rand.c", NULL, NULL, tests);
+}
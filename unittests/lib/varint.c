@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "../../lib/varint.h"
+#include "../../compiler/compiler.h"
+#include "../unittest.h"
+
+static const uint64_t vals[] = {
+	0, 1, 127, 128, 16383, 16384, 1ULL << 32, (1ULL << 63) - 1,
+	1ULL << 63, ~0ULL, 5, 5, 5, 4096, 4096, 0, 0, 0, 0, 3,
+};
+
+static void test_varint_put_get(void)
+{
+	uint8_t buf[VARINT_MAX_LEN];
+	unsigned int i;
+	uint64_t v;
+	size_t len;
+
+	CU_ASSERT_EQUAL(varint_put(buf, 127), 1);
+	CU_ASSERT_EQUAL(varint_put(buf, 128), 2);
+	CU_ASSERT_EQUAL(varint_put(buf, ~0ULL), VARINT_MAX_LEN);
+
+	for (i = 0; i < FIO_ARRAY_SIZE(vals); i++) {
+		len = varint_put(buf, vals[i]);
+		CU_ASSERT_EQUAL(varint_get(buf, buf + len, &v), len);
+		CU_ASSERT_EQUAL(v, vals[i]);
+		/* truncated */
+		CU_ASSERT_EQUAL(varint_get(buf, buf + len - 1, &v), 0);
+	}
+
+	CU_ASSERT_EQUAL(zigzag_enc(0), 0);
+	CU_ASSERT_EQUAL(zigzag_enc(-1), 1);
+	CU_ASSERT_EQUAL(zigzag_enc(1), 2);
+	CU_ASSERT_EQUAL(zigzag_dec(zigzag_enc(INT64_MIN)), INT64_MIN);
+	CU_ASSERT_EQUAL(zigzag_dec(zigzag_enc(INT64_MAX)), INT64_MAX);
+}
+
+static void test_varint_arrays(void)
+{
+	uint8_t buf[2 * VARINT_MAX_LEN * FIO_ARRAY_SIZE(vals)];
+	uint64_t out[FIO_ARRAY_SIZE(vals)];
+	size_t nr = FIO_ARRAY_SIZE(vals);
+	unsigned int i;
+	size_t len;
+
+	len = varint_enc(buf, vals, nr);
+	CU_ASSERT_EQUAL(varint_dec(buf, len, out, nr), len);
+	for (i = 0; i < nr; i++)
+		CU_ASSERT_EQUAL(out[i], vals[i]);
+	CU_ASSERT_EQUAL(varint_dec(buf, len - 1, out, nr), -1);
+
+	len = varint_enc_delta(buf, vals, nr);
+	CU_ASSERT_EQUAL(varint_dec_delta(buf, len, out, nr), len);
+	for (i = 0; i < nr; i++)
+		CU_ASSERT_EQUAL(out[i], vals[i]);
+
+	len = varint_enc_rle(buf, vals, nr);
+	CU_ASSERT_EQUAL(varint_dec_rle(buf, len, out, nr), len);
+	for (i = 0; i < nr; i++)
+		CU_ASSERT_EQUAL(out[i], vals[i]);
+	/* runs past the end of the array */
+	CU_ASSERT_EQUAL(varint_dec_rle(buf, len, out, nr - 2), -1);
+}
+
+/*
+ * Monotonic timestamps and repeated values must shrink
+ */
+static void test_varint_compact(void)
+{
+	uint64_t in[1000], out[1000];
+	uint8_t buf[2 * VARINT_MAX_LEN * 1000];
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < FIO_ARRAY_SIZE(in); i++)
+		in[i] = 1000000000ULL + i * 3;
+
+	len = varint_enc_delta(buf, in, FIO_ARRAY_SIZE(in));
+	CU_ASSERT(len <= 5 + FIO_ARRAY_SIZE(in));
+	CU_ASSERT_EQUAL(varint_dec_delta(buf, len, out, FIO_ARRAY_SIZE(in)), len);
+	for (i = 0; i < FIO_ARRAY_SIZE(in); i++)
+		CU_ASSERT_EQUAL(out[i], in[i]);
+
+	for (i = 0; i < FIO_ARRAY_SIZE(in); i++)
+		in[i] = i < 600 ? 4096 : 65536;
+
+	len = varint_enc_rle(buf, in, FIO_ARRAY_SIZE(in));
+	CU_ASSERT(len <= 10);
+	CU_ASSERT_EQUAL(varint_dec_rle(buf, len, out, FIO_ARRAY_SIZE(in)), len);
+	for (i = 0; i < FIO_ARRAY_SIZE(in); i++)
+		CU_ASSERT_EQUAL(out[i], in[i]);
+}
+
+static void test_varint_sparse(void)
+{
+	uint64_t in[3][64], out[3][64];
+	uint8_t buf[3 * (2 * 64 + 1) * VARINT_MAX_LEN];
+	unsigned int i, j;
+	size_t len;
+
+	memset(in, 0, sizeof(in));
+	/* row 0 stays empty */
+	in[1][0] = 7;
+	in[1][63] = 1ULL << 40;
+	for (i = 0; i < 64; i++)
+		in[2][i] = i + 1;
+
+	len = varint_enc_sparse(buf, &in[0][0], 3, 64);
+	CU_ASSERT_EQUAL(varint_dec_sparse(buf, len, &out[0][0], 3, 64), len);
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 64; j++)
+			CU_ASSERT_EQUAL(out[i][j], in[i][j]);
+
+	/* entries beyond the row length are rejected */
+	CU_ASSERT_EQUAL(varint_dec_sparse(buf, len, &out[0][0], 3, 32), -1);
+	CU_ASSERT_EQUAL(varint_dec_sparse(buf, len - 1, &out[0][0], 3, 64), -1);
+}
+
+static struct fio_unittest_entry tests[] = {
+	{
+		.name	= "varint/put_get",
+		.fn	= test_varint_put_get,
+	},
+	{
+		.name	= "varint/arrays",
+		.fn	= test_varint_arrays,
+	},
+	{
+		.name	= "varint/compact",
+		.fn	= test_varint_compact,
+	},
+	{
+		.name	= "varint/sparse",
+		.fn	= test_varint_sparse,
+	},
+	{
+		.name	= NULL,
+	},
+};
+
+CU_ErrorCode fio_unittest_lib_varint(void)
+{
+	return fio_unittest_add_suite("lib/varint.c", NULL, NULL, tests);
+}
@@ -51,6 +51,10 @@ int main(void)
 	fio_unittest_register(fio_unittest_lib_num2str);
 	fio_unittest_register(fio_unittest_lib_strntol);
 	fio_unittest_register(fio_unittest_lib_pcbuf);
+	fio_unittest_register(fio_unittest_lib_rand);
+	fio_unittest_register(fio_unittest_lib_blockmap);
+	fio_unittest_register(fio_unittest_lib_philox);
+	fio_unittest_register(fio_unittest_lib_varint);
 	fio_unittest_register(fio_unittest_oslib_strlcat);
 	fio_unittest_register(fio_unittest_oslib_strndup);
 	fio_unittest_register(fio_unittest_oslib_strcasestr);
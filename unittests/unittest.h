@@ -18,6 +18,10 @@ CU_ErrorCode fio_unittest_lib_memalign(void);
 CU_ErrorCode fio_unittest_lib_num2str(void);
 CU_ErrorCode fio_unittest_lib_strntol(void);
 CU_ErrorCode fio_unittest_lib_pcbuf(void);
+CU_ErrorCode fio_unittest_lib_rand(void);
+CU_ErrorCode fio_unittest_lib_blockmap(void);
+CU_ErrorCode fio_unittest_lib_philox(void);
+CU_ErrorCode fio_unittest_lib_varint(void);
 CU_ErrorCode fio_unittest_oslib_strlcat(void);
 CU_ErrorCode fio_unittest_oslib_strndup(void);
 CU_ErrorCode fio_unittest_oslib_strcasestr(void);